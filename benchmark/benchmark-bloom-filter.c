@@ -0,0 +1,183 @@
+/*
+
+Copyright (c) 2026 Simon Howard
+
+Permission to use, copy, modify, and/or distribute this software
+for any purpose with or without fee is hereby granted, provided
+that the above copyright notice and this permission notice appear
+in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT,
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+ */
+
+/* Benchmark comparing the layouts and hashing schemes of BloomFilter.
+ *
+ * Usage: benchmark-bloom-filter [number of keys]
+ *
+ * For each number of bits per key, the time taken to insert every key,
+ * query every key and query the same number of keys that were not
+ * inserted is printed, in seconds, along with the percentage of those
+ * queries that were false positives.  The number of hash functions is
+ * the one that gives the lowest false positive rate for an unblocked
+ * filter of that size.  The wide rows use bloom_filter_new_wide, which
+ * finds the bits using double hashing. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "bloom-filter.h"
+#include "hash-int.h"
+
+#define DEFAULT_NUM_KEYS 10000000
+
+/* Filter kinds to compare, as well as the flags */
+#define NARROW_HASH 0
+#define WIDE_HASH 1
+
+static unsigned int num_keys;
+static int *present;
+static int *missing;
+
+/* Scramble the bits of an integer.  This is reversible, so different
+ * integers always give different results. */
+static unsigned int scramble(unsigned int value)
+{
+	value ^= value >> 16;
+	value *= 0x7feb352dU;
+	value ^= value >> 15;
+	value *= 0x846ca68bU;
+	value ^= value >> 16;
+
+	return value;
+}
+
+static unsigned long int_wide_hash(void *location)
+{
+	return (unsigned long) *((int *) location);
+}
+
+static double seconds_since(clock_t start)
+{
+	return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+/* Keys are scrambled even and odd numbers for inserted keys and keys
+ * that are not inserted, so that the two never overlap, but there is no
+ * pattern in the keys for a weak hash function to preserve. */
+static void generate_keys(void)
+{
+	unsigned int i;
+
+	present = malloc(sizeof(int) * num_keys);
+	missing = malloc(sizeof(int) * num_keys);
+
+	for (i = 0; i < num_keys; ++i) {
+		present[i] = (int) scramble(i * 2);
+		missing[i] = (int) scramble(i * 2 + 1);
+	}
+}
+
+static void benchmark_bloom_filter(const char *name,
+                                   unsigned int bits_per_key,
+                                   unsigned int num_functions,
+                                   int hash, unsigned int flags)
+{
+	BloomFilter *filter;
+	clock_t start;
+	double insert_time, query_time, missing_time;
+	unsigned int found;
+	unsigned int false_positives;
+	unsigned int i;
+
+	if (hash == WIDE_HASH) {
+		filter = bloom_filter_new_wide(
+		    (unsigned long) num_keys * bits_per_key, int_wide_hash,
+		    num_functions, flags);
+	} else {
+		filter = bloom_filter_new_with_flags(num_keys * bits_per_key,
+		                                     int_hash, num_functions,
+		                                     flags);
+	}
+
+	start = clock();
+	for (i = 0; i < num_keys; ++i) {
+		bloom_filter_insert(filter, &present[i]);
+	}
+	insert_time = seconds_since(start);
+
+	found = 0;
+	start = clock();
+	for (i = 0; i < num_keys; ++i) {
+		if (bloom_filter_query(filter, &present[i])) {
+			++found;
+		}
+	}
+	query_time = seconds_since(start);
+
+	false_positives = 0;
+	start = clock();
+	for (i = 0; i < num_keys; ++i) {
+		if (bloom_filter_query(filter, &missing[i])) {
+			++false_positives;
+		}
+	}
+	missing_time = seconds_since(start);
+
+	if (found != num_keys) {
+		printf("  %u keys were not found!\n", num_keys - found);
+	}
+
+	printf("  %-12s %2u bits, k=%-2u %9.3f %9.3f %9.3f %8.3f%%\n", name,
+	       bits_per_key, num_functions, insert_time, query_time,
+	       missing_time, 100.0 * false_positives / num_keys);
+
+	bloom_filter_free(filter);
+}
+
+int main(int argc, char *argv[])
+{
+	/* Bits per key, and the best number of hash functions for that
+	 * many bits, which is the number of bits times ln 2 */
+	static const unsigned int sizes[][2] = {
+		{8, 6}, {12, 8}, {16, 11}, {24, 17},
+	};
+	unsigned int i;
+
+	if (argc > 1) {
+		num_keys = (unsigned int) atoi(argv[1]);
+	} else {
+		num_keys = DEFAULT_NUM_KEYS;
+	}
+
+	printf("%u keys, times in seconds\n\n", num_keys);
+	printf("  %-27s %9s %9s %9s %9s\n", "", "insert", "query", "missing",
+	       "false +");
+
+	generate_keys();
+
+	for (i = 0; i < sizeof(sizes) / sizeof(*sizes); ++i) {
+		benchmark_bloom_filter("standard", sizes[i][0], sizes[i][1],
+		                       NARROW_HASH, 0);
+		benchmark_bloom_filter("blocked", sizes[i][0], sizes[i][1],
+		                       NARROW_HASH, BLOOM_FILTER_BLOCKED);
+		benchmark_bloom_filter("wide", sizes[i][0], sizes[i][1],
+		                       WIDE_HASH, 0);
+		benchmark_bloom_filter("wide blocked", sizes[i][0],
+		                       sizes[i][1], WIDE_HASH,
+		                       BLOOM_FILTER_BLOCKED);
+	}
+
+	free(present);
+	free(missing);
+
+	return 0;
+}
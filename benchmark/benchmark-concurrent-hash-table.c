@@ -0,0 +1,184 @@
+/*
+
+Copyright (c) 2026 Simon Howard
+
+Permission to use, copy, modify, and/or distribute this software
+for any purpose with or without fee is hereby granted, provided
+that the above copyright notice and this permission notice appear
+in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT,
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+ */
+
+/* Benchmark comparing ConcurrentHashTable against a HashTable protected
+ * by a single mutex.
+ *
+ * Usage: benchmark-concurrent-hash-table [number of keys]
+ *
+ * For each number of threads, every thread performs the same number of
+ * operations on a shared table which is already filled with the keys:
+ * nine in ten operations are lookups, and the rest replace an existing
+ * entry.  The elapsed wall clock time is printed, in seconds. */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include "compare-int.h"
+#include "concurrent-hash-table.h"
+#include "hash-int.h"
+#include "hash-table.h"
+
+#define DEFAULT_NUM_KEYS 1000000
+#define MAX_THREADS 16
+
+typedef struct {
+	ConcurrentHashTable *concurrent;
+	HashTable *locked;
+	unsigned int seed;
+} ThreadData;
+
+static unsigned int num_keys;
+static int *keys;
+static pthread_mutex_t table_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Simple xorshift generator, so that results are repeatable */
+static unsigned int next_random(unsigned int *state)
+{
+	*state ^= *state << 13;
+	*state ^= *state >> 17;
+	*state ^= *state << 5;
+
+	return *state;
+}
+
+static double now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+
+	return (double) tv.tv_sec + (double) tv.tv_usec / 1000000.0;
+}
+
+static void *concurrent_thread(void *arg)
+{
+	ThreadData *data = arg;
+	int *key;
+	unsigned int r;
+	unsigned int i;
+
+	for (i = 0; i < num_keys; ++i) {
+		r = next_random(&data->seed);
+		key = &keys[r % num_keys];
+
+		if (r % 10 == 0) {
+			concurrent_hash_table_insert(data->concurrent, key, key);
+		} else {
+			concurrent_hash_table_lookup(data->concurrent, key);
+		}
+	}
+
+	return NULL;
+}
+
+static void *locked_thread(void *arg)
+{
+	ThreadData *data = arg;
+	int *key;
+	unsigned int r;
+	unsigned int i;
+
+	for (i = 0; i < num_keys; ++i) {
+		r = next_random(&data->seed);
+		key = &keys[r % num_keys];
+
+		pthread_mutex_lock(&table_lock);
+
+		if (r % 10 == 0) {
+			hash_table_insert(data->locked, key, key);
+		} else {
+			hash_table_lookup(data->locked, key);
+		}
+
+		pthread_mutex_unlock(&table_lock);
+	}
+
+	return NULL;
+}
+
+static double run_threads(void *(*thread_func)(void *), ThreadData *template,
+                          unsigned int num_threads)
+{
+	pthread_t threads[MAX_THREADS];
+	ThreadData data[MAX_THREADS];
+	double start;
+	unsigned int i;
+
+	start = now();
+
+	for (i = 0; i < num_threads; ++i) {
+		data[i] = *template;
+		data[i].seed = 2463534242U + i;
+		pthread_create(&threads[i], NULL, thread_func, &data[i]);
+	}
+
+	for (i = 0; i < num_threads; ++i) {
+		pthread_join(threads[i], NULL);
+	}
+
+	return now() - start;
+}
+
+int main(int argc, char *argv[])
+{
+	ThreadData data;
+	double concurrent_time, locked_time;
+	unsigned int num_threads;
+	unsigned int i;
+
+	if (argc > 1) {
+		num_keys = (unsigned int) atoi(argv[1]);
+	} else {
+		num_keys = DEFAULT_NUM_KEYS;
+	}
+
+	keys = malloc(sizeof(int) * num_keys);
+
+	data.concurrent = concurrent_hash_table_new(int_hash, int_equal, 0);
+	data.locked = hash_table_new(int_hash, int_equal);
+
+	for (i = 0; i < num_keys; ++i) {
+		keys[i] = (int) i;
+		concurrent_hash_table_insert(data.concurrent, &keys[i], &keys[i]);
+		hash_table_insert(data.locked, &keys[i], &keys[i]);
+	}
+
+	printf("%u keys, %u operations per thread, times in seconds\n\n",
+	       num_keys, num_keys);
+	printf("  %-8s %12s %12s\n", "threads", "concurrent", "mutex");
+
+	for (num_threads = 1; num_threads <= MAX_THREADS; num_threads *= 2) {
+		concurrent_time =
+		    run_threads(concurrent_thread, &data, num_threads);
+		locked_time = run_threads(locked_thread, &data, num_threads);
+
+		printf("  %-8u %12.3f %12.3f\n", num_threads, concurrent_time,
+		       locked_time);
+	}
+
+	concurrent_hash_table_free(data.concurrent);
+	hash_table_free(data.locked);
+	free(keys);
+
+	return 0;
+}
@@ -0,0 +1,647 @@
+/*
+
+Copyright (c) 2026 Simon Howard
+
+Permission to use, copy, modify, and/or distribute this software
+for any purpose with or without fee is hereby granted, provided
+that the above copyright notice and this permission notice appear
+in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT,
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+ */
+
+/* Benchmark comparing the storage options of HashTable and Set.
+ *
+ * Usage: benchmark-hash-table [number of keys]
+ *
+ * For each kind of key, the time taken to insert every key, look up
+ * every key, look up the same number of keys that are not present and
+ * free the table is printed, in seconds.  Keys are inserted and looked up in a random
+ * order.  The bulk rows use hash_table_insert_many and
+ * hash_table_lookup_many, and show the number of keys found in place of
+ * the number of entries.  The thread rows time filling a table using
+ * several threads, in elapsed wall clock time rather than processor
+ * time.  Integer keys are also stored in an IntSet, which holds the
+ * integers themselves rather than pointers to them, and in a compressed
+ * RoaringBitmap, whose size once optimized is shown in bytes. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <time.h>
+
+#include "compare-int.h"
+#include "compare-string.h"
+#include "hash-int.h"
+#include "hash-string.h"
+#include "hash-table.h"
+#include "int-set.h"
+#include "roaring-bitmap.h"
+#include "set.h"
+
+#define DEFAULT_NUM_KEYS 1000000
+
+typedef struct {
+	const char *name;
+	void **present;
+	void **missing;
+	unsigned int (*hash_func)(void *value);
+	int (*equal_func)(void *value1, void *value2);
+} KeySet;
+
+static unsigned int num_keys;
+
+/* Simple xorshift generator, so that results are repeatable */
+static unsigned int random_state = 2463534242U;
+
+static unsigned int next_random(void)
+{
+	random_state ^= random_state << 13;
+	random_state ^= random_state >> 17;
+	random_state ^= random_state << 5;
+
+	return random_state;
+}
+
+/* Shuffle an array of keys.  Looking keys up in the same order that they
+ * were generated in can give an unrealistically cache-friendly access
+ * pattern. */
+static void shuffle(void **array)
+{
+	void *tmp;
+	unsigned int i, j;
+
+	for (i = num_keys; i > 1; --i) {
+		j = next_random() % i;
+		tmp = array[i - 1];
+		array[i - 1] = array[j];
+		array[j] = tmp;
+	}
+}
+
+static double seconds_since(clock_t start)
+{
+	return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+static double now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+
+	return (double) tv.tv_sec + (double) tv.tv_usec / 1000000.0;
+}
+
+/* Even values are used for keys present in the table and odd values for
+ * keys that are not, so that the two never overlap. */
+static void generate_int_keys(KeySet *keys, const char *name, int sequential)
+{
+	int *values;
+	unsigned int i;
+
+	values = malloc(sizeof(int) * num_keys * 2);
+	keys->present = malloc(sizeof(void *) * num_keys);
+	keys->missing = malloc(sizeof(void *) * num_keys);
+
+	for (i = 0; i < num_keys; ++i) {
+		if (sequential) {
+			values[i] = (int) (i * 2);
+		} else {
+			values[i] = (int) (next_random() & ~1U);
+		}
+
+		values[num_keys + i] = values[i] + 1;
+		keys->present[i] = &values[i];
+		keys->missing[i] = &values[num_keys + i];
+	}
+
+	shuffle(keys->present);
+	shuffle(keys->missing);
+
+	keys->name = name;
+	keys->hash_func = int_hash;
+	keys->equal_func = int_equal;
+}
+
+static void generate_string_keys(KeySet *keys)
+{
+	char *buf;
+	unsigned int i;
+
+	keys->present = malloc(sizeof(void *) * num_keys);
+	keys->missing = malloc(sizeof(void *) * num_keys);
+
+	for (i = 0; i < num_keys; ++i) {
+		buf = malloc(24);
+		sprintf(buf, "key-%u", i * 2);
+		keys->present[i] = buf;
+
+		buf = malloc(24);
+		sprintf(buf, "key-%u", i * 2 + 1);
+		keys->missing[i] = buf;
+	}
+
+	shuffle(keys->present);
+	shuffle(keys->missing);
+
+	keys->name = "string keys";
+	keys->hash_func = string_hash;
+	keys->equal_func = string_equal;
+}
+
+static void benchmark_hash_table(KeySet *keys, const char *name,
+                                 unsigned int flags)
+{
+	HashTable *hash_table;
+	clock_t start;
+	double insert_time, lookup_time, missing_time, free_time;
+	unsigned int entries;
+	unsigned int found;
+	unsigned int i;
+
+	hash_table =
+	    hash_table_new_with_flags(keys->hash_func, keys->equal_func, flags);
+
+	start = clock();
+	for (i = 0; i < num_keys; ++i) {
+		hash_table_insert(hash_table, keys->present[i],
+		                  keys->present[i]);
+	}
+	insert_time = seconds_since(start);
+
+	found = 0;
+	start = clock();
+	for (i = 0; i < num_keys; ++i) {
+		if (hash_table_lookup(hash_table, keys->present[i]) != NULL) {
+			++found;
+		}
+	}
+	lookup_time = seconds_since(start);
+
+	start = clock();
+	for (i = 0; i < num_keys; ++i) {
+		if (hash_table_lookup(hash_table, keys->missing[i]) != NULL) {
+			++found;
+		}
+	}
+	missing_time = seconds_since(start);
+
+	entries = hash_table_num_entries(hash_table);
+
+	start = clock();
+	hash_table_free(hash_table);
+	free_time = seconds_since(start);
+
+	printf("  HashTable %-22s %9.3f %9.3f %9.3f %9.3f %9u\n", name,
+	       insert_time, lookup_time, missing_time, free_time, entries);
+}
+
+/* The same as benchmark_hash_table, but using the bulk insert and lookup
+ * functions. */
+static void benchmark_hash_table_bulk(KeySet *keys, const char *name,
+                                      unsigned int flags)
+{
+	HashTable *hash_table;
+	HashTableValue *results;
+	clock_t start;
+	double insert_time, lookup_time, missing_time, free_time;
+	unsigned int found;
+
+	hash_table =
+	    hash_table_new_with_flags(keys->hash_func, keys->equal_func, flags);
+	results = malloc(sizeof(HashTableValue) * num_keys);
+
+	start = clock();
+	hash_table_insert_many(hash_table, keys->present, keys->present,
+	                       num_keys);
+	insert_time = seconds_since(start);
+
+	start = clock();
+	found = hash_table_lookup_many(hash_table, keys->present, results,
+	                               num_keys);
+	lookup_time = seconds_since(start);
+
+	start = clock();
+	found += hash_table_lookup_many(hash_table, keys->missing, results,
+	                                num_keys);
+	missing_time = seconds_since(start);
+
+	free(results);
+
+	start = clock();
+	hash_table_free(hash_table);
+	free_time = seconds_since(start);
+
+	printf("  HashTable %-22s %9.3f %9.3f %9.3f %9.3f %9u\n", name,
+	       insert_time, lookup_time, missing_time, free_time, found);
+}
+
+static void benchmark_set(KeySet *keys, const char *name, unsigned int flags)
+{
+	Set *set;
+	clock_t start;
+	double insert_time, lookup_time, missing_time, free_time;
+	unsigned int entries;
+	unsigned int found;
+	unsigned int i;
+
+	set = set_new_with_flags(keys->hash_func, keys->equal_func, flags);
+
+	start = clock();
+	for (i = 0; i < num_keys; ++i) {
+		set_insert(set, keys->present[i]);
+	}
+	insert_time = seconds_since(start);
+
+	found = 0;
+	start = clock();
+	for (i = 0; i < num_keys; ++i) {
+		found += (unsigned int) set_query(set, keys->present[i]);
+	}
+	lookup_time = seconds_since(start);
+
+	start = clock();
+	for (i = 0; i < num_keys; ++i) {
+		found += (unsigned int) set_query(set, keys->missing[i]);
+	}
+	missing_time = seconds_since(start);
+
+	entries = set_num_entries(set);
+
+	start = clock();
+	set_free(set);
+	free_time = seconds_since(start);
+
+	printf("  Set       %-22s %9.3f %9.3f %9.3f %9.3f %9u\n", name,
+	       insert_time, lookup_time, missing_time, free_time, entries);
+}
+
+/* Time the union and intersection of two sets, each holding two thirds
+ * of the keys, overlapping by a third of the keys. */
+static void benchmark_set_algebra(KeySet *keys, const char *name,
+                                  unsigned int flags)
+{
+	Set *set1, *set2, *result;
+	clock_t start;
+	double union_time, intersection_time;
+	unsigned int i;
+
+	set1 = set_new_with_flags(keys->hash_func, keys->equal_func, flags);
+	set2 = set_new_with_flags(keys->hash_func, keys->equal_func, flags);
+
+	for (i = 0; i < num_keys; ++i) {
+		if (i % 3 != 0) {
+			set_insert(set1, keys->present[i]);
+		}
+		if (i % 3 != 1) {
+			set_insert(set2, keys->present[i]);
+		}
+	}
+
+	start = clock();
+	result = set_union(set1, set2);
+	union_time = seconds_since(start);
+	set_free(result);
+
+	start = clock();
+	result = set_intersection(set1, set2);
+	intersection_time = seconds_since(start);
+	set_free(result);
+
+	printf("  Set       %-22s %9.3f union, %9.3f intersection\n", name,
+	       union_time, intersection_time);
+
+	set_free(set1);
+	set_free(set2);
+}
+
+static void benchmark_int_set(KeySet *keys)
+{
+	IntSet *set, *set1, *set2, *result;
+	clock_t start;
+	double insert_time, lookup_time, missing_time, free_time;
+	double union_time, intersection_time;
+	unsigned int entries;
+	unsigned int i;
+
+	set = int_set_new();
+
+	start = clock();
+	for (i = 0; i < num_keys; ++i) {
+		int_set_insert(set, *((int *) keys->present[i]));
+	}
+	insert_time = seconds_since(start);
+
+	start = clock();
+	for (i = 0; i < num_keys; ++i) {
+		int_set_query(set, *((int *) keys->present[i]));
+	}
+	lookup_time = seconds_since(start);
+
+	start = clock();
+	for (i = 0; i < num_keys; ++i) {
+		int_set_query(set, *((int *) keys->missing[i]));
+	}
+	missing_time = seconds_since(start);
+
+	entries = int_set_num_entries(set);
+
+	start = clock();
+	int_set_free(set);
+	free_time = seconds_since(start);
+
+	printf("  IntSet    %-22s %9.3f %9.3f %9.3f %9.3f %9u\n", "",
+	       insert_time, lookup_time, missing_time, free_time, entries);
+
+	/* The same union and intersection as benchmark_set_algebra */
+	set1 = int_set_new();
+	set2 = int_set_new();
+
+	for (i = 0; i < num_keys; ++i) {
+		if (i % 3 != 0) {
+			int_set_insert(set1, *((int *) keys->present[i]));
+		}
+		if (i % 3 != 1) {
+			int_set_insert(set2, *((int *) keys->present[i]));
+		}
+	}
+
+	start = clock();
+	result = int_set_union(set1, set2);
+	union_time = seconds_since(start);
+	int_set_free(result);
+
+	start = clock();
+	result = int_set_intersection(set1, set2);
+	intersection_time = seconds_since(start);
+	int_set_free(result);
+
+	printf("  IntSet    %-22s %9.3f union, %9.3f intersection\n", "",
+	       union_time, intersection_time);
+
+	int_set_free(set1);
+	int_set_free(set2);
+}
+
+static void benchmark_roaring_bitmap(KeySet *keys)
+{
+	RoaringBitmap *bitmap, *bitmap1, *bitmap2, *result;
+	clock_t start;
+	double insert_time, lookup_time, missing_time, free_time;
+	double union_time, intersection_time;
+	unsigned long entries;
+	size_t size;
+	unsigned int i;
+
+	bitmap = roaring_bitmap_new();
+
+	start = clock();
+	for (i = 0; i < num_keys; ++i) {
+		roaring_bitmap_insert(bitmap,
+		                      (unsigned int) *((int *) keys->present[i]));
+	}
+	insert_time = seconds_since(start);
+
+	start = clock();
+	for (i = 0; i < num_keys; ++i) {
+		roaring_bitmap_query(bitmap,
+		                     (unsigned int) *((int *) keys->present[i]));
+	}
+	lookup_time = seconds_since(start);
+
+	start = clock();
+	for (i = 0; i < num_keys; ++i) {
+		roaring_bitmap_query(bitmap,
+		                     (unsigned int) *((int *) keys->missing[i]));
+	}
+	missing_time = seconds_since(start);
+
+	entries = roaring_bitmap_num_entries(bitmap);
+	roaring_bitmap_optimize(bitmap);
+	size = roaring_bitmap_serialized_size(bitmap);
+
+	start = clock();
+	roaring_bitmap_free(bitmap);
+	free_time = seconds_since(start);
+
+	printf("  Roaring   %-22s %9.3f %9.3f %9.3f %9.3f %9lu %lu bytes\n",
+	       "", insert_time, lookup_time, missing_time, free_time, entries,
+	       (unsigned long) size);
+
+	/* The same union and intersection as benchmark_set_algebra */
+	bitmap1 = roaring_bitmap_new();
+	bitmap2 = roaring_bitmap_new();
+
+	for (i = 0; i < num_keys; ++i) {
+		if (i % 3 != 0) {
+			roaring_bitmap_insert(bitmap1,
+			    (unsigned int) *((int *) keys->present[i]));
+		}
+		if (i % 3 != 1) {
+			roaring_bitmap_insert(bitmap2,
+			    (unsigned int) *((int *) keys->present[i]));
+		}
+	}
+
+	start = clock();
+	result = roaring_bitmap_union(bitmap1, bitmap2);
+	union_time = seconds_since(start);
+	roaring_bitmap_free(result);
+
+	start = clock();
+	result = roaring_bitmap_intersection(bitmap1, bitmap2);
+	intersection_time = seconds_since(start);
+	roaring_bitmap_free(result);
+
+	printf("  Roaring   %-22s %9.3f union, %9.3f intersection\n", "",
+	       union_time, intersection_time);
+
+	roaring_bitmap_free(bitmap1);
+	roaring_bitmap_free(bitmap2);
+}
+
+/* Time updating the value for every key, first by looking it up and
+ * inserting the new value, then with a single hash_table_lookup_or_insert
+ * call. */
+static void benchmark_update(KeySet *keys, const char *name, unsigned int flags)
+{
+	HashTable *hash_table;
+	HashTableValue *slot;
+	clock_t start;
+	double separate_time, combined_time;
+	unsigned int i;
+
+	hash_table =
+	    hash_table_new_with_flags(keys->hash_func, keys->equal_func, flags);
+	hash_table_insert_many(hash_table, keys->present, keys->present,
+	                       num_keys);
+
+	start = clock();
+	for (i = 0; i < num_keys; ++i) {
+		if (hash_table_lookup(hash_table, keys->present[i]) != NULL) {
+			hash_table_insert(hash_table, keys->present[i],
+			                  keys->missing[i]);
+		}
+	}
+	separate_time = seconds_since(start);
+
+	start = clock();
+	for (i = 0; i < num_keys; ++i) {
+		slot = hash_table_lookup_or_insert(hash_table, keys->present[i],
+		                                   NULL, NULL);
+		*slot = keys->present[i];
+	}
+	combined_time = seconds_since(start);
+
+	printf("  HashTable %-22s %9.3f lookup+insert, %9.3f lookup_or_insert\n",
+	       name, separate_time, combined_time);
+
+	hash_table_free(hash_table);
+}
+
+/* Time filling a table one insert at a time, so that the time is mostly
+ * spent enlarging the table, and with hash_table_insert_many, using the
+ * given number of threads. */
+static void benchmark_threads(KeySet *keys, unsigned int num_threads)
+{
+	HashTable *hash_table;
+	double start;
+	double insert_time, bulk_time;
+	unsigned int i;
+
+	hash_table = hash_table_new(keys->hash_func, keys->equal_func);
+	hash_table_set_threads(hash_table, num_threads);
+
+	start = now();
+	for (i = 0; i < num_keys; ++i) {
+		hash_table_insert(hash_table, keys->present[i],
+		                  keys->present[i]);
+	}
+	insert_time = now() - start;
+
+	hash_table_free(hash_table);
+
+	hash_table = hash_table_new(keys->hash_func, keys->equal_func);
+	hash_table_set_threads(hash_table, num_threads);
+
+	start = now();
+	hash_table_insert_many(hash_table, keys->present, keys->present,
+	                       num_keys);
+	bulk_time = now() - start;
+
+	hash_table_free(hash_table);
+
+	printf("  HashTable %2u thread(s) %12s %9.3f insert, %9.3f bulk\n",
+	       num_threads, "", insert_time, bulk_time);
+}
+
+/* Find the longest time taken by a single insert.  This is dominated by
+ * the inserts that cause the table to be enlarged. */
+static void benchmark_insert_latency(KeySet *keys, const char *name,
+                                     unsigned int flags)
+{
+	HashTable *hash_table;
+	clock_t start, end;
+	clock_t worst;
+	unsigned int i;
+
+	hash_table =
+	    hash_table_new_with_flags(keys->hash_func, keys->equal_func, flags);
+	worst = 0;
+
+	for (i = 0; i < num_keys; ++i) {
+		start = clock();
+		hash_table_insert(hash_table, keys->present[i],
+		                  keys->present[i]);
+		end = clock();
+
+		if (end - start > worst) {
+			worst = end - start;
+		}
+	}
+
+	printf("  HashTable %-22s %9.3f ms worst insert\n", name,
+	       (double) worst * 1000.0 / CLOCKS_PER_SEC);
+
+	hash_table_free(hash_table);
+}
+
+static void benchmark_keys(KeySet *keys)
+{
+	unsigned int num_threads;
+
+	printf("%s:\n", keys->name);
+	printf("  %-32s %9s %9s %9s %9s %9s\n", "", "insert", "lookup",
+	       "missing", "free", "entries");
+
+	benchmark_hash_table(keys, "prime sizes", 0);
+	benchmark_hash_table(keys, "power of two sizes",
+	                     HASH_TABLE_POWER_OF_TWO);
+	benchmark_hash_table(keys, "open addressing",
+	                     HASH_TABLE_OPEN_ADDRESSING);
+	benchmark_hash_table(keys, "pooled entries", HASH_TABLE_POOLED);
+	benchmark_hash_table_bulk(keys, "prime sizes, bulk", 0);
+	benchmark_hash_table_bulk(keys, "open addressing, bulk",
+	                          HASH_TABLE_OPEN_ADDRESSING);
+	benchmark_set(keys, "prime sizes", 0);
+	benchmark_set(keys, "power of two sizes", SET_POWER_OF_TWO);
+	benchmark_set(keys, "pooled entries", SET_POOLED);
+	benchmark_set(keys, "robin hood", SET_ROBIN_HOOD);
+
+	benchmark_set_algebra(keys, "prime sizes", 0);
+	benchmark_set_algebra(keys, "pooled entries", SET_POOLED);
+	benchmark_set_algebra(keys, "robin hood", SET_ROBIN_HOOD);
+
+	if (keys->hash_func == int_hash) {
+		benchmark_int_set(keys);
+		benchmark_roaring_bitmap(keys);
+	}
+
+	benchmark_update(keys, "prime sizes", 0);
+	benchmark_update(keys, "open addressing", HASH_TABLE_OPEN_ADDRESSING);
+
+	benchmark_insert_latency(keys, "prime sizes", 0);
+	benchmark_insert_latency(keys, "incremental resize",
+	                         HASH_TABLE_INCREMENTAL_RESIZE);
+
+	for (num_threads = 1; num_threads <= 8; num_threads *= 2) {
+		benchmark_threads(keys, num_threads);
+	}
+
+	printf("\n");
+}
+
+int main(int argc, char *argv[])
+{
+	KeySet keys;
+
+	if (argc > 1) {
+		num_keys = (unsigned int) atoi(argv[1]);
+	} else {
+		num_keys = DEFAULT_NUM_KEYS;
+	}
+
+	printf("%u keys, times in seconds\n\n", num_keys);
+
+	/* The key arrays are deliberately never freed; the process exits
+	 * straight after they are used. */
+	generate_int_keys(&keys, "sequential integer keys", 1);
+	benchmark_keys(&keys);
+
+	generate_int_keys(&keys, "random integer keys", 0);
+	benchmark_keys(&keys);
+
+	generate_string_keys(&keys);
+	benchmark_keys(&keys);
+
+	return 0;
+}
@@ -48,7 +48,12 @@ CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  * @li @link queue.h Queue @endlink: Double ended queue which can be used
  * as a FIFO or a stack.
  * @li @link set.h Set @endlink: Unordered set of values.
+ * @li @link int-set.h Integer set @endlink: Unordered set of integers.
+ * @li @link roaring-bitmap.h Roaring bitmap @endlink: Compressed set of
+ * unsigned integers.
  * @li @link bloom-filter.h Bloom Filter @endlink: Space-efficient set.
+ * @li @link counting-bloom-filter.h Counting Bloom Filter @endlink:
+ * Space-efficient set which supports removal.
  *
  * @subsection Mappings
  *
@@ -57,6 +57,8 @@ typedef StructType BinomialHeapValue;
 typedef StructType BloomFilterValue;
 #define BLOOM_FILTER_NULL STRUCT_TYPE_NULL
 
+typedef StructType CountingBloomFilterValue;
+
 typedef StructType2 HashTableKey;
 #define HASH_TABLE_KEY_NULL STRUCT_TYPE2_NULL
 typedef StructType HashTableValue;
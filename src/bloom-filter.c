@@ -18,21 +18,54 @@ CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 
  */
 
+#include <limits.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "bloom-filter.h"
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 /* malloc() / free() testing */
 #ifdef ALLOC_TESTING
 #include "alloc-testing.h"
 #endif
 
+/* A blocked filter divides the table into blocks the size of a typical
+ * cache line, and sets all of the bits for a value in a single block, so
+ * that a query only needs to read one cache line.  The bits for a value
+ * are gathered into a mask the size of a block, which is then set or
+ * tested a vector at a time.  As in the rest of the table, bit n of a
+ * block is bit n % 8 of byte n / 8, so a saved blocked filter can be
+ * loaded on a machine with the other byte order. */
+#define BLOOM_FILTER_BLOCK_BYTES 64
+#define BLOOM_FILTER_BLOCK_BITS (BLOOM_FILTER_BLOCK_BYTES * 8)
+
+/* Odd multiplier used to spread the bits of a salted hash into the top
+ * bits, which choose the bit within a block */
+#define BLOOM_FILTER_BLOCK_MULTIPLIER 0x9e3779b1U
+
+#if defined(__SIZEOF_INT128__) && defined(__SIZEOF_LONG__) && \
+    __SIZEOF_LONG__ == 8
+__extension__ typedef unsigned __int128 BloomFilterProduct;
+#define BLOOM_FILTER_HAVE_PRODUCT
+#endif
+
 struct _BloomFilter {
 	BloomFilterHashFunc hash_func;
+	BloomFilterWideHashFunc wide_hash_func;
 	unsigned char *table;
-	unsigned int table_size;
+	unsigned long table_size;
 	unsigned int num_functions;
+	unsigned int flags;
+
+	/* The memory allocated for the table, of which a blocked filter
+	 * uses the part aligned to the start of a cache line */
+	unsigned char *table_memory;
 };
 
 /* Salt values.  These salts are XORed with the output of the hash function to
@@ -61,18 +94,47 @@ static const unsigned int salts[] = {
     0xa27e2a58, 0x66866fc5, 0x12519ce7, 0x437a8456,
 };
 
-BloomFilter *bloom_filter_new(unsigned int table_size,
-                              BloomFilterHashFunc hash_func,
-                              unsigned int num_functions)
+/* Number of bytes in the table of a filter */
+static size_t bloom_filter_table_bytes(unsigned long table_size)
+{
+	/* The table is an array of bits, packed into bytes.  Round up
+	 * to the nearest byte. */
+	return (size_t) (table_size / 8 + (table_size % 8 != 0));
+}
+
+/* Round the size of a blocked filter up to a whole number of blocks,
+ * returning zero if it is too large */
+static unsigned long bloom_filter_round_blocks(unsigned long table_size)
+{
+	if (table_size > ULONG_MAX - (BLOOM_FILTER_BLOCK_BITS - 1)) {
+		return 0;
+	} else if (table_size == 0) {
+		table_size = BLOOM_FILTER_BLOCK_BITS;
+	}
+
+	return (table_size + BLOOM_FILTER_BLOCK_BITS - 1)
+	     / BLOOM_FILTER_BLOCK_BITS * BLOOM_FILTER_BLOCK_BITS;
+}
+
+/* Allocate a filter with an empty table of the given size.  Exactly one
+ * of the hash functions is given. */
+static BloomFilter *bloom_filter_alloc(unsigned long table_size,
+                                       BloomFilterHashFunc hash_func,
+                                       BloomFilterWideHashFunc wide_hash_func,
+                                       unsigned int num_functions,
+                                       unsigned int flags)
 {
 	BloomFilter *filter;
+	size_t table_bytes;
+	size_t offset;
 
-	/* There is a limit on the number of functions which can be
-	 * applied, due to the table size */
-	if (num_functions > sizeof(salts) / sizeof(*salts)) {
+	/* The table must fit in memory */
+	if (table_size / 8 >= (size_t) -1 - BLOOM_FILTER_BLOCK_BYTES) {
 		return NULL;
 	}
 
+	table_bytes = bloom_filter_table_bytes(table_size);
+
 	/* Allocate bloom filter structure */
 	filter = malloc(sizeof(BloomFilter));
 
@@ -80,40 +142,363 @@ BloomFilter *bloom_filter_new(unsigned int table_size,
 		return NULL;
 	}
 
-	/* Allocate table, each entry is one bit; these are packed into
-	 * bytes.  When allocating we must round the length up to the nearest
-	 * byte. */
-	filter->table = calloc((table_size + 7) / 8, 1);
+	/* Allocate table, each entry is one bit.  A blocked table has room
+	 * to start it on a cache line. */
+	if ((flags & BLOOM_FILTER_BLOCKED) != 0) {
+		filter->table_memory =
+		    calloc(table_bytes + BLOOM_FILTER_BLOCK_BYTES - 1, 1);
+	} else {
+		filter->table_memory = calloc(table_bytes, 1);
+	}
 
-	if (filter->table == NULL) {
+	if (filter->table_memory == NULL) {
 		free(filter);
 		return NULL;
 	}
 
+	filter->table = filter->table_memory;
+
+	if ((flags & BLOOM_FILTER_BLOCKED) != 0) {
+		offset = (size_t) filter->table % BLOOM_FILTER_BLOCK_BYTES;
+
+		if (offset != 0) {
+			filter->table += BLOOM_FILTER_BLOCK_BYTES - offset;
+		}
+	}
+
 	filter->hash_func = hash_func;
+	filter->wide_hash_func = wide_hash_func;
 	filter->num_functions = num_functions;
 	filter->table_size = table_size;
+	filter->flags = flags;
 
 	return filter;
 }
 
+BloomFilter *bloom_filter_new(unsigned int table_size,
+                              BloomFilterHashFunc hash_func,
+                              unsigned int num_functions)
+{
+	return bloom_filter_new_with_flags(table_size, hash_func, num_functions,
+	                                   0);
+}
+
+BloomFilter *bloom_filter_new_with_flags(unsigned int table_size,
+                                         BloomFilterHashFunc hash_func,
+                                         unsigned int num_functions,
+                                         unsigned int flags)
+{
+	unsigned long size;
+
+	/* There is a limit on the number of functions which can be
+	 * applied, due to the table size */
+	if (num_functions > sizeof(salts) / sizeof(*salts)) {
+		return NULL;
+	}
+
+	/* Blocked filters use a whole number of blocks */
+	size = table_size;
+
+	if ((flags & BLOOM_FILTER_BLOCKED) != 0) {
+		size = bloom_filter_round_blocks(size);
+
+		if (size == 0) {
+			return NULL;
+		}
+	}
+
+	return bloom_filter_alloc(size, hash_func, NULL, num_functions, flags);
+}
+
+BloomFilter *bloom_filter_new_wide(unsigned long table_size,
+                                   BloomFilterWideHashFunc hash_func,
+                                   unsigned int num_functions,
+                                   unsigned int flags)
+{
+	/* Bits within a block are still chosen using the salts */
+	if ((flags & BLOOM_FILTER_BLOCKED) != 0) {
+		if (num_functions > sizeof(salts) / sizeof(*salts)) {
+			return NULL;
+		}
+
+		table_size = bloom_filter_round_blocks(table_size);
+	}
+
+	if (table_size == 0) {
+		return NULL;
+	}
+
+	return bloom_filter_alloc(table_size, NULL, hash_func, num_functions,
+	                          flags);
+}
+
 void bloom_filter_free(BloomFilter *bloomfilter)
 {
-	free(bloomfilter->table);
+	free(bloomfilter->table_memory);
 	free(bloomfilter);
 }
 
+/* Build the mask of the bits to set or test within a block for a hash
+ * value.  Each bit is chosen by the top bits of a salted hash multiplied
+ * by an odd constant, which depend on every bit of the hash. */
+static void bloom_filter_block_mask(BloomFilter *bloomfilter,
+                                    unsigned int hash, unsigned char *mask)
+{
+	unsigned int subhash;
+	unsigned int bit;
+	unsigned int i;
+
+	memset(mask, 0, BLOOM_FILTER_BLOCK_BYTES);
+
+	for (i = 0; i < bloomfilter->num_functions; ++i) {
+		subhash = ((hash ^ salts[i]) * BLOOM_FILTER_BLOCK_MULTIPLIER)
+		        & 0xffffffffU;
+		bit = subhash >> 23;
+		mask[bit / 8] |= (unsigned char) (1 << (bit % 8));
+	}
+}
+
+/* Find the block of a blocked filter for a hash value, and build the
+ * mask of the bits to set or test within it.  Every bit of the hash is
+ * mixed into the rest first, as a hash that is poor in its low bits
+ * would otherwise use only some of the blocks. */
+static unsigned char *bloom_filter_block(BloomFilter *bloomfilter,
+                                         unsigned int hash,
+                                         unsigned char *mask)
+{
+	unsigned char *block;
+	unsigned long num_blocks;
+
+	hash ^= hash >> 16;
+	hash = (hash * 0x85ebca6bU) & 0xffffffffU;
+	hash ^= hash >> 13;
+	hash = (hash * 0xc2b2ae35U) & 0xffffffffU;
+	hash ^= hash >> 16;
+
+	bloom_filter_block_mask(bloomfilter, hash, mask);
+
+	num_blocks = bloomfilter->table_size / BLOOM_FILTER_BLOCK_BITS;
+	block = bloomfilter->table +
+	        (size_t) (hash % num_blocks) * BLOOM_FILTER_BLOCK_BYTES;
+
+	return block;
+}
+
+static void bloom_filter_block_set(unsigned char *block,
+                                   const unsigned char *mask)
+{
+#if defined(__AVX2__)
+	__m256i *words;
+	unsigned int i;
+
+	words = (__m256i *) block;
+
+	for (i = 0; i < 2; ++i) {
+		_mm256_store_si256(
+		    &words[i],
+		    _mm256_or_si256(_mm256_load_si256(&words[i]),
+		                    _mm256_loadu_si256(
+		                        (const __m256i *) mask + i)));
+	}
+#elif defined(__SSE2__)
+	__m128i *words;
+	unsigned int i;
+
+	words = (__m128i *) block;
+
+	for (i = 0; i < 4; ++i) {
+		_mm_store_si128(
+		    &words[i],
+		    _mm_or_si128(_mm_load_si128(&words[i]),
+		                 _mm_loadu_si128((const __m128i *) mask + i)));
+	}
+#else
+	unsigned int i;
+
+	for (i = 0; i < BLOOM_FILTER_BLOCK_BYTES; ++i) {
+		block[i] |= mask[i];
+	}
+#endif
+}
+
+/* Test whether every bit of a mask is set in a block */
+static int bloom_filter_block_test(const unsigned char *block,
+                                   const unsigned char *mask)
+{
+#if defined(__AVX2__)
+	const __m256i *words;
+
+	words = (const __m256i *) block;
+
+	return _mm256_testc_si256(_mm256_load_si256(&words[0]),
+	                          _mm256_loadu_si256((const __m256i *) mask))
+	    && _mm256_testc_si256(_mm256_load_si256(&words[1]),
+	                          _mm256_loadu_si256(
+	                              (const __m256i *) mask + 1));
+#elif defined(__SSE2__)
+	const __m128i *words;
+	__m128i missing;
+	__m128i m;
+	unsigned int i;
+
+	/* Gather the bits of the mask that are not set in the block */
+	words = (const __m128i *) block;
+	missing = _mm_setzero_si128();
+
+	for (i = 0; i < 4; ++i) {
+		m = _mm_loadu_si128((const __m128i *) mask + i);
+		missing = _mm_or_si128(
+		    missing, _mm_andnot_si128(_mm_load_si128(&words[i]), m));
+	}
+
+	return _mm_movemask_epi8(
+	           _mm_cmpeq_epi8(missing, _mm_setzero_si128())) == 0xffff;
+#else
+	unsigned int i;
+
+	for (i = 0; i < BLOOM_FILTER_BLOCK_BYTES; ++i) {
+		if ((mask[i] & ~block[i]) != 0) {
+			return 0;
+		}
+	}
+
+	return 1;
+#endif
+}
+
+/* Mix the bits of a wide hash value, so that every bit of the result
+ * depends on every bit of the hash.  This is reversible, so different
+ * hashes always give different results. */
+static unsigned long bloom_filter_mix(unsigned long hash)
+{
+#if ULONG_MAX > 0xffffffffUL
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdUL;
+	hash ^= hash >> 33;
+	hash *= 0xc4ceb9fe1a85ec53UL;
+	hash ^= hash >> 33;
+#else
+	hash ^= hash >> 16;
+	hash *= 0x85ebca6bUL;
+	hash ^= hash >> 13;
+	hash *= 0xc2b2ae35UL;
+	hash ^= hash >> 16;
+#endif
+
+	return hash;
+}
+
+/* Map a hash value onto the range from zero to range - 1, by taking the
+ * top half of the product of the two.  This is uniform for a uniform
+ * hash, and much faster than finding the remainder after division. */
+static unsigned long bloom_filter_range(unsigned long hash,
+                                        unsigned long range)
+{
+#ifdef BLOOM_FILTER_HAVE_PRODUCT
+	return (unsigned long) (((BloomFilterProduct) hash * range) >> 64);
+#else
+	unsigned long half;
+	unsigned long low_mask;
+	unsigned long low_low, high_low, low_high, high_high;
+	unsigned long middle;
+
+	/* Multiply a half of each value at a time */
+	half = sizeof(unsigned long) * CHAR_BIT / 2;
+	low_mask = (1UL << half) - 1;
+
+	low_low = (hash & low_mask) * (range & low_mask);
+	high_low = (hash >> half) * (range & low_mask);
+	low_high = (hash & low_mask) * (range >> half);
+	high_high = (hash >> half) * (range >> half);
+
+	middle = (low_low >> half) + (high_low & low_mask) + low_high;
+
+	return high_high + (high_low >> half) + (middle >> half);
+#endif
+}
+
+/* Insert a value into a filter created using bloom_filter_new_wide, or
+ * if insert is zero, query it.  The positions of the bits come from
+ * enhanced double hashing: two hashes are derived from the value's
+ * hash, and each position is taken from the first, which then has the
+ * second added to it, which has the number of positions so far added
+ * to it in turn.  The positions are independent enough to give the
+ * theoretical false positive rate, and need no salts, so there is no
+ * limit on the number of them. */
+static int bloom_filter_wide_apply(BloomFilter *bloomfilter,
+                                   BloomFilterValue value, int insert)
+{
+	unsigned char mask[BLOOM_FILTER_BLOCK_BYTES];
+	unsigned char *block;
+	unsigned long hash1;
+	unsigned long hash2;
+	unsigned long index;
+	unsigned int i;
+	unsigned char b;
+
+	hash1 = bloom_filter_mix(bloomfilter->wide_hash_func(value));
+	hash2 = bloom_filter_mix(hash1);
+
+	/* A blocked filter takes the block from the first hash and the
+	 * bits within it from the second */
+	if ((bloomfilter->flags & BLOOM_FILTER_BLOCKED) != 0) {
+		index = bloom_filter_range(hash1, bloomfilter->table_size /
+		                                  BLOOM_FILTER_BLOCK_BITS);
+		block = bloomfilter->table +
+		        (size_t) index * BLOOM_FILTER_BLOCK_BYTES;
+		bloom_filter_block_mask(bloomfilter,
+		                        (unsigned int) (hash2 & 0xffffffffUL),
+		                        mask);
+
+		if (insert) {
+			bloom_filter_block_set(block, mask);
+			return 1;
+		} else {
+			return bloom_filter_block_test(block, mask);
+		}
+	}
+
+	for (i = 0; i < bloomfilter->num_functions; ++i) {
+		index = bloom_filter_range(hash1, bloomfilter->table_size);
+		b = (unsigned char) (1 << (index % 8));
+
+		if (insert) {
+			bloomfilter->table[index / 8] |= b;
+		} else if ((bloomfilter->table[index / 8] & b) == 0) {
+			return 0;
+		}
+
+		hash1 += hash2;
+		hash2 += i;
+	}
+
+	return 1;
+}
+
 void bloom_filter_insert(BloomFilter *bloomfilter, BloomFilterValue value)
 {
+	unsigned char mask[BLOOM_FILTER_BLOCK_BYTES];
+	unsigned char *block;
 	unsigned int hash;
 	unsigned int subhash;
-	unsigned int index;
+	unsigned long index;
 	unsigned int i;
 	unsigned char b;
 
+	if (bloomfilter->wide_hash_func != NULL) {
+		bloom_filter_wide_apply(bloomfilter, value, 1);
+		return;
+	}
+
 	/* Generate hash of the value to insert */
 	hash = bloomfilter->hash_func(value);
 
+	if ((bloomfilter->flags & BLOOM_FILTER_BLOCKED) != 0) {
+		block = bloom_filter_block(bloomfilter, hash, mask);
+		bloom_filter_block_set(block, mask);
+		return;
+	}
+
 	/* Generate multiple unique hashes by XORing with values in the
 	 * salt table. */
 	for (i = 0; i < bloomfilter->num_functions; ++i) {
@@ -136,14 +521,25 @@ int bloom_filter_query(BloomFilter *bloomfilter, BloomFilterValue value)
 {
 	unsigned int hash;
 	unsigned int subhash;
-	unsigned int index;
+	unsigned long index;
 	unsigned int i;
 	unsigned char b;
 	int bit;
+	unsigned char mask[BLOOM_FILTER_BLOCK_BYTES];
+	unsigned char *block;
+
+	if (bloomfilter->wide_hash_func != NULL) {
+		return bloom_filter_wide_apply(bloomfilter, value, 0);
+	}
 
 	/* Generate hash of the value to lookup */
 	hash = bloomfilter->hash_func(value);
 
+	if ((bloomfilter->flags & BLOOM_FILTER_BLOCKED) != 0) {
+		block = bloom_filter_block(bloomfilter, hash, mask);
+		return bloom_filter_block_test(block, mask);
+	}
+
 	/* Generate multiple unique hashes by XORing with values in the
 	 * salt table. */
 	for (i = 0; i < bloomfilter->num_functions; ++i) {
@@ -173,11 +569,9 @@ int bloom_filter_query(BloomFilter *bloomfilter, BloomFilterValue value)
 
 void bloom_filter_read(BloomFilter *bloomfilter, unsigned char *array)
 {
-	unsigned int array_size;
+	size_t array_size;
 
-	/* The table is an array of bits, packed into bytes.  Round up
-	 * to the nearest byte. */
-	array_size = (bloomfilter->table_size + 7) / 8;
+	array_size = bloom_filter_table_bytes(bloomfilter->table_size);
 
 	/* Copy into the buffer of the calling routine. */
 	memcpy(array, bloomfilter->table, array_size);
@@ -185,11 +579,9 @@ void bloom_filter_read(BloomFilter *bloomfilter, unsigned char *array)
 
 void bloom_filter_load(BloomFilter *bloomfilter, unsigned char *array)
 {
-	unsigned int array_size;
+	size_t array_size;
 
-	/* The table is an array of bits, packed into bytes.  Round up
-	 * to the nearest byte. */
-	array_size = (bloomfilter->table_size + 7) / 8;
+	array_size = bloom_filter_table_bytes(bloomfilter->table_size);
 
 	/* Copy from the buffer of the calling routine. */
 	memcpy(bloomfilter->table, array, array_size);
@@ -198,28 +590,29 @@ void bloom_filter_load(BloomFilter *bloomfilter, unsigned char *array)
 BloomFilter *bloom_filter_union(BloomFilter *filter1, BloomFilter *filter2)
 {
 	BloomFilter *result;
-	unsigned int i;
-	unsigned int array_size;
+	size_t i;
+	size_t array_size;
 
 	/* To perform this operation, both filters must be created with
 	 * the same values. */
 	if (filter1->table_size != filter2->table_size ||
 	    filter1->num_functions != filter2->num_functions ||
-	    filter1->hash_func != filter2->hash_func) {
+	    filter1->hash_func != filter2->hash_func ||
+	    filter1->wide_hash_func != filter2->wide_hash_func ||
+	    filter1->flags != filter2->flags) {
 		return NULL;
 	}
 
 	/* Create a new bloom filter for the result */
-	result = bloom_filter_new(filter1->table_size, filter1->hash_func,
-	                          filter1->num_functions);
+	result = bloom_filter_alloc(filter1->table_size, filter1->hash_func,
+	                            filter1->wide_hash_func,
+	                            filter1->num_functions, filter1->flags);
 
 	if (result == NULL) {
 		return NULL;
 	}
 
-	/* The table is an array of bits, packed into bytes.  Round up
-	 * to the nearest byte. */
-	array_size = (filter1->table_size + 7) / 8;
+	array_size = bloom_filter_table_bytes(filter1->table_size);
 
 	/* Populate the table of the new filter */
 	for (i = 0; i < array_size; ++i) {
@@ -233,28 +626,29 @@ BloomFilter *bloom_filter_intersection(BloomFilter *filter1,
                                        BloomFilter *filter2)
 {
 	BloomFilter *result;
-	unsigned int i;
-	unsigned int array_size;
+	size_t i;
+	size_t array_size;
 
 	/* To perform this operation, both filters must be created with
 	 * the same values. */
 	if (filter1->table_size != filter2->table_size ||
 	    filter1->num_functions != filter2->num_functions ||
-	    filter1->hash_func != filter2->hash_func) {
+	    filter1->hash_func != filter2->hash_func ||
+	    filter1->wide_hash_func != filter2->wide_hash_func ||
+	    filter1->flags != filter2->flags) {
 		return NULL;
 	}
 
 	/* Create a new bloom filter for the result */
-	result = bloom_filter_new(filter1->table_size, filter1->hash_func,
-	                          filter1->num_functions);
+	result = bloom_filter_alloc(filter1->table_size, filter1->hash_func,
+	                            filter1->wide_hash_func,
+	                            filter1->num_functions, filter1->flags);
 
 	if (result == NULL) {
 		return NULL;
 	}
 
-	/* The table is an array of bits, packed into bytes.  Round up
-	 * to the nearest byte. */
-	array_size = (filter1->table_size + 7) / 8;
+	array_size = bloom_filter_table_bytes(filter1->table_size);
 
 	/* Populate the table of the new filter */
 	for (i = 0; i < array_size; ++i) {
@@ -29,7 +29,19 @@ CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  * negatives.
  *
  * To create a bloom filter, use @ref bloom_filter_new.  To destroy a
- * bloom filter, use @ref bloom_filter_free.
+ * bloom filter, use @ref bloom_filter_free.  A bloom filter using a
+ * different layout can be created using @ref bloom_filter_new_with_flags.
+ *
+ * Filters created using @ref bloom_filter_new_wide use a wide hash
+ * function, and may have a table of more than 2^32 bits.  Both the hash
+ * and the table size are an unsigned long, so are only wider than 32
+ * bits where unsigned long is 64 bits wide (most 64-bit Unix systems,
+ * but not 64-bit Windows or any 32-bit system).  Elsewhere both are
+ * capped at 32 bits, and a filter that must hold billions of values
+ * cannot be built.  These filters also find the bits for a value using
+ * double hashing, which gives a lower false positive rate than the
+ * salted hashes used by other filters, and are recommended for new
+ * code.
  *
  * To insert a value into a bloom filter, use @ref bloom_filter_insert.
  *
@@ -69,6 +81,42 @@ typedef void *BloomFilterValue;
  */
 typedef unsigned int (*BloomFilterHashFunc)(BloomFilterValue data);
 
+/**
+ * Hash function used by a bloom filter created using
+ * @ref bloom_filter_new_wide.  Every bit of the result should depend on
+ * the value, as a filter holding billions of values needs a hash value
+ * of more than 32 bits to tell them apart.  Where unsigned long is only
+ * 32 bits wide, the hash is also only 32 bits wide.
+ *
+ * @param data   The value to generate a hash value for.
+ * @return       The hash value.
+ */
+typedef unsigned long (*BloomFilterWideHashFunc)(BloomFilterValue data);
+
+/**
+ * Flags which may be passed to @ref bloom_filter_new_with_flags to
+ * control how a bloom filter is stored.  Flags can be combined using
+ * bitwise OR.
+ */
+typedef enum {
+	/**
+	 * Divide the table into 512-bit blocks, the size of a typical
+	 * cache line, and set all of the bits for a value within a single
+	 * block.  An insertion or query then reads only one cache line,
+	 * however many hash functions are used, and tests all of the bits
+	 * at once, rather than reading up to one cache line per function.
+	 *
+	 * The cost is a higher false positive rate for the same table
+	 * size, as some blocks receive more values than others.  The
+	 * difference is small for a crowded table, around 2.4% rather
+	 * than 2.3% with 8 bits per value, but grows as the table becomes
+	 * sparser, to around 0.09% rather than 0.05% with 16 bits per
+	 * value, and can be made up by using a larger table.  The table
+	 * size is rounded up to a whole number of blocks.
+	 */
+	BLOOM_FILTER_BLOCKED = 1 << 0
+} BloomFilterFlag;
+
 /**
  * Create a new bloom filter.
  *
@@ -92,6 +140,55 @@ BloomFilter *bloom_filter_new(unsigned int table_size,
                               BloomFilterHashFunc hash_func,
                               unsigned int num_functions);
 
+/**
+ * Create a new bloom filter, with flags controlling how it is stored.
+ *
+ * @param table_size       The size of the bloom filter, as for
+ *                         @ref bloom_filter_new.
+ * @param hash_func        Hash function to use on values stored in the
+ *                         filter.
+ * @param num_functions    Number of hash functions to apply to each
+ *                         element on insertion.  The maximum number of
+ *                         functions is 64.
+ * @param flags            Bitwise OR of @ref BloomFilterFlag values, or
+ *                         zero to create the same kind of filter as
+ *                         @ref bloom_filter_new.
+ * @return                 A new bloom filter, or NULL if it was not
+ *                         possible to allocate the new bloom filter.
+ */
+BloomFilter *bloom_filter_new_with_flags(unsigned int table_size,
+                                         BloomFilterHashFunc hash_func,
+                                         unsigned int num_functions,
+                                         unsigned int flags);
+
+/**
+ * Create a new bloom filter using a wide hash function.  The bits for a
+ * value are found using double hashing: a pair of hash values is
+ * derived from the value's hash, and each position is found from a
+ * combination of the two, mapped onto the table by multiplication
+ * rather than division.
+ *
+ * @param table_size       The size of the bloom filter in bits.  This
+ *                         may be more than 2^32 only where unsigned
+ *                         long is 64 bits wide.  Elsewhere it is at
+ *                         most 2^32 - 1.
+ * @param hash_func        Hash function to use on values stored in the
+ *                         filter.
+ * @param num_functions    Number of bits to set for each value.  There
+ *                         is no limit on the number, except for a
+ *                         @ref BLOOM_FILTER_BLOCKED filter, which
+ *                         allows up to 64.
+ * @param flags            Bitwise OR of @ref BloomFilterFlag values, or
+ *                         zero.
+ * @return                 A new bloom filter, or NULL if it was not
+ *                         possible to allocate the new bloom filter,
+ *                         or if the table size is zero.
+ */
+BloomFilter *bloom_filter_new_wide(unsigned long table_size,
+                                   BloomFilterWideHashFunc hash_func,
+                                   unsigned int num_functions,
+                                   unsigned int flags);
+
 /**
  * Destroy a bloom filter.
  *
@@ -120,12 +217,16 @@ void bloom_filter_insert(BloomFilter *bloomfilter, BloomFilterValue value);
 int bloom_filter_query(BloomFilter *bloomfilter, BloomFilterValue value);
 
 /**
- * Read the contents of a bloom filter into an array.
+ * Read the contents of a bloom filter into an array.  Bit n of the table
+ * is stored in bit n % 8 of byte n / 8, for blocked filters as well, so
+ * the array does not depend on the byte order of the machine.
  *
  * @param bloomfilter          The bloom filter.
  * @param array                Pointer to the array to read into.  This
  *                             should be (table_size + 7) / 8 bytes in
- *                             length.
+ *                             length, with the table size rounded up
+ *                             to a whole number of blocks for a
+ *                             @ref BLOOM_FILTER_BLOCKED filter.
  */
 void bloom_filter_read(BloomFilter *bloomfilter, unsigned char *array);
 
@@ -137,8 +238,8 @@ void bloom_filter_read(BloomFilter *bloomfilter, unsigned char *array);
  *
  * @param bloomfilter          The bloom filter.
  * @param array                Pointer to the array to load from.  This
- *                             should be (table_size + 7) / 8 bytes in
- *                             length.
+ *                             should be the same length as for
+ *                             @ref bloom_filter_read.
  */
 void bloom_filter_load(BloomFilter *bloomfilter, unsigned char *array);
 
@@ -148,7 +249,7 @@ void bloom_filter_load(BloomFilter *bloomfilter, unsigned char *array);
  * filters.
  *
  * Both of the original filters must have been created using the
- * same parameters to @ref bloom_filter_new.
+ * same function and parameters.
  *
  * @param filter1              The first filter.
  * @param filter2              The second filter.
@@ -166,7 +267,7 @@ BloomFilter *bloom_filter_union(BloomFilter *filter1, BloomFilter *filter2);
  * original filters.
  *
  * Both of the original filters must have been created using the
- * same parameters to @ref bloom_filter_new.
+ * same function and parameters.
  *
  * @param filter1              The first filter.
  * @param filter2              The second filter.
@@ -0,0 +1,459 @@
+/*
+
+Copyright (c) 2026 Simon Howard
+
+Permission to use, copy, modify, and/or distribute this software
+for any purpose with or without fee is hereby granted, provided
+that the above copyright notice and this permission notice appear
+in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT,
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+ */
+
+/* Lock-striped hash table */
+
+/* Read/write locks are part of POSIX.1-2001 */
+#define _POSIX_C_SOURCE 200112L
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "concurrent-hash-table.h"
+
+/* malloc() / free() testing */
+#ifdef ALLOC_TESTING
+#include "alloc-testing.h"
+#endif
+
+#define CONCURRENT_HASH_TABLE_DEFAULT_STRIPES 64
+#define CONCURRENT_HASH_TABLE_MAX_STRIPES 65536
+#define CONCURRENT_HASH_TABLE_MIN_CHAINS 16
+
+/* Each stripe is padded out to this size.  Without the padding, the lock
+ * for one stripe could share a cache line with the lock for the next, and
+ * threads using different stripes would still slow each other down as
+ * the cache line bounced between them. */
+#define CONCURRENT_HASH_TABLE_STRIPE_SIZE 128
+
+typedef struct _ConcurrentHashTableEntry ConcurrentHashTableEntry;
+
+struct _ConcurrentHashTableEntry {
+	HashTablePair pair;
+	unsigned int hash;
+	ConcurrentHashTableEntry *next;
+};
+
+/* Each stripe is a chained hash table with a power-of-two number of
+ * chains, protected by its own lock. */
+typedef struct {
+	pthread_rwlock_t lock;
+	ConcurrentHashTableEntry **table;
+	unsigned int table_size;
+	unsigned int entries;
+} ConcurrentHashTableStripe;
+
+typedef union {
+	ConcurrentHashTableStripe stripe;
+	unsigned char padding[CONCURRENT_HASH_TABLE_STRIPE_SIZE];
+} ConcurrentHashTablePaddedStripe;
+
+struct _ConcurrentHashTable {
+	ConcurrentHashTablePaddedStripe *stripes;
+	unsigned int num_stripes;
+	unsigned int stripe_bits;
+	HashTableHashFunc hash_func;
+	HashTableEqualFunc equal_func;
+	HashTableKeyFreeFunc key_free_func;
+	HashTableValueFreeFunc value_free_func;
+};
+
+/* Null value that can be returned without creating a local variable */
+static const HashTableValue concurrent_hash_table_null_value = HASH_TABLE_NULL;
+
+/* Generate the hash of a key.  The low bits of the result select the
+ * stripe and the bits above those select the chain within the stripe,
+ * so the user's hash is first scrambled with the MurmurHash3 finalizer
+ * to make sure that all of its bits affect both. */
+static unsigned int concurrent_hash_table_hash(ConcurrentHashTable *hash_table,
+                                               HashTableKey key)
+{
+	unsigned int hash;
+
+	hash = hash_table->hash_func(key);
+
+	hash ^= hash >> 16;
+	hash *= 0x85ebca6bU;
+	hash ^= hash >> 13;
+	hash *= 0xc2b2ae35U;
+	hash ^= hash >> 16;
+
+	return hash;
+}
+
+static ConcurrentHashTableStripe *
+concurrent_hash_table_stripe(ConcurrentHashTable *hash_table, unsigned int hash)
+{
+	return &hash_table->stripes[hash & (hash_table->num_stripes - 1)].stripe;
+}
+
+static unsigned int concurrent_hash_table_chain(ConcurrentHashTable *hash_table,
+                                                unsigned int hash,
+                                                unsigned int table_size)
+{
+	return (hash >> hash_table->stripe_bits) & (table_size - 1);
+}
+
+ConcurrentHashTable *concurrent_hash_table_new(HashTableHashFunc hash_func,
+                                               HashTableEqualFunc equal_func,
+                                               unsigned int num_stripes)
+{
+	ConcurrentHashTable *hash_table;
+	ConcurrentHashTableStripe *stripe;
+	unsigned int i;
+
+	if (num_stripes == 0) {
+		num_stripes = CONCURRENT_HASH_TABLE_DEFAULT_STRIPES;
+	} else if (num_stripes > CONCURRENT_HASH_TABLE_MAX_STRIPES) {
+		num_stripes = CONCURRENT_HASH_TABLE_MAX_STRIPES;
+	}
+
+	hash_table = (ConcurrentHashTable *) malloc(sizeof(ConcurrentHashTable));
+
+	if (hash_table == NULL) {
+		return NULL;
+	}
+
+	/* Round the number of stripes up to a power of two */
+	hash_table->num_stripes = 1;
+	hash_table->stripe_bits = 0;
+
+	while (hash_table->num_stripes < num_stripes) {
+		hash_table->num_stripes <<= 1;
+		++hash_table->stripe_bits;
+	}
+
+	hash_table->hash_func = hash_func;
+	hash_table->equal_func = equal_func;
+	hash_table->key_free_func = NULL;
+	hash_table->value_free_func = NULL;
+
+	hash_table->stripes =
+	    malloc(sizeof(ConcurrentHashTablePaddedStripe) *
+	           hash_table->num_stripes);
+
+	if (hash_table->stripes == NULL) {
+		free(hash_table);
+		return NULL;
+	}
+
+	for (i = 0; i < hash_table->num_stripes; ++i) {
+		stripe = &hash_table->stripes[i].stripe;
+		stripe->table_size = CONCURRENT_HASH_TABLE_MIN_CHAINS;
+		stripe->entries = 0;
+		stripe->table = calloc(stripe->table_size,
+		                       sizeof(ConcurrentHashTableEntry *));
+
+		if (stripe->table == NULL) {
+			break;
+		}
+
+		if (pthread_rwlock_init(&stripe->lock, NULL) != 0) {
+			free(stripe->table);
+			break;
+		}
+	}
+
+	/* Undo the stripes that were set up if one of them failed */
+	if (i < hash_table->num_stripes) {
+		while (i > 0) {
+			--i;
+			stripe = &hash_table->stripes[i].stripe;
+			pthread_rwlock_destroy(&stripe->lock);
+			free(stripe->table);
+		}
+
+		free(hash_table->stripes);
+		free(hash_table);
+
+		return NULL;
+	}
+
+	return hash_table;
+}
+
+static void concurrent_hash_table_free_entry(ConcurrentHashTable *hash_table,
+                                             ConcurrentHashTableEntry *entry)
+{
+	if (hash_table->key_free_func != NULL) {
+		hash_table->key_free_func(entry->pair.key);
+	}
+
+	if (hash_table->value_free_func != NULL) {
+		hash_table->value_free_func(entry->pair.value);
+	}
+
+	free(entry);
+}
+
+void concurrent_hash_table_free(ConcurrentHashTable *hash_table)
+{
+	ConcurrentHashTableStripe *stripe;
+	ConcurrentHashTableEntry *rover;
+	ConcurrentHashTableEntry *next;
+	unsigned int i, j;
+
+	for (i = 0; i < hash_table->num_stripes; ++i) {
+		stripe = &hash_table->stripes[i].stripe;
+
+		for (j = 0; j < stripe->table_size; ++j) {
+			rover = stripe->table[j];
+
+			while (rover != NULL) {
+				next = rover->next;
+				concurrent_hash_table_free_entry(hash_table,
+				                                 rover);
+				rover = next;
+			}
+		}
+
+		pthread_rwlock_destroy(&stripe->lock);
+		free(stripe->table);
+	}
+
+	free(hash_table->stripes);
+	free(hash_table);
+}
+
+void concurrent_hash_table_register_free_functions(
+    ConcurrentHashTable *hash_table, HashTableKeyFreeFunc key_free_func,
+    HashTableValueFreeFunc value_free_func)
+{
+	hash_table->key_free_func = key_free_func;
+	hash_table->value_free_func = value_free_func;
+}
+
+/* Double the number of chains in a stripe.  The lock on the stripe must
+ * be held for writing. */
+static int concurrent_hash_table_enlarge(ConcurrentHashTable *hash_table,
+                                         ConcurrentHashTableStripe *stripe)
+{
+	ConcurrentHashTableEntry **new_table;
+	ConcurrentHashTableEntry *rover;
+	ConcurrentHashTableEntry *next;
+	unsigned int new_table_size;
+	unsigned int index;
+	unsigned int i;
+
+	new_table_size = stripe->table_size * 2;
+	new_table = calloc(new_table_size, sizeof(ConcurrentHashTableEntry *));
+
+	if (new_table == NULL) {
+		return 0;
+	}
+
+	for (i = 0; i < stripe->table_size; ++i) {
+		rover = stripe->table[i];
+
+		while (rover != NULL) {
+			next = rover->next;
+
+			index = concurrent_hash_table_chain(
+			    hash_table, rover->hash, new_table_size);
+			rover->next = new_table[index];
+			new_table[index] = rover;
+
+			rover = next;
+		}
+	}
+
+	free(stripe->table);
+	stripe->table = new_table;
+	stripe->table_size = new_table_size;
+
+	return 1;
+}
+
+/* Find an entry in a stripe, returning a pointer to the pointer which
+ * points at it so that it can be unlinked, or NULL if it is not present.
+ * The lock on the stripe must be held. */
+static ConcurrentHashTableEntry **
+concurrent_hash_table_find(ConcurrentHashTable *hash_table,
+                           ConcurrentHashTableStripe *stripe, HashTableKey key,
+                           unsigned int hash)
+{
+	ConcurrentHashTableEntry **rover;
+
+	rover = &stripe->table[concurrent_hash_table_chain(hash_table, hash,
+	                                                   stripe->table_size)];
+
+	while (*rover != NULL) {
+		if ((*rover)->hash == hash &&
+		    hash_table->equal_func(key, (*rover)->pair.key) != 0) {
+			return rover;
+		}
+
+		rover = &((*rover)->next);
+	}
+
+	return NULL;
+}
+
+int concurrent_hash_table_insert(ConcurrentHashTable *hash_table,
+                                 HashTableKey key, HashTableValue value)
+{
+	ConcurrentHashTableStripe *stripe;
+	ConcurrentHashTableEntry **rover;
+	ConcurrentHashTableEntry *newentry;
+	HashTablePair *pair;
+	unsigned int hash;
+	unsigned int index;
+
+	hash = concurrent_hash_table_hash(hash_table, key);
+	stripe = concurrent_hash_table_stripe(hash_table, hash);
+
+	pthread_rwlock_wrlock(&stripe->lock);
+
+	rover = concurrent_hash_table_find(hash_table, stripe, key, hash);
+
+	if (rover != NULL) {
+
+		/* Same key: overwrite the existing entry, freeing the old
+		 * key and value */
+		pair = &((*rover)->pair);
+
+		if (hash_table->value_free_func != NULL) {
+			hash_table->value_free_func(pair->value);
+		}
+
+		if (hash_table->key_free_func != NULL) {
+			hash_table->key_free_func(pair->key);
+		}
+
+		pair->key = key;
+		pair->value = value;
+
+		pthread_rwlock_unlock(&stripe->lock);
+
+		return 1;
+	}
+
+	/* Keep the average chain length below one */
+	if (stripe->entries >= stripe->table_size - stripe->table_size / 4) {
+		if (!concurrent_hash_table_enlarge(hash_table, stripe)) {
+			pthread_rwlock_unlock(&stripe->lock);
+			return 0;
+		}
+	}
+
+	newentry = malloc(sizeof(ConcurrentHashTableEntry));
+
+	if (newentry == NULL) {
+		pthread_rwlock_unlock(&stripe->lock);
+		return 0;
+	}
+
+	newentry->pair.key = key;
+	newentry->pair.value = value;
+	newentry->hash = hash;
+
+	index = concurrent_hash_table_chain(hash_table, hash,
+	                                    stripe->table_size);
+	newentry->next = stripe->table[index];
+	stripe->table[index] = newentry;
+
+	++stripe->entries;
+
+	pthread_rwlock_unlock(&stripe->lock);
+
+	return 1;
+}
+
+HashTableValue concurrent_hash_table_lookup(ConcurrentHashTable *hash_table,
+                                            HashTableKey key)
+{
+	ConcurrentHashTableStripe *stripe;
+	ConcurrentHashTableEntry **rover;
+	HashTableValue result;
+	unsigned int hash;
+
+	hash = concurrent_hash_table_hash(hash_table, key);
+	stripe = concurrent_hash_table_stripe(hash_table, hash);
+
+	pthread_rwlock_rdlock(&stripe->lock);
+
+	rover = concurrent_hash_table_find(hash_table, stripe, key, hash);
+
+	/* The value must be copied out before the lock is released, as
+	 * the entry may be freed by another thread straight afterwards. */
+	if (rover != NULL) {
+		result = (*rover)->pair.value;
+	} else {
+		result = concurrent_hash_table_null_value;
+	}
+
+	pthread_rwlock_unlock(&stripe->lock);
+
+	return result;
+}
+
+int concurrent_hash_table_remove(ConcurrentHashTable *hash_table,
+                                 HashTableKey key)
+{
+	ConcurrentHashTableStripe *stripe;
+	ConcurrentHashTableEntry **rover;
+	ConcurrentHashTableEntry *entry;
+	unsigned int hash;
+
+	hash = concurrent_hash_table_hash(hash_table, key);
+	stripe = concurrent_hash_table_stripe(hash_table, hash);
+
+	pthread_rwlock_wrlock(&stripe->lock);
+
+	rover = concurrent_hash_table_find(hash_table, stripe, key, hash);
+
+	if (rover == NULL) {
+		pthread_rwlock_unlock(&stripe->lock);
+		return 0;
+	}
+
+	/* Readers hold the lock for reading while they examine an entry,
+	 * so while it is held for writing here, nobody else can have a
+	 * reference to the entry and it can be freed immediately. */
+	entry = *rover;
+	*rover = entry->next;
+	--stripe->entries;
+
+	concurrent_hash_table_free_entry(hash_table, entry);
+
+	pthread_rwlock_unlock(&stripe->lock);
+
+	return 1;
+}
+
+unsigned int concurrent_hash_table_num_entries(ConcurrentHashTable *hash_table)
+{
+	ConcurrentHashTableStripe *stripe;
+	unsigned int result;
+	unsigned int i;
+
+	result = 0;
+
+	for (i = 0; i < hash_table->num_stripes; ++i) {
+		stripe = &hash_table->stripes[i].stripe;
+
+		pthread_rwlock_rdlock(&stripe->lock);
+		result += stripe->entries;
+		pthread_rwlock_unlock(&stripe->lock);
+	}
+
+	return result;
+}
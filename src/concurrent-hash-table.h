@@ -0,0 +1,161 @@
+/*
+
+Copyright (c) 2026 Simon Howard
+
+Permission to use, copy, modify, and/or distribute this software
+for any purpose with or without fee is hereby granted, provided
+that the above copyright notice and this permission notice appear
+in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT,
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+ */
+
+/**
+ * @file concurrent-hash-table.h
+ *
+ * @brief Hash table which may be used from several threads at once.
+ *
+ * A concurrent hash table stores a set of values which can be addressed
+ * by a key, in the same way as a @ref HashTable, but may be safely
+ * accessed by any number of threads at the same time without any
+ * external locking.
+ *
+ * The table is divided into a number of stripes, each of which is an
+ * independent hash table protected by its own read/write lock.  Each
+ * key belongs to exactly one stripe, so threads working on keys in
+ * different stripes never wait for each other, and any number of
+ * threads may look up keys in the same stripe at once.  Each stripe is
+ * enlarged independently, so a resize never stops the whole table.
+ *
+ * Keys, values and the hash and comparison functions are the same types
+ * used by @ref HashTable.
+ *
+ * To create a concurrent hash table, use @ref concurrent_hash_table_new.
+ * To destroy one, use @ref concurrent_hash_table_free; no other thread
+ * may be using the table at that point.
+ *
+ * To insert a value, use @ref concurrent_hash_table_insert.  To remove a
+ * value, use @ref concurrent_hash_table_remove.  To look up a value by
+ * its key, use @ref concurrent_hash_table_lookup.
+ *
+ * Entries are only ever freed while the lock on their stripe is held for
+ * writing, which guarantees that no other thread is examining them.  The
+ * free functions registered using
+ * @ref concurrent_hash_table_register_free_functions are called at the
+ * same point, so if a value is freed when it is removed, another thread
+ * which has looked up that value must not still be using it.
+ */
+
+#ifndef ALGORITHM_CONCURRENT_HASH_TABLE_H
+#define ALGORITHM_CONCURRENT_HASH_TABLE_H
+
+#include "hash-table.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * A concurrent hash table structure.
+ */
+typedef struct _ConcurrentHashTable ConcurrentHashTable;
+
+/**
+ * Create a new concurrent hash table.
+ *
+ * @param hash_func            Function used to generate hash keys for the
+ *                             keys used in the table.
+ * @param equal_func           Function used to test keys used in the table
+ *                             for equality.
+ * @param num_stripes          Number of independently locked stripes to
+ *                             divide the table into.  This is rounded up
+ *                             to a power of two.  A few times the number
+ *                             of threads using the table is a good choice.
+ *                             If zero, a default is used.
+ * @return                     A new concurrent hash table, or NULL if it
+ *                             was not possible to allocate the new table.
+ */
+ConcurrentHashTable *concurrent_hash_table_new(HashTableHashFunc hash_func,
+                                               HashTableEqualFunc equal_func,
+                                               unsigned int num_stripes);
+
+/**
+ * Destroy a concurrent hash table.  No other thread may be using the
+ * table.
+ *
+ * @param hash_table           The table to destroy.
+ */
+void concurrent_hash_table_free(ConcurrentHashTable *hash_table);
+
+/**
+ * Register functions used to free the key and value when an entry is
+ * removed from a concurrent hash table.  This should be done before the
+ * table is shared with other threads.
+ *
+ * @param hash_table           The table.
+ * @param key_free_func        Function used to free keys.
+ * @param value_free_func      Function used to free values.
+ */
+void concurrent_hash_table_register_free_functions(
+    ConcurrentHashTable *hash_table, HashTableKeyFreeFunc key_free_func,
+    HashTableValueFreeFunc value_free_func);
+
+/**
+ * Insert a value into a concurrent hash table, overwriting any existing
+ * entry using the same key.
+ *
+ * @param hash_table           The table.
+ * @param key                  The key for the new value.
+ * @param value                The value to insert.
+ * @return                     Non-zero if the value was added successfully,
+ *                             or zero if it was not possible to allocate
+ *                             memory for the new entry.
+ */
+int concurrent_hash_table_insert(ConcurrentHashTable *hash_table,
+                                 HashTableKey key, HashTableValue value);
+
+/**
+ * Look up a value in a concurrent hash table by key.
+ *
+ * @param hash_table           The table.
+ * @param key                  The key of the value to look up.
+ * @return                     The value, or @ref HASH_TABLE_NULL if there
+ *                             is no value with that key in the table.
+ */
+HashTableValue concurrent_hash_table_lookup(ConcurrentHashTable *hash_table,
+                                            HashTableKey key);
+
+/**
+ * Remove a value from a concurrent hash table.
+ *
+ * @param hash_table           The table.
+ * @param key                  The key of the value to remove.
+ * @return                     Non-zero if a key was removed, or zero if the
+ *                             specified key was not found in the table.
+ */
+int concurrent_hash_table_remove(ConcurrentHashTable *hash_table,
+                                 HashTableKey key);
+
+/**
+ * Retrieve the number of entries in a concurrent hash table.  If other
+ * threads are modifying the table at the same time, the result may
+ * already be out of date when it is returned.
+ *
+ * @param hash_table           The table.
+ * @return                     The number of entries in the table.
+ */
+unsigned int concurrent_hash_table_num_entries(ConcurrentHashTable *hash_table);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef ALGORITHM_CONCURRENT_HASH_TABLE_H */
@@ -0,0 +1,282 @@
+/*
+
+Copyright (c) 2026 Simon Howard
+
+Permission to use, copy, modify, and/or distribute this software
+for any purpose with or without fee is hereby granted, provided
+that the above copyright notice and this permission notice appear
+in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT,
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+ */
+
+/* Counting bloom filter: a bloom filter with counters, to allow removal */
+
+#include <stdlib.h>
+
+#include "counting-bloom-filter.h"
+
+/* malloc() / free() testing */
+#ifdef ALLOC_TESTING
+#include "alloc-testing.h"
+#endif
+
+/* Counters are four bits, packed two to a byte with the even-numbered
+ * counter in the low half.  A counter that reaches the maximum is never
+ * changed again, as it may be shared by more values than it can
+ * count. */
+#define COUNTING_BLOOM_FILTER_MAX 15
+
+struct _CountingBloomFilter {
+	CountingBloomFilterHashFunc hash_func;
+	unsigned char *table;
+	unsigned int table_size;
+	unsigned int num_functions;
+};
+
+CountingBloomFilter *counting_bloom_filter_new(
+    unsigned int table_size, CountingBloomFilterHashFunc hash_func,
+    unsigned int num_functions)
+{
+	CountingBloomFilter *filter;
+
+	if (table_size == 0) {
+		return NULL;
+	}
+
+	filter = malloc(sizeof(CountingBloomFilter));
+
+	if (filter == NULL) {
+		return NULL;
+	}
+
+	/* Two counters fit in each byte, so round up to a whole byte */
+	filter->table = calloc(table_size / 2 + table_size % 2, 1);
+
+	if (filter->table == NULL) {
+		free(filter);
+		return NULL;
+	}
+
+	filter->hash_func = hash_func;
+	filter->table_size = table_size;
+	filter->num_functions = num_functions;
+
+	return filter;
+}
+
+void counting_bloom_filter_free(CountingBloomFilter *filter)
+{
+	free(filter->table);
+	free(filter);
+}
+
+static unsigned int counting_bloom_filter_get(CountingBloomFilter *filter,
+                                              unsigned int index)
+{
+	return (filter->table[index / 2] >> ((index % 2) * 4)) & 0xf;
+}
+
+static void counting_bloom_filter_set(CountingBloomFilter *filter,
+                                      unsigned int index, unsigned int count)
+{
+	unsigned int shift;
+	unsigned char *p;
+
+	shift = (index % 2) * 4;
+	p = &filter->table[index / 2];
+	*p = (unsigned char) ((*p & ~(0xfU << shift)) | (count << shift));
+}
+
+/* Mix the bits of a hash value, so that every bit of the result depends
+ * on every bit of the hash */
+static unsigned int counting_bloom_filter_mix(unsigned int hash)
+{
+	hash ^= hash >> 16;
+	hash = (hash * 0x85ebca6bU) & 0xffffffffU;
+	hash ^= hash >> 13;
+	hash = (hash * 0xc2b2ae35U) & 0xffffffffU;
+	hash ^= hash >> 16;
+
+	return hash;
+}
+
+/* Find the greatest common divisor of two numbers */
+static unsigned int counting_bloom_filter_gcd(unsigned int a, unsigned int b)
+{
+	unsigned int t;
+
+	while (b != 0) {
+		t = a % b;
+		a = b;
+		b = t;
+	}
+
+	return a;
+}
+
+/* Find the counters for a value, storing the index of the first in
+ * *index and the step to the next in *step.  The counters are found by
+ * double hashing, from the mixed hash and the result of mixing it
+ * again, rather than needing a separate hash for each counter.
+ *
+ * The step is chosen to have no factor in common with the table size.
+ * Stepping through the table then visits every counter once before
+ * coming back to the first, so each value gets num_functions different
+ * counters (as long as the table has that many). */
+static void counting_bloom_filter_hash(CountingBloomFilter *filter,
+                                       CountingBloomFilterValue value,
+                                       unsigned int *index,
+                                       unsigned int *step)
+{
+	unsigned int mixed;
+
+	mixed = counting_bloom_filter_mix(filter->hash_func(value));
+	*index = mixed % filter->table_size;
+
+	if (filter->table_size < 2) {
+		*step = 0;
+		return;
+	}
+
+	*step = counting_bloom_filter_mix(mixed) %
+	        (filter->table_size - 1) + 1;
+
+	/* 1 has no factors, so this always stops */
+	while (counting_bloom_filter_gcd(filter->table_size, *step) != 1) {
+		--*step;
+	}
+}
+
+/* Move on to the next counter for a value.  The index and step are both
+ * less than the table size, so this cannot overflow. */
+static void counting_bloom_filter_next(CountingBloomFilter *filter,
+                                       unsigned int *index,
+                                       unsigned int step)
+{
+	if (*index >= filter->table_size - step) {
+		*index -= filter->table_size - step;
+	} else {
+		*index += step;
+	}
+}
+
+void counting_bloom_filter_insert(CountingBloomFilter *filter,
+                                  CountingBloomFilterValue value)
+{
+	unsigned int index;
+	unsigned int step;
+	unsigned int count;
+	unsigned int i;
+
+	counting_bloom_filter_hash(filter, value, &index, &step);
+
+	for (i = 0; i < filter->num_functions; ++i) {
+		count = counting_bloom_filter_get(filter, index);
+
+		if (count < COUNTING_BLOOM_FILTER_MAX) {
+			counting_bloom_filter_set(filter, index, count + 1);
+		}
+
+		counting_bloom_filter_next(filter, &index, step);
+	}
+}
+
+int counting_bloom_filter_query(CountingBloomFilter *filter,
+                                CountingBloomFilterValue value)
+{
+	unsigned int index;
+	unsigned int step;
+	unsigned int i;
+
+	counting_bloom_filter_hash(filter, value, &index, &step);
+
+	/* The value cannot have been inserted if any of its counters
+	 * are zero */
+	for (i = 0; i < filter->num_functions; ++i) {
+		if (counting_bloom_filter_get(filter, index) == 0) {
+			return 0;
+		}
+
+		counting_bloom_filter_next(filter, &index, step);
+	}
+
+	return 1;
+}
+
+int counting_bloom_filter_remove(CountingBloomFilter *filter,
+                                 CountingBloomFilterValue value)
+{
+	unsigned int index;
+	unsigned int step;
+	unsigned int count;
+	unsigned int i;
+
+	/* Removing a value which is definitely absent would take counts
+	 * away from other values */
+	if (!counting_bloom_filter_query(filter, value)) {
+		return 0;
+	}
+
+	counting_bloom_filter_hash(filter, value, &index, &step);
+
+	for (i = 0; i < filter->num_functions; ++i) {
+		count = counting_bloom_filter_get(filter, index);
+
+		/* A counter can only reach zero here if a value that was
+		 * never inserted has been removed before */
+		if (count > 0 && count < COUNTING_BLOOM_FILTER_MAX) {
+			counting_bloom_filter_set(filter, index, count - 1);
+		}
+
+		counting_bloom_filter_next(filter, &index, step);
+	}
+
+	return 1;
+}
+
+CountingBloomFilter *counting_bloom_filter_union(
+    CountingBloomFilter *filter1, CountingBloomFilter *filter2)
+{
+	CountingBloomFilter *result;
+	unsigned int count;
+	unsigned int i;
+
+	/* To perform this operation, both filters must be created with
+	 * the same values. */
+	if (filter1->table_size != filter2->table_size ||
+	    filter1->num_functions != filter2->num_functions ||
+	    filter1->hash_func != filter2->hash_func) {
+		return NULL;
+	}
+
+	result = counting_bloom_filter_new(filter1->table_size,
+	                                   filter1->hash_func,
+	                                   filter1->num_functions);
+
+	if (result == NULL) {
+		return NULL;
+	}
+
+	/* Add the counters, saturating at the maximum */
+	for (i = 0; i < filter1->table_size; ++i) {
+		count = counting_bloom_filter_get(filter1, i) +
+		        counting_bloom_filter_get(filter2, i);
+
+		if (count > COUNTING_BLOOM_FILTER_MAX) {
+			count = COUNTING_BLOOM_FILTER_MAX;
+		}
+
+		counting_bloom_filter_set(result, i, count);
+	}
+
+	return result;
+}
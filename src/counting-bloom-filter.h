@@ -0,0 +1,172 @@
+/*
+
+Copyright (c) 2026 Simon Howard
+
+Permission to use, copy, modify, and/or distribute this software
+for any purpose with or without fee is hereby granted, provided
+that the above copyright notice and this permission notice appear
+in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT,
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+ */
+
+/**
+ * @file counting-bloom-filter.h
+ *
+ * @brief Bloom filter which supports removal
+ *
+ * A counting bloom filter is a bloom filter with a small counter in
+ * place of each bit, so that values can be removed as well as inserted.
+ * As with a @ref BloomFilter, queries will occasionally generate false
+ * positives, but never false negatives, provided that only values which
+ * were inserted are removed.
+ *
+ * Each counter is four bits, so the table uses four times the memory of
+ * a bloom filter of the same size.  A counter which reaches its maximum
+ * of 15 sticks there, as it is no longer known how many values share
+ * it; such counters are very rare in a table sized for a reasonable
+ * false positive rate.
+ *
+ * To create a counting bloom filter, use @ref counting_bloom_filter_new.
+ * To destroy a counting bloom filter, use
+ * @ref counting_bloom_filter_free.
+ *
+ * To insert a value, use @ref counting_bloom_filter_insert.  To remove a
+ * value, use @ref counting_bloom_filter_remove.
+ *
+ * To query whether a value is part of the set, use
+ * @ref counting_bloom_filter_query.
+ *
+ * To combine the values of two filters, use
+ * @ref counting_bloom_filter_union.
+ */
+
+#ifndef ALGORITHM_COUNTING_BLOOM_FILTER_H
+#define ALGORITHM_COUNTING_BLOOM_FILTER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * A counting bloom filter structure.
+ */
+typedef struct _CountingBloomFilter CountingBloomFilter;
+
+#ifdef TEST_ALTERNATE_VALUE_TYPES
+#include "alt-value-type.h"
+#else
+
+/**
+ * A value stored in a @ref CountingBloomFilter.
+ */
+typedef void *CountingBloomFilterValue;
+
+#endif /* #ifndef TEST_ALTERNATE_VALUE_TYPES */
+
+/**
+ * Hash function used to generate hash values for values inserted into a
+ * counting bloom filter.
+ *
+ * @param data   The value to generate a hash value for.
+ * @return       The hash value.
+ */
+typedef unsigned int (*CountingBloomFilterHashFunc)(
+    CountingBloomFilterValue data);
+
+/**
+ * Create a new counting bloom filter.
+ *
+ * @param table_size       The number of counters in the filter.  The
+ *                         greater the table size, the more elements can
+ *                         be stored, and the lesser the chance of false
+ *                         positives.
+ * @param hash_func        Hash function to use on values stored in the
+ *                         filter.
+ * @param num_functions    Number of counters to change for each value.
+ *                         The running time of each operation is
+ *                         proportional to this value.
+ * @return                 A new counting bloom filter, or NULL if it was
+ *                         not possible to allocate the new filter, or
+ *                         if the table size is zero.
+ */
+CountingBloomFilter *counting_bloom_filter_new(
+    unsigned int table_size, CountingBloomFilterHashFunc hash_func,
+    unsigned int num_functions);
+
+/**
+ * Destroy a counting bloom filter.
+ *
+ * @param filter               The filter to destroy.
+ */
+void counting_bloom_filter_free(CountingBloomFilter *filter);
+
+/**
+ * Insert a value into a counting bloom filter.  A value may be inserted
+ * more than once, and must then be removed as many times.
+ *
+ * @param filter               The filter.
+ * @param value                The value to insert.
+ */
+void counting_bloom_filter_insert(CountingBloomFilter *filter,
+                                  CountingBloomFilterValue value);
+
+/**
+ * Remove a value from a counting bloom filter.  Only values which were
+ * inserted should be removed: removing a value which was not inserted,
+ * but which the filter reports as present because of a false positive,
+ * can cause other values to be reported as absent.
+ *
+ * @param filter               The filter.
+ * @param value                The value to remove.
+ * @return                     Non-zero if the value was removed, or zero
+ *                             if it was definitely not in the filter, in
+ *                             which case the filter is not changed.
+ */
+int counting_bloom_filter_remove(CountingBloomFilter *filter,
+                                 CountingBloomFilterValue value);
+
+/**
+ * Query a counting bloom filter for a particular value.
+ *
+ * @param filter               The filter.
+ * @param value                The value to look up.
+ * @return                     Zero if the value is definitely not in the
+ *                             filter.  Non-zero indicates that it either
+ *                             may or may not be in the filter.
+ */
+int counting_bloom_filter_query(CountingBloomFilter *filter,
+                                CountingBloomFilterValue value);
+
+/**
+ * Find the union of two counting bloom filters.  Each counter of the
+ * result is the sum of those of the original filters, so a value
+ * inserted into both filters must be removed twice from the result.
+ *
+ * Both of the original filters must have been created using the
+ * same parameters to @ref counting_bloom_filter_new.
+ *
+ * @param filter1              The first filter.
+ * @param filter2              The second filter.
+ * @return                     A new filter which is the union of the two
+ *                             filters, or NULL if it was not possible
+ *                             to allocate memory for the new filter, or
+ *                             if the two filters specified were created
+ *                             with different parameters.
+ */
+CountingBloomFilter *counting_bloom_filter_union(
+    CountingBloomFilter *filter1, CountingBloomFilter *filter2);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef ALGORITHM_COUNTING_BLOOM_FILTER_H */
@@ -21,6 +21,7 @@ CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 /* String hash functions */
 
 #include <ctype.h>
+#include <limits.h>
 
 #include "hash-string.h"
 
@@ -56,3 +57,26 @@ unsigned int string_nocase_hash(void *string)
 
 	return result;
 }
+
+unsigned long string_wide_hash(void *string)
+{
+	/* This is the FNV-1a string hash function, using the 64-bit
+	 * parameters where unsigned long is wide enough */
+#if ULONG_MAX > 0xffffffffUL
+	unsigned long result = 0xcbf29ce484222325UL;
+	unsigned long prime = 0x100000001b3UL;
+#else
+	unsigned long result = 0x811c9dc5UL;
+	unsigned long prime = 0x01000193UL;
+#endif
+	unsigned char *p;
+
+	p = (unsigned char *) string;
+
+	while (*p != '\0') {
+		result = (result ^ *p) * prime;
+		++p;
+	}
+
+	return result;
+}
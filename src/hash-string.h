@@ -22,7 +22,8 @@ CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  * @file hash-string.h
  *
  * Hash functions for text strings.  For more information
- * see @ref string_hash or @ref string_nocase_hash.
+ * see @ref string_hash, @ref string_nocase_hash or
+ * @ref string_wide_hash.
  */
 
 #ifndef ALGORITHM_HASH_STRING_H
@@ -48,6 +49,17 @@ unsigned int string_hash(void *string);
  */
 unsigned int string_nocase_hash(void *string);
 
+/**
+ * Generate a wide hash key from a string, with as many bits as an
+ * unsigned long, for uses such as large bloom filters where a 32-bit
+ * hash key would not tell enough strings apart.  Where unsigned long is
+ * only 32 bits wide, this is no wider than @ref string_hash.
+ *
+ * @param string           The string.
+ * @return                 A hash key for the string.
+ */
+unsigned long string_wide_hash(void *string);
+
 #ifdef __cplusplus
 }
 #endif
@@ -20,21 +20,124 @@ CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 
 /* Hash table */
 
+/* Large resizes and bulk inserts can only use several threads if the
+ * library is built with HASH_TABLE_THREADS defined, which needs POSIX
+ * threads.  Otherwise everything is done on the calling thread. */
+#ifdef HASH_TABLE_THREADS
+/* Threads are part of POSIX.1-2001 */
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include <limits.h>
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef HASH_TABLE_THREADS
+#include <pthread.h>
+#endif
+
 #include "hash-table.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 /* malloc() / free() testing */
 #ifdef ALLOC_TESTING
 #include "alloc-testing.h"
 #endif
 
+/* Each entry stores the hash of its key.  Comparing hashes first means
+ * that the key comparison function is only called when the keys are
+ * likely to be equal, and the table can be enlarged without calling
+ * the hash function again. */
 struct _HashTableEntry {
 	HashTablePair pair;
+	unsigned int hash;
 	HashTableEntry *next;
 };
 
+/* Pooled tables allocate their entries from slabs, each holding twice
+ * as many entries as the last up to a maximum, so that small tables stay
+ * small and large ones need few allocations. */
+#define HASH_TABLE_MIN_SLAB_ENTRIES 32
+#define HASH_TABLE_MAX_SLAB_ENTRIES 8192
+
+typedef struct _HashTableSlab HashTableSlab;
+
+struct _HashTableSlab {
+	HashTableSlab *next;
+	unsigned int capacity;
+	HashTableEntry entries[1];
+};
+
+/* Open addressing tables store their entries in an array of slots, and
+ * keep a parallel array of control bytes that describes each slot.  A
+ * control byte is either one of the special values below (both of which
+ * have the top bit set) or, for a slot in use, the low seven bits of the
+ * hash of the key stored in the slot.  Slots are probed a group at a
+ * time: the control bytes for a whole group can be compared against the
+ * hash of the key being looked for in a single operation, and the key
+ * comparison function is usually only invoked for the slot that
+ * actually matches. */
+
+#define HASH_TABLE_GROUP_WIDTH 16
+#define HASH_TABLE_CTRL_EMPTY 0x80
+#define HASH_TABLE_CTRL_DELETED 0xfe
+#define HASH_TABLE_MIN_SLOTS HASH_TABLE_GROUP_WIDTH
+
+/* Number of chains moved to the new table on each insert during an
+ * incremental resize.  The table is enlarged when it reaches the maximum
+ * load factor, and the next enlarge is not needed until about as many
+ * entries again have been added.  With the default maximum load factor
+ * of 1/3, moving more than three chains per insert guarantees the resize
+ * is complete by then, and this leaves room for load factors down to
+ * 1/8.  If the table does fill up first, the rest of the resize is done
+ * at once. */
+#define HASH_TABLE_INSERT_REHASH_STEP 8
+
+/* By default, chained tables are enlarged when they become 1/3 full, and
+ * never shrink. */
+#define HASH_TABLE_DEFAULT_MAX_LOAD (1.0 / 3.0)
+#define HASH_TABLE_DEFAULT_MIN_LOAD 0.0
+
+/* Open addressing tables are allowed to become 7/8 full by default */
+#define HASH_TABLE_DEFAULT_OPEN_MAX_LOAD (7.0 / 8.0)
+
+/* Statistics on searches are only gathered if the library is built with
+ * HASH_TABLE_STATISTICS defined, as they add to the cost of every search.
+ * Everything else reported by hash_table_get_statistics is worked out
+ * when it is called. */
+#ifdef HASH_TABLE_STATISTICS
+#define HASH_TABLE_SEARCH_BEGIN(hash_table) ((hash_table)->search_probes = 0)
+#define HASH_TABLE_SEARCH_PROBE(hash_table) (++(hash_table)->search_probes)
+#define HASH_TABLE_SEARCH_END(hash_table) hash_table_search_end(hash_table)
+#else
+#define HASH_TABLE_SEARCH_BEGIN(hash_table) ((void) 0)
+#define HASH_TABLE_SEARCH_PROBE(hash_table) ((void) 0)
+#define HASH_TABLE_SEARCH_END(hash_table) ((void) 0)
+#endif
+
+/* Returned by the slot search functions when a key is not present */
+#define HASH_TABLE_NO_SLOT ((unsigned int) -1)
+
+/* Number of keys hashed at once by the bulk insert and lookup functions.
+ * The memory each key needs is prefetched for the whole batch before any
+ * of them are inserted or looked up, so that the cache misses overlap
+ * instead of being waited for one after another. */
+#define HASH_TABLE_BATCH_SIZE 16
+
+#if defined(__GNUC__)
+#define HASH_TABLE_PREFETCH(addr) __builtin_prefetch(addr)
+#else
+#define HASH_TABLE_PREFETCH(addr)
+#endif
+
+/* Resizes and bulk inserts smaller than this are always done on the
+ * calling thread, as starting threads would cost more than it saves. */
+#define HASH_TABLE_PARALLEL_MIN_ENTRIES 8192
+#define HASH_TABLE_MAX_THREADS 64
+
 struct _HashTable {
 	HashTableEntry **table;
 	unsigned int table_size;
@@ -44,6 +147,59 @@ struct _HashTable {
 	HashTableValueFreeFunc value_free_func;
 	unsigned int entries;
 	unsigned int prime_index;
+	unsigned int flags;
+
+	/* The table is enlarged when an insert finds max_entries entries
+	 * in it, and shrunk when a remove leaves fewer than min_entries.
+	 * These are recalculated from the load factors whenever the table
+	 * changes size. */
+	double max_load_factor;
+	double min_load_factor;
+	unsigned int max_entries;
+	unsigned int min_entries;
+
+	/* Used during an incremental resize of a chained table.  Chains
+	 * before rehash_index in the old table have already been moved
+	 * into the new one. */
+	HashTableEntry **old_table;
+	unsigned int old_table_size;
+	unsigned int rehash_index;
+
+	/* Used by pooled tables only.  New entries are carved from the
+	 * first slab in the list, which has slab_used of its slab_capacity
+	 * entries in use.  Removed entries are kept on a free list, linked
+	 * through their next pointers, to be reused first. */
+	HashTableSlab *slabs;
+	HashTableEntry *free_entries;
+	unsigned int slab_used;
+	unsigned int slab_capacity;
+
+	/* Number of times the table has been rebuilt at a new size */
+	unsigned int resizes;
+
+	/* Number of threads used for large resizes and bulk inserts */
+	unsigned int num_threads;
+
+#ifdef HASH_TABLE_STATISTICS
+	/* Number of searches for a key, the total number of entries (or
+	 * groups, for an open addressing table) examined by them, and the
+	 * most examined by any one search.  search_probes counts the
+	 * entries examined by the search in progress. */
+	unsigned long searches;
+	unsigned long probes;
+	unsigned int max_probes;
+	unsigned int search_probes;
+#endif
+
+	/* Used by open addressing tables only.  table_size is the number
+	 * of slots, and growth_left is the number of empty slots that may
+	 * still be filled before the table must be resized.  The full hash
+	 * of each slot's key is kept separately from the slot itself, as
+	 * it is only needed when the table is rebuilt. */
+	HashTablePair *slots;
+	unsigned int *hashes;
+	unsigned char *ctrl;
+	unsigned int growth_left;
 };
 
 /* This is a set of good hash table prime numbers, from:
@@ -63,29 +219,177 @@ static const unsigned int hash_table_num_primes =
 /* Null value that can be returned without creating a local variable */
 static const HashTableValue hash_table_null_value = HASH_TABLE_NULL;
 
-/* Internal function used to allocate the table on hash table creation
- * and when enlarging the table */
-static int hash_table_allocate_table(HashTable *hash_table)
+#ifdef HASH_TABLE_STATISTICS
+static void hash_table_search_end(HashTable *hash_table)
 {
-	unsigned int new_table_size;
+	++hash_table->searches;
+	hash_table->probes += hash_table->search_probes;
 
-	/* Determine the table size based on the current prime index.
-	 * An attempt is made here to ensure sensible behavior if the
-	 * maximum prime is exceeded, but in practice other things are
-	 * likely to break long before that happens. */
-	if (hash_table->prime_index < hash_table_num_primes) {
-		new_table_size = hash_table_primes[hash_table->prime_index];
+	if (hash_table->search_probes > hash_table->max_probes) {
+		hash_table->max_probes = hash_table->search_probes;
+	}
+}
+#endif
+
+/* Determine the size of a chained table with the given prime index.
+ * An attempt is made here to ensure sensible behavior if the maximum
+ * prime is exceeded, but in practice other things are likely to break
+ * long before that happens. */
+static unsigned int hash_table_size_for_index(HashTable *hash_table,
+                                              unsigned int prime_index)
+{
+	if ((hash_table->flags & HASH_TABLE_POWER_OF_TWO) != 0) {
+		if (prime_index < 24) {
+			return 256U << prime_index;
+		} else {
+			return 1U << 31;
+		}
+	} else if (prime_index < hash_table_num_primes) {
+		return hash_table_primes[prime_index];
 	} else {
-		new_table_size = hash_table->entries * 10;
+		return hash_table->entries * 10;
+	}
+}
+
+/* Find the number of entries that gives a table of the given size the
+ * given load factor, rounding up. */
+static unsigned int hash_table_load_limit(unsigned int table_size,
+                                          double load_factor)
+{
+	double limit;
+	unsigned int result;
+
+	limit = (double) table_size * load_factor;
+
+	if (limit >= (double) UINT_MAX) {
+		return UINT_MAX;
+	}
+
+	result = (unsigned int) limit;
+
+	if ((double) result < limit) {
+		++result;
+	}
+
+	return result;
+}
+
+/* Find the number of entries that a table of the given size can hold
+ * before it must be enlarged.  Open addressing tables must always have
+ * some empty slots left, so they are never allowed to become more than
+ * 7/8 full, whatever the maximum load factor.  This guarantees that
+ * every probe sequence ends at an empty slot. */
+static unsigned int hash_table_max_entries(HashTable *hash_table,
+                                           unsigned int table_size)
+{
+	unsigned int result;
+
+	result = hash_table_load_limit(table_size,
+	                               hash_table->max_load_factor);
+
+	if ((hash_table->flags & HASH_TABLE_OPEN_ADDRESSING) != 0 &&
+	    result > table_size - table_size / 8) {
+		result = table_size - table_size / 8;
 	}
 
-	hash_table->table_size = new_table_size;
+	return result;
+}
+
+/* Recalculate the entry counts at which the table is resized, after the
+ * table size or the load factors have changed. */
+static void hash_table_update_limits(HashTable *hash_table)
+{
+	hash_table->max_entries =
+	    hash_table_max_entries(hash_table, hash_table->table_size);
+	hash_table->min_entries = hash_table_load_limit(
+	    hash_table->table_size, hash_table->min_load_factor);
+}
+
+/* Internal function used to allocate the table on hash table creation
+ * and when enlarging the table */
+static int hash_table_allocate_table(HashTable *hash_table)
+{
+	/* Determine the table size based on the current prime index. */
+	hash_table->table_size =
+	    hash_table_size_for_index(hash_table, hash_table->prime_index);
 
 	/* Allocate the table and initialise to NULL for all entries */
 	hash_table->table =
 	    calloc(hash_table->table_size, sizeof(HashTableEntry *));
 
-	return hash_table->table != NULL;
+	if (hash_table->table == NULL) {
+		return 0;
+	}
+
+	hash_table_update_limits(hash_table);
+
+	return 1;
+}
+
+/* Allocate a new entry for a chained table */
+static HashTableEntry *hash_table_alloc_entry(HashTable *hash_table)
+{
+	HashTableEntry *entry;
+	HashTableSlab *slab;
+	unsigned int capacity;
+
+	if ((hash_table->flags & HASH_TABLE_POOLED) == 0) {
+		return (HashTableEntry *) malloc(sizeof(HashTableEntry));
+	}
+
+	/* Reuse a removed entry if there is one */
+	if (hash_table->free_entries != NULL) {
+		entry = hash_table->free_entries;
+		hash_table->free_entries = entry->next;
+
+		return entry;
+	}
+
+	/* Start a new slab if the current one is full */
+	if (hash_table->slabs == NULL ||
+	    hash_table->slab_used == hash_table->slab_capacity) {
+
+		if (hash_table->slabs == NULL ||
+		    hash_table->slab_capacity <
+		        HASH_TABLE_MIN_SLAB_ENTRIES / 2) {
+			capacity = HASH_TABLE_MIN_SLAB_ENTRIES;
+		} else if (hash_table->slab_capacity <
+		           HASH_TABLE_MAX_SLAB_ENTRIES / 2) {
+			capacity = hash_table->slab_capacity * 2;
+		} else {
+			capacity = HASH_TABLE_MAX_SLAB_ENTRIES;
+		}
+
+		slab = malloc(sizeof(HashTableSlab) +
+		              (capacity - 1) * sizeof(HashTableEntry));
+
+		if (slab == NULL) {
+			return NULL;
+		}
+
+		slab->next = hash_table->slabs;
+		slab->capacity = capacity;
+		hash_table->slabs = slab;
+		hash_table->slab_used = 0;
+		hash_table->slab_capacity = capacity;
+	}
+
+	return &hash_table->slabs->entries[hash_table->slab_used++];
+}
+
+/* Free all of the slabs of a pooled table */
+static void hash_table_free_slabs(HashTable *hash_table)
+{
+	HashTableSlab *slab;
+	HashTableSlab *next;
+
+	for (slab = hash_table->slabs; slab != NULL; slab = next) {
+		next = slab->next;
+		free(slab);
+	}
+
+	hash_table->slabs = NULL;
+	hash_table->free_entries = NULL;
 }
 
 /* Free an entry, calling the free functions if there are any registered */
@@ -106,287 +410,1904 @@ static void hash_table_free_entry(HashTable *hash_table, HashTableEntry *entry)
 		hash_table->value_free_func(pair->value);
 	}
 
-	/* Free the data structure */
-	free(entry);
+	/* Free the data structure, or keep it to be reused if it belongs
+	 * to a slab */
+	if ((hash_table->flags & HASH_TABLE_POOLED) != 0) {
+		entry->next = hash_table->free_entries;
+		hash_table->free_entries = entry;
+	} else {
+		free(entry);
+	}
 }
 
-HashTable *hash_table_new(HashTableHashFunc hash_func,
-                          HashTableEqualFunc equal_func)
+/* Scramble the bits of a hash value produced by the user's hash function.
+ * Open addressing tables use the low bits of the hash to find the group
+ * to probe and the high bits as the control byte, so hash functions that
+ * only vary in a few bits (such as int_hash) must be mixed first.  This
+ * is the finalizer from MurmurHash3. */
+static unsigned int hash_table_mix(unsigned int hash)
 {
-	HashTable *hash_table;
+	hash ^= hash >> 16;
+	hash *= 0x85ebca6bU;
+	hash ^= hash >> 13;
+	hash *= 0xc2b2ae35U;
+	hash ^= hash >> 16;
 
-	/* Allocate a new hash table structure */
-	hash_table = (HashTable *) malloc(sizeof(HashTable));
+	return hash;
+}
 
-	if (hash_table == NULL) {
-		return NULL;
+/* Find the chain in a chained table of the given size that a hash value
+ * belongs to. */
+static unsigned int hash_table_chain_index(HashTable *hash_table,
+                                           unsigned int hash,
+                                           unsigned int table_size)
+{
+	if ((hash_table->flags & HASH_TABLE_POWER_OF_TWO) != 0) {
+		return hash_table_mix(hash) & (table_size - 1);
+	} else {
+		return hash % table_size;
 	}
+}
 
-	hash_table->hash_func = hash_func;
-	hash_table->equal_func = equal_func;
-	hash_table->key_free_func = NULL;
-	hash_table->value_free_func = NULL;
-	hash_table->entries = 0;
-	hash_table->prime_index = 0;
+/* Find the index of the lowest bit that is set in a non-zero mask. */
+static unsigned int hash_table_lowest_bit(unsigned int mask)
+{
+#ifdef __GNUC__
+	return (unsigned int) __builtin_ctz(mask);
+#else
+	unsigned int result;
 
-	/* Allocate the table */
-	if (!hash_table_allocate_table(hash_table)) {
-		free(hash_table);
+	for (result = 0; (mask & 1) == 0; ++result) {
+		mask >>= 1;
+	}
 
-		return NULL;
+	return result;
+#endif
+}
+
+/* Compare every control byte in a group against a value, returning a
+ * bitmask with a bit set for each byte that matched. */
+static unsigned int hash_table_group_match(const unsigned char *group,
+                                           unsigned int value)
+{
+#ifdef __SSE2__
+	__m128i ctrl;
+	__m128i match;
+
+	ctrl = _mm_loadu_si128((const __m128i *) group);
+	match = _mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char) value));
+
+	return (unsigned int) _mm_movemask_epi8(match);
+#else
+	unsigned int result;
+	unsigned int i;
+
+	result = 0;
+
+	for (i = 0; i < HASH_TABLE_GROUP_WIDTH; ++i) {
+		if (group[i] == value) {
+			result |= 1U << i;
+		}
+	}
+
+	return result;
+#endif
+}
+
+/* Find the slots in a group that are not in use (either empty or
+ * deleted), returning a bitmask with a bit set for each one.  Both special
+ * control values have the top bit set, which is exactly what the SSE2
+ * movemask instruction extracts. */
+static unsigned int hash_table_group_match_free(const unsigned char *group)
+{
+#ifdef __SSE2__
+	__m128i ctrl;
+
+	ctrl = _mm_loadu_si128((const __m128i *) group);
+
+	return (unsigned int) _mm_movemask_epi8(ctrl);
+#else
+	unsigned int result;
+	unsigned int i;
+
+	result = 0;
+
+	for (i = 0; i < HASH_TABLE_GROUP_WIDTH; ++i) {
+		if ((group[i] & 0x80) != 0) {
+			result |= 1U << i;
+		}
+	}
+
+	return result;
+#endif
+}
+
+/* Allocate the slot, hash and control arrays of an open addressing
+ * table.  All three live in a single block, with the control bytes at
+ * the end. */
+static int hash_table_open_allocate(HashTable *hash_table,
+                                    unsigned int num_slots)
+{
+	HashTablePair *slots;
+
+	slots = malloc(num_slots *
+	               (sizeof(HashTablePair) + sizeof(unsigned int) + 1));
+
+	if (slots == NULL) {
+		return 0;
+	}
+
+	hash_table->slots = slots;
+	hash_table->hashes = (unsigned int *) (slots + num_slots);
+	hash_table->ctrl = (unsigned char *) (hash_table->hashes + num_slots);
+	hash_table->table_size = num_slots;
+
+	hash_table_update_limits(hash_table);
+	hash_table->growth_left = hash_table->max_entries;
+
+	memset(hash_table->ctrl, HASH_TABLE_CTRL_EMPTY, num_slots);
+
+	return 1;
+}
+
+/* Search for the slot holding a key.  The hash is the mixed hash of the
+ * key.  Groups are probed using triangular numbers, which visits every
+ * group when the number of groups is a power of two. */
+static unsigned int hash_table_open_find(HashTable *hash_table,
+                                         HashTableKey key, unsigned int hash)
+{
+	unsigned int group_mask;
+	unsigned int group;
+	unsigned int step;
+	unsigned int match;
+	unsigned int index;
+	unsigned char *ctrl;
+
+	group_mask = hash_table->table_size / HASH_TABLE_GROUP_WIDTH - 1;
+	group = (hash >> 7) & group_mask;
+
+	HASH_TABLE_SEARCH_BEGIN(hash_table);
+
+	for (step = 1;; ++step) {
+		HASH_TABLE_SEARCH_PROBE(hash_table);
+
+		ctrl = hash_table->ctrl + group * HASH_TABLE_GROUP_WIDTH;
+		match = hash_table_group_match(ctrl, hash & 0x7f);
+
+		while (match != 0) {
+			index = group * HASH_TABLE_GROUP_WIDTH +
+			        hash_table_lowest_bit(match);
+
+			if (hash_table->equal_func(
+			        key, hash_table->slots[index].key) != 0) {
+				HASH_TABLE_SEARCH_END(hash_table);
+				return index;
+			}
+
+			match &= match - 1;
+		}
+
+		/* The key would have been stored in this group if there
+		 * was an empty slot in it, so the search ends here. */
+		if (hash_table_group_match(ctrl, HASH_TABLE_CTRL_EMPTY) != 0) {
+			HASH_TABLE_SEARCH_END(hash_table);
+			return HASH_TABLE_NO_SLOT;
+		}
+
+		group = (group + step) & group_mask;
+	}
+}
+
+/* Find the first slot along the probe sequence for a hash that can be
+ * used to store a new entry. */
+static unsigned int hash_table_open_find_free(HashTable *hash_table,
+                                              unsigned int hash)
+{
+	unsigned int group_mask;
+	unsigned int group;
+	unsigned int step;
+	unsigned int match;
+
+	group_mask = hash_table->table_size / HASH_TABLE_GROUP_WIDTH - 1;
+	group = (hash >> 7) & group_mask;
+
+	for (step = 1;; ++step) {
+		match = hash_table_group_match_free(
+		    hash_table->ctrl + group * HASH_TABLE_GROUP_WIDTH);
+
+		if (match != 0) {
+			return group * HASH_TABLE_GROUP_WIDTH +
+			       hash_table_lowest_bit(match);
+		}
+
+		group = (group + step) & group_mask;
+	}
+}
+
+/* Rebuild an open addressing table with the given number of slots.  As
+ * well as growing the table, this clears out any deleted slots. */
+static int hash_table_open_rehash(HashTable *hash_table,
+                                  unsigned int num_slots)
+{
+	HashTablePair *old_slots;
+	unsigned int *old_hashes;
+	unsigned char *old_ctrl;
+	unsigned int old_table_size;
+	unsigned int old_growth_left;
+	unsigned int hash;
+	unsigned int index;
+	unsigned int i;
+
+	old_slots = hash_table->slots;
+	old_hashes = hash_table->hashes;
+	old_ctrl = hash_table->ctrl;
+	old_table_size = hash_table->table_size;
+	old_growth_left = hash_table->growth_left;
+
+	if (!hash_table_open_allocate(hash_table, num_slots)) {
+		hash_table->slots = old_slots;
+		hash_table->hashes = old_hashes;
+		hash_table->ctrl = old_ctrl;
+		hash_table->table_size = old_table_size;
+		hash_table->growth_left = old_growth_left;
+
+		return 0;
+	}
+
+	for (i = 0; i < old_table_size; ++i) {
+		if ((old_ctrl[i] & 0x80) != 0) {
+			continue;
+		}
+
+		hash = old_hashes[i];
+		index = hash_table_open_find_free(hash_table, hash);
+
+		hash_table->ctrl[index] = (unsigned char) (hash & 0x7f);
+		hash_table->slots[index] = old_slots[i];
+		hash_table->hashes[index] = hash;
+		--hash_table->growth_left;
+	}
+
+	free(old_slots);
+
+	++hash_table->resizes;
+
+	return 1;
+}
+
+static void hash_table_open_free(HashTable *hash_table)
+{
+	HashTablePair *pair;
+	unsigned int i;
+
+	if (hash_table->key_free_func != NULL ||
+	    hash_table->value_free_func != NULL) {
+		for (i = 0; i < hash_table->table_size; ++i) {
+			if ((hash_table->ctrl[i] & 0x80) != 0) {
+				continue;
+			}
+
+			pair = &hash_table->slots[i];
+
+			if (hash_table->key_free_func != NULL) {
+				hash_table->key_free_func(pair->key);
+			}
+			if (hash_table->value_free_func != NULL) {
+				hash_table->value_free_func(pair->value);
+			}
+		}
+	}
+
+	free(hash_table->slots);
+}
+
+/* Find the slot holding a key in an open addressing table, adding the
+ * key with the given value if it is not already present.  The hash is
+ * the mixed hash of the key.  NULL is returned if it was not possible to
+ * allocate memory for a new entry. */
+static HashTablePair *hash_table_open_find_or_add(HashTable *hash_table,
+                                                  HashTableKey key,
+                                                  HashTableValue value,
+                                                  unsigned int hash,
+                                                  int *inserted)
+{
+	unsigned int index;
+	unsigned int num_slots;
+
+	index = hash_table_open_find(hash_table, key, hash);
+
+	if (index != HASH_TABLE_NO_SLOT) {
+		*inserted = 0;
+		return &hash_table->slots[index];
+	}
+
+	index = hash_table_open_find_free(hash_table, hash);
+
+	/* Reusing a deleted slot does not bring the table any closer to
+	 * being full, but filling an empty one does. */
+	if (hash_table->ctrl[index] == HASH_TABLE_CTRL_EMPTY &&
+	    hash_table->growth_left == 0) {
+
+		/* If most of the unavailable slots are deleted rather than in
+		 * use, rebuilding at the same size is enough to reclaim them;
+		 * otherwise the table doubles in size. */
+		num_slots = hash_table->table_size;
+
+		if (hash_table->entries >= hash_table->max_entries / 2) {
+			num_slots *= 2;
+		}
+
+		if (!hash_table_open_rehash(hash_table, num_slots)) {
+			return NULL;
+		}
+
+		index = hash_table_open_find_free(hash_table, hash);
+	}
+
+	if (hash_table->ctrl[index] == HASH_TABLE_CTRL_EMPTY) {
+		--hash_table->growth_left;
+	}
+
+	hash_table->ctrl[index] = (unsigned char) (hash & 0x7f);
+	hash_table->hashes[index] = hash;
+	hash_table->slots[index].key = key;
+	hash_table->slots[index].value = value;
+
+	++hash_table->entries;
+
+	*inserted = 1;
+
+	return &hash_table->slots[index];
+}
+
+static HashTableValue hash_table_open_lookup(HashTable *hash_table,
+                                             HashTableKey key,
+                                             unsigned int hash)
+{
+	unsigned int index;
+
+	index = hash_table_open_find(hash_table, key, hash);
+
+	if (index == HASH_TABLE_NO_SLOT) {
+		return hash_table_null_value;
+	}
+
+	return hash_table->slots[index].value;
+}
+
+static int hash_table_open_remove(HashTable *hash_table, HashTableKey key)
+{
+	HashTablePair *pair;
+	unsigned char *group;
+	unsigned int index;
+
+	index = hash_table_open_find(hash_table, key,
+	                             hash_table_mix(hash_table->hash_func(key)));
+
+	if (index == HASH_TABLE_NO_SLOT) {
+		return 0;
+	}
+
+	pair = &hash_table->slots[index];
+
+	if (hash_table->key_free_func != NULL) {
+		hash_table->key_free_func(pair->key);
+	}
+	if (hash_table->value_free_func != NULL) {
+		hash_table->value_free_func(pair->value);
+	}
+
+	/* A search only stops at a group if it contains an empty slot.  If
+	 * this group already has one, the slot can be made empty again
+	 * without affecting other searches.  Otherwise other keys may have
+	 * probed past this group, so it must be marked as deleted. */
+	group = hash_table->ctrl + (index & ~(HASH_TABLE_GROUP_WIDTH - 1U));
+
+	if (hash_table_group_match(group, HASH_TABLE_CTRL_EMPTY) != 0) {
+		hash_table->ctrl[index] = HASH_TABLE_CTRL_EMPTY;
+		++hash_table->growth_left;
+	} else {
+		hash_table->ctrl[index] = HASH_TABLE_CTRL_DELETED;
+	}
+
+	--hash_table->entries;
+
+	/* Shrink the table if it has dropped below the minimum load
+	 * factor.  If this fails, the table is simply left as it is. */
+	if (hash_table->entries < hash_table->min_entries &&
+	    hash_table->table_size > HASH_TABLE_MIN_SLOTS &&
+	    hash_table->entries <
+	        hash_table_max_entries(hash_table, hash_table->table_size / 2)) {
+		hash_table_open_rehash(hash_table, hash_table->table_size / 2);
+	}
+
+	return 1;
+}
+
+/* Prefetch the first group that a search for the given mixed hash will
+ * probe. */
+static void hash_table_open_prefetch(HashTable *hash_table, unsigned int hash)
+{
+	unsigned int group;
+
+	group = (hash >> 7) &
+	        (hash_table->table_size / HASH_TABLE_GROUP_WIDTH - 1);
+
+	HASH_TABLE_PREFETCH(hash_table->ctrl + group * HASH_TABLE_GROUP_WIDTH);
+	HASH_TABLE_PREFETCH(hash_table->slots + group * HASH_TABLE_GROUP_WIDTH);
+}
+
+/* Find the first slot in use at or after the given index, returning the
+ * table size if there are none. */
+static unsigned int hash_table_open_next_slot(HashTable *hash_table,
+                                              unsigned int index)
+{
+	while (index < hash_table->table_size &&
+	       (hash_table->ctrl[index] & 0x80) != 0) {
+		++index;
+	}
+
+	return index;
+}
+
+/* Move every entry in one chain of the old table into the new table,
+ * during an incremental resize. */
+static void hash_table_migrate_chain(HashTable *hash_table, unsigned int chain)
+{
+	HashTableEntry *rover;
+	HashTableEntry *next;
+	unsigned int index;
+
+	rover = hash_table->old_table[chain];
+	hash_table->old_table[chain] = NULL;
+
+	while (rover != NULL) {
+		next = rover->next;
+
+		index = hash_table_chain_index(hash_table, rover->hash,
+		                               hash_table->table_size);
+		rover->next = hash_table->table[index];
+		hash_table->table[index] = rover;
+
+		rover = next;
+	}
+}
+
+static void hash_table_finish_migration(HashTable *hash_table)
+{
+	free(hash_table->old_table);
+	hash_table->old_table = NULL;
+}
+
+/* Perform part of an incremental resize, moving up to the given number
+ * of chains from the old table to the new one.  Empty chains are cheap to
+ * skip, but a long run of them could still take a while, so only a
+ * limited number are examined on each call. */
+static void hash_table_rehash_step(HashTable *hash_table, unsigned int chains)
+{
+	unsigned int empty_visits;
+
+	if (hash_table->old_table == NULL) {
+		return;
+	}
+
+	empty_visits = chains * 10;
+
+	while (chains > 0 &&
+	       hash_table->rehash_index < hash_table->old_table_size) {
+
+		if (hash_table->old_table[hash_table->rehash_index] != NULL) {
+			hash_table_migrate_chain(hash_table,
+			                         hash_table->rehash_index);
+			--chains;
+		} else if (--empty_visits == 0) {
+			++hash_table->rehash_index;
+			break;
+		}
+
+		++hash_table->rehash_index;
+	}
+
+	if (hash_table->rehash_index >= hash_table->old_table_size) {
+		hash_table_finish_migration(hash_table);
+	}
+}
+
+/* Complete an incremental resize that is in progress, if any. */
+static void hash_table_rehash_all(HashTable *hash_table)
+{
+	if (hash_table->old_table == NULL) {
+		return;
+	}
+
+	while (hash_table->rehash_index < hash_table->old_table_size) {
+		hash_table_migrate_chain(hash_table, hash_table->rehash_index);
+		++hash_table->rehash_index;
+	}
+
+	hash_table_finish_migration(hash_table);
+}
+
+HashTable *hash_table_new(HashTableHashFunc hash_func,
+                          HashTableEqualFunc equal_func)
+{
+	return hash_table_new_with_flags(hash_func, equal_func, 0);
+}
+
+HashTable *hash_table_new_with_flags(HashTableHashFunc hash_func,
+                                     HashTableEqualFunc equal_func,
+                                     unsigned int flags)
+{
+	HashTable *hash_table;
+
+	/* Allocate a new hash table structure */
+	hash_table = (HashTable *) malloc(sizeof(HashTable));
+
+	if (hash_table == NULL) {
+		return NULL;
+	}
+
+	hash_table->hash_func = hash_func;
+	hash_table->equal_func = equal_func;
+	hash_table->key_free_func = NULL;
+	hash_table->value_free_func = NULL;
+	hash_table->entries = 0;
+	hash_table->prime_index = 0;
+	hash_table->flags = flags;
+	hash_table->max_load_factor =
+	    (flags & HASH_TABLE_OPEN_ADDRESSING) != 0
+	        ? HASH_TABLE_DEFAULT_OPEN_MAX_LOAD
+	        : HASH_TABLE_DEFAULT_MAX_LOAD;
+	hash_table->min_load_factor = HASH_TABLE_DEFAULT_MIN_LOAD;
+	hash_table->table = NULL;
+	hash_table->old_table = NULL;
+	hash_table->slabs = NULL;
+	hash_table->free_entries = NULL;
+	hash_table->resizes = 0;
+	hash_table->num_threads = 1;
+#ifdef HASH_TABLE_STATISTICS
+	hash_table->searches = 0;
+	hash_table->probes = 0;
+	hash_table->max_probes = 0;
+#endif
+	hash_table->slots = NULL;
+	hash_table->hashes = NULL;
+	hash_table->ctrl = NULL;
+
+	/* Incremental resizing is only possible with chained tables */
+	if ((flags & HASH_TABLE_OPEN_ADDRESSING) != 0 &&
+	    (flags & HASH_TABLE_INCREMENTAL_RESIZE) != 0) {
+		free(hash_table);
+
+		return NULL;
+	}
+
+	/* Allocate the table */
+	if ((flags & HASH_TABLE_OPEN_ADDRESSING) != 0) {
+		if (!hash_table_open_allocate(hash_table,
+		                              HASH_TABLE_MIN_SLOTS)) {
+			free(hash_table);
+
+			return NULL;
+		}
+	} else if (!hash_table_allocate_table(hash_table)) {
+		free(hash_table);
+
+		return NULL;
+	}
+
+	return hash_table;
+}
+
+void hash_table_free(HashTable *hash_table)
+{
+	HashTableEntry *rover;
+	HashTableEntry *next;
+	unsigned int i;
+
+	if ((hash_table->flags & HASH_TABLE_OPEN_ADDRESSING) != 0) {
+		hash_table_open_free(hash_table);
+		free(hash_table);
+
+		return;
+	}
+
+	/* Any entries still in the old table of an incremental resize are
+	 * moved over first, so that only one table needs to be freed. */
+	hash_table_rehash_all(hash_table);
+
+	/* Free all entries in all chains.  Pooled entries are freed along
+	 * with their slabs, so the chains only need to be walked to free
+	 * the keys and values. */
+	if ((hash_table->flags & HASH_TABLE_POOLED) == 0 ||
+	    hash_table->key_free_func != NULL ||
+	    hash_table->value_free_func != NULL) {
+		for (i = 0; i < hash_table->table_size; ++i) {
+			rover = hash_table->table[i];
+			while (rover != NULL) {
+				next = rover->next;
+				hash_table_free_entry(hash_table, rover);
+				rover = next;
+			}
+		}
+	}
+
+	hash_table_free_slabs(hash_table);
+
+	/* Free the table */
+	free(hash_table->table);
+
+	/* Free the hash table structure */
+	free(hash_table);
+}
+
+void hash_table_register_free_functions(HashTable *hash_table,
+                                        HashTableKeyFreeFunc key_free_func,
+                                        HashTableValueFreeFunc value_free_func)
+{
+	hash_table->key_free_func = key_free_func;
+	hash_table->value_free_func = value_free_func;
+}
+
+void hash_table_set_threads(HashTable *hash_table, unsigned int num_threads)
+{
+	if (num_threads == 0) {
+		num_threads = 1;
+	} else if (num_threads > HASH_TABLE_MAX_THREADS) {
+		num_threads = HASH_TABLE_MAX_THREADS;
+	}
+
+	hash_table->num_threads = num_threads;
+}
+
+#ifdef HASH_TABLE_THREADS
+
+/* A parallel resize or bulk insert is split into phases, each of which
+ * is divided between a number of workers.  Each worker deals with its
+ * own slice of the input and its own range of chains in the new table,
+ * so that no locking is needed.  Chains are divided into ranges of
+ * part_size chains, one range per worker.
+ *
+ * For a resize, each worker first unlinks the entries from its slice of
+ * the old table, sorting them into lists by the range of chains that
+ * they belong to, one list for each worker.  Each worker then links the
+ * entries from every list for its range into the new table.
+ *
+ * A bulk insert works in the same way but sorts indexes into the array
+ * of keys rather than entries, so that the keys for each range stay in
+ * the order in which they were given.  Each worker counts the keys in
+ * its slice of the array which belong to each range, the counts are
+ * turned into offsets, and each worker then writes the indexes of its
+ * keys into the order array at those offsets. */
+typedef struct {
+	HashTable *hash_table;
+	unsigned int num_workers;
+	unsigned int part_size;
+
+	/* Used by a resize */
+	HashTableEntry **old_table;
+	unsigned int old_table_size;
+	HashTableEntry **lists;
+
+	/* Used by a bulk insert */
+	HashTableKey *keys;
+	HashTableValue *values;
+	unsigned int count;
+	unsigned int *hashes;
+	unsigned int *order;
+	unsigned int *offsets;
+} HashTableJob;
+
+typedef struct {
+	HashTableJob *job;
+	pthread_t thread;
+	int started;
+	unsigned int index;
+
+	/* Number of keys dealt with by a bulk insert, and how many of them
+	 * were new */
+	unsigned int done;
+	unsigned int added;
+} HashTableWorker;
+
+/* Run a phase of a job, calling func once for each worker.  Worker 0
+ * runs on the calling thread.  If a thread cannot be started, its work
+ * is done on the calling thread instead, so a phase always completes. */
+static void hash_table_run_workers(HashTableWorker *workers,
+                                   unsigned int num_workers,
+                                   void *(*func)(void *))
+{
+	unsigned int i;
+
+	for (i = 1; i < num_workers; ++i) {
+		workers[i].started = pthread_create(&workers[i].thread, NULL,
+		                                    func, &workers[i]) == 0;
+	}
+
+	func(&workers[0]);
+
+	for (i = 1; i < num_workers; ++i) {
+		if (workers[i].started) {
+			pthread_join(workers[i].thread, NULL);
+		} else {
+			func(&workers[i]);
+		}
+	}
+}
+
+/* Find the slice of total items which belongs to a worker */
+static void hash_table_worker_slice(HashTableWorker *worker,
+                                    unsigned int total, unsigned int *start,
+                                    unsigned int *end)
+{
+	unsigned int num_workers;
+	unsigned int per_worker;
+	unsigned int extra;
+
+	num_workers = worker->job->num_workers;
+	per_worker = total / num_workers;
+	extra = total % num_workers;
+
+	if (worker->index < extra) {
+		*start = worker->index * (per_worker + 1);
+		*end = *start + per_worker + 1;
+	} else {
+		*start = worker->index * per_worker + extra;
+		*end = *start + per_worker;
+	}
+}
+
+static void *hash_table_split_chains(void *arg)
+{
+	HashTableWorker *worker = arg;
+	HashTableJob *job = worker->job;
+	HashTableEntry **lists;
+	HashTableEntry *rover;
+	HashTableEntry *next;
+	unsigned int index;
+	unsigned int start, end;
+	unsigned int i;
+
+	lists = job->lists + worker->index * job->num_workers;
+	hash_table_worker_slice(worker, job->old_table_size, &start, &end);
+
+	for (i = start; i < end; ++i) {
+		for (rover = job->old_table[i]; rover != NULL; rover = next) {
+			next = rover->next;
+
+			index = hash_table_chain_index(
+			    job->hash_table, rover->hash,
+			    job->hash_table->table_size);
+			index /= job->part_size;
+
+			rover->next = lists[index];
+			lists[index] = rover;
+		}
+	}
+
+	return NULL;
+}
+
+static void *hash_table_join_chains(void *arg)
+{
+	HashTableWorker *worker = arg;
+	HashTableJob *job = worker->job;
+	HashTable *hash_table = job->hash_table;
+	HashTableEntry *rover;
+	HashTableEntry *next;
+	unsigned int index;
+	unsigned int i;
+
+	for (i = 0; i < job->num_workers; ++i) {
+		rover = job->lists[i * job->num_workers + worker->index];
+
+		for (; rover != NULL; rover = next) {
+			next = rover->next;
+
+			index = hash_table_chain_index(hash_table, rover->hash,
+			                               hash_table->table_size);
+			rover->next = hash_table->table[index];
+			hash_table->table[index] = rover;
+		}
+	}
+
+	return NULL;
+}
+
+/* Move the entries of old_table into the new table using several
+ * threads.  Returns zero, having done nothing, if the table is too small
+ * to be worth it or memory could not be allocated. */
+static int hash_table_parallel_relink(HashTable *hash_table,
+                                      HashTableEntry **old_table,
+                                      unsigned int old_table_size)
+{
+	HashTableWorker workers[HASH_TABLE_MAX_THREADS];
+	HashTableJob job;
+	unsigned int i;
+
+	if (hash_table->num_threads < 2 ||
+	    hash_table->entries < HASH_TABLE_PARALLEL_MIN_ENTRIES) {
+		return 0;
+	}
+
+	job.hash_table = hash_table;
+	job.num_workers = hash_table->num_threads;
+	job.part_size = (hash_table->table_size - 1) / job.num_workers + 1;
+	job.old_table = old_table;
+	job.old_table_size = old_table_size;
+	job.lists = calloc(job.num_workers * job.num_workers,
+	                   sizeof(HashTableEntry *));
+
+	if (job.lists == NULL) {
+		return 0;
+	}
+
+	for (i = 0; i < job.num_workers; ++i) {
+		workers[i].job = &job;
+		workers[i].index = i;
+	}
+
+	hash_table_run_workers(workers, job.num_workers,
+	                       hash_table_split_chains);
+	hash_table_run_workers(workers, job.num_workers,
+	                       hash_table_join_chains);
+
+	free(job.lists);
+
+	return 1;
+}
+
+#endif /* #ifdef HASH_TABLE_THREADS */
+
+/* Resize a chained table to the size for the given prime index. */
+static int hash_table_resize(HashTable *hash_table, unsigned int prime_index)
+{
+	HashTableEntry **old_table;
+	unsigned int old_table_size;
+	unsigned int old_prime_index;
+	HashTableEntry *rover;
+	HashTableEntry *next;
+	unsigned int index;
+	unsigned int i;
+
+	/* Only one incremental resize can be in progress at once.  The
+	 * rehash steps taken on each insert normally finish it long before
+	 * the table fills up again. */
+	hash_table_rehash_all(hash_table);
+
+	/* Store a copy of the old table */
+	old_table = hash_table->table;
+	old_table_size = hash_table->table_size;
+	old_prime_index = hash_table->prime_index;
+
+	/* Allocate a new table */
+	hash_table->prime_index = prime_index;
+
+	if (!hash_table_allocate_table(hash_table)) {
+
+		/* Failed to allocate the new table */
+		hash_table->table = old_table;
+		hash_table->table_size = old_table_size;
+		hash_table->prime_index = old_prime_index;
+
+		return 0;
+	}
+
+	++hash_table->resizes;
+
+	/* For an incremental resize, the entries are left where they are
+	 * and moved across a few chains at a time by later operations. */
+	if ((hash_table->flags & HASH_TABLE_INCREMENTAL_RESIZE) != 0) {
+		hash_table->old_table = old_table;
+		hash_table->old_table_size = old_table_size;
+		hash_table->rehash_index = 0;
+
+		return 1;
+	}
+
+#ifdef HASH_TABLE_THREADS
+	/* Large tables can be rebuilt using several threads */
+	if (hash_table_parallel_relink(hash_table, old_table,
+	                               old_table_size)) {
+		free(old_table);
+		return 1;
+	}
+#endif
+
+	/* Link all entries from all chains into the new table */
+	for (i = 0; i < old_table_size; ++i) {
+		rover = old_table[i];
+
+		while (rover != NULL) {
+			next = rover->next;
+
+			/* Find the index into the new table.  The hash of the
+			 * key was saved when the entry was created. */
+			index = hash_table_chain_index(hash_table, rover->hash,
+			                               hash_table->table_size);
+
+			/* Link this entry into the chain */
+			rover->next = hash_table->table[index];
+			hash_table->table[index] = rover;
+
+			/* Advance to next in the chain */
+			rover = next;
+		}
+	}
+
+	/* Free the old table */
+	free(old_table);
+
+	return 1;
+}
+
+/* Walk a chain looking for the entry with a given key.  Returns a pointer
+ * to the pointer which points at the entry, ie. the entry in the table,
+ * or the "next" pointer of the previous entry in the chain.  This allows
+ * the entry to be unlinked when it is found.  NULL is returned if the key
+ * is not in the chain. */
+static HashTableEntry **hash_table_chain_find(HashTable *hash_table,
+                                              HashTableEntry **rover,
+                                              HashTableKey key,
+                                              unsigned int hash)
+{
+	while (*rover != NULL) {
+		HASH_TABLE_SEARCH_PROBE(hash_table);
+
+		if ((*rover)->hash == hash &&
+		    hash_table->equal_func(key, (*rover)->pair.key) != 0) {
+			return rover;
+		}
+
+		rover = &((*rover)->next);
+	}
+
+	return NULL;
+}
+
+/* Find the entry with a given key in a chained table, in the same way as
+ * hash_table_chain_find.  While an incremental resize is in progress, the
+ * entry may be in either the old or the new table. */
+static HashTableEntry **hash_table_find(HashTable *hash_table,
+                                        HashTableKey key, unsigned int hash)
+{
+	HashTableEntry **result;
+	unsigned int index;
+
+	HASH_TABLE_SEARCH_BEGIN(hash_table);
+
+	index = hash_table_chain_index(hash_table, hash, hash_table->table_size);
+	result = hash_table_chain_find(hash_table, &hash_table->table[index],
+	                               key, hash);
+
+	if (result == NULL && hash_table->old_table != NULL) {
+		index = hash_table_chain_index(hash_table, hash,
+		                               hash_table->old_table_size);
+		result = hash_table_chain_find(
+		    hash_table, &hash_table->old_table[index], key, hash);
+	}
+
+	HASH_TABLE_SEARCH_END(hash_table);
+
+	return result;
+}
+
+/* Find the entry for a key in a chained table, given the hash of the
+ * key, adding the key with the given value if it is not already present.
+ * NULL is returned if it was not possible to allocate memory for a new
+ * entry. */
+static HashTablePair *hash_table_chain_find_or_add(HashTable *hash_table,
+                                                   HashTableKey key,
+                                                   HashTableValue value,
+                                                   unsigned int hash,
+                                                   int *inserted)
+{
+	HashTableEntry **rover;
+	HashTableEntry *newentry;
+	unsigned int index;
+
+	hash_table_rehash_step(hash_table, HASH_TABLE_INSERT_REHASH_STEP);
+
+	/* Look for an existing entry with the same key */
+	rover = hash_table_find(hash_table, key, hash);
+
+	if (rover != NULL) {
+		*inserted = 0;
+		return &((*rover)->pair);
+	}
+
+	/* If there are too many items in the table with respect to the table
+	 * size, the number of hash collisions increases and performance
+	 * decreases. Enlarge the table size to prevent this happening */
+	if (hash_table->entries >= hash_table->max_entries) {
+
+		/* Table has reached the maximum load factor */
+		if (!hash_table_resize(hash_table,
+		                       hash_table->prime_index + 1)) {
+
+			/* Failed to enlarge the table */
+			return NULL;
+		}
+	}
+
+	/* Not in the hash table yet.  Create a new entry */
+	newentry = hash_table_alloc_entry(hash_table);
+
+	if (newentry == NULL) {
+		return NULL;
+	}
+
+	newentry->pair.key = key;
+	newentry->pair.value = value;
+	newentry->hash = hash;
+
+	/* Link into the list.  New entries always go into the new table
+	 * if a resize is in progress. */
+	index = hash_table_chain_index(hash_table, hash, hash_table->table_size);
+	newentry->next = hash_table->table[index];
+	hash_table->table[index] = newentry;
+
+	/* Maintain the count of the number of entries */
+	++hash_table->entries;
+
+	/* Added successfully */
+	*inserted = 1;
+
+	return &newentry->pair;
+}
+
+/* Find the entry for a key, adding it if it is not present.  The hash is
+ * the hash of the key from the user's hash function, or for an open
+ * addressing table, the mixed hash.  *inserted is always set, and is
+ * zero if NULL is returned. */
+static HashTablePair *hash_table_find_or_add(HashTable *hash_table,
+                                             HashTableKey key,
+                                             HashTableValue value,
+                                             unsigned int hash, int *inserted)
+{
+	*inserted = 0;
+
+	if ((hash_table->flags & HASH_TABLE_OPEN_ADDRESSING) != 0) {
+		return hash_table_open_find_or_add(hash_table, key, value, hash,
+		                                   inserted);
+	} else {
+		return hash_table_chain_find_or_add(hash_table, key, value,
+		                                    hash, inserted);
+	}
+}
+
+/* Insert a key and value, given the hash as for hash_table_find_or_add */
+static int hash_table_insert_hashed(HashTable *hash_table, HashTableKey key,
+                                    HashTableValue value, unsigned int hash)
+{
+	HashTablePair *pair;
+	int inserted;
+
+	pair = hash_table_find_or_add(hash_table, key, value, hash, &inserted);
+
+	if (pair == NULL) {
+		return 0;
+	}
+
+	if (!inserted) {
+
+		/* Same key: overwrite this entry with new data */
+		/* If there is a value free function, free the old data
+		 * before adding in the new data */
+		if (hash_table->value_free_func != NULL) {
+			hash_table->value_free_func(pair->value);
+		}
+
+		/* Same with the key: use the new key value and free
+		 * the old one */
+		if (hash_table->key_free_func != NULL) {
+			hash_table->key_free_func(pair->key);
+		}
+
+		pair->key = key;
+		pair->value = value;
+	}
+
+	return 1;
+}
+
+/* Generate the hash of a key as needed by hash_table_find_or_add */
+static unsigned int hash_table_hash(HashTable *hash_table, HashTableKey key)
+{
+	unsigned int hash;
+
+	hash = hash_table->hash_func(key);
+
+	if ((hash_table->flags & HASH_TABLE_OPEN_ADDRESSING) != 0) {
+		hash = hash_table_mix(hash);
+	}
+
+	return hash;
+}
+
+int hash_table_insert(HashTable *hash_table, HashTableKey key,
+                      HashTableValue value)
+{
+	return hash_table_insert_hashed(hash_table, key, value,
+	                                hash_table_hash(hash_table, key));
+}
+
+HashTableValue *hash_table_lookup_or_insert(HashTable *hash_table,
+                                            HashTableKey key,
+                                            HashTableValue value,
+                                            int *inserted)
+{
+	HashTablePair *pair;
+	int added;
+
+	pair = hash_table_find_or_add(hash_table, key, value,
+	                              hash_table_hash(hash_table, key), &added);
+
+	if (inserted != NULL) {
+		*inserted = added;
+	}
+
+	if (pair == NULL) {
+		return NULL;
+	}
+
+	return &pair->value;
+}
+
+int hash_table_lookup_pair(HashTable *hash_table, HashTableKey key,
+                           HashTablePair *pair)
+{
+	HashTableEntry **rover;
+	unsigned int index;
+
+	if ((hash_table->flags & HASH_TABLE_OPEN_ADDRESSING) != 0) {
+		index = hash_table_open_find(
+		    hash_table, key, hash_table_mix(hash_table->hash_func(key)));
+
+		if (index == HASH_TABLE_NO_SLOT) {
+			return 0;
+		}
+
+		*pair = hash_table->slots[index];
+
+		return 1;
+	}
+
+	hash_table_rehash_step(hash_table, 1);
+
+	rover = hash_table_find(hash_table, key, hash_table->hash_func(key));
+
+	if (rover == NULL) {
+		return 0;
+	}
+
+	*pair = (*rover)->pair;
+
+	return 1;
+}
+
+int hash_table_contains(HashTable *hash_table, HashTableKey key)
+{
+	HashTablePair pair;
+
+	return hash_table_lookup_pair(hash_table, key, &pair);
+}
+
+HashTableValue hash_table_lookup(HashTable *hash_table, HashTableKey key)
+{
+	HashTableEntry **rover;
+
+	if ((hash_table->flags & HASH_TABLE_OPEN_ADDRESSING) != 0) {
+		return hash_table_open_lookup(
+		    hash_table, key, hash_table_mix(hash_table->hash_func(key)));
+	}
+
+	hash_table_rehash_step(hash_table, 1);
+
+	/* Walk the chain for this key until the corresponding entry is
+	 * found */
+	rover = hash_table_find(hash_table, key, hash_table->hash_func(key));
+
+	if (rover != NULL) {
+
+		/* Found the entry.  Return the data. */
+		return (*rover)->pair.value;
+	}
+
+	/* Not found */
+	return hash_table_null_value;
+}
+
+int hash_table_remove(HashTable *hash_table, HashTableKey key)
+{
+	HashTableEntry **rover;
+	HashTableEntry *entry;
+
+	if ((hash_table->flags & HASH_TABLE_OPEN_ADDRESSING) != 0) {
+		return hash_table_open_remove(hash_table, key);
+	}
+
+	hash_table_rehash_step(hash_table, 1);
+
+	rover = hash_table_find(hash_table, key, hash_table->hash_func(key));
+
+	if (rover == NULL) {
+		return 0;
+	}
+
+	/* This is the entry to remove */
+	entry = *rover;
+
+	/* Unlink from the list */
+	*rover = entry->next;
+
+	/* Destroy the entry structure */
+	hash_table_free_entry(hash_table, entry);
+
+	/* Track count of entries */
+	--hash_table->entries;
+
+	/* Shrink the table if it has dropped below the minimum load
+	 * factor.  If this fails, the table is simply left as it is. */
+	if (hash_table->entries < hash_table->min_entries &&
+	    hash_table->prime_index > 0) {
+		hash_table_resize(hash_table, hash_table->prime_index - 1);
+	}
+
+	return 1;
+}
+
+int hash_table_set_load_factor(HashTable *hash_table, double max_load,
+                               double min_load)
+{
+	unsigned int used;
+
+	/* After a chained table shrinks, its load factor roughly doubles.
+	 * Unless that leaves it below the maximum, it would have to be
+	 * enlarged again straight away. */
+	if (max_load <= 0.0 || min_load < 0.0 || min_load * 2.0 >= max_load) {
+		return 0;
+	}
+
+	/* Slots in an open addressing table that have been filled since
+	 * it was last rebuilt, whether or not they have since been
+	 * removed, cannot be reused until it is rebuilt again */
+	used = hash_table->max_entries;
+
+	if ((hash_table->flags & HASH_TABLE_OPEN_ADDRESSING) != 0) {
+		used -= hash_table->growth_left;
+	}
+
+	hash_table->max_load_factor = max_load;
+	hash_table->min_load_factor = min_load;
+	hash_table_update_limits(hash_table);
+
+	if ((hash_table->flags & HASH_TABLE_OPEN_ADDRESSING) != 0) {
+		if (hash_table->max_entries > used) {
+			hash_table->growth_left = hash_table->max_entries - used;
+		} else {
+			hash_table->growth_left = 0;
+		}
+	}
+
+	return 1;
+}
+
+/* Find the smallest number of slots, no smaller than the given number,
+ * that an open addressing table can have and hold the given number of
+ * entries. */
+static unsigned int hash_table_open_size_for(HashTable *hash_table,
+                                             unsigned int num_slots,
+                                             unsigned int num_entries)
+{
+	while (hash_table_max_entries(hash_table, num_slots) < num_entries &&
+	       num_slots < (1U << 31)) {
+		num_slots *= 2;
+	}
+
+	return num_slots;
+}
+
+/* Find the smallest prime index, no smaller than the given index, that a
+ * chained table can have and hold the given number of entries.  The table
+ * is enlarged when an insert finds it at its maximum load, so this is the
+ * smallest size where that will not happen until after the last of the
+ * entries has been added. */
+static unsigned int hash_table_index_for(HashTable *hash_table,
+                                         unsigned int prime_index,
+                                         unsigned int num_entries)
+{
+	unsigned int table_size;
+
+	for (;;) {
+		table_size = hash_table_size_for_index(hash_table, prime_index);
+
+		if (num_entries <= hash_table_max_entries(hash_table,
+		                                          table_size)) {
+			break;
+		}
+
+		if ((hash_table->flags & HASH_TABLE_POWER_OF_TWO) != 0
+		        ? prime_index >= 24
+		        : prime_index + 1 >= hash_table_num_primes) {
+			break;
+		}
+
+		++prime_index;
+	}
+
+	return prime_index;
+}
+
+int hash_table_reserve(HashTable *hash_table, unsigned int num_entries)
+{
+	unsigned int num_slots;
+	unsigned int prime_index;
+
+	if (num_entries <= hash_table->entries) {
+		return 1;
+	}
+
+	if ((hash_table->flags & HASH_TABLE_OPEN_ADDRESSING) != 0) {
+		num_slots = hash_table_open_size_for(
+		    hash_table, hash_table->table_size, num_entries);
+
+		if (num_slots == hash_table->table_size &&
+		    hash_table->growth_left >=
+		        num_entries - hash_table->entries) {
+			return 1;
+		}
+
+		return hash_table_open_rehash(hash_table, num_slots);
+	}
+
+	prime_index = hash_table_index_for(hash_table, hash_table->prime_index,
+	                                   num_entries);
+
+	if (prime_index == hash_table->prime_index) {
+		return 1;
+	}
+
+	return hash_table_resize(hash_table, prime_index);
+}
+
+/* Move all of the entries of a pooled table into a single new slab, in
+ * chain order, so that the memory of removed entries is released and
+ * entries in the same chain are close together. */
+static int hash_table_repack(HashTable *hash_table)
+{
+	HashTableSlab *slab;
+	HashTableEntry **rover;
+	HashTableEntry *entry;
+	unsigned int used;
+	unsigned int i;
+
+	slab = NULL;
+	used = 0;
+
+	if (hash_table->entries > 0) {
+		slab = malloc(sizeof(HashTableSlab) +
+		              (hash_table->entries - 1) * sizeof(HashTableEntry));
+
+		if (slab == NULL) {
+			return 0;
+		}
+
+		slab->next = NULL;
+		slab->capacity = hash_table->entries;
+
+		for (i = 0; i < hash_table->table_size; ++i) {
+			rover = &hash_table->table[i];
+
+			while (*rover != NULL) {
+				entry = &slab->entries[used];
+				++used;
+
+				*entry = **rover;
+				*rover = entry;
+				rover = &entry->next;
+			}
+		}
+	}
+
+	hash_table_free_slabs(hash_table);
+
+	hash_table->slabs = slab;
+	hash_table->slab_used = used;
+	hash_table->slab_capacity = used;
+
+	return 1;
+}
+
+int hash_table_compact(HashTable *hash_table)
+{
+	unsigned int prime_index;
+
+	if ((hash_table->flags & HASH_TABLE_OPEN_ADDRESSING) != 0) {
+		return hash_table_open_rehash(
+		    hash_table,
+		    hash_table_open_size_for(hash_table, HASH_TABLE_MIN_SLOTS,
+		                             hash_table->entries));
+	}
+
+	hash_table_rehash_all(hash_table);
+
+	prime_index = hash_table_index_for(hash_table, 0, hash_table->entries);
+
+	if (prime_index != hash_table->prime_index) {
+		if (!hash_table_resize(hash_table, prime_index)) {
+			return 0;
+		}
+
+		hash_table_rehash_all(hash_table);
+	}
+
+	if ((hash_table->flags & HASH_TABLE_POOLED) != 0) {
+		return hash_table_repack(hash_table);
+	}
+
+	return 1;
+}
+
+/* Prefetch the chain that a hash belongs to in a chained table. */
+static void hash_table_chain_prefetch(HashTable *hash_table, unsigned int hash)
+{
+	HASH_TABLE_PREFETCH(&hash_table->table[hash_table_chain_index(
+	    hash_table, hash, hash_table->table_size)]);
+}
+
+/* Hash a batch of keys, prefetching the memory that inserting or looking
+ * up each key will need. */
+static void hash_table_hash_batch(HashTable *hash_table, HashTableKey *keys,
+                                  unsigned int *hashes, unsigned int count)
+{
+	unsigned int i;
+
+	if ((hash_table->flags & HASH_TABLE_OPEN_ADDRESSING) != 0) {
+		for (i = 0; i < count; ++i) {
+			hashes[i] = hash_table_mix(hash_table->hash_func(keys[i]));
+			hash_table_open_prefetch(hash_table, hashes[i]);
+		}
+	} else {
+		for (i = 0; i < count; ++i) {
+			hashes[i] = hash_table->hash_func(keys[i]);
+			hash_table_chain_prefetch(hash_table, hashes[i]);
+		}
 	}
+}
 
-	return hash_table;
+#ifdef HASH_TABLE_THREADS
+
+/* Find the range of chains that a key belongs to in a bulk insert */
+static unsigned int hash_table_job_part(HashTableJob *job, unsigned int hash)
+{
+	return hash_table_chain_index(job->hash_table, hash,
+	                              job->hash_table->table_size) /
+	       job->part_size;
 }
 
-void hash_table_free(HashTable *hash_table)
+static void *hash_table_count_slice(void *arg)
 {
-	HashTableEntry *rover;
-	HashTableEntry *next;
+	HashTableWorker *worker = arg;
+	HashTableJob *job = worker->job;
+	unsigned int *counts;
+	unsigned int start, end;
 	unsigned int i;
 
-	/* Free all entries in all chains */
-	for (i = 0; i < hash_table->table_size; ++i) {
-		rover = hash_table->table[i];
-		while (rover != NULL) {
-			next = rover->next;
-			hash_table_free_entry(hash_table, rover);
-			rover = next;
-		}
-	}
+	counts = job->offsets + worker->index * job->num_workers;
+	hash_table_worker_slice(worker, job->count, &start, &end);
 
-	/* Free the table */
-	free(hash_table->table);
+	for (i = start; i < end; ++i) {
+		job->hashes[i] = job->hash_table->hash_func(job->keys[i]);
+		++counts[hash_table_job_part(job, job->hashes[i])];
+	}
 
-	/* Free the hash table structure */
-	free(hash_table);
+	return NULL;
 }
 
-void hash_table_register_free_functions(HashTable *hash_table,
-                                        HashTableKeyFreeFunc key_free_func,
-                                        HashTableValueFreeFunc value_free_func)
+static void *hash_table_sort_slice(void *arg)
 {
-	hash_table->key_free_func = key_free_func;
-	hash_table->value_free_func = value_free_func;
+	HashTableWorker *worker = arg;
+	HashTableJob *job = worker->job;
+	unsigned int *offsets;
+	unsigned int start, end;
+	unsigned int i;
+
+	offsets = job->offsets + worker->index * job->num_workers;
+	hash_table_worker_slice(worker, job->count, &start, &end);
+
+	for (i = start; i < end; ++i) {
+		job->order[offsets[hash_table_job_part(job, job->hashes[i])]++] =
+		    i;
+	}
+
+	return NULL;
 }
 
-static int hash_table_enlarge(HashTable *hash_table)
+/* Insert the keys which belong to a worker's range of chains.  Nothing
+ * else touches those chains, so no locking is needed. */
+static void *hash_table_insert_part(void *arg)
 {
-	HashTableEntry **old_table;
-	unsigned int old_table_size;
-	unsigned int old_prime_index;
+	HashTableWorker *worker = arg;
+	HashTableJob *job = worker->job;
+	HashTable *hash_table = job->hash_table;
 	HashTableEntry *rover;
-	HashTablePair *pair;
-	HashTableEntry *next;
-	unsigned int index;
+	HashTableEntry **chain;
+	unsigned int start, end;
+	unsigned int hash;
 	unsigned int i;
+	unsigned int k;
 
-	/* Store a copy of the old table */
-	old_table = hash_table->table;
-	old_table_size = hash_table->table_size;
-	old_prime_index = hash_table->prime_index;
+	/* After the keys have been sorted, the offsets of the last worker
+	 * point at the end of each range in the order array */
+	end = job->offsets[(job->num_workers - 1) * job->num_workers +
+	                   worker->index];
 
-	/* Allocate a new, larger table */
-	++hash_table->prime_index;
+	if (worker->index == 0) {
+		start = 0;
+	} else {
+		start = job->offsets[(job->num_workers - 1) * job->num_workers +
+		                     worker->index - 1];
+	}
 
-	if (!hash_table_allocate_table(hash_table)) {
+	for (i = start; i < end; ++i) {
+		k = job->order[i];
+		hash = job->hashes[k];
+		chain = &hash_table->table[hash_table_chain_index(
+		    hash_table, hash, hash_table->table_size)];
 
-		/* Failed to allocate the new table */
-		hash_table->table = old_table;
-		hash_table->table_size = old_table_size;
-		hash_table->prime_index = old_prime_index;
+		for (rover = *chain; rover != NULL; rover = rover->next) {
+			if (rover->hash == hash &&
+			    hash_table->equal_func(job->keys[k],
+			                           rover->pair.key) != 0) {
+				break;
+			}
+		}
+
+		if (rover != NULL) {
+
+			/* Same key: overwrite the entry, as in
+			 * hash_table_insert_hashed */
+			if (hash_table->value_free_func != NULL) {
+				hash_table->value_free_func(rover->pair.value);
+			}
+
+			if (hash_table->key_free_func != NULL) {
+				hash_table->key_free_func(rover->pair.key);
+			}
+		} else {
+			rover = malloc(sizeof(HashTableEntry));
+
+			if (rover == NULL) {
+				break;
+			}
+
+			rover->hash = hash;
+			rover->next = *chain;
+			*chain = rover;
+			++worker->added;
+		}
+
+		rover->pair.key = job->keys[k];
+		rover->pair.value = job->values[k];
+		++worker->done;
+	}
 
+	return NULL;
+}
+
+/* Insert keys into a chained table using several threads.  The table
+ * must already be large enough for all of them.  Returns zero, having
+ * done nothing, if this is not possible; otherwise the number of keys
+ * inserted is stored in *done. */
+static int hash_table_parallel_insert(HashTable *hash_table,
+                                      HashTableKey *keys,
+                                      HashTableValue *values,
+                                      unsigned int count, unsigned int *done)
+{
+	HashTableWorker workers[HASH_TABLE_MAX_THREADS];
+	HashTableJob job;
+	unsigned int total;
+	unsigned int offset;
+	unsigned int i, j;
+
+	/* Pooled entries cannot be allocated by several threads at once */
+	if (hash_table->num_threads < 2 ||
+	    count < HASH_TABLE_PARALLEL_MIN_ENTRIES ||
+	    (hash_table->flags &
+	     (HASH_TABLE_OPEN_ADDRESSING | HASH_TABLE_POOLED)) != 0 ||
+	    hash_table->entries > hash_table->max_entries ||
+	    count > hash_table->max_entries - hash_table->entries) {
 		return 0;
 	}
 
-	/* Link all entries from all chains into the new table */
-	for (i = 0; i < old_table_size; ++i) {
-		rover = old_table[i];
+	job.hash_table = hash_table;
+	job.num_workers = hash_table->num_threads;
+	job.keys = keys;
+	job.values = values;
+	job.count = count;
+	job.hashes = malloc(count * sizeof(unsigned int));
+	job.order = malloc(count * sizeof(unsigned int));
+	job.offsets =
+	    calloc(job.num_workers * job.num_workers, sizeof(unsigned int));
+
+	if (job.hashes == NULL || job.order == NULL || job.offsets == NULL) {
+		free(job.hashes);
+		free(job.order);
+		free(job.offsets);
+		return 0;
+	}
 
-		while (rover != NULL) {
-			next = rover->next;
+	/* The table was made large enough by hash_table_reserve, but an
+	 * incremental resize may still be in progress */
+	hash_table_rehash_all(hash_table);
+	job.part_size = (hash_table->table_size - 1) / job.num_workers + 1;
 
-			/* Fetch rover HashTablePair */
-			pair = &(rover->pair);
+	for (i = 0; i < job.num_workers; ++i) {
+		workers[i].job = &job;
+		workers[i].index = i;
+		workers[i].done = 0;
+		workers[i].added = 0;
+	}
 
-			/* Find the index into the new table */
-			index = hash_table->hash_func(pair->key) %
-			        hash_table->table_size;
+	hash_table_run_workers(workers, job.num_workers,
+	                       hash_table_count_slice);
 
-			/* Link this entry into the chain */
-			rover->next = hash_table->table[index];
-			hash_table->table[index] = rover;
+	/* Turn the counts into offsets into the order array, with the
+	 * keys for each range of chains together in their original order */
+	offset = 0;
 
-			/* Advance to next in the chain */
-			rover = next;
+	for (j = 0; j < job.num_workers; ++j) {
+		for (i = 0; i < job.num_workers; ++i) {
+			total = job.offsets[i * job.num_workers + j];
+			job.offsets[i * job.num_workers + j] = offset;
+			offset += total;
 		}
 	}
 
-	/* Free the old table */
-	free(old_table);
+	hash_table_run_workers(workers, job.num_workers,
+	                       hash_table_sort_slice);
+	hash_table_run_workers(workers, job.num_workers,
+	                       hash_table_insert_part);
+
+	*done = 0;
+
+	for (i = 0; i < job.num_workers; ++i) {
+		*done += workers[i].done;
+		hash_table->entries += workers[i].added;
+	}
+
+	free(job.hashes);
+	free(job.order);
+	free(job.offsets);
 
 	return 1;
 }
 
-int hash_table_insert(HashTable *hash_table, HashTableKey key,
-                      HashTableValue value)
+#endif /* #ifdef HASH_TABLE_THREADS */
+
+unsigned int hash_table_insert_many(HashTable *hash_table, HashTableKey *keys,
+                                    HashTableValue *values, unsigned int count)
 {
-	HashTableEntry *rover;
-	HashTablePair *pair;
-	HashTableEntry *newentry;
-	unsigned int index;
+	unsigned int hashes[HASH_TABLE_BATCH_SIZE];
+	unsigned int batch;
+	unsigned int done;
+	unsigned int i;
 
-	/* If there are too many items in the table with respect to the table
-	 * size, the number of hash collisions increases and performance
-	 * decreases. Enlarge the table size to prevent this happening */
-	if ((hash_table->entries * 3) / hash_table->table_size > 0) {
+	/* Make room for all of the new entries at once.  Some of the keys
+	 * may already be present, so this can be more than is needed, and
+	 * it does not matter if it fails: the table is then enlarged by
+	 * the individual inserts as usual. */
+	if (count <= ~0U - hash_table->entries) {
+		hash_table_reserve(hash_table, hash_table->entries + count);
+	}
+
+#ifdef HASH_TABLE_THREADS
+	if (hash_table_parallel_insert(hash_table, keys, values, count,
+	                               &done)) {
+		return done;
+	}
+#endif
 
-		/* Table is more than 1/3 full */
-		if (!hash_table_enlarge(hash_table)) {
+	for (done = 0; done < count; done += batch) {
+		batch = count - done;
 
-			/* Failed to enlarge the table */
-			return 0;
+		if (batch > HASH_TABLE_BATCH_SIZE) {
+			batch = HASH_TABLE_BATCH_SIZE;
+		}
+
+		hash_table_hash_batch(hash_table, keys + done, hashes, batch);
+
+		for (i = 0; i < batch; ++i) {
+			if (!hash_table_insert_hashed(hash_table,
+			                              keys[done + i],
+			                              values[done + i],
+			                              hashes[i])) {
+				return done + i;
+			}
 		}
 	}
 
-	/* Generate the hash of the key and hence the index into the table */
-	index = hash_table->hash_func(key) % hash_table->table_size;
+	return count;
+}
 
-	/* Traverse the chain at this location and look for an existing
-	 * entry with the same key */
-	rover = hash_table->table[index];
+unsigned int hash_table_lookup_many(HashTable *hash_table, HashTableKey *keys,
+                                    HashTableValue *values, unsigned int count)
+{
+	unsigned int hashes[HASH_TABLE_BATCH_SIZE];
+	HashTableEntry **rover;
+	unsigned int batch;
+	unsigned int done;
+	unsigned int found;
+	unsigned int index;
+	unsigned int i;
 
-	while (rover != NULL) {
+	found = 0;
 
-		/* Fetch rover's HashTablePair entry */
-		pair = &(rover->pair);
+	for (done = 0; done < count; done += batch) {
+		batch = count - done;
 
-		if (hash_table->equal_func(pair->key, key) != 0) {
+		if (batch > HASH_TABLE_BATCH_SIZE) {
+			batch = HASH_TABLE_BATCH_SIZE;
+		}
 
-			/* Same key: overwrite this entry with new data */
-			/* If there is a value free function, free the old data
-			 * before adding in the new data */
-			if (hash_table->value_free_func != NULL) {
-				hash_table->value_free_func(pair->value);
+		if ((hash_table->flags & HASH_TABLE_OPEN_ADDRESSING) != 0) {
+			hash_table_hash_batch(hash_table, keys + done, hashes,
+			                      batch);
+
+			for (i = 0; i < batch; ++i) {
+				index = hash_table_open_find(
+				    hash_table, keys[done + i], hashes[i]);
+
+				if (index != HASH_TABLE_NO_SLOT) {
+					values[done + i] =
+					    hash_table->slots[index].value;
+					++found;
+				} else {
+					values[done + i] =
+					    hash_table_null_value;
+				}
 			}
 
-			/* Same with the key: use the new key value and free
-			 * the old one */
-			if (hash_table->key_free_func != NULL) {
-				hash_table->key_free_func(pair->key);
-			}
+			continue;
+		}
 
-			pair->key = key;
-			pair->value = value;
+		hash_table_rehash_step(hash_table, 1);
+		hash_table_hash_batch(hash_table, keys + done, hashes, batch);
 
-			/* Finished */
-			return 1;
+		/* Now that the chain heads have arrived, prefetch the first
+		 * entry of each chain as well */
+		for (i = 0; i < batch; ++i) {
+			HASH_TABLE_PREFETCH(
+			    hash_table->table[hash_table_chain_index(
+			        hash_table, hashes[i], hash_table->table_size)]);
 		}
 
-		rover = rover->next;
-	}
-
-	/* Not in the hash table yet.  Create a new entry */
-	newentry = (HashTableEntry *) malloc(sizeof(HashTableEntry));
+		for (i = 0; i < batch; ++i) {
+			rover = hash_table_find(hash_table, keys[done + i],
+			                        hashes[i]);
 
-	if (newentry == NULL) {
-		return 0;
+			if (rover != NULL) {
+				values[done + i] = (*rover)->pair.value;
+				++found;
+			} else {
+				values[done + i] = hash_table_null_value;
+			}
+		}
 	}
 
-	newentry->pair.key = key;
-	newentry->pair.value = value;
+	return found;
+}
 
-	/* Link into the list */
-	newentry->next = hash_table->table[index];
-	hash_table->table[index] = newentry;
+unsigned int hash_table_num_entries(HashTable *hash_table)
+{
+	return hash_table->entries;
+}
 
-	/* Maintain the count of the number of entries */
-	++hash_table->entries;
+/* Add a chain or probe sequence of the given length to the histogram */
+static void hash_table_count_length(HashTableStatistics *stats,
+                                    unsigned int length)
+{
+	if (length < HASH_TABLE_HISTOGRAM_SIZE) {
+		++stats->chain_lengths[length];
+	} else {
+		++stats->chain_lengths[HASH_TABLE_HISTOGRAM_SIZE - 1];
+	}
 
-	/* Added successfully */
-	return 1;
+	if (length > stats->max_chain_length) {
+		stats->max_chain_length = length;
+	}
 }
 
-HashTableValue hash_table_lookup(HashTable *hash_table, HashTableKey key)
+/* Find how many groups away from its home group each entry of an open
+ * addressing table is stored, by following the probe sequence from the
+ * home group until the group holding the entry is reached. */
+static void hash_table_open_statistics(HashTable *hash_table,
+                                       HashTableStatistics *stats)
 {
-	HashTableEntry *rover;
-	HashTablePair *pair;
-	unsigned int index;
-
-	/* Generate the hash of the key and hence the index into the table */
-	index = hash_table->hash_func(key) % hash_table->table_size;
+	unsigned int group_mask;
+	unsigned int group;
+	unsigned int step;
+	unsigned int i;
 
-	/* Walk the chain at this index until the corresponding entry is
-	 * found */
-	rover = hash_table->table[index];
+	group_mask = hash_table->table_size / HASH_TABLE_GROUP_WIDTH - 1;
 
-	while (rover != NULL) {
-		pair = &(rover->pair);
+	for (i = 0; i < hash_table->table_size; ++i) {
+		if ((hash_table->ctrl[i] & 0x80) != 0) {
+			continue;
+		}
 
-		if (hash_table->equal_func(key, pair->key) != 0) {
+		group = (hash_table->hashes[i] >> 7) & group_mask;
 
-			/* Found the entry.  Return the data. */
-			return pair->value;
+		for (step = 1; group != i / HASH_TABLE_GROUP_WIDTH; ++step) {
+			group = (group + step) & group_mask;
 		}
 
-		rover = rover->next;
+		hash_table_count_length(stats, step - 1);
 	}
 
-	/* Not found */
-	return hash_table_null_value;
+	stats->memory_used +=
+	    (size_t) hash_table->table_size *
+	    (sizeof(HashTablePair) + sizeof(unsigned int) + 1);
 }
 
-int hash_table_remove(HashTable *hash_table, HashTableKey key)
+void hash_table_get_statistics(HashTable *hash_table,
+                               HashTableStatistics *stats)
 {
-	HashTableEntry **rover;
-	HashTableEntry *entry;
-	HashTablePair *pair;
-	unsigned int index;
-	int result;
-
-	/* Generate the hash of the key and hence the index into the table */
-	index = hash_table->hash_func(key) % hash_table->table_size;
-
-	/* Rover points at the pointer which points at the current entry
-	 * in the chain being inspected.  ie. the entry in the table, or
-	 * the "next" pointer of the previous entry in the chain.  This
-	 * allows us to unlink the entry when we find it. */
-	result = 0;
-	rover = &hash_table->table[index];
-
-	while (*rover != NULL) {
-
-		pair = &((*rover)->pair);
+	HashTableEntry *rover;
+	HashTableSlab *slab;
+	unsigned int length;
+	unsigned int i;
 
-		if (hash_table->equal_func(key, pair->key) != 0) {
+	/* Chains are easier to measure once they are all in one table */
+	if ((hash_table->flags & HASH_TABLE_OPEN_ADDRESSING) == 0) {
+		hash_table_rehash_all(hash_table);
+	}
 
-			/* This is the entry to remove */
-			entry = *rover;
+	memset(stats, 0, sizeof(HashTableStatistics));
 
-			/* Unlink from the list */
-			*rover = entry->next;
+	stats->entries = hash_table->entries;
+	stats->table_size = hash_table->table_size;
+	stats->load_factor =
+	    (double) hash_table->entries / (double) hash_table->table_size;
+	stats->memory_used = sizeof(HashTable);
+	stats->resizes = hash_table->resizes;
 
-			/* Destroy the entry structure */
-			hash_table_free_entry(hash_table, entry);
+#ifdef HASH_TABLE_STATISTICS
+	stats->searches = hash_table->searches;
+	stats->probes = hash_table->probes;
+	stats->max_probes = hash_table->max_probes;
+#endif
 
-			/* Track count of entries */
-			--hash_table->entries;
+	if ((hash_table->flags & HASH_TABLE_OPEN_ADDRESSING) != 0) {
+		hash_table_open_statistics(hash_table, stats);
+		return;
+	}
 
-			result = 1;
+	for (i = 0; i < hash_table->table_size; ++i) {
+		length = 0;
 
-			break;
+		for (rover = hash_table->table[i]; rover != NULL;
+		     rover = rover->next) {
+			++length;
 		}
 
-		/* Advance to the next entry */
-		rover = &((*rover)->next);
+		hash_table_count_length(stats, length);
 	}
 
-	return result;
-}
+	stats->memory_used +=
+	    (size_t) hash_table->table_size * sizeof(HashTableEntry *);
 
-unsigned int hash_table_num_entries(HashTable *hash_table)
-{
-	return hash_table->entries;
+	if ((hash_table->flags & HASH_TABLE_POOLED) != 0) {
+		for (slab = hash_table->slabs; slab != NULL; slab = slab->next) {
+			stats->memory_used +=
+			    sizeof(HashTableSlab) +
+			    (slab->capacity - 1) * sizeof(HashTableEntry);
+		}
+	} else {
+		stats->memory_used +=
+		    (size_t) hash_table->entries * sizeof(HashTableEntry);
+	}
 }
 
 void hash_table_iterate(HashTable *hash_table, HashTableIterator *iterator)
@@ -398,6 +2319,18 @@ void hash_table_iterate(HashTable *hash_table, HashTableIterator *iterator)
 	/* Default value of next if no entries are found. */
 	iterator->next_entry = NULL;
 
+	/* Open addressing tables have no entry structures, so the iterator
+	 * just records the index of the next slot in use. */
+	if ((hash_table->flags & HASH_TABLE_OPEN_ADDRESSING) != 0) {
+		iterator->next_chain = hash_table_open_next_slot(hash_table, 0);
+		return;
+	}
+
+	/* Entries cannot be visited exactly once if they are being moved
+	 * between tables during iteration, so finish any incremental resize
+	 * first.  Removing entries does not start a new resize. */
+	hash_table_rehash_all(hash_table);
+
 	/* Find the first entry */
 	for (chain = 0; chain < hash_table->table_size; ++chain) {
 
@@ -411,6 +2344,14 @@ void hash_table_iterate(HashTable *hash_table, HashTableIterator *iterator)
 
 int hash_table_iter_has_more(HashTableIterator *iterator)
 {
+	HashTable *hash_table;
+
+	hash_table = iterator->hash_table;
+
+	if ((hash_table->flags & HASH_TABLE_OPEN_ADDRESSING) != 0) {
+		return iterator->next_chain < hash_table->table_size;
+	}
+
 	return iterator->next_entry != NULL;
 }
 
@@ -423,6 +2364,16 @@ HashTablePair hash_table_iter_next(HashTableIterator *iterator)
 
 	hash_table = iterator->hash_table;
 
+	if ((hash_table->flags & HASH_TABLE_OPEN_ADDRESSING) != 0) {
+		if (iterator->next_chain < hash_table->table_size) {
+			pair = hash_table->slots[iterator->next_chain];
+			iterator->next_chain = hash_table_open_next_slot(
+			    hash_table, iterator->next_chain + 1);
+		}
+
+		return pair;
+	}
+
 	if (iterator->next_entry == NULL) {
 		return pair;
 	}
@@ -462,3 +2413,185 @@ HashTablePair hash_table_iter_next(HashTableIterator *iterator)
 
 	return pair;
 }
+
+/* Reverse the order of the bits in a 32-bit value */
+static unsigned int hash_table_reverse_bits(unsigned int value)
+{
+	value = ((value >> 1) & 0x55555555U) | ((value & 0x55555555U) << 1);
+	value = ((value >> 2) & 0x33333333U) | ((value & 0x33333333U) << 2);
+	value = ((value >> 4) & 0x0f0f0f0fU) | ((value & 0x0f0f0f0fU) << 4);
+	value = ((value >> 8) & 0x00ff00ffU) | ((value & 0x00ff00ffU) << 8);
+
+	return ((value >> 16) | (value << 16)) & 0xffffffffU;
+}
+
+/* Advance a scan cursor to the next chain of a power-of-two sized table
+ * with the given mask.  The cursor is incremented from its top bit
+ * downwards, so the chains that an already visited chain splits into
+ * when the table doubles in size come before the cursor, as do those
+ * that it merges into when the table halves.  Zero is returned after the
+ * last chain. */
+static unsigned int hash_table_cursor_next(unsigned int cursor,
+                                           unsigned int mask)
+{
+	cursor |= ~mask;
+	cursor = hash_table_reverse_bits(cursor);
+	++cursor;
+
+	return hash_table_reverse_bits(cursor);
+}
+
+static void hash_table_scan_chain(HashTableEntry *rover,
+                                  HashTableScanFunc callback,
+                                  void *user_data)
+{
+	while (rover != NULL) {
+		callback(rover->pair, user_data);
+		rover = rover->next;
+	}
+}
+
+/* Visit the entries of an open addressing table that belong to a group.
+ * They can be stored anywhere along the probe sequence from that group
+ * up to the first group with an empty slot, which is where a search for
+ * any of them would stop. */
+static void hash_table_open_scan_group(HashTable *hash_table,
+                                       unsigned int home,
+                                       HashTableScanFunc callback,
+                                       void *user_data)
+{
+	unsigned int group_mask;
+	unsigned int group;
+	unsigned int step;
+	unsigned int full;
+	unsigned int index;
+	unsigned int hash;
+	unsigned char *ctrl;
+
+	group_mask = hash_table->table_size / HASH_TABLE_GROUP_WIDTH - 1;
+	group = home;
+
+	for (step = 1;; ++step) {
+		ctrl = hash_table->ctrl + group * HASH_TABLE_GROUP_WIDTH;
+		full = ~hash_table_group_match_free(ctrl) &
+		       ((1U << HASH_TABLE_GROUP_WIDTH) - 1);
+
+		while (full != 0) {
+			index = group * HASH_TABLE_GROUP_WIDTH +
+			        hash_table_lowest_bit(full);
+
+			hash = hash_table->hashes[index];
+
+			if (((hash >> 7) & group_mask) == home) {
+				callback(hash_table->slots[index], user_data);
+			}
+
+			full &= full - 1;
+		}
+
+		if (hash_table_group_match(ctrl, HASH_TABLE_CTRL_EMPTY) != 0) {
+			return;
+		}
+
+		group = (group + step) & group_mask;
+	}
+}
+
+void hash_table_scan_start(HashTable *hash_table, HashTableCursor *cursor)
+{
+	cursor->position = 0;
+	cursor->resizes = hash_table->resizes;
+}
+
+int hash_table_scan(HashTable *hash_table, HashTableCursor *cursor,
+                    unsigned int count, HashTableScanFunc callback,
+                    void *user_data)
+{
+	HashTableEntry **small_table;
+	HashTableEntry **large_table;
+	unsigned int small_mask;
+	unsigned int large_mask;
+
+	if ((hash_table->flags & HASH_TABLE_OPEN_ADDRESSING) != 0) {
+		large_mask = hash_table->table_size / HASH_TABLE_GROUP_WIDTH - 1;
+
+		do {
+			hash_table_open_scan_group(hash_table,
+			                           cursor->position & large_mask,
+			                           callback, user_data);
+			cursor->position =
+			    hash_table_cursor_next(cursor->position, large_mask);
+		} while (--count > 0 && cursor->position != 0);
+
+		return cursor->position != 0;
+	}
+
+	if ((hash_table->flags & HASH_TABLE_POWER_OF_TWO) == 0) {
+
+		/* Chains of prime sized tables do not correspond between
+		 * sizes, so the scan starts again if the table has been
+		 * resized. */
+		if (cursor->resizes != hash_table->resizes) {
+			cursor->position = 0;
+			cursor->resizes = hash_table->resizes;
+		}
+
+		hash_table_rehash_all(hash_table);
+
+		do {
+			hash_table_scan_chain(
+			    hash_table->table[cursor->position], callback,
+			    user_data);
+			++cursor->position;
+		} while (--count > 0 &&
+		         cursor->position < hash_table->table_size);
+
+		if (cursor->position < hash_table->table_size) {
+			return 1;
+		}
+
+		cursor->position = 0;
+
+		return 0;
+	}
+
+	/* During an incremental resize, the entries of a chain in the
+	 * smaller table may be spread over several chains in the larger
+	 * one, so all of those are visited together. */
+	do {
+		if (hash_table->old_table == NULL) {
+			large_mask = hash_table->table_size - 1;
+			hash_table_scan_chain(
+			    hash_table->table[cursor->position & large_mask],
+			    callback, user_data);
+			cursor->position =
+			    hash_table_cursor_next(cursor->position, large_mask);
+			continue;
+		}
+
+		if (hash_table->old_table_size < hash_table->table_size) {
+			small_table = hash_table->old_table;
+			small_mask = hash_table->old_table_size - 1;
+			large_table = hash_table->table;
+			large_mask = hash_table->table_size - 1;
+		} else {
+			small_table = hash_table->table;
+			small_mask = hash_table->table_size - 1;
+			large_table = hash_table->old_table;
+			large_mask = hash_table->old_table_size - 1;
+		}
+
+		hash_table_scan_chain(small_table[cursor->position & small_mask],
+		                      callback, user_data);
+
+		do {
+			hash_table_scan_chain(
+			    large_table[cursor->position & large_mask],
+			    callback, user_data);
+			cursor->position =
+			    hash_table_cursor_next(cursor->position, large_mask);
+		} while ((cursor->position & (small_mask ^ large_mask)) != 0);
+	} while (--count > 0 && cursor->position != 0);
+
+	return cursor->position != 0;
+}
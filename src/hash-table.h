@@ -28,7 +28,8 @@ CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  * quickly.
  *
  * To create a hash table, use @ref hash_table_new.  To destroy a
- * hash table, use @ref hash_table_free.
+ * hash table, use @ref hash_table_free.  A hash table using a different
+ * storage scheme can be created using @ref hash_table_new_with_flags.
  *
  * To insert a value into a hash table, use @ref hash_table_insert.
  *
@@ -40,11 +41,18 @@ CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  * @ref hash_table_iterate to initialise a @ref HashTableIterator
  * structure.  Each value can then be read in turn using
  * @ref hash_table_iter_next and @ref hash_table_iter_has_more.
+ *
+ * A large table can instead be scanned a few chains at a time, changing
+ * it between steps, using @ref hash_table_scan_start to initialise a
+ * @ref HashTableCursor and then calling @ref hash_table_scan until it
+ * returns zero.
  */
 
 #ifndef ALGORITHM_HASH_TABLE_H
 #define ALGORITHM_HASH_TABLE_H
 
+#include <stddef.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -90,6 +98,54 @@ typedef void *HashTableValue;
 
 #endif /* #ifndef TEST_ALTERNATE_VALUE_TYPES */
 
+/**
+ * Flags which may be passed to @ref hash_table_new_with_flags to control
+ * how a hash table is stored.  Flags can be combined using bitwise OR.
+ */
+typedef enum {
+	/**
+	 * Store entries in a flat array of slots using open addressing,
+	 * rather than in chains of individually allocated entries.
+	 * Slots are grouped together with an array of control bytes that
+	 * allows a whole group to be probed at once, so that a lookup
+	 * usually only needs to examine a single cache line.
+	 */
+	HASH_TABLE_OPEN_ADDRESSING = 1 << 0,
+
+	/**
+	 * Use power-of-two table sizes for a chained table, rather than
+	 * prime numbers.  The index into the table is then found by
+	 * masking rather than by an integer division.  Hash values are
+	 * scrambled before being masked so that weak hash functions such
+	 * as int_hash() or pointer_hash() still distribute well.
+	 * Open addressing tables always behave this way.
+	 */
+	HASH_TABLE_POWER_OF_TWO = 1 << 1,
+
+	/**
+	 * Enlarge a chained table incrementally.  Rather than moving every
+	 * entry into the new table at once, which can stall an insert for
+	 * a long time on a large table, both tables are kept and a few
+	 * chains are moved across on each insert, lookup and remove.  The
+	 * time taken by an insert is then independent of the size of the
+	 * table.  Starting to iterate over the table completes any resize
+	 * in progress.  This flag cannot be combined with
+	 * @ref HASH_TABLE_OPEN_ADDRESSING.
+	 */
+	HASH_TABLE_INCREMENTAL_RESIZE = 1 << 2,
+
+	/**
+	 * Allocate the entries of a chained table from large blocks owned
+	 * by the table, rather than with a separate malloc() for each.
+	 * This uses less memory, and freeing the table only needs to free
+	 * each block rather than each entry.  The memory used by removed
+	 * entries is reused for new entries, but is not returned until
+	 * the table is freed.  Open addressing tables have no separate
+	 * entries, so this flag has no effect on them.
+	 */
+	HASH_TABLE_POOLED = 1 << 3
+} HashTableFlag;
+
 /**
  * Internal structure representing an entry in hash table
  * used as @ref HashTableIterator next result.
@@ -99,6 +155,71 @@ typedef struct _HashTablePair {
 	HashTableValue value;
 } HashTablePair;
 
+/**
+ * Number of elements in the histogram of chain lengths in
+ * @ref HashTableStatistics.
+ */
+#define HASH_TABLE_HISTOGRAM_SIZE 8
+
+/**
+ * Statistics describing the state of a hash table, which can be used to
+ * spot a hash function that distributes keys badly.  See
+ * @ref hash_table_get_statistics.
+ */
+typedef struct _HashTableStatistics {
+
+	/** Number of entries in the table. */
+	unsigned int entries;
+
+	/** Number of chains, or of slots for an open addressing table. */
+	unsigned int table_size;
+
+	/** Number of entries divided by the table size. */
+	double load_factor;
+
+	/**
+	 * Histogram of chain lengths.  Element i is the number of chains
+	 * with i entries, except for the last element, which counts every
+	 * chain at least that long.  For an open addressing table, element
+	 * i is instead the number of entries stored i groups along the
+	 * probe sequence from the group that they hash to.
+	 */
+	unsigned int chain_lengths[HASH_TABLE_HISTOGRAM_SIZE];
+
+	/** Length of the longest chain or probe sequence. */
+	unsigned int max_chain_length;
+
+	/**
+	 * Approximate number of bytes of memory used by the table, not
+	 * including the keys and values or any overhead of malloc().
+	 */
+	size_t memory_used;
+
+	/**
+	 * Number of times the table has been rebuilt at a new size,
+	 * whether to enlarge it, shrink it or compact it.
+	 */
+	unsigned int resizes;
+
+	/**
+	 * Number of searches made for a key, by any function.  This and
+	 * the following fields are only counted if the library was built
+	 * with HASH_TABLE_STATISTICS defined, and are otherwise zero.
+	 */
+	unsigned long searches;
+
+	/**
+	 * Total number of entries examined by all searches.  For an open
+	 * addressing table, the number of groups of slots is counted
+	 * instead.  Dividing this by the number of searches gives the
+	 * average cost of a search.
+	 */
+	unsigned long probes;
+
+	/** Largest number of entries or groups examined by one search. */
+	unsigned int max_probes;
+} HashTableStatistics;
+
 /**
  * Definition of a @ref HashTableIterator.
  */
@@ -108,6 +229,28 @@ struct _HashTableIterator {
 	unsigned int next_chain;
 };
 
+/**
+ * A cursor used to scan a hash table in steps, with the table changing
+ * between them.  Unlike a @ref HashTableIterator, it does not point into
+ * the table.
+ *
+ * @see hash_table_scan_start
+ */
+typedef struct _HashTableCursor {
+	unsigned int position;
+	unsigned int resizes;
+} HashTableCursor;
+
+/**
+ * Function called by @ref hash_table_scan for each entry that it visits.
+ * It must not change the hash table.
+ *
+ * @param pair         The key and value of the entry.
+ * @param user_data    The pointer that was passed to
+ *                     @ref hash_table_scan.
+ */
+typedef void (*HashTableScanFunc)(HashTablePair pair, void *user_data);
+
 /**
  * Hash function used to generate hash values for keys used in a hash
  * table.
@@ -151,6 +294,25 @@ typedef void (*HashTableValueFreeFunc)(HashTableValue value);
 HashTable *hash_table_new(HashTableHashFunc hash_func,
                           HashTableEqualFunc equal_func);
 
+/**
+ * Create a new hash table, specifying how the table is to be stored.
+ *
+ * @param hash_func            Function used to generate hash keys for the
+ *                             keys used in the table.
+ * @param equal_func           Function used to test keys used in the table
+ *                             for equality.
+ * @param flags                Bitwise OR of @ref HashTableFlag values, or
+ *                             zero to create the same kind of table as
+ *                             @ref hash_table_new.
+ * @return                     A new hash table structure, or NULL if it
+ *                             was not possible to allocate the new hash
+ *                             table, or if the flags specified cannot be
+ *                             combined.
+ */
+HashTable *hash_table_new_with_flags(HashTableHashFunc hash_func,
+                                     HashTableEqualFunc equal_func,
+                                     unsigned int flags);
+
 /**
  * Destroy a hash table.
  *
@@ -194,6 +356,61 @@ int hash_table_insert(HashTable *hash_table, HashTableKey key,
  */
 HashTableValue hash_table_lookup(HashTable *hash_table, HashTableKey key);
 
+/**
+ * Look up an entry in a hash table by key, and retrieve both the key
+ * stored in the table and its value.  Unlike @ref hash_table_lookup,
+ * this distinguishes a key that is stored with a value of
+ * @ref HASH_TABLE_NULL from a key that is not in the table.
+ *
+ * @param hash_table          The hash table.
+ * @param key                 The key of the entry to look up.
+ * @param pair                Pointer to a structure in which to store the
+ *                            key and value, if the key is found.
+ * @return                    Non-zero if the key was found, or zero if it
+ *                            is not in the hash table.
+ */
+int hash_table_lookup_pair(HashTable *hash_table, HashTableKey key,
+                           HashTablePair *pair);
+
+/**
+ * Determine whether a hash table contains an entry with a given key.
+ *
+ * @param hash_table          The hash table.
+ * @param key                 The key to look for.
+ * @return                    Non-zero if the key is in the hash table,
+ *                            or zero if it is not.
+ */
+int hash_table_contains(HashTable *hash_table, HashTableKey key);
+
+/**
+ * Look up a value in a hash table, inserting a new entry if the key is
+ * not present, and return a pointer through which the value can be read
+ * or changed in place.  This only searches the table once, so updating
+ * a value this way is faster than calling @ref hash_table_lookup and
+ * then @ref hash_table_insert.
+ *
+ * If the key is already in the table, the existing entry is kept and
+ * neither the key passed nor the value passed is stored or freed.
+ *
+ * The pointer returned remains valid until the hash table is next
+ * changed by inserting or removing an entry, or by resizing it.
+ *
+ * @param hash_table          The hash table.
+ * @param key                 The key of the value to look up.
+ * @param value               Value to store if the key is not present.
+ * @param inserted            If not NULL, set to non-zero if a new entry
+ *                            was inserted, or zero if the key was
+ *                            already present.
+ * @return                    Pointer to the value stored for the key, or
+ *                            NULL if the key was not present and it was
+ *                            not possible to allocate memory for a new
+ *                            entry.
+ */
+HashTableValue *hash_table_lookup_or_insert(HashTable *hash_table,
+                                            HashTableKey key,
+                                            HashTableValue value,
+                                            int *inserted);
+
 /**
  * Remove a value from a hash table.
  *
@@ -204,6 +421,145 @@ HashTableValue hash_table_lookup(HashTable *hash_table, HashTableKey key);
  */
 int hash_table_remove(HashTable *hash_table, HashTableKey key);
 
+/**
+ * Set the load factors at which a hash table is resized.  The load factor
+ * of a table is the number of entries divided by the number of chains
+ * (or slots, for an open addressing table).
+ *
+ * The table is enlarged when an insert finds it at the maximum load
+ * factor.  A lower maximum makes lookups faster at the cost of memory.
+ * Chained tables can have a maximum load factor above one; open
+ * addressing tables are never allowed to become more than 7/8 full.
+ * By default, the maximum is 1/3 for chained tables and 7/8 for open
+ * addressing tables.
+ *
+ * The table is shrunk when a remove leaves it below the minimum load
+ * factor, so that memory use follows the number of entries.  The
+ * minimum must be less than half of the maximum, so that a table which
+ * has just been shrunk does not need to be enlarged again straight
+ * away.  By default the minimum is zero and tables never shrink.
+ *
+ * Note: because removing an entry can cause the table to be resized,
+ *       entries must not be removed while iterating over a table with
+ *       a non-zero minimum load factor.
+ *
+ * @param hash_table          The hash table.
+ * @param max_load            The maximum load factor.
+ * @param min_load            The minimum load factor, or zero never to
+ *                            shrink the table.
+ * @return                    Non-zero if the load factors were set, or
+ *                            zero if they are not valid.
+ */
+int hash_table_set_load_factor(HashTable *hash_table, double max_load,
+                               double min_load);
+
+/**
+ * Shrink a hash table to the smallest size that can hold its current
+ * entries at its maximum load factor.  Any space left behind by
+ * removed entries is also reclaimed: the entries of a table created
+ * with @ref HASH_TABLE_POOLED are moved together into a single block,
+ * and an open addressing table is rebuilt without any deleted slots.
+ *
+ * Note: entries must not be compacted while iterating over the table.
+ *
+ * @param hash_table          The hash table.
+ * @return                    Non-zero if the table was compacted, or
+ *                            zero if it was not possible to allocate
+ *                            memory for the new table.  The table can
+ *                            still be used if this fails.
+ */
+int hash_table_compact(HashTable *hash_table);
+
+/**
+ * Set the number of threads that a chained hash table may use to rebuild
+ * itself when it is enlarged, and to insert values with
+ * @ref hash_table_insert_many.  Threads are only started for large
+ * tables and large numbers of values.  Open addressing tables, and
+ * tables using @ref HASH_TABLE_INCREMENTAL_RESIZE, are always enlarged on
+ * the calling thread, and values are always inserted into open
+ * addressing tables and tables using @ref HASH_TABLE_POOLED on the
+ * calling thread.
+ *
+ * The extra threads are not kept in a pool: they are created when an
+ * operation starts and joined before it returns, so the cost of starting
+ * them is paid by every large resize and bulk insert.
+ *
+ * Threads are only used if the library was built with
+ * HASH_TABLE_THREADS defined, which needs POSIX threads.  Otherwise the
+ * number of threads is recorded but everything is done on the calling
+ * thread, and hash-table.c has no dependencies beyond the C library.
+ *
+ * When several threads are used by @ref hash_table_insert_many, the
+ * hash function, the key comparison function and any free functions
+ * registered with @ref hash_table_register_free_functions are called
+ * from all of them at once, and must be safe to use in this way.
+ *
+ * @param hash_table          The hash table.
+ * @param num_threads         The number of threads to use, including the
+ *                            calling thread.  The default is 1, which
+ *                            does everything on the calling thread.
+ */
+void hash_table_set_threads(HashTable *hash_table, unsigned int num_threads);
+
+/**
+ * Enlarge a hash table so that it can hold at least the given number of
+ * entries without needing to be resized.  This is useful before inserting
+ * a large number of entries, as the table then only needs to be resized
+ * once.  The table is never made smaller.
+ *
+ * @param hash_table          The hash table.
+ * @param num_entries         The total number of entries the table should
+ *                            be able to hold.
+ * @return                    Non-zero if the table is now large enough,
+ *                            or zero if it was not possible to allocate
+ *                            memory for the larger table.
+ */
+int hash_table_reserve(HashTable *hash_table, unsigned int num_entries);
+
+/**
+ * Insert a number of values into a hash table, as though by calling
+ * @ref hash_table_insert for each in turn.  This is faster than
+ * inserting the values one at a time: the table is enlarged up front,
+ * and the keys are hashed a batch at a time so that the table memory
+ * each needs can be fetched while earlier keys are being inserted.
+ *
+ * If the table has been allowed to use several threads with
+ * @ref hash_table_set_threads, a large number of values is inserted by
+ * dividing the chains of the table between the threads.
+ *
+ * @param hash_table          The hash table.
+ * @param keys                Array of keys for the new values.
+ * @param values              Array of values to insert.
+ * @param count               Number of entries in the arrays.
+ * @return                    The number of values inserted.  This is
+ *                            less than count only if it was not possible
+ *                            to allocate memory for an entry, in which
+ *                            case the values after it were not inserted.
+ *                            If several threads were used, each thread
+ *                            stops at the first value that it cannot
+ *                            insert, so the values that were inserted
+ *                            are not necessarily the first ones.
+ */
+unsigned int hash_table_insert_many(HashTable *hash_table, HashTableKey *keys,
+                                    HashTableValue *values, unsigned int count);
+
+/**
+ * Look up a number of values in a hash table, as though by calling
+ * @ref hash_table_lookup for each key in turn.  As with
+ * @ref hash_table_insert_many, the keys are hashed a batch at a time so
+ * that several lookups can wait on memory at once.
+ *
+ * @param hash_table          The hash table.
+ * @param keys                Array of keys to look up.
+ * @param values              Array in which to store the value for each
+ *                            key, or @ref HASH_TABLE_NULL for keys that
+ *                            are not in the hash table.
+ * @param count               Number of entries in the arrays.
+ * @return                    The number of keys that were found.
+ */
+unsigned int hash_table_lookup_many(HashTable *hash_table, HashTableKey *keys,
+                                    HashTableValue *values, unsigned int count);
+
 /**
  * Retrieve the number of entries in a hash table.
  *
@@ -212,6 +568,18 @@ int hash_table_remove(HashTable *hash_table, HashTableKey key);
  */
 unsigned int hash_table_num_entries(HashTable *hash_table);
 
+/**
+ * Retrieve statistics about a hash table.  This examines every chain or
+ * slot in the table, so takes time proportional to the table size.  Any
+ * incremental resize in progress is completed first.
+ *
+ * @param hash_table          The hash table.
+ * @param stats               Pointer to a structure in which to store the
+ *                            statistics.
+ */
+void hash_table_get_statistics(HashTable *hash_table,
+                               HashTableStatistics *stats);
+
 /**
  * Initialise a @ref HashTableIterator to iterate over a hash table.
  *
@@ -248,6 +616,48 @@ int hash_table_iter_has_more(HashTableIterator *iterator);
  */
 HashTablePair hash_table_iter_next(HashTableIterator *iterator);
 
+/**
+ * Initialise a @ref HashTableCursor to scan over a hash table using
+ * @ref hash_table_scan.
+ *
+ * @param hash_table          The hash table.
+ * @param cursor              Pointer to the cursor to initialise.
+ */
+void hash_table_scan_start(HashTable *hash_table, HashTableCursor *cursor);
+
+/**
+ * Continue a scan over a hash table, visiting the next few chains (or,
+ * for an open addressing table, the entries belonging to the next few
+ * groups of slots) and passing each entry in them to a callback
+ * function.
+ *
+ * Entries may be inserted and removed, and the table may be resized,
+ * between calls.  Every entry that is in the table for the whole of the
+ * scan is visited at least once; entries inserted or removed during the
+ * scan may or may not be visited.  Tables using
+ * @ref HASH_TABLE_POWER_OF_TWO or @ref HASH_TABLE_OPEN_ADDRESSING are
+ * scanned in reverse binary order of their chains, which stays valid
+ * when the table doubles or halves in size, so an entry is visited more
+ * than once only if the table shrinks during the scan.  For other tables,
+ * a resize restarts the scan from the beginning, and any incremental
+ * resize in progress is completed first.
+ *
+ * @param hash_table          The hash table.
+ * @param cursor              The cursor, initialised using
+ *                            @ref hash_table_scan_start.
+ * @param count               The number of chains or groups to visit.
+ *                            At least one is always visited.
+ * @param callback            Function to call for each entry visited.
+ * @param user_data           Pointer to pass to the callback.
+ * @return                    Non-zero if there is more of the table to
+ *                            scan, or zero if the scan is complete.  The
+ *                            cursor is then back at the start of the
+ *                            table.
+ */
+int hash_table_scan(HashTable *hash_table, HashTableCursor *cursor,
+                    unsigned int count, HashTableScanFunc callback,
+                    void *user_data);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,540 @@
+/*
+
+Copyright (c) 2026 Simon Howard
+
+Permission to use, copy, modify, and/or distribute this software
+for any purpose with or without fee is hereby granted, provided
+that the above copyright notice and this permission notice appear
+in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT,
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+ */
+
+/* Set of integers */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "int-set.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/* malloc() / free() testing */
+#ifdef ALLOC_TESTING
+#include "alloc-testing.h"
+#endif
+
+/* Values are stored in a power-of-two sized table using linear probing.
+ * An empty slot holds zero, so zero itself is never stored in the table;
+ * whether it is in the set is recorded separately.  A search compares a
+ * group of neighbouring slots at once, so the table size is always a
+ * multiple of the group width. */
+#if defined(__AVX2__)
+#define INT_SET_GROUP_WIDTH 8
+#else
+#define INT_SET_GROUP_WIDTH 4
+#endif
+
+#define INT_SET_MIN_SIZE 16
+
+/* The table is enlarged when it becomes 3/4 full */
+#define INT_SET_LOAD(table_size) ((table_size) - (table_size) / 4)
+
+struct _IntSet {
+	int *table;
+	unsigned int table_size;
+	unsigned int entries;
+	int has_zero;
+};
+
+/* Scramble the bits of a value to find the slot that it belongs to.
+ * This is the finalizer from MurmurHash3. */
+static unsigned int int_set_mix(int value)
+{
+	unsigned int hash;
+
+	hash = (unsigned int) value;
+	hash ^= hash >> 16;
+	hash *= 0x85ebca6bU;
+	hash ^= hash >> 13;
+	hash *= 0xc2b2ae35U;
+	hash ^= hash >> 16;
+
+	return hash;
+}
+
+/* Find the index of the lowest bit that is set in a non-zero mask. */
+static unsigned int int_set_lowest_bit(unsigned int mask)
+{
+#ifdef __GNUC__
+	return (unsigned int) __builtin_ctz(mask);
+#else
+	unsigned int result;
+
+	for (result = 0; (mask & 1) == 0; ++result) {
+		mask >>= 1;
+	}
+
+	return result;
+#endif
+}
+
+/* Compare every slot in a group against a value, returning a bitmask
+ * with a bit set for each slot that matched. */
+static unsigned int int_set_group_match(const int *group, int value)
+{
+#if defined(__AVX2__)
+	__m256i slots;
+	__m256i match;
+
+	slots = _mm256_loadu_si256((const __m256i *) group);
+	match = _mm256_cmpeq_epi32(slots, _mm256_set1_epi32(value));
+
+	return (unsigned int) _mm256_movemask_ps(_mm256_castsi256_ps(match));
+#elif defined(__SSE2__)
+	__m128i slots;
+	__m128i match;
+
+	slots = _mm_loadu_si128((const __m128i *) group);
+	match = _mm_cmpeq_epi32(slots, _mm_set1_epi32(value));
+
+	return (unsigned int) _mm_movemask_ps(_mm_castsi128_ps(match));
+#else
+	unsigned int result;
+	unsigned int i;
+
+	result = 0;
+
+	for (i = 0; i < INT_SET_GROUP_WIDTH; ++i) {
+		if (group[i] == value) {
+			result |= 1U << i;
+		}
+	}
+
+	return result;
+#endif
+}
+
+/* Search for a non-zero value.  If it is found, non-zero is returned and
+ * its slot is stored in *slot.  Otherwise, zero is returned and the first
+ * empty slot after the one the value belongs to, where it should be
+ * inserted, is stored in *slot.
+ *
+ * The search starts with the group containing the slot that the value
+ * belongs to.  A value is only ever stored once, so a match anywhere in
+ * that group is the value being searched for, but empty slots before the
+ * one it belongs to must be ignored. */
+static int int_set_find(IntSet *set, int value, unsigned int *slot)
+{
+	unsigned int mask;
+	unsigned int home;
+	unsigned int group;
+	unsigned int match;
+	unsigned int skip;
+
+	mask = set->table_size - 1;
+	home = int_set_mix(value) & mask;
+	group = home & ~(INT_SET_GROUP_WIDTH - 1U);
+	skip = home - group;
+
+	for (;;) {
+		match = int_set_group_match(set->table + group, value);
+
+		if (match != 0) {
+			*slot = group + int_set_lowest_bit(match);
+			return 1;
+		}
+
+		match = int_set_group_match(set->table + group, 0) &
+		        (~0U << skip);
+
+		if (match != 0) {
+			*slot = group + int_set_lowest_bit(match);
+			return 0;
+		}
+
+		skip = 0;
+		group = (group + INT_SET_GROUP_WIDTH) & mask;
+	}
+}
+
+static int int_set_resize(IntSet *set, unsigned int table_size)
+{
+	int *old_table;
+	unsigned int old_table_size;
+	unsigned int slot;
+	unsigned int i;
+
+	old_table = set->table;
+	old_table_size = set->table_size;
+
+	set->table = calloc(table_size, sizeof(int));
+
+	if (set->table == NULL) {
+		set->table = old_table;
+		return 0;
+	}
+
+	set->table_size = table_size;
+
+	for (i = 0; i < old_table_size; ++i) {
+		if (old_table[i] != 0) {
+			int_set_find(set, old_table[i], &slot);
+			set->table[slot] = old_table[i];
+		}
+	}
+
+	free(old_table);
+
+	return 1;
+}
+
+/* Make room for a total of num_entries values in the table */
+static int int_set_reserve(IntSet *set, unsigned int num_entries)
+{
+	unsigned int table_size;
+
+	table_size = set->table_size;
+
+	while (num_entries > INT_SET_LOAD(table_size)) {
+		if (table_size >= (1U << 31)) {
+			return 0;
+		}
+
+		table_size <<= 1;
+	}
+
+	if (table_size == set->table_size) {
+		return 1;
+	}
+
+	return int_set_resize(set, table_size);
+}
+
+IntSet *int_set_new(void)
+{
+	IntSet *set;
+
+	set = (IntSet *) malloc(sizeof(IntSet));
+
+	if (set == NULL) {
+		return NULL;
+	}
+
+	set->table_size = INT_SET_MIN_SIZE;
+	set->entries = 0;
+	set->has_zero = 0;
+	set->table = calloc(set->table_size, sizeof(int));
+
+	if (set->table == NULL) {
+		free(set);
+		return NULL;
+	}
+
+	return set;
+}
+
+void int_set_free(IntSet *set)
+{
+	free(set->table);
+	free(set);
+}
+
+int int_set_insert(IntSet *set, int value)
+{
+	unsigned int slot;
+
+	if (value == 0) {
+		if (set->has_zero) {
+			return 0;
+		}
+
+		set->has_zero = 1;
+		return 1;
+	}
+
+	if (int_set_find(set, value, &slot)) {
+		return 0;
+	}
+
+	/* Only enlarge the table once it is known that a value is really
+	 * being added.  The slot must then be found again.  Growing
+	 * through int_set_reserve fails cleanly once the table cannot
+	 * be doubled any further. */
+	if (set->entries >= INT_SET_LOAD(set->table_size)) {
+		if (!int_set_reserve(set, set->entries + 1)) {
+			return 0;
+		}
+
+		int_set_find(set, value, &slot);
+	}
+
+	set->table[slot] = value;
+	++set->entries;
+
+	return 1;
+}
+
+int int_set_remove(IntSet *set, int value)
+{
+	unsigned int mask;
+	unsigned int slot;
+	unsigned int next;
+	unsigned int home;
+
+	if (value == 0) {
+		if (!set->has_zero) {
+			return 0;
+		}
+
+		set->has_zero = 0;
+		return 1;
+	}
+
+	if (!int_set_find(set, value, &slot)) {
+		return 0;
+	}
+
+	/* Rather than leaving a marker in the slot, move back any later
+	 * value in the same run of full slots that would otherwise no
+	 * longer be found, because the slot it belongs to is at or before
+	 * the slot being emptied. */
+	mask = set->table_size - 1;
+	next = slot;
+
+	for (;;) {
+		next = (next + 1) & mask;
+
+		if (set->table[next] == 0) {
+			break;
+		}
+
+		home = int_set_mix(set->table[next]) & mask;
+
+		/* Distances are measured going backwards from the value being
+		 * considered, wrapping around the end of the table */
+		if (((next - home) & mask) >= ((next - slot) & mask)) {
+			set->table[slot] = set->table[next];
+			slot = next;
+		}
+	}
+
+	set->table[slot] = 0;
+	--set->entries;
+
+	return 1;
+}
+
+int int_set_query(IntSet *set, int value)
+{
+	unsigned int slot;
+
+	if (value == 0) {
+		return set->has_zero;
+	}
+
+	return int_set_find(set, value, &slot);
+}
+
+unsigned int int_set_num_entries(IntSet *set)
+{
+	return set->entries + (set->has_zero ? 1U : 0U);
+}
+
+int *int_set_to_array(IntSet *set)
+{
+	int *array;
+	unsigned int array_counter;
+	unsigned int i;
+
+	array = malloc(sizeof(int) * int_set_num_entries(set));
+
+	if (array == NULL) {
+		return NULL;
+	}
+
+	array_counter = 0;
+
+	if (set->has_zero) {
+		array[array_counter] = 0;
+		++array_counter;
+	}
+
+	for (i = 0; i < set->table_size; ++i) {
+		if (set->table[i] != 0) {
+			array[array_counter] = set->table[i];
+			++array_counter;
+		}
+	}
+
+	return array;
+}
+
+IntSet *int_set_union(IntSet *set1, IntSet *set2)
+{
+	IntSet *new_set;
+	unsigned int slot;
+	unsigned int i;
+
+	new_set = int_set_new();
+
+	if (new_set == NULL) {
+		return NULL;
+	}
+
+	/* Size the new set for the largest possible result, so that
+	 * adding the values cannot fail */
+	if (set2->entries > ~0U - set1->entries ||
+	    !int_set_reserve(new_set, set1->entries + set2->entries)) {
+		int_set_free(new_set);
+		return NULL;
+	}
+
+	/* The values of the first set are all different, so they can be
+	 * copied across without checking for duplicates */
+	for (i = 0; i < set1->table_size; ++i) {
+		if (set1->table[i] != 0) {
+			int_set_find(new_set, set1->table[i], &slot);
+			new_set->table[slot] = set1->table[i];
+		}
+	}
+
+	new_set->entries = set1->entries;
+
+	for (i = 0; i < set2->table_size; ++i) {
+		if (set2->table[i] != 0 &&
+		    !int_set_find(new_set, set2->table[i], &slot)) {
+			new_set->table[slot] = set2->table[i];
+			++new_set->entries;
+		}
+	}
+
+	new_set->has_zero = set1->has_zero || set2->has_zero;
+
+	return new_set;
+}
+
+IntSet *int_set_intersection(IntSet *set1, IntSet *set2)
+{
+	IntSet *new_set;
+	IntSet *smaller;
+	IntSet *larger;
+	unsigned int slot;
+	unsigned int i;
+
+	new_set = int_set_new();
+
+	if (new_set == NULL) {
+		return NULL;
+	}
+
+	/* Only the values in the smaller set need to be examined */
+	if (set2->entries < set1->entries) {
+		smaller = set2;
+		larger = set1;
+	} else {
+		smaller = set1;
+		larger = set2;
+	}
+
+	if (!int_set_reserve(new_set, smaller->entries)) {
+		int_set_free(new_set);
+		return NULL;
+	}
+
+	for (i = 0; i < smaller->table_size; ++i) {
+		if (smaller->table[i] != 0 &&
+		    int_set_find(larger, smaller->table[i], &slot)) {
+			int_set_find(new_set, smaller->table[i], &slot);
+			new_set->table[slot] = smaller->table[i];
+			++new_set->entries;
+		}
+	}
+
+	new_set->has_zero = set1->has_zero && set2->has_zero;
+
+	return new_set;
+}
+
+/* Find the slot in use before the given slot, going backwards and
+ * wrapping around, or return set->table_size if end is reached first. */
+static unsigned int int_set_prev(IntSet *set, unsigned int index,
+                                 unsigned int end)
+{
+	unsigned int mask;
+
+	mask = set->table_size - 1;
+
+	for (;;) {
+		index = (index - 1) & mask;
+
+		if (index == end) {
+			return set->table_size;
+		}
+
+		if (set->table[index] != 0) {
+			return index;
+		}
+	}
+}
+
+void int_set_iterate(IntSet *set, IntSetIterator *iter)
+{
+	unsigned int index;
+
+	iter->set = set;
+	iter->zero_pending = set->has_zero;
+
+	/* The table is iterated backwards, starting and ending at an empty
+	 * slot.  Removing a value only moves values from the run of full
+	 * slots after it, which have all been visited already, so removing
+	 * the value just returned does not cause any other value to be
+	 * missed or visited twice. */
+	for (index = 0; set->table[index] != 0; ++index)
+		;
+
+	iter->end_index = index;
+	iter->next_index = int_set_prev(set, index, index);
+}
+
+int int_set_iter_has_more(IntSetIterator *iterator)
+{
+	return iterator->zero_pending ||
+	       iterator->next_index != iterator->set->table_size;
+}
+
+int int_set_iter_next(IntSetIterator *iterator)
+{
+	IntSet *set;
+	int result;
+
+	set = iterator->set;
+
+	/* Zero is not stored in the table, so is returned first */
+	if (iterator->zero_pending) {
+		iterator->zero_pending = 0;
+		return 0;
+	}
+
+	if (iterator->next_index == set->table_size) {
+		return 0;
+	}
+
+	result = set->table[iterator->next_index];
+	iterator->next_index =
+	    int_set_prev(set, iterator->next_index, iterator->end_index);
+
+	return result;
+}
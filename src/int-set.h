@@ -0,0 +1,204 @@
+/*
+
+Copyright (c) 2026 Simon Howard
+
+Permission to use, copy, modify, and/or distribute this software
+for any purpose with or without fee is hereby granted, provided
+that the above copyright notice and this permission notice appear
+in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT,
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+ */
+
+/**
+ * @file int-set.h
+ *
+ * @brief Set of integers.
+ *
+ * An integer set stores a collection of int values, each of which can
+ * only exist once in the set.  It behaves like a @ref Set using
+ * int_hash() and int_equal(), but the values themselves are stored in
+ * a single flat array rather than as pointers to separately allocated
+ * integers.  This uses several times less memory, and a search compares
+ * a whole group of values at once using SIMD instructions where they
+ * are available, rather than following a pointer for each.
+ *
+ * To create a new integer set, use @ref int_set_new.  To destroy one,
+ * use @ref int_set_free.
+ *
+ * To add a value to a set, use @ref int_set_insert.  To remove a value
+ * from a set, use @ref int_set_remove.
+ *
+ * To find the number of entries in a set, use @ref int_set_num_entries.
+ *
+ * To query if a particular value is in a set, use @ref int_set_query.
+ *
+ * To iterate over all values in a set, use @ref int_set_iterate to
+ * initialise a @ref IntSetIterator structure, with @ref int_set_iter_next
+ * and @ref int_set_iter_has_more to read each value in turn.
+ *
+ * Two sets can be combined (union) using @ref int_set_union, while the
+ * intersection of two sets can be generated using
+ * @ref int_set_intersection.
+ */
+
+#ifndef ALGORITHM_INT_SET_H
+#define ALGORITHM_INT_SET_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Represents a set of integers.  Created using the @ref int_set_new
+ * function and destroyed using the @ref int_set_free function.
+ */
+typedef struct _IntSet IntSet;
+
+/**
+ * An object used to iterate over an integer set.
+ *
+ * @see int_set_iterate
+ */
+typedef struct _IntSetIterator IntSetIterator;
+
+/**
+ * Definition of a @ref IntSetIterator.
+ */
+struct _IntSetIterator {
+	IntSet *set;
+	unsigned int next_index;
+	unsigned int end_index;
+	int zero_pending;
+};
+
+/**
+ * Create a new, empty integer set.
+ *
+ * @return               A new set, or NULL if it was not possible to
+ *                       allocate the memory for the set.
+ */
+IntSet *int_set_new(void);
+
+/**
+ * Destroy an integer set.
+ *
+ * @param set            The set to destroy.
+ */
+void int_set_free(IntSet *set);
+
+/**
+ * Add a value to an integer set.
+ *
+ * @param set            The set.
+ * @param value          The value to add to the set.
+ * @return               Non-zero (true) if the value was added to the set,
+ *                       zero (false) if it already exists in the set, or
+ *                       if it was not possible to allocate memory for a
+ *                       larger table.
+ */
+int int_set_insert(IntSet *set, int value);
+
+/**
+ * Remove a value from an integer set.
+ *
+ * @param set            The set.
+ * @param value          The value to remove from the set.
+ * @return               Non-zero (true) if the value was found and removed
+ *                       from the set, zero (false) if the value was not
+ *                       found in the set.
+ */
+int int_set_remove(IntSet *set, int value);
+
+/**
+ * Query if a particular value is in an integer set.
+ *
+ * @param set            The set.
+ * @param value          The value to query for.
+ * @return               Zero if the value is not in the set, non-zero if
+ *                       the value is in the set.
+ */
+int int_set_query(IntSet *set, int value);
+
+/**
+ * Retrieve the number of entries in an integer set.
+ *
+ * @param set            The set.
+ * @return               A count of the number of entries in the set.
+ */
+unsigned int int_set_num_entries(IntSet *set);
+
+/**
+ * Create an array containing all entries in an integer set.
+ *
+ * @param set            The set.
+ * @return               An array containing all entries in the set,
+ *                       or NULL if it was not possible to allocate
+ *                       memory for the array.
+ */
+int *int_set_to_array(IntSet *set);
+
+/**
+ * Perform a union of two integer sets.
+ *
+ * @param set1           The first set.
+ * @param set2           The second set.
+ * @return               A new set containing all values which are in the
+ *                       first or second sets, or NULL if it was not
+ *                       possible to allocate memory for the new set.
+ */
+IntSet *int_set_union(IntSet *set1, IntSet *set2);
+
+/**
+ * Perform an intersection of two integer sets.
+ *
+ * @param set1           The first set.
+ * @param set2           The second set.
+ * @return               A new set containing all values which are in both
+ *                       sets, or NULL if it was not possible to allocate
+ *                       memory for the new set.
+ */
+IntSet *int_set_intersection(IntSet *set1, IntSet *set2);
+
+/**
+ * Initialise a @ref IntSetIterator structure to iterate over the values
+ * in an integer set.  The value most recently returned by the iterator
+ * may be removed from the set without disturbing the iteration.
+ *
+ * @param set            The set to iterate over.
+ * @param iter           Pointer to an iterator structure to initialise.
+ */
+void int_set_iterate(IntSet *set, IntSetIterator *iter);
+
+/**
+ * Determine if there are more values in an integer set to iterate over.
+ *
+ * @param iterator       The set iterator object.
+ * @return               Zero if there are no more values in the set
+ *                       to iterate over, non-zero if there are more
+ *                       values to be read.
+ */
+int int_set_iter_has_more(IntSetIterator *iterator);
+
+/**
+ * Using an integer set iterator, retrieve the next value from the set.
+ *
+ * @param iterator       The set iterator.
+ * @return               The next value from the set, or zero if no
+ *                       more values are available.
+ */
+int int_set_iter_next(IntSetIterator *iterator);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef ALGORITHM_INT_SET_H */
@@ -34,10 +34,14 @@ CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 #include <libcalg/binary-heap.h>
 #include <libcalg/binomial-heap.h>
 #include <libcalg/bloom-filter.h>
+#include <libcalg/concurrent-hash-table.h>
+#include <libcalg/counting-bloom-filter.h>
 #include <libcalg/hash-table.h>
+#include <libcalg/int-set.h>
 #include <libcalg/list.h>
 #include <libcalg/queue.h>
 #include <libcalg/rb-tree.h>
+#include <libcalg/roaring-bitmap.h>
 #include <libcalg/set.h>
 #include <libcalg/slist.h>
 #include <libcalg/sortedarray.h>
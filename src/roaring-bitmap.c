@@ -0,0 +1,1704 @@
+/*
+
+Copyright (c) 2026 Simon Howard
+
+Permission to use, copy, modify, and/or distribute this software
+for any purpose with or without fee is hereby granted, provided
+that the above copyright notice and this permission notice appear
+in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT,
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+ */
+
+/* Compressed set of 32-bit unsigned integers */
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "roaring-bitmap.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* malloc() / free() testing */
+#ifdef ALLOC_TESTING
+#include "alloc-testing.h"
+#endif
+
+/* Container types */
+#define ROARING_ARRAY  0
+#define ROARING_BITMAP 1
+#define ROARING_RUN    2
+
+/* Largest number of values held in an array container.  Beyond this, a
+ * bitmap container is smaller. */
+#define ROARING_ARRAY_MAX 4096
+
+/* Number of 32-bit words in a bitmap container.  Only the low 32 bits
+ * of each unsigned int are used. */
+#define ROARING_WORDS 2048
+
+#define ROARING_WORD_MASK 0xffffffffU
+
+/* Size in bytes of each form of container, used to choose between them */
+#define ROARING_ARRAY_BYTES(cardinality) (2UL * (cardinality))
+#define ROARING_BITMAP_BYTES              8192UL
+#define ROARING_RUN_BYTES(runs)           (4UL * (runs))
+
+/* A container holds the lower 16 bits of the values that share the same
+ * upper 16 bits (the key).  An array container holds its values in
+ * increasing order.  A run container holds pairs of unsigned shorts in
+ * increasing order: the first value of each run, and its length minus
+ * one.  Runs never overlap or touch each other.  Containers are never
+ * empty. */
+typedef struct {
+	unsigned int key;
+	int type;
+	unsigned int cardinality;
+	unsigned int length;
+	unsigned int capacity;
+	unsigned short *values;
+	unsigned int *words;
+} RoaringContainer;
+
+struct _RoaringBitmap {
+	RoaringContainer *containers;
+	unsigned int num_containers;
+	unsigned int capacity;
+	unsigned long num_entries;
+};
+
+/* Operations performed by roaring_bitmap_combine */
+#define ROARING_UNION        0
+#define ROARING_INTERSECTION 1
+#define ROARING_DIFFERENCE   2
+
+/* Identifies serialized data, "RBM1" read as a little-endian integer */
+#define ROARING_COOKIE 0x314d4252UL
+
+static unsigned int roaring_popcount(unsigned int word)
+{
+#ifdef __GNUC__
+	return (unsigned int) __builtin_popcount(word);
+#else
+	word = word - ((word >> 1) & 0x55555555U);
+	word = (word & 0x33333333U) + ((word >> 2) & 0x33333333U);
+	word = (word + (word >> 4)) & 0x0f0f0f0fU;
+
+	return ((word * 0x01010101U) & ROARING_WORD_MASK) >> 24;
+#endif
+}
+
+/* Find the index of the lowest bit that is set in a non-zero word. */
+static unsigned int roaring_lowest_bit(unsigned int word)
+{
+#ifdef __GNUC__
+	return (unsigned int) __builtin_ctz(word);
+#else
+	unsigned int result;
+
+	for (result = 0; (word & 1) == 0; ++result) {
+		word >>= 1;
+	}
+
+	return result;
+#endif
+}
+
+/* Operations on whole bitmap containers.  These combine four words at
+ * once where SSE2 is available. */
+#ifdef __SSE2__
+#define ROARING_WORDS_LOOP(sse_op, op)                                       \
+	for (i = 0; i < ROARING_WORDS; i += 4) {                             \
+		_mm_storeu_si128((__m128i *) (dest + i),                     \
+		    sse_op(_mm_loadu_si128((const __m128i *) (src + i)),     \
+		           _mm_loadu_si128((const __m128i *) (dest + i))));  \
+	}
+#else
+#define ROARING_WORDS_LOOP(sse_op, op)                                       \
+	for (i = 0; i < ROARING_WORDS; ++i) {                                \
+		dest[i] = op;                                                \
+	}
+#endif
+
+static void roaring_words_or(unsigned int *dest, const unsigned int *src)
+{
+	unsigned int i;
+
+	ROARING_WORDS_LOOP(_mm_or_si128, dest[i] | src[i])
+}
+
+static void roaring_words_and(unsigned int *dest, const unsigned int *src)
+{
+	unsigned int i;
+
+	ROARING_WORDS_LOOP(_mm_and_si128, dest[i] & src[i])
+}
+
+/* dest = dest & ~src.  Note that _mm_andnot_si128 inverts its first
+ * argument. */
+static void roaring_words_andnot(unsigned int *dest, const unsigned int *src)
+{
+	unsigned int i;
+
+	ROARING_WORDS_LOOP(_mm_andnot_si128,
+	                   dest[i] & ~src[i] & ROARING_WORD_MASK)
+}
+
+static unsigned int roaring_words_popcount(const unsigned int *words)
+{
+	unsigned int result;
+	unsigned int i;
+
+	result = 0;
+
+	for (i = 0; i < ROARING_WORDS; ++i) {
+		result += roaring_popcount(words[i]);
+	}
+
+	return result;
+}
+
+/* Set every bit from first to last inclusive */
+static void roaring_words_set_range(unsigned int *words, unsigned int first,
+                                    unsigned int last)
+{
+	unsigned int first_word, last_word;
+	unsigned int first_mask, last_mask;
+	unsigned int i;
+
+	first_word = first >> 5;
+	last_word = last >> 5;
+	first_mask = (ROARING_WORD_MASK << (first & 31)) & ROARING_WORD_MASK;
+	last_mask = ROARING_WORD_MASK >> (31 - (last & 31));
+
+	if (first_word == last_word) {
+		words[first_word] |= first_mask & last_mask;
+		return;
+	}
+
+	words[first_word] |= first_mask;
+
+	for (i = first_word + 1; i < last_word; ++i) {
+		words[i] = ROARING_WORD_MASK;
+	}
+
+	words[last_word] |= last_mask;
+}
+
+/* Find the first bit at or after start which is set (if set is non-zero)
+ * or clear (if set is zero), or return 65536 if there is none. */
+static unsigned int roaring_words_next(const unsigned int *words,
+                                       unsigned int start, int set)
+{
+	unsigned int index;
+	unsigned int word;
+	unsigned int invert;
+
+	invert = set ? 0 : ROARING_WORD_MASK;
+	index = start >> 5;
+	word = (words[index] ^ invert) & (ROARING_WORD_MASK << (start & 31));
+
+	while ((word & ROARING_WORD_MASK) == 0) {
+		++index;
+
+		if (index == ROARING_WORDS) {
+			return 65536;
+		}
+
+		word = words[index] ^ invert;
+	}
+
+	return (index << 5) + roaring_lowest_bit(word & ROARING_WORD_MASK);
+}
+
+/* Count the runs of consecutive set bits */
+static unsigned int roaring_words_num_runs(const unsigned int *words)
+{
+	unsigned int result;
+	unsigned int carry;
+	unsigned int i;
+
+	result = 0;
+	carry = 0;
+
+	/* A run starts at each bit that is set when the one below it is
+	 * not */
+	for (i = 0; i < ROARING_WORDS; ++i) {
+		result += roaring_popcount(words[i] & ~((words[i] << 1) | carry) &
+		                           ROARING_WORD_MASK);
+		carry = (words[i] >> 31) & 1;
+	}
+
+	return result;
+}
+
+/* Find the index of the first value in a sorted array that is at or
+ * after the given value. */
+static unsigned int roaring_lower_bound(const unsigned short *values,
+                                        unsigned int length,
+                                        unsigned int value)
+{
+	unsigned int low, high, mid;
+
+	low = 0;
+	high = length;
+
+	while (low < high) {
+		mid = (low + high) / 2;
+
+		if (values[mid] < value) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+
+	return low;
+}
+
+/* Find the number of runs in a run container that start at or before
+ * the given value.  The run that might contain the value is the one
+ * before this index. */
+static unsigned int roaring_run_upper_bound(const RoaringContainer *container,
+                                            unsigned int value)
+{
+	unsigned int low, high, mid;
+
+	low = 0;
+	high = container->length;
+
+	while (low < high) {
+		mid = (low + high) / 2;
+
+		if (container->values[mid * 2] <= value) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+
+	return low;
+}
+
+#define ROARING_RUN_START(container, i)                                      \
+	((unsigned int) (container)->values[(i) * 2])
+#define ROARING_RUN_LAST(container, i)                                       \
+	(ROARING_RUN_START(container, i) + (container)->values[(i) * 2 + 1])
+
+static void roaring_container_free(RoaringContainer *container)
+{
+	free(container->values);
+	free(container->words);
+}
+
+/* Make room for the given number of unsigned shorts in the values of
+ * an array or run container. */
+static int roaring_container_reserve(RoaringContainer *container,
+                                     unsigned int length)
+{
+	unsigned short *new_values;
+	unsigned int new_capacity;
+
+	if (length <= container->capacity) {
+		return 1;
+	}
+
+	new_capacity = container->capacity < 4 ? 4 : container->capacity;
+
+	while (new_capacity < length) {
+		new_capacity *= 2;
+	}
+
+	new_values = realloc(container->values,
+	                     sizeof(unsigned short) * new_capacity);
+
+	if (new_values == NULL) {
+		return 0;
+	}
+
+	container->values = new_values;
+	container->capacity = new_capacity;
+
+	return 1;
+}
+
+static int roaring_container_contains(const RoaringContainer *container,
+                                      unsigned int value)
+{
+	unsigned int index;
+
+	switch (container->type) {
+	case ROARING_ARRAY:
+		index = roaring_lower_bound(container->values,
+		                            container->length, value);
+		return index < container->length &&
+		       container->values[index] == value;
+
+	case ROARING_BITMAP:
+		return (container->words[value >> 5] >> (value & 31)) & 1;
+
+	default:
+		index = roaring_run_upper_bound(container, value);
+		return index > 0 && value <= ROARING_RUN_LAST(container, index - 1);
+	}
+}
+
+/* Find the first value at or after the given value in a container.
+ * Returns zero if there is none. */
+static int roaring_container_next(const RoaringContainer *container,
+                                  unsigned int value, unsigned int *result)
+{
+	unsigned int index;
+
+	switch (container->type) {
+	case ROARING_ARRAY:
+		index = roaring_lower_bound(container->values,
+		                            container->length, value);
+
+		if (index == container->length) {
+			return 0;
+		}
+
+		*result = container->values[index];
+		return 1;
+
+	case ROARING_BITMAP:
+		*result = roaring_words_next(container->words, value, 1);
+		return *result < 65536;
+
+	default:
+		index = roaring_run_upper_bound(container, value);
+
+		if (index > 0 && value <= ROARING_RUN_LAST(container, index - 1)) {
+			*result = value;
+			return 1;
+		}
+
+		if (index == container->length) {
+			return 0;
+		}
+
+		*result = ROARING_RUN_START(container, index);
+		return 1;
+	}
+}
+
+/* Set the bits for all values in a container in a bitmap */
+static void roaring_container_or_words(const RoaringContainer *container,
+                                       unsigned int *words)
+{
+	unsigned int value;
+	unsigned int i;
+
+	switch (container->type) {
+	case ROARING_ARRAY:
+		for (i = 0; i < container->length; ++i) {
+			value = container->values[i];
+			words[value >> 5] |= 1U << (value & 31);
+		}
+		break;
+
+	case ROARING_BITMAP:
+		roaring_words_or(words, container->words);
+		break;
+
+	default:
+		for (i = 0; i < container->length; ++i) {
+			roaring_words_set_range(words,
+			                        ROARING_RUN_START(container, i),
+			                        ROARING_RUN_LAST(container, i));
+		}
+		break;
+	}
+}
+
+static void roaring_container_to_words(const RoaringContainer *container,
+                                       unsigned int *words)
+{
+	memset(words, 0, sizeof(unsigned int) * ROARING_WORDS);
+	roaring_container_or_words(container, words);
+}
+
+/* Store the values in a bitmap into a container, in the given form.
+ * The container's previous contents are freed if this succeeds. */
+static int roaring_container_from_words(RoaringContainer *container,
+                                        const unsigned int *words,
+                                        unsigned int cardinality, int type)
+{
+	unsigned short *values;
+	unsigned int *new_words;
+	unsigned int length;
+	unsigned int first, end;
+
+	values = NULL;
+	new_words = NULL;
+	length = 0;
+
+	if (type == ROARING_BITMAP) {
+		new_words = malloc(sizeof(unsigned int) * ROARING_WORDS);
+
+		if (new_words == NULL) {
+			return 0;
+		}
+
+		memcpy(new_words, words, sizeof(unsigned int) * ROARING_WORDS);
+	} else if (type == ROARING_ARRAY) {
+		values = malloc(sizeof(unsigned short) * cardinality);
+
+		if (values == NULL) {
+			return 0;
+		}
+
+		for (first = roaring_words_next(words, 0, 1); first < 65536;
+		     first = roaring_words_next(words, first + 1, 1)) {
+			values[length] = (unsigned short) first;
+			++length;
+
+			if (first == 65535) {
+				break;
+			}
+		}
+	} else {
+		length = roaring_words_num_runs(words);
+		values = malloc(sizeof(unsigned short) * length * 2);
+
+		if (values == NULL) {
+			return 0;
+		}
+
+		end = 0;
+
+		for (length = 0;; ++length) {
+			first = end < 65536 ? roaring_words_next(words, end, 1)
+			                    : 65536;
+
+			if (first == 65536) {
+				break;
+			}
+
+			end = roaring_words_next(words, first, 0);
+			values[length * 2] = (unsigned short) first;
+			values[length * 2 + 1] = (unsigned short) (end - 1 - first);
+		}
+	}
+
+	roaring_container_free(container);
+
+	container->type = type;
+	container->cardinality = cardinality;
+	container->values = values;
+	container->words = new_words;
+
+	if (type == ROARING_BITMAP) {
+		container->length = 0;
+		container->capacity = 0;
+	} else {
+		container->length = length;
+		container->capacity = type == ROARING_ARRAY ? length : length * 2;
+	}
+
+	return 1;
+}
+
+/* Make a new container from a bitmap, in whichever of array or bitmap
+ * form suits the number of values. */
+static int roaring_container_new_from_words(RoaringContainer *container,
+                                            unsigned int key,
+                                            const unsigned int *words,
+                                            unsigned int cardinality)
+{
+	container->key = key;
+	container->values = NULL;
+	container->words = NULL;
+
+	return roaring_container_from_words(
+	    container, words, cardinality,
+	    cardinality <= ROARING_ARRAY_MAX ? ROARING_ARRAY : ROARING_BITMAP);
+}
+
+static int roaring_container_copy(RoaringContainer *dest,
+                                  const RoaringContainer *src)
+{
+	*dest = *src;
+
+	if (src->type == ROARING_BITMAP) {
+		dest->words = malloc(sizeof(unsigned int) * ROARING_WORDS);
+
+		if (dest->words == NULL) {
+			return 0;
+		}
+
+		memcpy(dest->words, src->words,
+		       sizeof(unsigned int) * ROARING_WORDS);
+	} else {
+		dest->values = malloc(sizeof(unsigned short) * src->capacity);
+
+		if (dest->values == NULL) {
+			return 0;
+		}
+
+		memcpy(dest->values, src->values,
+		       sizeof(unsigned short) * src->capacity);
+	}
+
+	return 1;
+}
+
+/* Convert an array or run container to a bitmap container */
+static int roaring_container_to_bitmap(RoaringContainer *container)
+{
+	unsigned int words[ROARING_WORDS];
+
+	roaring_container_to_words(container, words);
+
+	return roaring_container_from_words(container, words,
+	                                    container->cardinality,
+	                                    ROARING_BITMAP);
+}
+
+/* Add a value to a container.  Returns 1 if it was added, 0 if it was
+ * already present, or -1 if memory could not be allocated. */
+static int roaring_container_add(RoaringContainer *container,
+                                 unsigned int value)
+{
+	unsigned int index;
+	int extends_prev, extends_next;
+
+	switch (container->type) {
+	case ROARING_ARRAY:
+		index = roaring_lower_bound(container->values,
+		                            container->length, value);
+
+		if (index < container->length &&
+		    container->values[index] == value) {
+			return 0;
+		}
+
+		if (container->length < ROARING_ARRAY_MAX) {
+			if (!roaring_container_reserve(container,
+			                               container->length + 1)) {
+				return -1;
+			}
+
+			memmove(container->values + index + 1,
+			        container->values + index,
+			        sizeof(unsigned short) *
+			            (container->length - index));
+			container->values[index] = (unsigned short) value;
+			++container->length;
+			++container->cardinality;
+
+			return 1;
+		}
+
+		/* The array is full, so switch to a bitmap */
+		if (!roaring_container_to_bitmap(container)) {
+			return -1;
+		}
+
+		/* Fall through */
+
+	case ROARING_BITMAP:
+		if ((container->words[value >> 5] >> (value & 31)) & 1) {
+			return 0;
+		}
+
+		container->words[value >> 5] |= 1U << (value & 31);
+		++container->cardinality;
+
+		return 1;
+
+	default:
+		index = roaring_run_upper_bound(container, value);
+
+		if (index > 0 && value <= ROARING_RUN_LAST(container, index - 1)) {
+			return 0;
+		}
+
+		extends_prev = index > 0 &&
+		               ROARING_RUN_LAST(container, index - 1) + 1 == value;
+		extends_next = index < container->length &&
+		               ROARING_RUN_START(container, index) == value + 1;
+
+		if (extends_prev && extends_next) {
+			/* The value joins two runs together */
+			container->values[index * 2 - 1] = (unsigned short) (
+			    ROARING_RUN_LAST(container, index) -
+			    ROARING_RUN_START(container, index - 1));
+			memmove(container->values + index * 2,
+			        container->values + index * 2 + 2,
+			        sizeof(unsigned short) * 2 *
+			            (container->length - index - 1));
+			--container->length;
+		} else if (extends_prev) {
+			++container->values[index * 2 - 1];
+		} else if (extends_next) {
+			--container->values[index * 2];
+			++container->values[index * 2 + 1];
+		} else {
+			/* Another run would make the container larger than a
+			 * bitmap, so switch to one */
+			if (ROARING_RUN_BYTES(container->length + 1) >
+			    ROARING_BITMAP_BYTES) {
+				if (!roaring_container_to_bitmap(container)) {
+					return -1;
+				}
+
+				return roaring_container_add(container, value);
+			}
+
+			if (!roaring_container_reserve(container,
+			                               container->length * 2 + 2)) {
+				return -1;
+			}
+
+			memmove(container->values + index * 2 + 2,
+			        container->values + index * 2,
+			        sizeof(unsigned short) * 2 *
+			            (container->length - index));
+			container->values[index * 2] = (unsigned short) value;
+			container->values[index * 2 + 1] = 0;
+			++container->length;
+		}
+
+		++container->cardinality;
+
+		return 1;
+	}
+}
+
+/* Remove a value from a container.  Returns 1 if it was removed, 0 if
+ * it was not present, or -1 if memory could not be allocated. */
+static int roaring_container_delete(RoaringContainer *container,
+                                    unsigned int value)
+{
+	unsigned int index;
+	unsigned int first, last;
+
+	switch (container->type) {
+	case ROARING_ARRAY:
+		index = roaring_lower_bound(container->values,
+		                            container->length, value);
+
+		if (index == container->length ||
+		    container->values[index] != value) {
+			return 0;
+		}
+
+		memmove(container->values + index,
+		        container->values + index + 1,
+		        sizeof(unsigned short) *
+		            (container->length - index - 1));
+		--container->length;
+		break;
+
+	case ROARING_BITMAP:
+		if (((container->words[value >> 5] >> (value & 31)) & 1) == 0) {
+			return 0;
+		}
+
+		container->words[value >> 5] &= ~(1U << (value & 31));
+		--container->cardinality;
+
+		/* Switch back to an array once it is smaller.  If there is
+		 * not enough memory, the bitmap is still valid, and the
+		 * switch is tried again on the next removal. */
+		if (container->cardinality <= ROARING_ARRAY_MAX) {
+			roaring_container_from_words(container, container->words,
+			                             container->cardinality,
+			                             ROARING_ARRAY);
+		}
+
+		return 1;
+
+	default:
+		index = roaring_run_upper_bound(container, value);
+
+		if (index == 0 || value > ROARING_RUN_LAST(container, index - 1)) {
+			return 0;
+		}
+
+		--index;
+		first = ROARING_RUN_START(container, index);
+		last = ROARING_RUN_LAST(container, index);
+
+		if (first == last) {
+			memmove(container->values + index * 2,
+			        container->values + index * 2 + 2,
+			        sizeof(unsigned short) * 2 *
+			            (container->length - index - 1));
+			--container->length;
+		} else if (value == first) {
+			++container->values[index * 2];
+			--container->values[index * 2 + 1];
+		} else if (value == last) {
+			--container->values[index * 2 + 1];
+		} else {
+			/* Splitting the run would make the container larger
+			 * than a bitmap, so switch to one */
+			if (ROARING_RUN_BYTES(container->length + 1) >
+			    ROARING_BITMAP_BYTES) {
+				if (!roaring_container_to_bitmap(container)) {
+					return -1;
+				}
+
+				return roaring_container_delete(container,
+				                                value);
+			}
+
+			/* Split the run in two */
+			if (!roaring_container_reserve(container,
+			                               container->length * 2 + 2)) {
+				return -1;
+			}
+
+			memmove(container->values + index * 2 + 4,
+			        container->values + index * 2 + 2,
+			        sizeof(unsigned short) * 2 *
+			            (container->length - index - 1));
+			container->values[index * 2 + 1] =
+			    (unsigned short) (value - first - 1);
+			container->values[index * 2 + 2] =
+			    (unsigned short) (value + 1);
+			container->values[index * 2 + 3] =
+			    (unsigned short) (last - value - 1);
+			++container->length;
+		}
+		break;
+	}
+
+	--container->cardinality;
+
+	return 1;
+}
+
+/* Count the runs of consecutive values in a container */
+static unsigned int roaring_container_num_runs(const RoaringContainer *container)
+{
+	unsigned int result;
+	unsigned int i;
+
+	switch (container->type) {
+	case ROARING_ARRAY:
+		result = 1;
+
+		for (i = 1; i < container->length; ++i) {
+			if (container->values[i] != container->values[i - 1] + 1) {
+				++result;
+			}
+		}
+
+		return result;
+
+	case ROARING_BITMAP:
+		return roaring_words_num_runs(container->words);
+
+	default:
+		return container->length;
+	}
+}
+
+/* Combine two containers with the same key into a new container.
+ * Returns 1 if the result holds any values, 0 if it is empty, or -1 if
+ * memory could not be allocated. */
+static int roaring_container_combine(RoaringContainer *result,
+                                     const RoaringContainer *container1,
+                                     const RoaringContainer *container2,
+                                     int op)
+{
+	unsigned int words[ROARING_WORDS];
+	unsigned int other_words[ROARING_WORDS];
+	const RoaringContainer *array;
+	const RoaringContainer *other;
+	unsigned int cardinality;
+	unsigned short value;
+	unsigned int i, j;
+	int keep;
+
+	result->key = container1->key;
+	result->type = ROARING_ARRAY;
+	result->words = NULL;
+	result->values = NULL;
+	result->length = 0;
+
+	/* Two arrays are merged, as they are both in order */
+	if (container1->type == ROARING_ARRAY &&
+	    container2->type == ROARING_ARRAY &&
+	    (op != ROARING_UNION ||
+	     container1->length + container2->length <= ROARING_ARRAY_MAX)) {
+		result->capacity = container1->length;
+
+		if (op == ROARING_UNION) {
+			result->capacity += container2->length;
+		}
+
+		result->values = malloc(sizeof(unsigned short) * result->capacity);
+
+		if (result->values == NULL) {
+			return -1;
+		}
+
+		i = 0;
+		j = 0;
+
+		while (i < container1->length || j < container2->length) {
+			if (j == container2->length ||
+			    (i < container1->length &&
+			     container1->values[i] < container2->values[j])) {
+				keep = op != ROARING_INTERSECTION;
+				value = container1->values[i];
+				++i;
+			} else if (i == container1->length ||
+			           container2->values[j] < container1->values[i]) {
+				keep = op == ROARING_UNION;
+				value = container2->values[j];
+				++j;
+			} else {
+				keep = op != ROARING_DIFFERENCE;
+				value = container1->values[i];
+				++i;
+				++j;
+			}
+
+			if (keep) {
+				result->values[result->length] = value;
+				++result->length;
+			}
+		}
+
+		result->cardinality = result->length;
+
+		if (result->length == 0) {
+			free(result->values);
+			return 0;
+		}
+
+		return 1;
+	}
+
+	/* An intersection or difference with an array contains only values
+	 * from the array */
+	if (op != ROARING_UNION && (container1->type == ROARING_ARRAY ||
+	                            container2->type == ROARING_ARRAY)) {
+		if (container1->type == ROARING_ARRAY) {
+			array = container1;
+			other = container2;
+		} else {
+			array = container2;
+			other = container1;
+		}
+
+		if (op == ROARING_INTERSECTION || array == container1) {
+			result->capacity = array->length;
+			result->values =
+			    malloc(sizeof(unsigned short) * result->capacity);
+
+			if (result->values == NULL) {
+				return -1;
+			}
+
+			for (i = 0; i < array->length; ++i) {
+				if (roaring_container_contains(other, array->values[i]) ==
+				    (op == ROARING_INTERSECTION)) {
+					result->values[result->length] = array->values[i];
+					++result->length;
+				}
+			}
+
+			result->cardinality = result->length;
+
+			if (result->length == 0) {
+				free(result->values);
+				return 0;
+			}
+
+			return 1;
+		}
+	}
+
+	/* Otherwise, operate on whole bitmaps */
+	roaring_container_to_words(container1, words);
+
+	if (op == ROARING_UNION) {
+		roaring_container_or_words(container2, words);
+	} else if (op == ROARING_DIFFERENCE && container2->type == ROARING_ARRAY) {
+		for (i = 0; i < container2->length; ++i) {
+			words[container2->values[i] >> 5] &=
+			    ~(1U << (container2->values[i] & 31));
+		}
+	} else {
+		if (container2->type == ROARING_BITMAP) {
+			memcpy(other_words, container2->words, sizeof(other_words));
+		} else {
+			roaring_container_to_words(container2, other_words);
+		}
+
+		if (op == ROARING_INTERSECTION) {
+			roaring_words_and(words, other_words);
+		} else {
+			roaring_words_andnot(words, other_words);
+		}
+	}
+
+	cardinality = roaring_words_popcount(words);
+
+	if (cardinality == 0) {
+		return 0;
+	}
+
+	if (!roaring_container_new_from_words(result, container1->key, words,
+	                                      cardinality)) {
+		return -1;
+	}
+
+	return 1;
+}
+
+RoaringBitmap *roaring_bitmap_new(void)
+{
+	RoaringBitmap *bitmap;
+
+	bitmap = (RoaringBitmap *) malloc(sizeof(RoaringBitmap));
+
+	if (bitmap == NULL) {
+		return NULL;
+	}
+
+	bitmap->containers = NULL;
+	bitmap->num_containers = 0;
+	bitmap->capacity = 0;
+	bitmap->num_entries = 0;
+
+	return bitmap;
+}
+
+void roaring_bitmap_free(RoaringBitmap *bitmap)
+{
+	unsigned int i;
+
+	for (i = 0; i < bitmap->num_containers; ++i) {
+		roaring_container_free(&bitmap->containers[i]);
+	}
+
+	free(bitmap->containers);
+	free(bitmap);
+}
+
+/* Find the index of the first container with a key at or after the
+ * given key. */
+static unsigned int roaring_bitmap_find(RoaringBitmap *bitmap,
+                                        unsigned int key)
+{
+	unsigned int low, high, mid;
+
+	low = 0;
+	high = bitmap->num_containers;
+
+	while (low < high) {
+		mid = (low + high) / 2;
+
+		if (bitmap->containers[mid].key < key) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+
+	return low;
+}
+
+/* Make room for a new container at the given index */
+static int roaring_bitmap_open(RoaringBitmap *bitmap, unsigned int index)
+{
+	RoaringContainer *new_containers;
+	unsigned int new_capacity;
+
+	if (bitmap->num_containers == bitmap->capacity) {
+		new_capacity = bitmap->capacity < 4 ? 4 : bitmap->capacity * 2;
+		new_containers = realloc(bitmap->containers,
+		                         sizeof(RoaringContainer) * new_capacity);
+
+		if (new_containers == NULL) {
+			return 0;
+		}
+
+		bitmap->containers = new_containers;
+		bitmap->capacity = new_capacity;
+	}
+
+	memmove(bitmap->containers + index + 1, bitmap->containers + index,
+	        sizeof(RoaringContainer) * (bitmap->num_containers - index));
+	++bitmap->num_containers;
+
+	return 1;
+}
+
+int roaring_bitmap_insert(RoaringBitmap *bitmap, unsigned int value)
+{
+	RoaringContainer *container;
+	unsigned short *values;
+	unsigned int key;
+	unsigned int index;
+	int result;
+
+	key = value >> 16;
+	index = roaring_bitmap_find(bitmap, key);
+
+	if (index < bitmap->num_containers &&
+	    bitmap->containers[index].key == key) {
+		result = roaring_container_add(&bitmap->containers[index],
+		                               value & 0xffff);
+
+		if (result <= 0) {
+			return 0;
+		}
+
+		++bitmap->num_entries;
+
+		return 1;
+	}
+
+	/* Start a new array container */
+	values = malloc(sizeof(unsigned short) * 4);
+
+	if (values == NULL) {
+		return 0;
+	}
+
+	if (!roaring_bitmap_open(bitmap, index)) {
+		free(values);
+		return 0;
+	}
+
+	container = &bitmap->containers[index];
+	container->key = key;
+	container->type = ROARING_ARRAY;
+	container->cardinality = 1;
+	container->length = 1;
+	container->capacity = 4;
+	container->values = values;
+	container->words = NULL;
+	values[0] = (unsigned short) (value & 0xffff);
+
+	++bitmap->num_entries;
+
+	return 1;
+}
+
+int roaring_bitmap_remove(RoaringBitmap *bitmap, unsigned int value)
+{
+	RoaringContainer *container;
+	unsigned int index;
+
+	index = roaring_bitmap_find(bitmap, value >> 16);
+
+	if (index == bitmap->num_containers ||
+	    bitmap->containers[index].key != value >> 16) {
+		return 0;
+	}
+
+	container = &bitmap->containers[index];
+
+	if (roaring_container_delete(container, value & 0xffff) <= 0) {
+		return 0;
+	}
+
+	--bitmap->num_entries;
+
+	/* Containers are never left empty */
+	if (container->cardinality == 0) {
+		roaring_container_free(container);
+		memmove(bitmap->containers + index,
+		        bitmap->containers + index + 1,
+		        sizeof(RoaringContainer) *
+		            (bitmap->num_containers - index - 1));
+		--bitmap->num_containers;
+	}
+
+	return 1;
+}
+
+int roaring_bitmap_query(RoaringBitmap *bitmap, unsigned int value)
+{
+	unsigned int index;
+
+	index = roaring_bitmap_find(bitmap, value >> 16);
+
+	return index < bitmap->num_containers &&
+	       bitmap->containers[index].key == value >> 16 &&
+	       roaring_container_contains(&bitmap->containers[index],
+	                                  value & 0xffff);
+}
+
+unsigned long roaring_bitmap_num_entries(RoaringBitmap *bitmap)
+{
+	/* Where unsigned long is only 32 bits wide, the count for a bitmap
+	 * holding every unsigned int wraps around to zero.  A bitmap with
+	 * any containers is never empty, so this can be told apart. */
+	if (bitmap->num_entries == 0 && bitmap->num_containers > 0) {
+		return ULONG_MAX;
+	}
+
+	return bitmap->num_entries;
+}
+
+int roaring_bitmap_optimize(RoaringBitmap *bitmap)
+{
+	unsigned int words[ROARING_WORDS];
+	RoaringContainer *container;
+	unsigned long array_bytes;
+	unsigned long run_bytes;
+	unsigned int i;
+	int type;
+
+	for (i = 0; i < bitmap->num_containers; ++i) {
+		container = &bitmap->containers[i];
+
+		run_bytes = ROARING_RUN_BYTES(roaring_container_num_runs(container));
+
+		if (container->cardinality <= ROARING_ARRAY_MAX) {
+			array_bytes = ROARING_ARRAY_BYTES(container->cardinality);
+		} else {
+			array_bytes = ROARING_BITMAP_BYTES + 1;
+		}
+
+		if (run_bytes < array_bytes && run_bytes < ROARING_BITMAP_BYTES) {
+			type = ROARING_RUN;
+		} else if (array_bytes <= ROARING_BITMAP_BYTES) {
+			type = ROARING_ARRAY;
+		} else {
+			type = ROARING_BITMAP;
+		}
+
+		if (type == container->type) {
+			continue;
+		}
+
+		roaring_container_to_words(container, words);
+
+		if (!roaring_container_from_words(container, words,
+		                                  container->cardinality, type)) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+unsigned int *roaring_bitmap_to_array(RoaringBitmap *bitmap)
+{
+	RoaringContainer *container;
+	unsigned int *array;
+	unsigned long array_counter;
+	unsigned int high;
+	unsigned int value;
+	unsigned int last;
+	unsigned int i, j;
+
+	/* The size of the array may not fit in a size_t */
+	if (roaring_bitmap_num_entries(bitmap) >
+	    ((size_t) -1) / sizeof(unsigned int)) {
+		return NULL;
+	}
+
+	array = malloc(sizeof(unsigned int) * bitmap->num_entries);
+
+	if (array == NULL) {
+		return NULL;
+	}
+
+	array_counter = 0;
+
+	for (i = 0; i < bitmap->num_containers; ++i) {
+		container = &bitmap->containers[i];
+		high = container->key << 16;
+
+		switch (container->type) {
+		case ROARING_ARRAY:
+			for (j = 0; j < container->length; ++j) {
+				array[array_counter] = high | container->values[j];
+				++array_counter;
+			}
+			break;
+
+		case ROARING_BITMAP:
+			for (j = 0; j < ROARING_WORDS; ++j) {
+				value = container->words[j];
+
+				while (value != 0) {
+					array[array_counter] =
+					    high | (j << 5) | roaring_lowest_bit(value);
+					++array_counter;
+					value &= value - 1;
+				}
+			}
+			break;
+
+		default:
+			for (j = 0; j < container->length; ++j) {
+				last = ROARING_RUN_LAST(container, j);
+
+				for (value = ROARING_RUN_START(container, j);
+				     value <= last; ++value) {
+					array[array_counter] = high | value;
+					++array_counter;
+				}
+			}
+			break;
+		}
+	}
+
+	return array;
+}
+
+/* Add a container to the end of a bitmap being built up in order */
+static int roaring_bitmap_append(RoaringBitmap *bitmap,
+                                 RoaringContainer *container)
+{
+	if (!roaring_bitmap_open(bitmap, bitmap->num_containers)) {
+		return 0;
+	}
+
+	bitmap->containers[bitmap->num_containers - 1] = *container;
+	bitmap->num_entries += container->cardinality;
+
+	return 1;
+}
+
+/* Walk through the containers of both bitmaps in order of their keys,
+ * combining those with the same key and copying those that are only in
+ * one bitmap, where the operation keeps them. */
+static RoaringBitmap *roaring_bitmap_combine(RoaringBitmap *bitmap1,
+                                             RoaringBitmap *bitmap2, int op)
+{
+	RoaringBitmap *new_bitmap;
+	RoaringContainer container;
+	RoaringContainer *container1;
+	RoaringContainer *container2;
+	unsigned int i, j;
+	int result;
+
+	new_bitmap = roaring_bitmap_new();
+
+	if (new_bitmap == NULL) {
+		return NULL;
+	}
+
+	i = 0;
+	j = 0;
+
+	while (i < bitmap1->num_containers || j < bitmap2->num_containers) {
+		container1 = i < bitmap1->num_containers ?
+		                 &bitmap1->containers[i] : NULL;
+		container2 = j < bitmap2->num_containers ?
+		                 &bitmap2->containers[j] : NULL;
+
+		if (container2 == NULL ||
+		    (container1 != NULL && container1->key < container2->key)) {
+			++i;
+
+			if (op == ROARING_INTERSECTION) {
+				continue;
+			}
+
+			result = roaring_container_copy(&container, container1)
+			             ? 1 : -1;
+		} else if (container1 == NULL ||
+		           container2->key < container1->key) {
+			++j;
+
+			if (op != ROARING_UNION) {
+				continue;
+			}
+
+			result = roaring_container_copy(&container, container2)
+			             ? 1 : -1;
+		} else {
+			++i;
+			++j;
+			result = roaring_container_combine(&container, container1,
+			                                   container2, op);
+		}
+
+		if (result == 0) {
+			continue;
+		}
+
+		if (result < 0 || !roaring_bitmap_append(new_bitmap, &container)) {
+			if (result > 0) {
+				roaring_container_free(&container);
+			}
+
+			roaring_bitmap_free(new_bitmap);
+			return NULL;
+		}
+	}
+
+	return new_bitmap;
+}
+
+RoaringBitmap *roaring_bitmap_union(RoaringBitmap *bitmap1,
+                                    RoaringBitmap *bitmap2)
+{
+	return roaring_bitmap_combine(bitmap1, bitmap2, ROARING_UNION);
+}
+
+RoaringBitmap *roaring_bitmap_intersection(RoaringBitmap *bitmap1,
+                                           RoaringBitmap *bitmap2)
+{
+	return roaring_bitmap_combine(bitmap1, bitmap2, ROARING_INTERSECTION);
+}
+
+RoaringBitmap *roaring_bitmap_difference(RoaringBitmap *bitmap1,
+                                         RoaringBitmap *bitmap2)
+{
+	return roaring_bitmap_combine(bitmap1, bitmap2, ROARING_DIFFERENCE);
+}
+
+/* Find the first value in a bitmap at or after the given value */
+static int roaring_bitmap_next(RoaringBitmap *bitmap, unsigned int value,
+                               unsigned int *result)
+{
+	RoaringContainer *container;
+	unsigned int index;
+	unsigned int low;
+
+	index = roaring_bitmap_find(bitmap, value >> 16);
+	low = value & 0xffff;
+
+	for (; index < bitmap->num_containers; ++index) {
+		container = &bitmap->containers[index];
+
+		if (container->key != value >> 16) {
+			low = 0;
+		}
+
+		if (roaring_container_next(container, low, result)) {
+			*result |= container->key << 16;
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+void roaring_bitmap_iterate(RoaringBitmap *bitmap,
+                            RoaringBitmapIterator *iter)
+{
+	iter->bitmap = bitmap;
+	iter->has_more = roaring_bitmap_next(bitmap, 0, &iter->next_value);
+}
+
+int roaring_bitmap_iter_has_more(RoaringBitmapIterator *iterator)
+{
+	return iterator->has_more;
+}
+
+unsigned int roaring_bitmap_iter_next(RoaringBitmapIterator *iterator)
+{
+	unsigned int result;
+
+	if (!iterator->has_more) {
+		return 0;
+	}
+
+	/* Look ahead to the following value now, so that the value being
+	 * returned can be removed. */
+	result = iterator->next_value;
+
+	if (result == ROARING_WORD_MASK) {
+		iterator->has_more = 0;
+	} else {
+		iterator->has_more = roaring_bitmap_next(iterator->bitmap,
+		                                         result + 1,
+		                                         &iterator->next_value);
+	}
+
+	return result;
+}
+
+/* Serialized format, with all integers in little-endian byte order:
+ *
+ *   4 bytes   ROARING_COOKIE
+ *   4 bytes   number of containers
+ *
+ * then for each container, in increasing order of key:
+ *
+ *   2 bytes   key
+ *   1 byte    type
+ *   4 bytes   number of values (array) or runs (run), or zero (bitmap)
+ *   ...       2 bytes per value (array), 8192 bytes of bits with the
+ *             lowest value in the least significant bit of the first
+ *             byte (bitmap), or 2 bytes for the first value and 2 bytes
+ *             for the length minus one of each run (run)
+ */
+
+#define ROARING_HEADER_SIZE    8
+#define ROARING_CONTAINER_SIZE 7
+
+static unsigned char *roaring_write16(unsigned char *buffer, unsigned int value)
+{
+	buffer[0] = (unsigned char) (value & 0xff);
+	buffer[1] = (unsigned char) ((value >> 8) & 0xff);
+
+	return buffer + 2;
+}
+
+static unsigned char *roaring_write32(unsigned char *buffer,
+                                      unsigned long value)
+{
+	buffer = roaring_write16(buffer, (unsigned int) (value & 0xffff));
+
+	return roaring_write16(buffer, (unsigned int) ((value >> 16) & 0xffff));
+}
+
+static unsigned int roaring_read16(const unsigned char *buffer)
+{
+	return (unsigned int) buffer[0] | ((unsigned int) buffer[1] << 8);
+}
+
+static unsigned long roaring_read32(const unsigned char *buffer)
+{
+	return (unsigned long) roaring_read16(buffer) |
+	       ((unsigned long) roaring_read16(buffer + 2) << 16);
+}
+
+/* Size of the data following a container's header */
+static size_t roaring_container_data_size(int type, unsigned long length)
+{
+	switch (type) {
+	case ROARING_ARRAY:
+		return (size_t) ROARING_ARRAY_BYTES(length);
+	case ROARING_BITMAP:
+		return (size_t) ROARING_BITMAP_BYTES;
+	default:
+		return (size_t) ROARING_RUN_BYTES(length);
+	}
+}
+
+size_t roaring_bitmap_serialized_size(RoaringBitmap *bitmap)
+{
+	RoaringContainer *container;
+	size_t result;
+	unsigned int i;
+
+	result = ROARING_HEADER_SIZE;
+
+	for (i = 0; i < bitmap->num_containers; ++i) {
+		container = &bitmap->containers[i];
+		result += ROARING_CONTAINER_SIZE +
+		          roaring_container_data_size(container->type,
+		                                      container->length);
+	}
+
+	return result;
+}
+
+size_t roaring_bitmap_serialize(RoaringBitmap *bitmap, unsigned char *buffer)
+{
+	RoaringContainer *container;
+	unsigned char *p;
+	unsigned int i, j;
+
+	p = roaring_write32(buffer, ROARING_COOKIE);
+	p = roaring_write32(p, bitmap->num_containers);
+
+	for (i = 0; i < bitmap->num_containers; ++i) {
+		container = &bitmap->containers[i];
+
+		p = roaring_write16(p, container->key);
+		*p = (unsigned char) container->type;
+		++p;
+		p = roaring_write32(p, container->length);
+
+		if (container->type == ROARING_BITMAP) {
+			for (j = 0; j < ROARING_WORDS; ++j) {
+				p = roaring_write32(p, container->words[j]);
+			}
+		} else if (container->type == ROARING_ARRAY) {
+			for (j = 0; j < container->length; ++j) {
+				p = roaring_write16(p, container->values[j]);
+			}
+		} else {
+			for (j = 0; j < container->length * 2; ++j) {
+				p = roaring_write16(p, container->values[j]);
+			}
+		}
+	}
+
+	return (size_t) (p - buffer);
+}
+
+/* Read the data of a container and check that it is valid */
+static int roaring_container_read(RoaringContainer *container,
+                                  const unsigned char *p)
+{
+	unsigned int previous;
+	unsigned int first, last;
+	unsigned int i;
+
+	container->cardinality = 0;
+	container->capacity = 0;
+
+	if (container->type == ROARING_BITMAP) {
+		container->words = malloc(sizeof(unsigned int) * ROARING_WORDS);
+
+		if (container->words == NULL) {
+			return 0;
+		}
+
+		for (i = 0; i < ROARING_WORDS; ++i) {
+			container->words[i] = (unsigned int) roaring_read32(p + i * 4);
+		}
+
+		container->cardinality = roaring_words_popcount(container->words);
+
+		if (container->cardinality == 0) {
+			return 0;
+		}
+
+		/* A bitmap with few values is stored as an array, as it
+		 * would have been if the values had been inserted */
+		if (container->cardinality <= ROARING_ARRAY_MAX) {
+			return roaring_container_from_words(
+			    container, container->words, container->cardinality,
+			    ROARING_ARRAY);
+		}
+
+		return 1;
+	}
+
+	if (container->type == ROARING_ARRAY) {
+		container->capacity = container->length;
+	} else {
+		container->capacity = container->length * 2;
+	}
+
+	container->values = malloc(sizeof(unsigned short) * container->capacity);
+
+	if (container->values == NULL) {
+		return 0;
+	}
+
+	for (i = 0; i < container->capacity; ++i) {
+		container->values[i] = (unsigned short) roaring_read16(p + i * 2);
+	}
+
+	/* Values must be in increasing order, and runs must not overlap,
+	 * touch or extend beyond the end of the container */
+	previous = 0;
+
+	for (i = 0; i < container->length; ++i) {
+		if (container->type == ROARING_ARRAY) {
+			first = container->values[i];
+			last = first;
+		} else {
+			first = ROARING_RUN_START(container, i);
+			last = ROARING_RUN_LAST(container, i);
+		}
+
+		if ((i > 0 && first <= previous + (container->type == ROARING_RUN))
+		    || last > 0xffff) {
+			return 0;
+		}
+
+		container->cardinality += last - first + 1;
+		previous = last;
+	}
+
+	return 1;
+}
+
+RoaringBitmap *roaring_bitmap_deserialize(const unsigned char *buffer,
+                                          size_t length)
+{
+	RoaringBitmap *bitmap;
+	RoaringContainer container;
+	const unsigned char *p;
+	const unsigned char *end;
+	unsigned long num_containers;
+	unsigned long container_length;
+	size_t data_size;
+	unsigned long i;
+
+	if (length < ROARING_HEADER_SIZE ||
+	    roaring_read32(buffer) != ROARING_COOKIE) {
+		return NULL;
+	}
+
+	num_containers = roaring_read32(buffer + 4);
+
+	if (num_containers > 65536) {
+		return NULL;
+	}
+
+	bitmap = roaring_bitmap_new();
+
+	if (bitmap == NULL) {
+		return NULL;
+	}
+
+	p = buffer + ROARING_HEADER_SIZE;
+	end = buffer + length;
+
+	for (i = 0; i < num_containers; ++i) {
+		if ((size_t) (end - p) < ROARING_CONTAINER_SIZE) {
+			break;
+		}
+
+		container.key = roaring_read16(p);
+		container.type = p[2];
+		container_length = roaring_read32(p + 3);
+		container.values = NULL;
+		container.words = NULL;
+		p += ROARING_CONTAINER_SIZE;
+
+		/* Check the header before allocating anything */
+		if ((bitmap->num_containers > 0 &&
+		     container.key <=
+		         bitmap->containers[bitmap->num_containers - 1].key) ||
+		    container.type > ROARING_RUN ||
+		    (container.type == ROARING_BITMAP && container_length != 0) ||
+		    (container.type == ROARING_ARRAY &&
+		     (container_length == 0 ||
+		      container_length > ROARING_ARRAY_MAX)) ||
+		    (container.type == ROARING_RUN &&
+		     (container_length == 0 || container_length > 32768))) {
+			break;
+		}
+
+		container.length = (unsigned int) container_length;
+		data_size = roaring_container_data_size(container.type,
+		                                        container_length);
+
+		if ((size_t) (end - p) < data_size) {
+			break;
+		}
+
+		if (!roaring_container_read(&container, p) ||
+		    !roaring_bitmap_append(bitmap, &container)) {
+			roaring_container_free(&container);
+			break;
+		}
+
+		p += data_size;
+	}
+
+	if (i < num_containers) {
+		roaring_bitmap_free(bitmap);
+		return NULL;
+	}
+
+	return bitmap;
+}
@@ -0,0 +1,290 @@
+/*
+
+Copyright (c) 2026 Simon Howard
+
+Permission to use, copy, modify, and/or distribute this software
+for any purpose with or without fee is hereby granted, provided
+that the above copyright notice and this permission notice appear
+in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT,
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+ */
+
+/**
+ * @file roaring-bitmap.h
+ *
+ * @brief Compressed set of 32-bit unsigned integers.
+ *
+ * A roaring bitmap stores a set of unsigned integers, each of which can
+ * only exist once in the set.  It is far smaller than a @ref Set or an
+ * @ref IntSet when the values are clustered together, as with dense
+ * ranges of identifiers.
+ *
+ * Values are grouped into containers of 65536 by their upper 16 bits.
+ * Each container stores the lower 16 bits of its values in whichever of
+ * three forms suits them: a sorted array when there are few values, a
+ * bitmap with one bit for every possible value when there are many, or
+ * a list of runs of consecutive values.  Run containers are only created
+ * by @ref roaring_bitmap_optimize, which should be called once a bitmap
+ * has been filled.
+ *
+ * To create a new roaring bitmap, use @ref roaring_bitmap_new.  To
+ * destroy one, use @ref roaring_bitmap_free.
+ *
+ * To add a value, use @ref roaring_bitmap_insert.  To remove a value,
+ * use @ref roaring_bitmap_remove.  To query if a value is present, use
+ * @ref roaring_bitmap_query.
+ *
+ * The number of values in the set is kept up to date as values are
+ * added and removed, and is read using @ref roaring_bitmap_num_entries.
+ *
+ * To iterate over the values in increasing order, use
+ * @ref roaring_bitmap_iterate to initialise a
+ * @ref RoaringBitmapIterator structure, with
+ * @ref roaring_bitmap_iter_next and @ref roaring_bitmap_iter_has_more to
+ * read each value in turn.
+ *
+ * Sets are combined using @ref roaring_bitmap_union,
+ * @ref roaring_bitmap_intersection and @ref roaring_bitmap_difference.
+ *
+ * A bitmap can be saved to a buffer using @ref roaring_bitmap_serialize
+ * and recreated using @ref roaring_bitmap_deserialize.
+ */
+
+#ifndef ALGORITHM_ROARING_BITMAP_H
+#define ALGORITHM_ROARING_BITMAP_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Represents a roaring bitmap.  Created using the
+ * @ref roaring_bitmap_new function and destroyed using the
+ * @ref roaring_bitmap_free function.
+ */
+typedef struct _RoaringBitmap RoaringBitmap;
+
+/**
+ * An object used to iterate over a roaring bitmap.
+ *
+ * @see roaring_bitmap_iterate
+ */
+typedef struct _RoaringBitmapIterator RoaringBitmapIterator;
+
+/**
+ * Definition of a @ref RoaringBitmapIterator.
+ */
+struct _RoaringBitmapIterator {
+	RoaringBitmap *bitmap;
+	unsigned int next_value;
+	int has_more;
+};
+
+/**
+ * Create a new, empty roaring bitmap.
+ *
+ * @return               A new bitmap, or NULL if it was not possible to
+ *                       allocate the memory for the bitmap.
+ */
+RoaringBitmap *roaring_bitmap_new(void);
+
+/**
+ * Destroy a roaring bitmap.
+ *
+ * @param bitmap         The bitmap to destroy.
+ */
+void roaring_bitmap_free(RoaringBitmap *bitmap);
+
+/**
+ * Add a value to a roaring bitmap.
+ *
+ * @param bitmap         The bitmap.
+ * @param value          The value to add.
+ * @return               Non-zero (true) if the value was added, zero
+ *                       (false) if it was already present, or if it was
+ *                       not possible to allocate memory for it.
+ */
+int roaring_bitmap_insert(RoaringBitmap *bitmap, unsigned int value);
+
+/**
+ * Remove a value from a roaring bitmap.
+ *
+ * @param bitmap         The bitmap.
+ * @param value          The value to remove.
+ * @return               Non-zero (true) if the value was found and
+ *                       removed, zero (false) if it was not present, or
+ *                       if removing it from the middle of a run needed
+ *                       memory that could not be allocated.
+ */
+int roaring_bitmap_remove(RoaringBitmap *bitmap, unsigned int value);
+
+/**
+ * Query if a particular value is in a roaring bitmap.
+ *
+ * @param bitmap         The bitmap.
+ * @param value          The value to query for.
+ * @return               Zero if the value is not present, non-zero if it
+ *                       is present.
+ */
+int roaring_bitmap_query(RoaringBitmap *bitmap, unsigned int value);
+
+/**
+ * Retrieve the number of values in a roaring bitmap.  This does not
+ * need to examine the values, so takes constant time.
+ *
+ * @param bitmap         The bitmap.
+ * @return               The number of values in the bitmap.  This is an
+ *                       unsigned long, as a bitmap can hold every
+ *                       possible unsigned int.  Where unsigned long is
+ *                       only 32 bits wide, that is one more than it can
+ *                       hold, and ULONG_MAX is returned for a bitmap
+ *                       holding every unsigned int.
+ */
+unsigned long roaring_bitmap_num_entries(RoaringBitmap *bitmap);
+
+/**
+ * Convert each container in a roaring bitmap to whichever form uses the
+ * least memory, storing runs of consecutive values as runs.  This should
+ * be called after filling a bitmap with long ranges of values.
+ *
+ * @param bitmap         The bitmap.
+ * @return               Non-zero (true) on success, or zero (false) if
+ *                       it was not possible to allocate memory.  The
+ *                       bitmap is unchanged, but may not be fully
+ *                       compressed, if this fails.
+ */
+int roaring_bitmap_optimize(RoaringBitmap *bitmap);
+
+/**
+ * Create an array containing all values in a roaring bitmap, in
+ * increasing order.
+ *
+ * @param bitmap         The bitmap.
+ * @return               An array containing all values in the bitmap, or
+ *                       NULL if it was not possible to allocate memory
+ *                       for the array, or its size does not fit in a
+ *                       size_t.
+ */
+unsigned int *roaring_bitmap_to_array(RoaringBitmap *bitmap);
+
+/**
+ * Perform a union of two roaring bitmaps.
+ *
+ * @param bitmap1        The first bitmap.
+ * @param bitmap2        The second bitmap.
+ * @return               A new bitmap containing all values which are in
+ *                       either bitmap, or NULL if it was not possible to
+ *                       allocate memory for the new bitmap.
+ */
+RoaringBitmap *roaring_bitmap_union(RoaringBitmap *bitmap1,
+                                    RoaringBitmap *bitmap2);
+
+/**
+ * Perform an intersection of two roaring bitmaps.
+ *
+ * @param bitmap1        The first bitmap.
+ * @param bitmap2        The second bitmap.
+ * @return               A new bitmap containing all values which are in
+ *                       both bitmaps, or NULL if it was not possible to
+ *                       allocate memory for the new bitmap.
+ */
+RoaringBitmap *roaring_bitmap_intersection(RoaringBitmap *bitmap1,
+                                           RoaringBitmap *bitmap2);
+
+/**
+ * Find the difference of two roaring bitmaps.
+ *
+ * @param bitmap1        The first bitmap.
+ * @param bitmap2        The second bitmap.
+ * @return               A new bitmap containing all values which are in
+ *                       the first bitmap but not the second, or NULL if
+ *                       it was not possible to allocate memory for the
+ *                       new bitmap.
+ */
+RoaringBitmap *roaring_bitmap_difference(RoaringBitmap *bitmap1,
+                                         RoaringBitmap *bitmap2);
+
+/**
+ * Initialise a @ref RoaringBitmapIterator structure to iterate over the
+ * values in a roaring bitmap, in increasing order.  The value most
+ * recently returned by the iterator may be removed from the bitmap
+ * without disturbing the iteration.
+ *
+ * @param bitmap         The bitmap to iterate over.
+ * @param iter           Pointer to an iterator structure to initialise.
+ */
+void roaring_bitmap_iterate(RoaringBitmap *bitmap,
+                            RoaringBitmapIterator *iter);
+
+/**
+ * Determine if there are more values in a roaring bitmap to iterate
+ * over.
+ *
+ * @param iterator       The iterator.
+ * @return               Zero if there are no more values to iterate
+ *                       over, non-zero if there are more values to be
+ *                       read.
+ */
+int roaring_bitmap_iter_has_more(RoaringBitmapIterator *iterator);
+
+/**
+ * Using a roaring bitmap iterator, retrieve the next value.
+ *
+ * @param iterator       The iterator.
+ * @return               The next value from the bitmap, or zero if no
+ *                       more values are available.
+ */
+unsigned int roaring_bitmap_iter_next(RoaringBitmapIterator *iterator);
+
+/**
+ * Find the number of bytes needed to serialize a roaring bitmap.
+ *
+ * @param bitmap         The bitmap.
+ * @return               The size of the buffer that must be passed to
+ *                       @ref roaring_bitmap_serialize.
+ */
+size_t roaring_bitmap_serialized_size(RoaringBitmap *bitmap);
+
+/**
+ * Write the contents of a roaring bitmap to a buffer.  The format does
+ * not depend on the byte order or word size of the machine, and each
+ * container is written in its current form, so calling
+ * @ref roaring_bitmap_optimize first gives the smallest output.
+ *
+ * @param bitmap         The bitmap.
+ * @param buffer         The buffer to write to, which must be at least
+ *                       @ref roaring_bitmap_serialized_size bytes long.
+ * @return               The number of bytes written.
+ */
+size_t roaring_bitmap_serialize(RoaringBitmap *bitmap,
+                                unsigned char *buffer);
+
+/**
+ * Create a roaring bitmap from the output of
+ * @ref roaring_bitmap_serialize.
+ *
+ * @param buffer         The buffer to read from.
+ * @param length         The length of the buffer, in bytes.
+ * @return               A new bitmap, or NULL if the buffer does not hold
+ *                       a valid bitmap or if it was not possible to
+ *                       allocate memory for it.
+ */
+RoaringBitmap *roaring_bitmap_deserialize(const unsigned char *buffer,
+                                          size_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef ALGORITHM_ROARING_BITMAP_H */
@@ -34,16 +34,81 @@ struct _SetEntry {
 	SetEntry *next;
 };
 
+/* Pooled sets allocate their entries from slabs, each holding twice as
+ * many entries as the last up to a maximum. */
+#define SET_MIN_SLAB_ENTRIES 32
+#define SET_MAX_SLAB_ENTRIES 8192
+
+typedef struct _SetSlab SetSlab;
+
+struct _SetSlab {
+	SetSlab *next;
+	unsigned int capacity;
+	SetEntry entries[1];
+};
+
+/* A slot in a Robin Hood set.  dist is one more than the number of slots
+ * between the slot the value hashes to and the slot it is stored in, or
+ * zero if the slot is empty.  The mixed hash of the value is kept so
+ * that most values which do not match can be skipped without calling
+ * the comparison function, and so that the set can be enlarged without
+ * calling the hash function again. */
+typedef struct {
+	SetValue data;
+	unsigned int hash;
+	unsigned int dist;
+} SetSlot;
+
+/* Robin Hood sets are enlarged when they become 7/8 full */
+#define SET_ROBIN_HOOD_LOAD(table_size) ((table_size) - (table_size) / 8)
+
 struct _Set {
 	SetEntry **table;
+	SetSlot *slots;
 	unsigned int entries;
 	unsigned int table_size;
 	unsigned int prime_index;
 	SetHashFunc hash_func;
 	SetEqualFunc equal_func;
 	SetFreeFunc free_func;
+	unsigned int flags;
+
+	/* Used by pooled sets only.  New entries are carved from the first
+	 * slab in the list, which has slab_used of its slab_capacity
+	 * entries in use.  Removed entries are kept on a free list, linked
+	 * through their next pointers, to be reused first. */
+	SetSlab *slabs;
+	SetEntry *free_entries;
+	unsigned int slab_used;
+	unsigned int slab_capacity;
+
+	/* Number of times the table has been enlarged */
+	unsigned int resizes;
+
+#ifdef SET_STATISTICS
+	/* Number of searches for a value, the total number of entries
+	 * examined by them, and the most examined by any one search.
+	 * search_probes counts the entries examined by the search in
+	 * progress. */
+	unsigned long searches;
+	unsigned long probes;
+	unsigned int max_probes;
+	unsigned int search_probes;
+#endif
 };
 
+/* Statistics on searches are only gathered if the library is built with
+ * SET_STATISTICS defined, as they add to the cost of every search. */
+#ifdef SET_STATISTICS
+#define SET_SEARCH_BEGIN(set) ((set)->search_probes = 0)
+#define SET_SEARCH_PROBE(set) (++(set)->search_probes)
+#define SET_SEARCH_END(set) set_search_end(set)
+#else
+#define SET_SEARCH_BEGIN(set) ((void) 0)
+#define SET_SEARCH_PROBE(set) ((void) 0)
+#define SET_SEARCH_END(set) ((void) 0)
+#endif
+
 /* This is a set of good hash table prime numbers, from:
  *   http://planetmath.org/encyclopedia/GoodHashTablePrimes.html
  * Each prime is roughly double the previous value, and as far as
@@ -60,16 +125,60 @@ static const unsigned int set_num_primes = sizeof(set_primes) / sizeof(int);
 /* Null value that can be returned without creating a local variable */
 static const SetValue set_null_value = SET_NULL;
 
-static int set_allocate_table(Set *set)
+#ifdef SET_STATISTICS
+static void set_search_end(Set *set)
+{
+	++set->searches;
+	set->probes += set->search_probes;
+
+	if (set->search_probes > set->max_probes) {
+		set->max_probes = set->search_probes;
+	}
+}
+#endif
+
+/* Determine the table size for the given prime index.  An attempt is
+ * made here to ensure sensible behavior if the maximum prime is exceeded,
+ * but in practice other things are likely to break long before that
+ * happens. */
+static unsigned int set_size_for_index(Set *set, unsigned int prime_index)
+{
+	if ((set->flags & (SET_POWER_OF_TWO | SET_ROBIN_HOOD)) != 0) {
+		if (prime_index < 24) {
+			return 256U << prime_index;
+		} else {
+			return 1U << 31;
+		}
+	} else if (prime_index < set_num_primes) {
+		return set_primes[prime_index];
+	} else {
+		return set->entries * 10;
+	}
+}
+
+/* Determine whether a table of the given size can hold num_entries
+ * values without being enlarged */
+static int set_size_fits(Set *set, unsigned int table_size,
+                         unsigned int num_entries)
 {
-	/* Determine the table size based on the current prime index.
-	 * An attempt is made here to ensure sensible behavior if the
-	 * maximum prime is exceeded, but in practice other things are
-	 * likely to break long before that happens. */
-	if (set->prime_index < set_num_primes) {
-		set->table_size = set_primes[set->prime_index];
+	if ((set->flags & SET_ROBIN_HOOD) != 0) {
+		return num_entries <= SET_ROBIN_HOOD_LOAD(table_size);
 	} else {
-		set->table_size = set->entries * 10;
+		return num_entries == 0 ||
+		       num_entries - 1 <= (table_size - 1) / 3;
+	}
+}
+
+static int set_allocate_table(Set *set)
+{
+	set->table_size = set_size_for_index(set, set->prime_index);
+
+	/* A Robin Hood set has an array of slots instead, where a zero
+	 * dist marks an empty slot */
+	if ((set->flags & SET_ROBIN_HOOD) != 0) {
+		set->slots = calloc(set->table_size, sizeof(SetSlot));
+
+		return set->slots != NULL;
 	}
 
 	/* Allocate the table and initialise to NULL */
@@ -78,6 +187,82 @@ static int set_allocate_table(Set *set)
 	return set->table != NULL;
 }
 
+/* Scramble the bits of a hash value before it is masked to find a chain
+ * in a power-of-two sized table.  Masking only uses the low bits of the
+ * hash, so hash functions that only vary in their high bits (such as
+ * pointer_hash) must be mixed first.  This is the finalizer from
+ * MurmurHash3. */
+static unsigned int set_mix(unsigned int hash)
+{
+	hash ^= hash >> 16;
+	hash *= 0x85ebca6bU;
+	hash ^= hash >> 13;
+	hash *= 0xc2b2ae35U;
+	hash ^= hash >> 16;
+
+	return hash;
+}
+
+/* Find the chain that a value belongs to */
+static unsigned int set_chain_index(Set *set, SetValue data)
+{
+	unsigned int hash;
+
+	hash = set->hash_func(data);
+
+	if ((set->flags & SET_POWER_OF_TWO) != 0) {
+		return set_mix(hash) & (set->table_size - 1);
+	} else {
+		return hash % set->table_size;
+	}
+}
+
+static SetEntry *set_alloc_entry(Set *set)
+{
+	SetEntry *entry;
+	SetSlab *slab;
+	unsigned int capacity;
+
+	if ((set->flags & SET_POOLED) == 0) {
+		return (SetEntry *) malloc(sizeof(SetEntry));
+	}
+
+	/* Reuse a removed entry if there is one */
+	if (set->free_entries != NULL) {
+		entry = set->free_entries;
+		set->free_entries = entry->next;
+
+		return entry;
+	}
+
+	/* Start a new slab if the current one is full */
+	if (set->slabs == NULL || set->slab_used == set->slab_capacity) {
+
+		if (set->slabs == NULL) {
+			capacity = SET_MIN_SLAB_ENTRIES;
+		} else if (set->slab_capacity < SET_MAX_SLAB_ENTRIES) {
+			capacity = set->slab_capacity * 2;
+		} else {
+			capacity = SET_MAX_SLAB_ENTRIES;
+		}
+
+		slab = malloc(sizeof(SetSlab) +
+		              (capacity - 1) * sizeof(SetEntry));
+
+		if (slab == NULL) {
+			return NULL;
+		}
+
+		slab->next = set->slabs;
+		slab->capacity = capacity;
+		set->slabs = slab;
+		set->slab_used = 0;
+		set->slab_capacity = capacity;
+	}
+
+	return &set->slabs->entries[set->slab_used++];
+}
+
 static void set_free_entry(Set *set, SetEntry *entry)
 {
 	/* If there is a free function registered, call it to free the
@@ -86,11 +271,218 @@ static void set_free_entry(Set *set, SetEntry *entry)
 		set->free_func(entry->data);
 	}
 
-	/* Free the entry structure */
-	free(entry);
+	/* Free the entry structure, or keep it to be reused if it belongs
+	 * to a slab */
+	if ((set->flags & SET_POOLED) != 0) {
+		entry->next = set->free_entries;
+		set->free_entries = entry;
+	} else {
+		free(entry);
+	}
+}
+
+/* Find the slot holding a value in a Robin Hood set, or return
+ * set->table_size if it is not present.  Values are stored in order of
+ * their distance from their own slot, so the search can stop at the
+ * first slot holding a value closer to its own slot than the value
+ * being searched for would be. */
+static unsigned int set_rh_find(Set *set, SetValue data, unsigned int hash)
+{
+	SetSlot *slot;
+	unsigned int mask;
+	unsigned int index;
+	unsigned int dist;
+
+	mask = set->table_size - 1;
+	index = hash & mask;
+	SET_SEARCH_BEGIN(set);
+
+	for (dist = 1;; ++dist) {
+		slot = &set->slots[index];
+		SET_SEARCH_PROBE(set);
+
+		if (slot->dist < dist) {
+			break;
+		}
+
+		if (slot->hash == hash && set->equal_func(data, slot->data) != 0) {
+			SET_SEARCH_END(set);
+			return index;
+		}
+
+		index = (index + 1) & mask;
+	}
+
+	SET_SEARCH_END(set);
+
+	return set->table_size;
+}
+
+/* Store a value which is known not to be present in a Robin Hood set.
+ * Whenever a value is found which is closer to its own slot than the
+ * value being placed, the two are swapped and the displaced value is
+ * placed further along instead. */
+static void set_rh_place(Set *set, SetValue data, unsigned int hash)
+{
+	SetSlot carried;
+	SetSlot tmp;
+	SetSlot *slot;
+	unsigned int mask;
+	unsigned int index;
+
+	mask = set->table_size - 1;
+	index = hash & mask;
+
+	carried.data = data;
+	carried.hash = hash;
+	carried.dist = 1;
+
+	for (;;) {
+		slot = &set->slots[index];
+
+		if (slot->dist == 0) {
+			*slot = carried;
+			return;
+		}
+
+		if (slot->dist < carried.dist) {
+			tmp = *slot;
+			*slot = carried;
+			carried = tmp;
+		}
+
+		index = (index + 1) & mask;
+		++carried.dist;
+	}
+}
+
+static int set_rh_resize(Set *set, unsigned int prime_index)
+{
+	SetSlot *old_slots;
+	unsigned int old_table_size;
+	unsigned int old_prime_index;
+	unsigned int i;
+
+	old_slots = set->slots;
+	old_table_size = set->table_size;
+	old_prime_index = set->prime_index;
+
+	set->prime_index = prime_index;
+
+	if (!set_allocate_table(set)) {
+		set->slots = old_slots;
+		set->table_size = old_table_size;
+		set->prime_index = old_prime_index;
+
+		return 0;
+	}
+
+	for (i = 0; i < old_table_size; ++i) {
+		if (old_slots[i].dist != 0) {
+			set_rh_place(set, old_slots[i].data, old_slots[i].hash);
+		}
+	}
+
+	free(old_slots);
+
+	++set->resizes;
+
+	return 1;
+}
+
+/* Add a value with the given mixed hash, which is known not to be in a
+ * Robin Hood set already */
+static int set_rh_add(Set *set, SetValue data, unsigned int hash)
+{
+	if (set->entries >= SET_ROBIN_HOOD_LOAD(set->table_size)) {
+		if (!set_rh_resize(set, set->prime_index + 1)) {
+			return 0;
+		}
+	}
+
+	set_rh_place(set, data, hash);
+	++set->entries;
+
+	return 1;
+}
+
+static int set_rh_insert(Set *set, SetValue data)
+{
+	unsigned int hash;
+
+	hash = set_mix(set->hash_func(data));
+
+	if (set_rh_find(set, data, hash) != set->table_size) {
+		return 0;
+	}
+
+	return set_rh_add(set, data, hash);
+}
+
+/* Remove a value from a Robin Hood set.  Rather than leaving a marker in
+ * the slot, the values after it are moved back one slot each, until one
+ * is reached which is already in its own slot or the slot is empty. */
+static int set_rh_remove(Set *set, SetValue data)
+{
+	unsigned int mask;
+	unsigned int index;
+	unsigned int next;
+
+	index = set_rh_find(set, data, set_mix(set->hash_func(data)));
+
+	if (index == set->table_size) {
+		return 0;
+	}
+
+	if (set->free_func != NULL) {
+		set->free_func(set->slots[index].data);
+	}
+
+	mask = set->table_size - 1;
+	next = (index + 1) & mask;
+
+	while (set->slots[next].dist > 1) {
+		set->slots[index] = set->slots[next];
+		--set->slots[index].dist;
+		index = next;
+		next = (next + 1) & mask;
+	}
+
+	set->slots[index].dist = 0;
+	--set->entries;
+
+	return 1;
+}
+
+/* Find the slot in use before the given slot of a Robin Hood set, going
+ * backwards and wrapping around, or return set->table_size if end is
+ * reached first. */
+static unsigned int set_rh_prev(Set *set, unsigned int index, unsigned int end)
+{
+	unsigned int mask;
+
+	mask = set->table_size - 1;
+
+	for (;;) {
+		index = (index - 1) & mask;
+
+		if (index == end) {
+			return set->table_size;
+		}
+
+		if (set->slots[index].dist != 0) {
+			return index;
+		}
+	}
 }
 
 Set *set_new(SetHashFunc hash_func, SetEqualFunc equal_func)
+{
+	return set_new_with_flags(hash_func, equal_func, 0);
+}
+
+Set *set_new_with_flags(SetHashFunc hash_func, SetEqualFunc equal_func,
+                        unsigned int flags)
 {
 	Set *new_set;
 
@@ -106,6 +498,17 @@ Set *set_new(SetHashFunc hash_func, SetEqualFunc equal_func)
 	new_set->entries = 0;
 	new_set->prime_index = 0;
 	new_set->free_func = NULL;
+	new_set->flags = flags;
+	new_set->table = NULL;
+	new_set->slots = NULL;
+	new_set->slabs = NULL;
+	new_set->free_entries = NULL;
+	new_set->resizes = 0;
+#ifdef SET_STATISTICS
+	new_set->searches = 0;
+	new_set->probes = 0;
+	new_set->max_probes = 0;
+#endif
 
 	/* Allocate the table */
 	if (!set_allocate_table(new_set)) {
@@ -120,23 +523,49 @@ void set_free(Set *set)
 {
 	SetEntry *rover;
 	SetEntry *next;
+	SetSlab *slab;
+	SetSlab *next_slab;
 	unsigned int i;
 
-	/* Free all entries in all chains */
-	for (i = 0; i < set->table_size; ++i) {
-		rover = set->table[i];
+	if ((set->flags & SET_ROBIN_HOOD) != 0) {
+		if (set->free_func != NULL) {
+			for (i = 0; i < set->table_size; ++i) {
+				if (set->slots[i].dist != 0) {
+					set->free_func(set->slots[i].data);
+				}
+			}
+		}
 
-		while (rover != NULL) {
-			next = rover->next;
+		free(set->slots);
+		free(set);
 
-			/* Free this entry */
-			set_free_entry(set, rover);
+		return;
+	}
 
-			/* Advance to the next entry in the chain */
-			rover = next;
+	/* Free all entries in all chains.  Pooled entries are freed along
+	 * with their slabs, so the chains only need to be walked to free
+	 * the data. */
+	if ((set->flags & SET_POOLED) == 0 || set->free_func != NULL) {
+		for (i = 0; i < set->table_size; ++i) {
+			rover = set->table[i];
+
+			while (rover != NULL) {
+				next = rover->next;
+
+				/* Free this entry */
+				set_free_entry(set, rover);
+
+				/* Advance to the next entry in the chain */
+				rover = next;
+			}
 		}
 	}
 
+	for (slab = set->slabs; slab != NULL; slab = next_slab) {
+		next_slab = slab->next;
+		free(slab);
+	}
+
 	/* Free the table */
 	free(set->table);
 
@@ -149,7 +578,7 @@ void set_register_free_function(Set *set, SetFreeFunc free_func)
 	set->free_func = free_func;
 }
 
-static int set_enlarge(Set *set)
+static int set_resize(Set *set, unsigned int prime_index)
 {
 	SetEntry *rover;
 	SetEntry *next;
@@ -164,8 +593,8 @@ static int set_enlarge(Set *set)
 	old_table_size = set->table_size;
 	old_prime_index = set->prime_index;
 
-	/* Use the next table size from the prime number array */
-	++set->prime_index;
+	/* Use the new table size from the prime number array */
+	set->prime_index = prime_index;
 
 	/* Allocate the new table */
 	if (!set_allocate_table(set)) {
@@ -188,7 +617,7 @@ static int set_enlarge(Set *set)
 			next = rover->next;
 
 			/* Hook this entry into the new table */
-			index = set->hash_func(rover->data) % set->table_size;
+			index = set_chain_index(set, rover->data);
 			rover->next = set->table[index];
 			set->table[index] = rover;
 
@@ -200,49 +629,192 @@ static int set_enlarge(Set *set)
 	/* Free back the old table */
 	free(old_table);
 
+	++set->resizes;
+
 	/* Resized successfully */
 	return 1;
 }
 
+/* Add a value which is known not to be in the set already */
+static int set_add(Set *set, SetValue data)
+{
+	SetEntry *newentry;
+	unsigned int index;
+
+	if ((set->flags & SET_ROBIN_HOOD) != 0) {
+		return set_rh_add(set, data, set_mix(set->hash_func(data)));
+	}
+
+	if ((set->entries * 3) / set->table_size > 0) {
+		if (!set_resize(set, set->prime_index + 1)) {
+			return 0;
+		}
+	}
+
+	newentry = set_alloc_entry(set);
+
+	if (newentry == NULL) {
+		return 0;
+	}
+
+	index = set_chain_index(set, data);
+	newentry->data = data;
+	newentry->next = set->table[index];
+	set->table[index] = newentry;
+
+	++set->entries;
+
+	return 1;
+}
+
+/* Make room in a set for a total of num_entries values, so that adding
+ * them does not enlarge the table one step at a time.  For a pooled set,
+ * a single slab is allocated for all of the new entries.  Failure is not
+ * an error: the set is then enlarged as values are added, as usual. */
+static void set_reserve(Set *set, unsigned int num_entries)
+{
+	SetSlab *slab;
+	unsigned int prime_index;
+	unsigned int max_index;
+	unsigned int needed;
+
+	if (num_entries <= set->entries) {
+		return;
+	}
+
+	if ((set->flags & (SET_POWER_OF_TWO | SET_ROBIN_HOOD)) != 0) {
+		max_index = 23;
+	} else {
+		max_index = set_num_primes - 1;
+	}
+
+	prime_index = set->prime_index;
+
+	while (prime_index < max_index &&
+	       !set_size_fits(set, set_size_for_index(set, prime_index),
+	                      num_entries)) {
+		++prime_index;
+	}
+
+	if (prime_index > set->prime_index) {
+		if ((set->flags & SET_ROBIN_HOOD) != 0) {
+			set_rh_resize(set, prime_index);
+		} else {
+			set_resize(set, prime_index);
+		}
+	}
+
+	if ((set->flags & (SET_POOLED | SET_ROBIN_HOOD)) != SET_POOLED) {
+		return;
+	}
+
+	needed = num_entries - set->entries;
+
+	if (set->slabs != NULL &&
+	    needed <= set->slab_capacity - set->slab_used) {
+		return;
+	}
+
+	slab = malloc(sizeof(SetSlab) + (needed - 1) * sizeof(SetEntry));
+
+	if (slab != NULL) {
+		slab->next = set->slabs;
+		slab->capacity = needed;
+		set->slabs = slab;
+		set->slab_used = 0;
+		set->slab_capacity = needed;
+	}
+}
+
+/* Query whether a set contains a value taken from another set, from
+ * the chain or slot pos.  Sets of the same kind which use the same hash
+ * function can be searched without hashing the value again: a Robin
+ * Hood set stores the hash of each value, and if two chained sets have
+ * the same table size, the value can only be in the same chain. */
+static int set_contains_at(Set *set, Set *from, SetValue data,
+                           unsigned int pos)
+{
+	SetEntry *rover;
+
+	if (set->hash_func != from->hash_func) {
+		return set_query(set, data);
+	}
+
+	if ((set->flags & from->flags & SET_ROBIN_HOOD) != 0) {
+		return set_rh_find(set, data, from->slots[pos].hash) !=
+		       set->table_size;
+	}
+
+	if (((set->flags | from->flags) & SET_ROBIN_HOOD) != 0 ||
+	    set->table_size != from->table_size ||
+	    ((set->flags ^ from->flags) & SET_POWER_OF_TWO) != 0) {
+		return set_query(set, data);
+	}
+
+	SET_SEARCH_BEGIN(set);
+
+	for (rover = set->table[pos]; rover != NULL; rover = rover->next) {
+		SET_SEARCH_PROBE(set);
+
+		if (set->equal_func(data, rover->data) != 0) {
+			SET_SEARCH_END(set);
+			return 1;
+		}
+	}
+
+	SET_SEARCH_END(set);
+
+	return 0;
+}
+
 int set_insert(Set *set, SetValue data)
 {
 	SetEntry *newentry;
 	SetEntry *rover;
 	unsigned int index;
 
+	if ((set->flags & SET_ROBIN_HOOD) != 0) {
+		return set_rh_insert(set, data);
+	}
+
 	/* The hash table becomes less efficient as the number of entries
 	 * increases. Check if the percentage used becomes large. */
 	if ((set->entries * 3) / set->table_size > 0) {
 
 		/* The table is more than 1/3 full and must be increased
 		 * in size */
-		if (!set_enlarge(set)) {
+		if (!set_resize(set, set->prime_index + 1)) {
 			return 0;
 		}
 	}
 
 	/* Use the hash of the data to determine an index to insert into the
 	 * table at. */
-	index = set->hash_func(data) % set->table_size;
+	index = set_chain_index(set, data);
 
 	/* Walk along this chain and attempt to determine if this data has
 	 * already been added to the table */
 	rover = set->table[index];
+	SET_SEARCH_BEGIN(set);
 
 	while (rover != NULL) {
+		SET_SEARCH_PROBE(set);
 
 		if (set->equal_func(data, rover->data) != 0) {
 
 			/* This data is already in the set */
+			SET_SEARCH_END(set);
 			return 0;
 		}
 
 		rover = rover->next;
 	}
 
+	SET_SEARCH_END(set);
+
 	/* Not in the set.  We must add a new entry. */
 	/* Make a new entry for this data */
-	newentry = (SetEntry *) malloc(sizeof(SetEntry));
+	newentry = set_alloc_entry(set);
 
 	if (newentry == NULL) {
 		return 0;
@@ -267,14 +839,22 @@ int set_remove(Set *set, SetValue data)
 	SetEntry *entry;
 	unsigned int index;
 
+	if ((set->flags & SET_ROBIN_HOOD) != 0) {
+		return set_rh_remove(set, data);
+	}
+
 	/* Look up the data by its hash key */
-	index = set->hash_func(data) % set->table_size;
+	index = set_chain_index(set, data);
 
 	/* Search this chain, until the corresponding entry is found */
 	rover = &set->table[index];
+	SET_SEARCH_BEGIN(set);
 
 	while (*rover != NULL) {
+		SET_SEARCH_PROBE(set);
+
 		if (set->equal_func(data, (*rover)->data) != 0) {
+			SET_SEARCH_END(set);
 
 			/* Found the entry */
 			entry = *rover;
@@ -295,6 +875,8 @@ int set_remove(Set *set, SetValue data)
 		rover = &((*rover)->next);
 	}
 
+	SET_SEARCH_END(set);
+
 	/* Not found in set */
 	return 0;
 }
@@ -304,16 +886,25 @@ int set_query(Set *set, SetValue data)
 	SetEntry *rover;
 	unsigned int index;
 
+	if ((set->flags & SET_ROBIN_HOOD) != 0) {
+		return set_rh_find(set, data, set_mix(set->hash_func(data))) !=
+		       set->table_size;
+	}
+
 	/* Look up the data by its hash key */
-	index = set->hash_func(data) % set->table_size;
+	index = set_chain_index(set, data);
 
 	/* Search this chain, until the corresponding entry is found */
 	rover = set->table[index];
+	SET_SEARCH_BEGIN(set);
 
 	while (rover != NULL) {
+		SET_SEARCH_PROBE(set);
+
 		if (set->equal_func(data, rover->data) != 0) {
 
 			/* Found the entry */
+			SET_SEARCH_END(set);
 			return 1;
 		}
 
@@ -321,6 +912,8 @@ int set_query(Set *set, SetValue data)
 		rover = rover->next;
 	}
 
+	SET_SEARCH_END(set);
+
 	/* Not found */
 	return 0;
 }
@@ -330,6 +923,81 @@ unsigned int set_num_entries(Set *set)
 	return set->entries;
 }
 
+/* Add a chain or probe sequence of the given length to the histogram */
+static void set_count_length(SetStatistics *stats, unsigned int length)
+{
+	if (length < SET_HISTOGRAM_SIZE) {
+		++stats->chain_lengths[length];
+	} else {
+		++stats->chain_lengths[SET_HISTOGRAM_SIZE - 1];
+	}
+
+	if (length > stats->max_chain_length) {
+		stats->max_chain_length = length;
+	}
+}
+
+void set_get_statistics(Set *set, SetStatistics *stats)
+{
+	SetEntry *rover;
+	SetSlab *slab;
+	unsigned int length;
+	unsigned int i;
+
+	memset(stats, 0, sizeof(SetStatistics));
+
+	stats->entries = set->entries;
+	stats->table_size = set->table_size;
+	stats->load_factor = (double) set->entries / (double) set->table_size;
+	stats->resizes = set->resizes;
+
+#ifdef SET_STATISTICS
+	stats->searches = set->searches;
+	stats->probes = set->probes;
+	stats->max_probes = set->max_probes;
+#endif
+
+	if ((set->flags & SET_ROBIN_HOOD) != 0) {
+		for (i = 0; i < set->table_size; ++i) {
+			if (set->slots[i].dist != 0) {
+				set_count_length(stats,
+				                 set->slots[i].dist - 1);
+			}
+		}
+
+		stats->memory_used =
+		    sizeof(Set) + (size_t) set->table_size * sizeof(SetSlot);
+
+		return;
+	}
+
+	for (i = 0; i < set->table_size; ++i) {
+		length = 0;
+
+		for (rover = set->table[i]; rover != NULL;
+		     rover = rover->next) {
+			++length;
+		}
+
+		set_count_length(stats, length);
+	}
+
+
+	stats->memory_used = sizeof(Set) +
+	                     (size_t) set->table_size * sizeof(SetEntry *);
+
+	if ((set->flags & SET_POOLED) != 0) {
+		for (slab = set->slabs; slab != NULL; slab = slab->next) {
+			stats->memory_used +=
+			    sizeof(SetSlab) +
+			    (slab->capacity - 1) * sizeof(SetEntry);
+		}
+	} else {
+		stats->memory_used +=
+		    (size_t) set->entries * sizeof(SetEntry);
+	}
+}
+
 SetValue *set_to_array(Set *set)
 {
 	SetValue *array;
@@ -346,6 +1014,17 @@ SetValue *set_to_array(Set *set)
 
 	array_counter = 0;
 
+	if ((set->flags & SET_ROBIN_HOOD) != 0) {
+		for (i = 0; i < set->table_size; ++i) {
+			if (set->slots[i].dist != 0) {
+				array[array_counter] = set->slots[i].data;
+				++array_counter;
+			}
+		}
+
+		return array;
+	}
+
 	/* Iterate over all entries in all chains */
 	for (i = 0; i < set->table_size; ++i) {
 
@@ -371,13 +1050,24 @@ Set *set_union(Set *set1, Set *set2)
 	Set *new_set;
 	SetValue value;
 
-	new_set = set_new(set1->hash_func, set1->equal_func);
+	/* The new set is pooled, so that its entries can all be taken from
+	 * a single block */
+	new_set = set_new_with_flags(set1->hash_func, set1->equal_func,
+	                             set1->flags | SET_POOLED);
 
 	if (new_set == NULL) {
 		return NULL;
 	}
 
-	/* Add all values from the first set */
+	/* Size the new set, and the block for its entries, for the largest
+	 * possible result up front */
+	if (set2->entries <= ~0U - set1->entries) {
+		set_reserve(new_set, set1->entries + set2->entries);
+	}
+
+	/* Add all values from the first set.  These are all different, so
+	 * they are added with set_add, which does not search for an
+	 * existing copy of each. */
 	set_iterate(set1, &iterator);
 
 	while (set_iter_has_more(&iterator)) {
@@ -386,7 +1076,7 @@ Set *set_union(Set *set1, Set *set2)
 		value = set_iter_next(&iterator);
 
 		/* Copy the value into the new set */
-		if (!set_insert(new_set, value)) {
+		if (!set_add(new_set, value)) {
 
 			/* Failed to insert */
 			set_free(new_set);
@@ -394,21 +1084,91 @@ Set *set_union(Set *set1, Set *set2)
 		}
 	}
 
-	/* Add all values from the second set */
+	/* Add the values from the second set which were not in the first */
+	if (!set_union_into(new_set, set2)) {
+		set_free(new_set);
+		return NULL;
+	}
+
+	return new_set;
+}
+
+int set_union_into(Set *set1, Set *set2)
+{
+	SetIterator iterator;
+	SetValue value;
+	unsigned int pos;
+
+	if (set2->entries <= ~0U - set1->entries) {
+		set_reserve(set1, set1->entries + set2->entries);
+	}
+
 	set_iterate(set2, &iterator);
 
 	while (set_iter_has_more(&iterator)) {
 
-		/* Read the next value */
+		/* The iterator's next chain or slot is where the value that
+		 * it is about to return is stored */
+		pos = iterator.next_chain;
 		value = set_iter_next(&iterator);
 
-		/* Has this value been put into the new set already?
+		/* Has this value been put into the set already?
 		 * If so, do not insert this again */
-		if (set_query(new_set, value) == 0) {
-			if (!set_insert(new_set, value)) {
+		if (!set_contains_at(set1, set2, value, pos)) {
+			if (!set_add(set1, value)) {
+				return 0;
+			}
+		}
+	}
 
-				/* Failed to insert */
+	return 1;
+}
+
+Set *set_intersection(Set *set1, Set *set2)
+{
+	Set *new_set;
+	Set *smaller;
+	Set *larger;
+	SetIterator iterator;
+	SetValue value;
+	unsigned int pos;
+
+	/* As for set_union, the new set is pooled */
+	new_set = set_new_with_flags(set1->hash_func, set1->equal_func,
+	                             set1->flags | SET_POOLED);
+
+	if (new_set == NULL) {
+		return NULL;
+	}
+
+	/* Only the smaller set needs to be examined, as the result cannot
+	 * contain more values than it does */
+	if (set2->entries < set1->entries) {
+		smaller = set2;
+		larger = set1;
+	} else {
+		smaller = set1;
+		larger = set2;
+	}
+
+	set_reserve(new_set, smaller->entries);
+
+	/* Iterate over all values in the smaller set. */
+	set_iterate(smaller, &iterator);
+
+	while (set_iter_has_more(&iterator)) {
+
+		/* Get the next value */
+		pos = iterator.next_chain;
+		value = set_iter_next(&iterator);
+
+		/* Is this value in the other set as well?  If so, it
+		 * should be in the new set. */
+		if (set_contains_at(larger, smaller, value, pos)) {
+
+			if (!set_add(new_set, value)) {
 				set_free(new_set);
+
 				return NULL;
 			}
 		}
@@ -417,33 +1177,49 @@ Set *set_union(Set *set1, Set *set2)
 	return new_set;
 }
 
-Set *set_intersection(Set *set1, Set *set2)
+void set_intersect_inplace(Set *set1, Set *set2)
+{
+	SetIterator iterator;
+	SetValue value;
+	unsigned int pos;
+
+	set_iterate(set1, &iterator);
+
+	while (set_iter_has_more(&iterator)) {
+		pos = iterator.next_chain;
+		value = set_iter_next(&iterator);
+
+		/* Removing the value just returned by the iterator is safe */
+		if (!set_contains_at(set2, set1, value, pos)) {
+			set_remove(set1, value);
+		}
+	}
+}
+
+Set *set_difference(Set *set1, Set *set2)
 {
 	Set *new_set;
 	SetIterator iterator;
 	SetValue value;
+	unsigned int pos;
 
-	new_set = set_new(set1->hash_func, set2->equal_func);
+	new_set = set_new_with_flags(set1->hash_func, set1->equal_func,
+	                             set1->flags);
 
 	if (new_set == NULL) {
 		return NULL;
 	}
 
-	/* Iterate over all values in set 1. */
+	set_reserve(new_set, set1->entries);
+
 	set_iterate(set1, &iterator);
 
 	while (set_iter_has_more(&iterator)) {
-
-		/* Get the next value */
+		pos = iterator.next_chain;
 		value = set_iter_next(&iterator);
 
-		/* Is this value in set 2 as well?  If so, it should be
-		 * in the new set. */
-		if (set_query(set2, value) != 0) {
-
-			/* Copy the value first before inserting,
-			 * if necessary */
-			if (!set_insert(new_set, value)) {
+		if (!set_contains_at(set2, set1, value, pos)) {
+			if (!set_add(new_set, value)) {
 				set_free(new_set);
 
 				return NULL;
@@ -454,6 +1230,30 @@ Set *set_intersection(Set *set1, Set *set2)
 	return new_set;
 }
 
+int set_is_subset(Set *set1, Set *set2)
+{
+	SetIterator iterator;
+	SetValue value;
+	unsigned int pos;
+
+	if (set1->entries > set2->entries) {
+		return 0;
+	}
+
+	set_iterate(set1, &iterator);
+
+	while (set_iter_has_more(&iterator)) {
+		pos = iterator.next_chain;
+		value = set_iter_next(&iterator);
+
+		if (!set_contains_at(set2, set1, value, pos)) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
 void set_iterate(Set *set, SetIterator *iter)
 {
 	unsigned int chain;
@@ -461,6 +1261,21 @@ void set_iterate(Set *set, SetIterator *iter)
 	iter->set = set;
 	iter->next_entry = NULL;
 
+	/* A Robin Hood set is iterated backwards, starting and ending at
+	 * an empty slot.  Removing a value only moves the values after it
+	 * back, up to the next empty slot, so those values have all been
+	 * visited already, and removing the value just returned does not
+	 * cause any other value to be missed or visited twice. */
+	if ((set->flags & SET_ROBIN_HOOD) != 0) {
+		for (chain = 0; set->slots[chain].dist != 0; ++chain)
+			;
+
+		iter->end_chain = chain;
+		iter->next_chain = set_rh_prev(set, chain, chain);
+
+		return;
+	}
+
 	/* Find the first entry */
 	for (chain = 0; chain < set->table_size; ++chain) {
 
@@ -483,6 +1298,18 @@ SetValue set_iter_next(SetIterator *iterator)
 
 	set = iterator->set;
 
+	if ((set->flags & SET_ROBIN_HOOD) != 0) {
+		if (iterator->next_chain == set->table_size) {
+			return set_null_value;
+		}
+
+		result = set->slots[iterator->next_chain].data;
+		iterator->next_chain = set_rh_prev(set, iterator->next_chain,
+		                                   iterator->end_chain);
+
+		return result;
+	}
+
 	/* No more entries? */
 	if (iterator->next_entry == NULL) {
 		return set_null_value;
@@ -529,5 +1356,129 @@ SetValue set_iter_next(SetIterator *iterator)
 
 int set_iter_has_more(SetIterator *iterator)
 {
+	if ((iterator->set->flags & SET_ROBIN_HOOD) != 0) {
+		return iterator->next_chain != iterator->set->table_size;
+	}
+
 	return iterator->next_entry != NULL;
 }
+
+/* Reverse the order of the bits in a 32-bit value */
+static unsigned int set_reverse_bits(unsigned int value)
+{
+	value = ((value >> 1) & 0x55555555U) | ((value & 0x55555555U) << 1);
+	value = ((value >> 2) & 0x33333333U) | ((value & 0x33333333U) << 2);
+	value = ((value >> 4) & 0x0f0f0f0fU) | ((value & 0x0f0f0f0fU) << 4);
+	value = ((value >> 8) & 0x00ff00ffU) | ((value & 0x00ff00ffU) << 8);
+
+	return ((value >> 16) | (value << 16)) & 0xffffffffU;
+}
+
+/* Advance a scan cursor to the next chain of a power-of-two sized table
+ * with the given mask.  The cursor is incremented from its top bit
+ * downwards, so the chains that an already visited chain splits into
+ * when the table doubles in size all come before the cursor.  Zero is
+ * returned after the last chain. */
+static unsigned int set_cursor_next(unsigned int cursor, unsigned int mask)
+{
+	cursor |= ~mask;
+	cursor = set_reverse_bits(cursor);
+	++cursor;
+
+	return set_reverse_bits(cursor);
+}
+
+/* Visit the values in a Robin Hood set that hash to a slot.  They are
+ * stored in the run of slots that starts there, and end before the first
+ * slot holding a value closer to its own slot. */
+static void set_rh_scan_slot(Set *set, unsigned int home,
+                             SetScanFunc callback, void *user_data)
+{
+	SetSlot *slot;
+	unsigned int mask;
+	unsigned int index;
+	unsigned int dist;
+
+	mask = set->table_size - 1;
+	index = home;
+
+	for (dist = 1;; ++dist) {
+		slot = &set->slots[index];
+
+		if (slot->dist < dist) {
+			break;
+		}
+
+		if (slot->dist == dist) {
+			callback(slot->data, user_data);
+		}
+
+		index = (index + 1) & mask;
+	}
+}
+
+static void set_scan_chain(SetEntry *rover, SetScanFunc callback,
+                           void *user_data)
+{
+	while (rover != NULL) {
+		callback(rover->data, user_data);
+		rover = rover->next;
+	}
+}
+
+void set_scan_start(Set *set, SetCursor *cursor)
+{
+	cursor->position = 0;
+	cursor->resizes = set->resizes;
+}
+
+int set_scan(Set *set, SetCursor *cursor, unsigned int count,
+             SetScanFunc callback, void *user_data)
+{
+	unsigned int mask;
+
+	mask = set->table_size - 1;
+
+	if ((set->flags & SET_ROBIN_HOOD) != 0) {
+		do {
+			set_rh_scan_slot(set, cursor->position & mask,
+			                 callback, user_data);
+			cursor->position =
+			    set_cursor_next(cursor->position, mask);
+		} while (--count > 0 && cursor->position != 0);
+
+		return cursor->position != 0;
+	}
+
+	if ((set->flags & SET_POWER_OF_TWO) != 0) {
+		do {
+			set_scan_chain(set->table[cursor->position & mask],
+			               callback, user_data);
+			cursor->position =
+			    set_cursor_next(cursor->position, mask);
+		} while (--count > 0 && cursor->position != 0);
+
+		return cursor->position != 0;
+	}
+
+	/* Chains of prime sized tables do not correspond between sizes, so
+	 * the scan starts again if the set has been enlarged. */
+	if (cursor->resizes != set->resizes) {
+		cursor->position = 0;
+		cursor->resizes = set->resizes;
+	}
+
+	do {
+		set_scan_chain(set->table[cursor->position], callback,
+		               user_data);
+		++cursor->position;
+	} while (--count > 0 && cursor->position < set->table_size);
+
+	if (cursor->position < set->table_size) {
+		return 1;
+	}
+
+	cursor->position = 0;
+
+	return 0;
+}
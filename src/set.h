@@ -27,7 +27,8 @@ CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  * the set.
  *
  * To create a new set, use @ref set_new.  To destroy a set, use
- * @ref set_free.
+ * @ref set_free.  A set using a different storage scheme can be created
+ * using @ref set_new_with_flags.
  *
  * To add a value to a set, use @ref set_insert.  To remove a value
  * from a set, use @ref set_remove.
@@ -40,13 +41,28 @@ CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  * a @ref SetIterator structure, with @ref set_iter_next and
  * @ref set_iter_has_more to read each value in turn.
  *
+ * A large set can instead be scanned a few chains at a time, changing it
+ * between steps, using @ref set_scan_start to initialise a
+ * @ref SetCursor and then calling @ref set_scan until it returns zero.
+ *
  * Two sets can be combined (union) using @ref set_union, while the
  * intersection of two sets can be generated using @ref set_intersection.
+ * The values in one set but not another can be found using
+ * @ref set_difference, and @ref set_is_subset tests whether all of the
+ * values in one set are in another.  @ref set_union_into and
+ * @ref set_intersect_inplace change an existing set rather than
+ * creating a new one.
+ *
+ * The sets passed to these functions should use the same hash and
+ * comparison functions.  When they also use the same flags, values can
+ * often be found in the other set without being hashed again.
  */
 
 #ifndef ALGORITHM_SET_H
 #define ALGORITHM_SET_H
 
+#include <stddef.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -85,6 +101,108 @@ typedef void *SetValue;
 
 #endif /* #ifndef TEST_ALTERNATE_VALUE_TYPES */
 
+/**
+ * Flags which may be passed to @ref set_new_with_flags to control how a
+ * set is stored.  Flags can be combined using bitwise OR.
+ */
+typedef enum {
+	/**
+	 * Use power-of-two table sizes, rather than prime numbers.  The
+	 * index into the table is then found by masking rather than by an
+	 * integer division.  Hash values are scrambled before being
+	 * masked so that weak hash functions such as int_hash() or
+	 * pointer_hash() still distribute well.
+	 */
+	SET_POWER_OF_TWO = 1 << 0,
+
+	/**
+	 * Allocate the entries of the set from large blocks owned by the
+	 * set, rather than with a separate malloc() for each.  This uses
+	 * less memory, and freeing the set only needs to free each block
+	 * rather than each entry.  The memory used by removed entries is
+	 * reused for new entries, but is not returned until the set is
+	 * freed.
+	 */
+	SET_POOLED = 1 << 1,
+
+	/**
+	 * Store values in a single array of slots using open addressing
+	 * with Robin Hood hashing, rather than in chains of individually
+	 * allocated entries.  When a new value is inserted, it takes the
+	 * place of any value that is closer to the slot that it hashes
+	 * to, so that every value stays close to its own slot and a search
+	 * can stop as soon as it passes the point where the value would
+	 * have been.  When a value is removed, the values after it are
+	 * moved back to fill the gap.  A search therefore reads a short,
+	 * contiguous run of slots rather than following pointers.  Sizes
+	 * are always powers of two, and @ref SET_POOLED has no effect.
+	 */
+	SET_ROBIN_HOOD = 1 << 2
+} SetFlag;
+
+/**
+ * Number of elements in the histogram of chain lengths in
+ * @ref SetStatistics.
+ */
+#define SET_HISTOGRAM_SIZE 8
+
+/**
+ * Statistics describing the state of a set, which can be used to spot a
+ * hash function that distributes values badly.  See
+ * @ref set_get_statistics.
+ */
+typedef struct _SetStatistics {
+
+	/** Number of values in the set. */
+	unsigned int entries;
+
+	/**
+	 * Number of chains in the set's hash table, or of slots for a set
+	 * using @ref SET_ROBIN_HOOD.
+	 */
+	unsigned int table_size;
+
+	/** Number of values divided by the number of chains. */
+	double load_factor;
+
+	/**
+	 * Histogram of chain lengths.  Element i is the number of chains
+	 * holding i values, except for the last element, which counts
+	 * every chain at least that long.  For a set using
+	 * @ref SET_ROBIN_HOOD, element i is instead the number of values
+	 * stored i slots after the slot that they hash to.
+	 */
+	unsigned int chain_lengths[SET_HISTOGRAM_SIZE];
+
+	/** Length of the longest chain or probe sequence. */
+	unsigned int max_chain_length;
+
+	/**
+	 * Approximate number of bytes of memory used by the set, not
+	 * including the values or any overhead of malloc().
+	 */
+	size_t memory_used;
+
+	/** Number of times the hash table has been enlarged. */
+	unsigned int resizes;
+
+	/**
+	 * Number of searches made for a value, by any function.  This and
+	 * the following fields are only counted if the library was built
+	 * with SET_STATISTICS defined, and are otherwise zero.
+	 */
+	unsigned long searches;
+
+	/**
+	 * Total number of entries, or slots for a set using
+	 * @ref SET_ROBIN_HOOD, examined by all searches.
+	 */
+	unsigned long probes;
+
+	/** Largest number of entries or slots examined by one search. */
+	unsigned int max_probes;
+} SetStatistics;
+
 /**
  * Definition of a @ref SetIterator.
  */
@@ -92,8 +210,20 @@ struct _SetIterator {
 	Set *set;
 	SetEntry *next_entry;
 	unsigned int next_chain;
+	unsigned int end_chain;
 };
 
+/**
+ * A cursor used to scan a set in steps, with the set changing between
+ * them.  Unlike a @ref SetIterator, it does not point into the set.
+ *
+ * @see set_scan_start
+ */
+typedef struct _SetCursor {
+	unsigned int position;
+	unsigned int resizes;
+} SetCursor;
+
 /**
  * Hash function.  Generates a hash key for values to be stored in a set.
  */
@@ -111,6 +241,12 @@ typedef int (*SetEqualFunc)(SetValue value1, SetValue value2);
  */
 typedef void (*SetFreeFunc)(SetValue value);
 
+/**
+ * Function called by @ref set_scan for each value that it visits.  It
+ * must not change the set.
+ */
+typedef void (*SetScanFunc)(SetValue value, void *user_data);
+
 /**
  * Create a new set.
  *
@@ -122,6 +258,20 @@ typedef void (*SetFreeFunc)(SetValue value);
  */
 Set *set_new(SetHashFunc hash_func, SetEqualFunc equal_func);
 
+/**
+ * Create a new set, specifying how the set is to be stored.
+ *
+ * @param hash_func     Hash function used on values in the set.
+ * @param equal_func    Compares two values in the set to determine
+ *                      if they are equal.
+ * @param flags         Bitwise OR of @ref SetFlag values, or zero to
+ *                      create the same kind of set as @ref set_new.
+ * @return              A new set, or NULL if it was not possible to
+ *                      allocate the memory for the set.
+ */
+Set *set_new_with_flags(SetHashFunc hash_func, SetEqualFunc equal_func,
+                        unsigned int flags);
+
 /**
  * Destroy a set.
  *
@@ -180,6 +330,16 @@ int set_query(Set *set, SetValue data);
  */
 unsigned int set_num_entries(Set *set);
 
+/**
+ * Retrieve statistics about a set.  This examines every chain in the
+ * set's hash table, so takes time proportional to the table size.
+ *
+ * @param set              The set.
+ * @param stats            Pointer to a structure in which to store the
+ *                         statistics.
+ */
+void set_get_statistics(Set *set, SetStatistics *stats);
+
 /**
  * Create an array containing all entries in a set.
  *
@@ -191,7 +351,10 @@ unsigned int set_num_entries(Set *set);
 SetValue *set_to_array(Set *set);
 
 /**
- * Perform a union of two sets.
+ * Perform a union of two sets.  The new set uses the same flags as the
+ * first set, with @ref SET_POOLED added.  Its table, and a single block
+ * for all of its entries, are sized for both sets before any values are
+ * added, so no further memory is allocated as the values are added.
  *
  * @param set1             The first set.
  * @param set2             The second set.
@@ -202,7 +365,26 @@ SetValue *set_to_array(Set *set);
 Set *set_union(Set *set1, Set *set2);
 
 /**
- * Perform an intersection of two sets.
+ * Add all of the values in one set to another.  As with
+ * @ref set_union, the values are not copied, so if the first set has a
+ * free function registered, the values added to it must not also be
+ * freed by the second set.
+ *
+ * @param set1             The set to add the values to.
+ * @param set2             The set containing the values to add.
+ * @return                 Non-zero if all of the values were added, or
+ *                         zero if it was not possible to allocate memory
+ *                         for them, in which case only some of them may
+ *                         have been added.
+ */
+int set_union_into(Set *set1, Set *set2);
+
+/**
+ * Perform an intersection of two sets.  Only the values in the smaller
+ * set are examined, and the values stored in the new set are taken from
+ * it.  As with @ref set_union, the new set uses the same flags as the
+ * first set, with @ref SET_POOLED added, and memory for all of its
+ * values is allocated up front.
  *
  * @param set1             The first set.
  * @param set2             The second set.
@@ -212,6 +394,38 @@ Set *set_union(Set *set1, Set *set2);
  */
 Set *set_intersection(Set *set1, Set *set2);
 
+/**
+ * Remove all of the values from a set which are not in another set.  The
+ * free function of the first set, if any, is called for each value
+ * removed.  No memory is allocated.
+ *
+ * @param set1             The set to remove values from.
+ * @param set2             The set containing the values to keep.
+ */
+void set_intersect_inplace(Set *set1, Set *set2);
+
+/**
+ * Find the values in one set which are not in another.
+ *
+ * @param set1             The first set.
+ * @param set2             The second set.
+ * @return                 A new set containing all values which are in the
+ *                         first set but not the second, or NULL if it was
+ *                         not possible to allocate memory for the new
+ *                         set.
+ */
+Set *set_difference(Set *set1, Set *set2);
+
+/**
+ * Determine whether every value in one set is also in another.
+ *
+ * @param set1             The set which may be a subset.
+ * @param set2             The other set.
+ * @return                 Non-zero if every value in the first set is
+ *                         also in the second set, or zero if not.
+ */
+int set_is_subset(Set *set1, Set *set2);
+
 /**
  * Initialise a @ref SetIterator structure to iterate over the values
  * in a set.
@@ -240,6 +454,42 @@ int set_iter_has_more(SetIterator *iterator);
  */
 SetValue set_iter_next(SetIterator *iterator);
 
+/**
+ * Initialise a @ref SetCursor to scan over a set using @ref set_scan.
+ *
+ * @param set              The set.
+ * @param cursor           Pointer to the cursor to initialise.
+ */
+void set_scan_start(Set *set, SetCursor *cursor);
+
+/**
+ * Continue a scan over a set, visiting the next few chains (or, for a
+ * set using @ref SET_ROBIN_HOOD, the values belonging to the next few
+ * slots) and passing each value in them to a callback function.
+ *
+ * Values may be inserted and removed, and the set may be enlarged,
+ * between calls.  Every value that is in the set for the whole of the
+ * scan is visited at least once; values inserted or removed during the
+ * scan may or may not be visited.  Sets using @ref SET_POWER_OF_TWO or
+ * @ref SET_ROBIN_HOOD are scanned in reverse binary order of their
+ * chains, which stays valid when the set doubles in size, so no value is
+ * visited twice.  For other sets, enlarging the set restarts the scan
+ * from the beginning.
+ *
+ * @param set              The set.
+ * @param cursor           The cursor, initialised using
+ *                         @ref set_scan_start.
+ * @param count            The number of chains or slots to visit.  At
+ *                         least one is always visited.
+ * @param callback         Function to call for each value visited.
+ * @param user_data        Pointer to pass to the callback.
+ * @return                 Non-zero if there is more of the set to scan,
+ *                         or zero if the scan is complete.  The cursor is
+ *                         then back at the start of the set.
+ */
+int set_scan(Set *set, SetCursor *cursor, unsigned int count,
+             SetScanFunc callback, void *user_data);
+
 #ifdef __cplusplus
 }
 #endif
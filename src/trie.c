@@ -20,9 +20,14 @@ CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 
 /* Trie: fast mapping of strings to values */
 
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "trie.h"
 
 /* malloc() / free() testing */
@@ -32,22 +37,143 @@ CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 
 typedef struct _TrieNode TrieNode;
 
+/* Number of keys looked up together by the batch lookup functions.  The
+ * lookups take a step down the trie in turn, prefetching the next node
+ * for each, so that the cache misses overlap instead of being waited
+ * for one after another. */
+#define TRIE_BATCH_SIZE 16
+
+#if defined(__GNUC__)
+#define TRIE_PREFETCH(addr) __builtin_prefetch(addr)
+#else
+#define TRIE_PREFETCH(addr)
+#endif
+
+/* The trie is an adaptive radix tree.  Chains of nodes with only one
+ * child are collapsed into a single node, whose label holds the bytes of
+ * the key along the whole chain.  The first byte of the label of a child
+ * node is the byte that selects it from its parent.  Every node other
+ * than the root either holds a value or has at least two children.
+ *
+ * Each node is stored in one of several forms, depending on how many
+ * children it has, and is moved to a larger or smaller form as children
+ * are added and removed:
+ *
+ *  - A leaf has no children.
+ *  - A node4 or node16 has up to 4 or 16 children, with their first
+ *    bytes in a sorted array that is searched to find a child.
+ *  - A node48 has up to 48 children, and a 256-byte array indexed by
+ *    the first byte of a child, holding one more than the child's
+ *    position in the children array, or zero if there is no child.
+ *  - A node256 has an array of 256 children, indexed by their first
+ *    byte, with NULL for a missing child.
+ *
+ * The children array is followed by the array of bytes for that form,
+ * and then by the label. */
+#define TRIE_LEAF 0
+#define TRIE_NODE4 1
+#define TRIE_NODE16 2
+#define TRIE_NODE48 3
+#define TRIE_NODE256 4
+
+static const unsigned int trie_node_capacity[] = {0, 4, 16, 48, 256};
+static const unsigned int trie_node_key_bytes[] = {0, 4, 16, 256, 0};
+
 struct _TrieNode {
 	TrieValue data;
-	unsigned int use_count;
-	TrieNode *next[256];
+	unsigned int label_length;
+	unsigned short num_children;
+	unsigned char type;
+	TrieNode *children[1];
+};
+
+/* Pooled tries allocate their nodes from large blocks.  Nodes are
+ * rounded up to a whole number of units, and removed nodes of up to
+ * TRIE_POOL_CLASSES units are kept on a free list for each size, to be
+ * reused first.  Larger nodes are given a block of their own, which is
+ * freed as soon as the node is. */
+#define TRIE_POOL_UNIT 16
+#define TRIE_POOL_CLASSES 64
+#define TRIE_MIN_BLOCK_SIZE 4096
+#define TRIE_MAX_BLOCK_SIZE 262144
+
+typedef union _TrieBlock TrieBlock;
+
+union _TrieBlock {
+	struct {
+		TrieBlock *next;
+		TrieBlock *prev;
+	} link;
+	unsigned char align[TRIE_POOL_UNIT];
+};
+
+typedef struct _TrieFreeChunk TrieFreeChunk;
+
+struct _TrieFreeChunk {
+	TrieFreeChunk *next;
 };
 
 struct _Trie {
 	TrieNode *root_node;
+	unsigned int num_entries;
+	unsigned int flags;
+
+	/* Used by pooled tries only.  Nodes are carved from the block at
+	 * the head of the blocks list, which has block_remaining bytes
+	 * left from block_next.  Blocks holding a single large node are
+	 * kept in a separate, doubly linked list. */
+	TrieBlock *blocks;
+	TrieBlock *large_blocks;
+	unsigned char *block_next;
+	size_t block_remaining;
+	size_t block_size;
+	TrieFreeChunk *free_chunks[TRIE_POOL_CLASSES];
+
+	/* Length of the longest key that has been inserted, which limits
+	 * the depth of the trie and the space needed by an iterator */
+	unsigned int max_key_length;
+
+	/* Used by frozen tries only, which have no nodes of their own and
+	 * are read from the buffer they were created from */
+	const unsigned char *frozen;
+	unsigned long frozen_size;
+	TrieValue *frozen_values;
+};
+
+/* An iterator keeps a stack with a frame for each node on the path from
+ * where the iteration started to the current node.  next_child is the
+ * byte to continue the search for the next child from, and key_length
+ * is the length of the key before the node's label. */
+struct _TrieIteratorFrame {
+	TrieNode *node;
+	unsigned int next_child;
+	unsigned int key_length;
 };
 
+#define TRIE_NODE_KEYS(node) \
+	((unsigned char *) ((node)->children + \
+	                    trie_node_capacity[(node)->type]))
+
+#define TRIE_NODE_LABEL(node) \
+	(TRIE_NODE_KEYS(node) + trie_node_key_bytes[(node)->type])
+
 /* Null value that can be returned without creating a local variable */
 static const TrieValue trie_null_value = TRIE_NULL;
 
+static int trie_value_is_null(TrieValue *v)
+{
+	return !memcmp(v, &trie_null_value, sizeof(TrieValue));
+}
+
 Trie *trie_new(void)
+{
+	return trie_new_with_flags(0);
+}
+
+Trie *trie_new_with_flags(unsigned int flags)
 {
 	Trie *new_trie;
+	unsigned int i;
 
 	new_trie = (Trie *) malloc(sizeof(Trie));
 
@@ -56,448 +182,1769 @@ Trie *trie_new(void)
 	}
 
 	new_trie->root_node = NULL;
+	new_trie->num_entries = 0;
+	new_trie->flags = flags;
+	new_trie->blocks = NULL;
+	new_trie->large_blocks = NULL;
+	new_trie->block_next = NULL;
+	new_trie->block_remaining = 0;
+	new_trie->block_size = 0;
+	new_trie->max_key_length = 0;
+	new_trie->frozen = NULL;
+	new_trie->frozen_size = 0;
+	new_trie->frozen_values = NULL;
+
+	for (i = 0; i < TRIE_POOL_CLASSES; ++i) {
+		new_trie->free_chunks[i] = NULL;
+	}
 
 	return new_trie;
 }
 
-static void free_node_recursive(TrieNode *node)
+/* Put a piece of memory of the given number of units on the free list
+ * for its size */
+static void trie_pool_release(Trie *trie, void *chunk, size_t units)
 {
-	int i;
-
-	if (node == NULL) {
-		return;
-	}
-
-	/* Free all subnodes */
-	for (i = 0; i < 256; ++i) {
-		free_node_recursive(node->next[i]);
-	}
-
-	free(node);
-}
+	TrieFreeChunk *free_chunk;
 
-void trie_free(Trie *trie)
-{
-	free_node_recursive(trie->root_node);
-	free(trie);
+	free_chunk = (TrieFreeChunk *) chunk;
+	free_chunk->next = trie->free_chunks[units - 1];
+	trie->free_chunks[units - 1] = free_chunk;
 }
 
-static TrieNode *trie_find_end(Trie *trie, char *key)
+static void *trie_alloc(Trie *trie, size_t size)
 {
-	TrieNode *node;
-	char *p;
+	TrieBlock *block;
+	TrieFreeChunk *chunk;
+	size_t block_size;
+	size_t leftover;
+	size_t units;
+	void *result;
+
+	if ((trie->flags & TRIE_POOLED) == 0) {
+		return malloc(size);
+	}
 
-	/* Search down the trie until the end of string is reached */
-	node = trie->root_node;
+	units = (size + TRIE_POOL_UNIT - 1) / TRIE_POOL_UNIT;
 
-	for (p = key; *p != '\0'; ++p) {
+	/* Large nodes have a block to themselves */
+	if (units > TRIE_POOL_CLASSES) {
+		block = (TrieBlock *) malloc(sizeof(TrieBlock) +
+		                             units * TRIE_POOL_UNIT);
 
-		if (node == NULL) {
-			/* Not found in the tree. Return. */
+		if (block == NULL) {
 			return NULL;
 		}
 
-		/* Jump to the next node */
-		node = node->next[(unsigned char) *p];
+		block->link.prev = NULL;
+		block->link.next = trie->large_blocks;
+
+		if (trie->large_blocks != NULL) {
+			trie->large_blocks->link.prev = block;
+		}
+
+		trie->large_blocks = block;
+
+		return block + 1;
 	}
 
-	/* This key is present if the value at the last node is not NULL */
-	return node;
-}
+	/* Reuse a removed node if there is one */
+	chunk = trie->free_chunks[units - 1];
 
-static TrieNode *trie_find_end_binary(Trie *trie, unsigned char *key,
-                                      int key_length)
-{
-	TrieNode *node;
-	int j;
-	int c;
+	if (chunk != NULL) {
+		trie->free_chunks[units - 1] = chunk->next;
 
-	/* Search down the trie until the end of string is reached */
-	node = trie->root_node;
+		return chunk;
+	}
 
-	for (j = 0; j < key_length; j++) {
+	/* Start a new block if the current one is full.  What is left of
+	 * the old block goes on a free list. */
+	if (trie->block_remaining < units * TRIE_POOL_UNIT) {
+		if (trie->block_size == 0) {
+			block_size = TRIE_MIN_BLOCK_SIZE;
+		} else if (trie->block_size < TRIE_MAX_BLOCK_SIZE) {
+			block_size = trie->block_size * 2;
+		} else {
+			block_size = TRIE_MAX_BLOCK_SIZE;
+		}
 
-		if (node == NULL) {
-			/* Not found in the tree. Return. */
+		block = (TrieBlock *) malloc(block_size);
+
+		if (block == NULL) {
 			return NULL;
 		}
 
-		c = (unsigned char) key[j];
+		if (trie->block_remaining > 0) {
+			leftover = trie->block_remaining / TRIE_POOL_UNIT;
+			trie_pool_release(trie, trie->block_next, leftover);
+		}
 
-		/* Jump to the next node */
-		node = node->next[c];
+		block->link.next = trie->blocks;
+		trie->blocks = block;
+		trie->block_size = block_size;
+		trie->block_next = (unsigned char *) (block + 1);
+		trie->block_remaining = block_size - sizeof(TrieBlock);
 	}
 
-	/* This key is present if the value at the last node is not NULL */
-	return node;
+	result = trie->block_next;
+	trie->block_next += units * TRIE_POOL_UNIT;
+	trie->block_remaining -= units * TRIE_POOL_UNIT;
+
+	return result;
 }
 
-/* Roll back an insert operation after a failed malloc() call. */
-static void trie_insert_rollback(Trie *trie, unsigned char *key)
+/* Free memory allocated using trie_alloc.  The size given may be less
+ * than was allocated, when a node's label has been shortened, which
+ * only means that the memory is reused for a smaller node. */
+static void trie_release(Trie *trie, void *chunk, size_t size)
 {
-	TrieNode *node;
-	TrieNode **prev_ptr;
-	TrieNode *next_node;
-	TrieNode **next_prev_ptr;
-	unsigned char *p;
+	TrieBlock *block;
+	size_t units;
 
-	/* Follow the chain along.  We know that we will never reach the
-	 * end of the string because trie_insert never got that far.  As a
-	 * result, it is not necessary to check for the end of string
-	 * delimiter (NUL) */
-	node = trie->root_node;
-	prev_ptr = &trie->root_node;
-	p = key;
+	if ((trie->flags & TRIE_POOLED) == 0) {
+		free(chunk);
+		return;
+	}
 
-	while (node != NULL) {
+	units = (size + TRIE_POOL_UNIT - 1) / TRIE_POOL_UNIT;
+
+	if (units <= TRIE_POOL_CLASSES) {
+		trie_pool_release(trie, chunk, units);
+		return;
+	}
+
+	block = (TrieBlock *) chunk - 1;
 
-		/* Find the next node now. We might free this node. */
-		next_prev_ptr = &node->next[(unsigned char) *p];
-		next_node = *next_prev_ptr;
-		++p;
+	if (block->link.prev != NULL) {
+		block->link.prev->link.next = block->link.next;
+	} else {
+		trie->large_blocks = block->link.next;
+	}
 
-		/* Decrease the use count and free the node if it
-		 * reaches zero. */
-		--node->use_count;
+	if (block->link.next != NULL) {
+		block->link.next->link.prev = block->link.prev;
+	}
 
-		if (node->use_count == 0) {
-			free(node);
+	free(block);
+}
 
-			if (prev_ptr != NULL) {
-				*prev_ptr = NULL;
+/* Find the child of a node with the smallest first byte that is at
+ * least *c, storing its first byte back to *c.  NULL is returned if
+ * there is no such child. */
+static TrieNode *trie_next_child(TrieNode *node, unsigned int *c)
+{
+	unsigned char *keys;
+	unsigned int i;
+
+	keys = TRIE_NODE_KEYS(node);
+
+	switch (node->type) {
+	case TRIE_NODE4:
+	case TRIE_NODE16:
+		for (i = 0; i < node->num_children; ++i) {
+			if (keys[i] >= *c) {
+				*c = keys[i];
+				return node->children[i];
 			}
+		}
+		break;
 
-			next_prev_ptr = NULL;
+	case TRIE_NODE48:
+		for (; *c < 256; ++*c) {
+			if (keys[*c] != 0) {
+				return node->children[keys[*c] - 1];
+			}
 		}
+		break;
 
-		/* Update pointers */
-		node = next_node;
-		prev_ptr = next_prev_ptr;
+	case TRIE_NODE256:
+		for (; *c < 256; ++*c) {
+			if (node->children[*c] != NULL) {
+				return node->children[*c];
+			}
+		}
+		break;
 	}
-}
 
-static int trie_value_is_null(TrieValue *v)
-{
-	return !memcmp(v, &trie_null_value, sizeof(TrieValue));
+	return NULL;
 }
 
-int trie_insert(Trie *trie, char *key, TrieValue value)
+static void free_node_recursive(TrieNode *node)
 {
-	TrieNode **rover;
-	TrieNode *node;
-	char *p;
-	int c;
+	TrieNode *child;
+	unsigned int c;
 
-	/* Cannot insert NULL values */
-	if (trie_value_is_null(&value)) {
-		return 0;
+	if (node == NULL) {
+		return;
 	}
 
-	/* Search to see if this is already in the tree */
-	node = trie_find_end(trie, key);
-
-	/* Already in the tree? If so, replace the existing value and
-	 * return success. */
-	if (node != NULL && !trie_value_is_null(&node->data)) {
-		node->data = value;
-		return 1;
+	/* Free all subnodes */
+	for (c = 0; (child = trie_next_child(node, &c)) != NULL; ++c) {
+		free_node_recursive(child);
 	}
 
-	/* Search down the trie until we reach the end of string,
-	 * creating nodes as necessary */
-	rover = &trie->root_node;
-	p = key;
+	free(node);
+}
 
-	for (;;) {
+static void trie_free_blocks(TrieBlock *block)
+{
+	TrieBlock *next;
 
-		node = *rover;
+	while (block != NULL) {
+		next = block->link.next;
+		free(block);
+		block = next;
+	}
+}
 
-		if (node == NULL) {
+void trie_free(Trie *trie)
+{
+	/* The nodes of a pooled trie are freed along with their blocks,
+	 * so there is no need to visit them. */
+	if ((trie->flags & TRIE_POOLED) != 0) {
+		trie_free_blocks(trie->blocks);
+		trie_free_blocks(trie->large_blocks);
+	} else {
+		free_node_recursive(trie->root_node);
+	}
 
-			/* Node does not exist, so create it */
-			node = (TrieNode *) calloc(1, sizeof(TrieNode));
+	free(trie);
+}
 
-			if (node == NULL) {
+/* A frozen trie is a copy of the nodes of a trie written to a buffer,
+ * with the offset of each node from the start of the buffer in place of
+ * pointers, so that the buffer can be saved to a file and mapped into
+ * memory at any address.  Integers are stored in little-endian byte
+ * order, and values are replaced by their position in key order.
+ *
+ * Header:
+ *   4 bytes   cookie
+ *   4 bytes   number of entries
+ *   4 bytes   offset of the root node, or zero for an empty trie
+ *   4 bytes   total size in bytes
+ *
+ * Each node:
+ *   4 bytes   one more than the position of the node's value, or zero
+ *             if it has no value
+ *   4 bytes   length of the label
+ *   2 bytes   number of children
+ *   ...       the label
+ *   ...       for up to TRIE_FROZEN_SPARSE children, 1 byte for the
+ *             first byte of each child in increasing order, followed
+ *             by 4 bytes for the offset of each child; otherwise, 4
+ *             bytes for the offset of the child for each possible
+ *             first byte, or zero if there is no child
+ *
+ * Nodes are written in key order, so that each child is stored after
+ * its parent. */
+
+/* Identifies a frozen trie, "TRI1" read as a little-endian integer */
+#define TRIE_FROZEN_COOKIE 0x31495254UL
+
+#define TRIE_FROZEN_HEADER_SIZE 16
+#define TRIE_FROZEN_NODE_SIZE   10
+#define TRIE_FROZEN_SPARSE      48
+
+/* Offsets are 32 bits, so the buffer cannot be larger than this */
+#define TRIE_FROZEN_MAX_SIZE    0xffffffffUL
+
+static unsigned char *trie_write16(unsigned char *buffer, unsigned int value)
+{
+	buffer[0] = (unsigned char) (value & 0xff);
+	buffer[1] = (unsigned char) ((value >> 8) & 0xff);
 
-				/* Allocation failed.  Go back and undo
-				 * what we have done so far. */
-				trie_insert_rollback(trie,
-				                     (unsigned char *) key);
+	return buffer + 2;
+}
 
-				return 0;
-			}
+static unsigned char *trie_write32(unsigned char *buffer, unsigned long value)
+{
+	buffer = trie_write16(buffer, (unsigned int) (value & 0xffff));
 
-			node->data = trie_null_value;
+	return trie_write16(buffer, (unsigned int) ((value >> 16) & 0xffff));
+}
 
-			/* Link in to the trie */
-			*rover = node;
-		}
+static unsigned int trie_read16(const unsigned char *buffer)
+{
+	return (unsigned int) buffer[0] | ((unsigned int) buffer[1] << 8);
+}
 
-		/* Increase the node use count */
-		++node->use_count;
+static unsigned long trie_read32(const unsigned char *buffer)
+{
+	return (unsigned long) trie_read16(buffer) |
+	       ((unsigned long) trie_read16(buffer + 2) << 16);
+}
 
-		/* Current character */
-		c = (unsigned char) *p;
+/* Number of bytes needed for the table of children of a frozen node */
+static unsigned long trie_frozen_table_size(unsigned int num_children)
+{
+	if (num_children > TRIE_FROZEN_SPARSE) {
+		return 256 * 4;
+	} else {
+		return (unsigned long) num_children * 5;
+	}
+}
 
-		/* Reached the end of string?  If so, we're finished. */
-		if (c == '\0') {
+/* Number of bytes needed to freeze a node and the nodes below it.  The
+ * result stops growing once it is past the largest possible size. */
+static unsigned long trie_frozen_node_size(TrieNode *node)
+{
+	TrieNode *child;
+	unsigned long size;
+	unsigned int c;
 
-			/* Set the data at the node we have reached */
-			node->data = value;
+	size = TRIE_FROZEN_NODE_SIZE + (unsigned long) node->label_length
+	     + trie_frozen_table_size(node->num_children);
 
-			break;
-		}
+	for (c = 0; (child = trie_next_child(node, &c)) != NULL; ++c) {
+		size += trie_frozen_node_size(child);
 
-		/* Advance to the next node in the chain */
-		rover = &node->next[c];
-		++p;
+		if (size > TRIE_FROZEN_MAX_SIZE) {
+			return TRIE_FROZEN_MAX_SIZE + 1;
+		}
 	}
 
-	return 1;
+	return size;
 }
 
-int trie_insert_binary(Trie *trie, unsigned char *key, int key_length,
-                       TrieValue value)
+size_t trie_frozen_size(Trie *trie)
 {
-	TrieNode **rover;
-	TrieNode *node;
-	int p, c;
+	unsigned long size;
 
-	/* Cannot insert NULL values */
-	if (trie_value_is_null(&value)) {
-		return 0;
+	if (trie->frozen != NULL) {
+		return (size_t) trie->frozen_size;
 	}
 
-	/* Search to see if this is already in the tree */
-	node = trie_find_end_binary(trie, key, key_length);
+	size = TRIE_FROZEN_HEADER_SIZE;
 
-	/* Already in the tree? If so, replace the existing value and
-	 * return success. */
-	if (node != NULL && !trie_value_is_null(&node->data)) {
-		node->data = value;
-		return 1;
+	if (trie->root_node != NULL) {
+		size += trie_frozen_node_size(trie->root_node);
 	}
 
-	/* Search down the trie until we reach the end of string,
-	 * creating nodes as necessary */
-	rover = &trie->root_node;
-	p = 0;
-
-	for (;;) {
+	if (size > TRIE_FROZEN_MAX_SIZE) {
+		return 0;
+	}
 
-		node = *rover;
+	return (size_t) size;
+}
 
-		if (node == NULL) {
+/* Write a node and the nodes below it at the given offset, returning the
+ * offset of the end of what was written.  *position counts the values
+ * written so far. */
+static unsigned long trie_freeze_node(TrieNode *node, unsigned char *buffer,
+                                      unsigned long offset,
+                                      unsigned long *position)
+{
+	TrieNode *child;
+	unsigned char *p;
+	unsigned long table;
+	unsigned long end;
+	unsigned int num_children;
+	unsigned int c;
+	unsigned int i;
 
-			/* Node does not exist, so create it */
-			node = (TrieNode *) calloc(1, sizeof(TrieNode));
+	p = buffer + offset;
 
-			if (node == NULL) {
+	if (trie_value_is_null(&node->data)) {
+		p = trie_write32(p, 0);
+	} else {
+		++*position;
+		p = trie_write32(p, *position);
+	}
 
-				/* Allocation failed.  Go back and undo
-				 * what we have done so far. */
-				trie_insert_rollback(trie, key);
+	num_children = node->num_children;
+	p = trie_write32(p, node->label_length);
+	p = trie_write16(p, num_children);
+	memcpy(p, TRIE_NODE_LABEL(node), node->label_length);
 
-				return 0;
-			}
+	table = offset + TRIE_FROZEN_NODE_SIZE + node->label_length;
+	end = table + trie_frozen_table_size(num_children);
 
-			node->data = trie_null_value;
+	if (num_children > TRIE_FROZEN_SPARSE) {
+		memset(buffer + table, 0, 256 * 4);
+	}
 
-			/* Link in to the trie */
-			*rover = node;
+	/* Each child is written after the ones before it, so its offset
+	 * is only known once they have been written */
+	for (c = 0, i = 0; (child = trie_next_child(node, &c)) != NULL;
+	     ++c, ++i) {
+		if (num_children > TRIE_FROZEN_SPARSE) {
+			trie_write32(buffer + table + c * 4, end);
+		} else {
+			buffer[table + i] = (unsigned char) c;
+			trie_write32(buffer + table + num_children + i * 4, end);
 		}
 
-		/* Increase the node use count */
-		++node->use_count;
+		end = trie_freeze_node(child, buffer, end, position);
+	}
 
-		/* Current character */
-		c = (unsigned char) key[p];
+	return end;
+}
 
-		/* Reached the end of string?  If so, we're finished. */
-		if (p == key_length) {
+size_t trie_freeze(Trie *trie, unsigned char *buffer)
+{
+	unsigned long size;
+	unsigned long root;
+	unsigned long position;
 
-			/* Set the data at the node we have reached */
-			node->data = value;
+	if (trie->frozen != NULL) {
+		memcpy(buffer, trie->frozen, (size_t) trie->frozen_size);
+		return (size_t) trie->frozen_size;
+	}
 
-			break;
-		}
+	size = (unsigned long) trie_frozen_size(trie);
+
+	if (size == 0) {
+		return 0;
+	}
 
-		/* Advance to the next node in the chain */
-		rover = &node->next[c];
-		++p;
+	if (trie->root_node != NULL) {
+		root = TRIE_FROZEN_HEADER_SIZE;
+		position = 0;
+		trie_freeze_node(trie->root_node, buffer, root, &position);
+	} else {
+		root = 0;
 	}
 
-	return 1;
+	buffer = trie_write32(buffer, TRIE_FROZEN_COOKIE);
+	buffer = trie_write32(buffer, trie->num_entries);
+	buffer = trie_write32(buffer, root);
+	trie_write32(buffer, size);
+
+	return (size_t) size;
 }
 
-int trie_remove_binary(Trie *trie, unsigned char *key, int key_length)
+Trie *trie_new_frozen(const unsigned char *buffer, size_t length,
+                      TrieValue *values)
 {
-	TrieNode *node;
-	TrieNode *next;
-	TrieNode **last_next_ptr;
-	int p, c;
+	Trie *trie;
+	unsigned long size;
+	unsigned long root;
+
+	/* Only the header is checked here, so that creating the trie
+	 * does not need to read the whole buffer.  Lookups check each
+	 * node as they read it. */
+	if (length < TRIE_FROZEN_HEADER_SIZE
+	 || trie_read32(buffer) != TRIE_FROZEN_COOKIE) {
+		return NULL;
+	}
 
-	/* Find the end node and remove the value */
-	node = trie_find_end_binary(trie, key, key_length);
+	root = trie_read32(buffer + 8);
+	size = trie_read32(buffer + 12);
 
-	if (node != NULL && !trie_value_is_null(&node->data)) {
-		node->data = trie_null_value;
-	} else {
-		return 0;
+	if (size < TRIE_FROZEN_HEADER_SIZE || size > length
+	 || (root != 0 && (root < TRIE_FROZEN_HEADER_SIZE || root >= size))) {
+		return NULL;
 	}
 
-	/* Now traverse the tree again as before, decrementing the use
-	 * count of each node.  Free back nodes as necessary. */
-	node = trie->root_node;
-	last_next_ptr = &trie->root_node;
-	p = 0;
+	trie = trie_new();
 
-	for (;;) {
+	if (trie == NULL) {
+		return NULL;
+	}
+
+	trie->num_entries = (unsigned int) trie_read32(buffer + 4);
+	trie->frozen = buffer;
+	trie->frozen_size = size;
+	trie->frozen_values = values;
 
-		/* Find the next node */
-		c = (unsigned char) key[p];
-		next = node->next[c];
+	return trie;
+}
 
-		/* Free this node if necessary */
-		--node->use_count;
+/* Follow a key down a frozen trie, returning the stored position of the
+ * value for the longest key that is a prefix of it, and the length of
+ * that key, or zero if there is none.  If exact is non-zero, only a
+ * value for the whole key is returned.  A node that does not fit in
+ * the buffer or a child that is not after its parent ends the search,
+ * so a damaged buffer can never be read past its end or cause a loop. */
+static unsigned long trie_frozen_find(Trie *trie, unsigned char *key,
+                                      unsigned int key_length, int exact,
+                                      unsigned int *prefix_length)
+{
+	const unsigned char *data;
+	const unsigned char *keys;
+	const unsigned char *found;
+	unsigned long size;
+	unsigned long offset;
+	unsigned long next;
+	unsigned long value;
+	unsigned long label_length;
+	unsigned long result;
+	unsigned int num_children;
+	unsigned int matched;
+
+	data = trie->frozen;
+	size = trie->frozen_size;
+	offset = trie_read32(data + 8);
+	result = 0;
+	matched = 0;
+
+	while (offset != 0 && offset <= size - TRIE_FROZEN_NODE_SIZE) {
+		value = trie_read32(data + offset);
+		label_length = trie_read32(data + offset + 4);
+		num_children = trie_read16(data + offset + 8);
+		offset += TRIE_FROZEN_NODE_SIZE;
+
+		/* The whole label must match the next part of the key */
+		if (label_length > key_length - matched
+		 || label_length > size - offset
+		 || memcmp(data + offset, key + matched,
+		           (size_t) label_length) != 0) {
+			break;
+		}
 
-		if (node->use_count <= 0) {
-			free(node);
+		matched += (unsigned int) label_length;
+		offset += label_length;
 
-			/* Set the "next" pointer on the previous node to NULL,
-			 * to unlink the freed node from the tree.  This only
-			 * needs to be done once in a remove.  After the first
-			 * unlink, all further nodes are also going to be
-			 * free'd. */
-			if (last_next_ptr != NULL) {
-				*last_next_ptr = NULL;
-				last_next_ptr = NULL;
-			}
+		if (value != 0 && (!exact || matched == key_length)) {
+			result = value;
+			*prefix_length = matched;
 		}
 
-		/* Go to the next character or finish */
-		if (p == key_length) {
+		if (matched == key_length
+		 || trie_frozen_table_size(num_children) > size - offset) {
 			break;
+		}
+
+		/* Jump to the next node */
+		if (num_children > TRIE_FROZEN_SPARSE) {
+			next = trie_read32(data + offset + key[matched] * 4U);
 		} else {
-			++p;
+			keys = data + offset;
+			found = (const unsigned char *)
+			        memchr(keys, key[matched], num_children);
+
+			if (found == NULL) {
+				break;
+			}
+
+			next = trie_read32(keys + num_children
+			                   + (found - keys) * 4);
 		}
 
-		/* If necessary, save the location of the "next" pointer
-		 * so that it may be set to NULL on the next iteration if
-		 * the next node visited is freed. */
-		if (last_next_ptr != NULL) {
-			last_next_ptr = &node->next[c];
+		if (next < offset) {
+			break;
 		}
 
-		/* Jump to the next node */
-		node = next;
+		offset = next;
 	}
 
-	/* Removed successfully */
-	return 1;
+	return result;
 }
 
-int trie_remove(Trie *trie, char *key)
+/* Find the value stored at a position in a frozen trie */
+static TrieValue trie_frozen_value(Trie *trie, unsigned long position)
+{
+	if (position == 0 || position > trie->num_entries) {
+		return trie_null_value;
+	}
+
+	return trie->frozen_values[position - 1];
+}
+
+static size_t trie_node_size(unsigned int type, unsigned int label_length)
+{
+	size_t size;
+
+	size = offsetof(TrieNode, children) +
+	       trie_node_capacity[type] * sizeof(TrieNode *) +
+	       trie_node_key_bytes[type] + label_length;
+
+	return size < sizeof(TrieNode) ? sizeof(TrieNode) : size;
+}
+
+/* Allocate a node of the given form with no children and no value,
+ * labelled with the given bytes. */
+static TrieNode *trie_new_node(Trie *trie, unsigned int type,
+                               unsigned char *label, unsigned int length)
 {
 	TrieNode *node;
-	TrieNode *next;
-	TrieNode **last_next_ptr;
-	char *p;
-	int c;
 
-	/* Find the end node and remove the value */
-	node = trie_find_end(trie, key);
+	node = (TrieNode *) trie_alloc(trie, trie_node_size(type, length));
 
-	if (node != NULL && !trie_value_is_null(&node->data)) {
-		node->data = trie_null_value;
-	} else {
-		return 0;
+	if (node == NULL) {
+		return NULL;
 	}
 
-	/* Now traverse the tree again as before, decrementing the use
-	 * count of each node.  Free back nodes as necessary. */
-	node = trie->root_node;
-	last_next_ptr = &trie->root_node;
-	p = key;
+	node->data = trie_null_value;
+	node->label_length = length;
+	node->num_children = 0;
+	node->type = (unsigned char) type;
 
-	for (;;) {
+	if (type == TRIE_NODE256) {
+		memset(node->children, 0, 256 * sizeof(TrieNode *));
+	}
 
-		/* Find the next node */
-		c = (unsigned char) *p;
-		next = node->next[c];
+	memset(TRIE_NODE_KEYS(node), 0, trie_node_key_bytes[type]);
+	memcpy(TRIE_NODE_LABEL(node), label, length);
 
-		/* Free this node if necessary */
-		--node->use_count;
+	return node;
+}
 
-		if (node->use_count <= 0) {
-			free(node);
+static void trie_free_node(Trie *trie, TrieNode *node)
+{
+	trie_release(trie, node, trie_node_size(node->type, node->label_length));
+}
 
-			/* Set the "next" pointer on the previous node to NULL,
-			 * to unlink the freed node from the tree.  This only
-			 * needs to be done once in a remove.  After the first
-			 * unlink, all further nodes are also going to be
-			 * free'd. */
-			if (last_next_ptr != NULL) {
-				*last_next_ptr = NULL;
-				last_next_ptr = NULL;
-			}
-		}
+/* Move a node to a larger allocation, with the same contents */
+static TrieNode *trie_grow_node(Trie *trie, TrieNode *node, size_t size)
+{
+	TrieNode *result;
+	size_t old_size;
 
-		/* Go to the next character or finish */
-		if (c == '\0') {
-			break;
-		} else {
-			++p;
-		}
+	if ((trie->flags & TRIE_POOLED) == 0) {
+		return (TrieNode *) realloc(node, size);
+	}
 
-		/* If necessary, save the location of the "next" pointer
-		 * so that it may be set to NULL on the next iteration if
-		 * the next node visited is freed. */
-		if (last_next_ptr != NULL) {
-			last_next_ptr = &node->next[c];
-		}
+	old_size = trie_node_size(node->type, node->label_length);
 
-		/* Jump to the next node */
-		node = next;
+	if ((size + TRIE_POOL_UNIT - 1) / TRIE_POOL_UNIT <=
+	    (old_size + TRIE_POOL_UNIT - 1) / TRIE_POOL_UNIT) {
+		return node;
 	}
 
-	/* Removed successfully */
-	return 1;
+	result = (TrieNode *) trie_alloc(trie, size);
+
+	if (result == NULL) {
+		return NULL;
+	}
+
+	memcpy(result, node, old_size);
+	trie_free_node(trie, node);
+
+	return result;
 }
 
-TrieValue trie_lookup(Trie *trie, char *key)
+#if defined(__SSE2__) && defined(__GNUC__)
+
+/* Find the index of the lowest bit that is set in a non-zero mask. */
+static unsigned int trie_lowest_bit(unsigned int mask)
 {
-	TrieNode *node;
+	return (unsigned int) __builtin_ctz(mask);
+}
 
-	node = trie_find_end(trie, key);
+#elif defined(__SSE2__)
 
-	if (node != NULL) {
-		return node->data;
-	} else {
-		return trie_null_value;
+static unsigned int trie_lowest_bit(unsigned int mask)
+{
+	unsigned int result;
+
+	for (result = 0; (mask & 1) == 0; ++result) {
+		mask >>= 1;
 	}
+
+	return result;
 }
 
-TrieValue trie_lookup_binary(Trie *trie, unsigned char *key, int key_length)
+#endif
+
+/* Find the position of a byte in the keys of a node16, or the number of
+ * children if it is not present.  All sixteen bytes are compared at
+ * once where SSE2 is available. */
+static unsigned int trie_node16_search(TrieNode *node, unsigned char c)
 {
-	TrieNode *node;
+#ifdef __SSE2__
+	__m128i keys;
+	unsigned int match;
 
-	node = trie_find_end_binary(trie, key, key_length);
+	keys = _mm_loadu_si128((const __m128i *) TRIE_NODE_KEYS(node));
+	match = (unsigned int) _mm_movemask_epi8(
+	            _mm_cmpeq_epi8(keys, _mm_set1_epi8((char) c))) &
+	        ((1U << node->num_children) - 1);
 
-	if (node != NULL) {
-		return node->data;
-	} else {
-		return trie_null_value;
+	if (match != 0) {
+		return trie_lowest_bit(match);
 	}
-}
 
-unsigned int trie_num_entries(Trie *trie)
-{
-	/* To find the number of entries, simply look at the use count
-	 * of the root node. */
-	if (trie->root_node == NULL) {
-		return 0;
+	return node->num_children;
+#else
+	unsigned char *keys;
+	unsigned int i;
+
+	keys = TRIE_NODE_KEYS(node);
+
+	for (i = 0; i < node->num_children && keys[i] != c; ++i)
+		;
+
+	return i;
+#endif
+}
+
+/* Find the pointer to the child of a node starting with the given byte,
+ * or NULL if there is none. */
+static TrieNode **trie_find_child(TrieNode *node, unsigned char c)
+{
+	unsigned char *keys;
+	unsigned int i;
+
+	switch (node->type) {
+	case TRIE_NODE4:
+		keys = TRIE_NODE_KEYS(node);
+
+		for (i = 0; i < node->num_children; ++i) {
+			if (keys[i] == c) {
+				return &node->children[i];
+			}
+		}
+		break;
+
+	case TRIE_NODE16:
+		i = trie_node16_search(node, c);
+
+		if (i < node->num_children) {
+			return &node->children[i];
+		}
+		break;
+
+	case TRIE_NODE48:
+		i = TRIE_NODE_KEYS(node)[c];
+
+		if (i != 0) {
+			return &node->children[i - 1];
+		}
+		break;
+
+	case TRIE_NODE256:
+		if (node->children[c] != NULL) {
+			return &node->children[c];
+		}
+		break;
+	}
+
+	return NULL;
+}
+
+/* Add a child to a node that has room for it. */
+static void trie_insert_child(TrieNode *node, unsigned char c,
+                              TrieNode *child)
+{
+	unsigned char *keys;
+	unsigned int i;
+
+	keys = TRIE_NODE_KEYS(node);
+
+	switch (node->type) {
+	case TRIE_NODE4:
+	case TRIE_NODE16:
+		for (i = node->num_children; i > 0 && keys[i - 1] > c; --i) {
+			keys[i] = keys[i - 1];
+			node->children[i] = node->children[i - 1];
+		}
+
+		keys[i] = c;
+		node->children[i] = child;
+		break;
+
+	case TRIE_NODE48:
+		node->children[node->num_children] = child;
+		keys[c] = (unsigned char) (node->num_children + 1);
+		break;
+
+	case TRIE_NODE256:
+		node->children[c] = child;
+		break;
+	}
+
+	++node->num_children;
+}
+
+/* Move a node to a different form, which must have room for all of its
+ * children. */
+static int trie_resize_node(Trie *trie, TrieNode **slot, unsigned int type)
+{
+	TrieNode *node;
+	TrieNode *new_node;
+	TrieNode *child;
+	unsigned int c;
+
+	node = *slot;
+	new_node = trie_new_node(trie, type, TRIE_NODE_LABEL(node),
+	                         node->label_length);
+
+	if (new_node == NULL) {
+		return 0;
+	}
+
+	new_node->data = node->data;
+
+	for (c = 0; (child = trie_next_child(node, &c)) != NULL; ++c) {
+		trie_insert_child(new_node, (unsigned char) c, child);
+	}
+
+	*slot = new_node;
+	trie_free_node(trie, node);
+
+	return 1;
+}
+
+/* Add a child to a node, moving the node to a larger form if it is
+ * full. */
+static int trie_add_child(Trie *trie, TrieNode **slot, TrieNode *child)
+{
+	TrieNode *node;
+
+	node = *slot;
+
+	if (node->num_children == trie_node_capacity[node->type]) {
+		if (!trie_resize_node(trie, slot, node->type + 1U)) {
+			return 0;
+		}
+
+		node = *slot;
+	}
+
+	trie_insert_child(node, TRIE_NODE_LABEL(child)[0], child);
+
+	return 1;
+}
+
+/* Remove the child of a node starting with the given byte.  The node is
+ * moved to a smaller form once it is well under the size of that form,
+ * if the memory for it can be allocated. */
+static void trie_remove_child(Trie *trie, TrieNode **slot, unsigned char c)
+{
+	TrieNode *node;
+	unsigned char *keys;
+	unsigned int last;
+	unsigned int i;
+
+	node = *slot;
+	keys = TRIE_NODE_KEYS(node);
+	last = node->num_children - 1U;
+
+	switch (node->type) {
+	case TRIE_NODE4:
+	case TRIE_NODE16:
+		for (i = 0; keys[i] != c; ++i)
+			;
+
+		for (; i < last; ++i) {
+			keys[i] = keys[i + 1];
+			node->children[i] = node->children[i + 1];
+		}
+		break;
+
+	case TRIE_NODE48:
+
+		/* The last child is moved into the position of the one
+		 * removed, to keep the children array packed */
+		i = keys[c] - 1U;
+		keys[c] = 0;
+
+		if (i != last) {
+			node->children[i] = node->children[last];
+
+			for (c = 0; keys[c] != last + 1; ++c)
+				;
+
+			keys[c] = (unsigned char) (i + 1);
+		}
+		break;
+
+	case TRIE_NODE256:
+		node->children[c] = NULL;
+		break;
+	}
+
+	--node->num_children;
+
+	if (node->num_children * 4U <=
+	    trie_node_capacity[node->type - 1] * 3U) {
+		trie_resize_node(trie, slot, node->type - 1U);
+	}
+}
+
+/* Find the number of bytes at the start of a node's label which match a
+ * key. */
+static unsigned int trie_match_label(TrieNode *node, unsigned char *key,
+                                     unsigned int key_length)
+{
+	unsigned char *label;
+	unsigned int length;
+	unsigned int i;
+
+	label = TRIE_NODE_LABEL(node);
+	length = node->label_length;
+
+	if (length > key_length) {
+		length = key_length;
+	}
+
+	for (i = 0; i < length && label[i] == key[i]; ++i)
+		;
+
+	return i;
+}
+
+static TrieNode *trie_find_end_binary(Trie *trie, unsigned char *key,
+                                      int key_length)
+{
+	TrieNode *node;
+	TrieNode **child;
+	unsigned int remaining;
+
+	node = trie->root_node;
+	remaining = (unsigned int) key_length;
+
+	/* Search down the trie until the end of the key is reached */
+	while (node != NULL) {
+
+		/* The whole label must match the next part of the key */
+		if (node->label_length > remaining ||
+		    memcmp(TRIE_NODE_LABEL(node), key, node->label_length) != 0) {
+			return NULL;
+		}
+
+		key += node->label_length;
+		remaining -= node->label_length;
+
+		/* This key is present if the value at this node is not
+		 * NULL */
+		if (remaining == 0) {
+			return node;
+		}
+
+		/* Jump to the next node */
+		child = trie_find_child(node, *key);
+
+		if (child == NULL) {
+			return NULL;
+		}
+
+		node = *child;
+	}
+
+	return NULL;
+}
+
+/* Split a node after the given number of bytes of its label, putting a
+ * new node with the start of the label in its place.  If the key being
+ * inserted does not end at the split, a new leaf is added to the new
+ * node for the rest of the key.  All memory is allocated before the
+ * trie is changed, so that nothing needs to be undone on failure. */
+static int trie_split_node(Trie *trie, TrieNode **slot, unsigned int matched,
+                           unsigned char *key, unsigned int remaining,
+                           TrieValue value)
+{
+	TrieNode *node;
+	TrieNode *parent;
+	TrieNode *leaf;
+	unsigned char *label;
+
+	node = *slot;
+	label = TRIE_NODE_LABEL(node);
+	parent = trie_new_node(trie, TRIE_NODE4, label, matched);
+
+	if (parent == NULL) {
+		return 0;
+	}
+
+	leaf = NULL;
+
+	if (matched < remaining) {
+		leaf = trie_new_node(trie, TRIE_LEAF, key + matched,
+		                     remaining - matched);
+
+		if (leaf == NULL) {
+			trie_free_node(trie, parent);
+			return 0;
+		}
+
+		leaf->data = value;
 	} else {
-		return trie->root_node->use_count;
+		parent->data = value;
+	}
+
+	/* The existing node keeps the rest of its label */
+	node->label_length -= matched;
+	memmove(label, label + matched, node->label_length);
+
+	trie_insert_child(parent, label[0], node);
+
+	if (leaf != NULL) {
+		trie_insert_child(parent, key[matched], leaf);
 	}
+
+	*slot = parent;
+
+	return 1;
+}
+
+int trie_insert_binary(Trie *trie, unsigned char *key, int key_length,
+                       TrieValue value)
+{
+	TrieNode **slot;
+	TrieNode **child;
+	TrieNode *node;
+	TrieNode *leaf;
+	unsigned int remaining;
+	unsigned int matched;
+
+	/* Cannot insert NULL values, or change a frozen trie */
+	if (trie_value_is_null(&value) || trie->frozen != NULL) {
+		return 0;
+	}
+
+	/* Search down the trie until we reach the end of the key,
+	 * splitting a node or adding a new one where the key leaves the
+	 * existing trie */
+	if ((unsigned int) key_length > trie->max_key_length) {
+		trie->max_key_length = (unsigned int) key_length;
+	}
+
+	slot = &trie->root_node;
+	remaining = (unsigned int) key_length;
+
+	for (;;) {
+
+		node = *slot;
+
+		if (node == NULL) {
+			node = trie_new_node(trie, TRIE_LEAF, key, remaining);
+
+			if (node == NULL) {
+				return 0;
+			}
+
+			node->data = value;
+			*slot = node;
+			++trie->num_entries;
+
+			return 1;
+		}
+
+		matched = trie_match_label(node, key, remaining);
+
+		if (matched < node->label_length) {
+			if (!trie_split_node(trie, slot, matched, key,
+			                     remaining, value)) {
+				return 0;
+			}
+
+			++trie->num_entries;
+
+			return 1;
+		}
+
+		key += matched;
+		remaining -= matched;
+
+		/* Reached the end of the key?  If so, set the value here,
+		 * replacing any existing value. */
+		if (remaining == 0) {
+			if (trie_value_is_null(&node->data)) {
+				++trie->num_entries;
+			}
+
+			node->data = value;
+
+			return 1;
+		}
+
+		child = trie_find_child(node, *key);
+
+		if (child != NULL) {
+			slot = child;
+			continue;
+		}
+
+		/* Add a new leaf holding the rest of the key */
+		leaf = trie_new_node(trie, TRIE_LEAF, key, remaining);
+
+		if (leaf == NULL) {
+			return 0;
+		}
+
+		if (!trie_add_child(trie, slot, leaf)) {
+			trie_free_node(trie, leaf);
+			return 0;
+		}
+
+		leaf->data = value;
+		++trie->num_entries;
+
+		return 1;
+	}
+}
+
+int trie_insert(Trie *trie, char *key, TrieValue value)
+{
+	return trie_insert_binary(trie, (unsigned char *) key,
+	                          (int) strlen(key), value);
+}
+
+/* Restore the structure of the trie around a node after a value or a
+ * child has been removed from it.  A node with neither is freed, and a
+ * node with no value and a single child is merged into the child.  The
+ * merge needs a larger allocation for the child's label; if that is not
+ * possible, the node is left as it is, which only costs some memory. */
+static void trie_tidy_node(Trie *trie, TrieNode **slot)
+{
+	TrieNode *node;
+	TrieNode *child;
+	unsigned char *label;
+	unsigned int c;
+
+	node = *slot;
+
+	if (!trie_value_is_null(&node->data) || node->num_children > 1) {
+		return;
+	}
+
+	if (node->num_children == 0) {
+		trie_free_node(trie, node);
+		*slot = NULL;
+		return;
+	}
+
+	c = 0;
+	child = trie_next_child(node, &c);
+	child = trie_grow_node(trie, child,
+	                       trie_node_size(child->type,
+	                                      node->label_length +
+	                                          child->label_length));
+
+	if (child == NULL) {
+		return;
+	}
+
+	label = TRIE_NODE_LABEL(child);
+	memmove(label + node->label_length, label, child->label_length);
+	memcpy(label, TRIE_NODE_LABEL(node), node->label_length);
+	child->label_length += node->label_length;
+
+	*slot = child;
+	trie_free_node(trie, node);
+}
+
+int trie_remove_binary(Trie *trie, unsigned char *key, int key_length)
+{
+	TrieNode **slot;
+	TrieNode **parent_slot;
+	TrieNode **child;
+	TrieNode *node;
+	unsigned int remaining;
+	unsigned char c;
+
+	if (trie->frozen != NULL) {
+		return 0;
+	}
+
+	/* Find the node holding the value, and the node above it */
+	slot = &trie->root_node;
+	parent_slot = NULL;
+	remaining = (unsigned int) key_length;
+
+	for (;;) {
+
+		node = *slot;
+
+		if (node == NULL || node->label_length > remaining ||
+		    memcmp(TRIE_NODE_LABEL(node), key,
+		           node->label_length) != 0) {
+			return 0;
+		}
+
+		key += node->label_length;
+		remaining -= node->label_length;
+
+		if (remaining == 0) {
+			break;
+		}
+
+		child = trie_find_child(node, *key);
+
+		if (child == NULL) {
+			return 0;
+		}
+
+		parent_slot = slot;
+		slot = child;
+	}
+
+	if (trie_value_is_null(&node->data)) {
+		return 0;
+	}
+
+	node->data = trie_null_value;
+	--trie->num_entries;
+
+	/* A leaf is unlinked from its parent, which may then be left with
+	 * only one child itself. */
+	if (node->num_children == 0 && parent_slot != NULL) {
+		c = TRIE_NODE_LABEL(node)[0];
+		trie_free_node(trie, node);
+		trie_remove_child(trie, parent_slot, c);
+		slot = parent_slot;
+	}
+
+	trie_tidy_node(trie, slot);
+
+	/* Removed successfully */
+	return 1;
+}
+
+int trie_remove(Trie *trie, char *key)
+{
+	return trie_remove_binary(trie, (unsigned char *) key,
+	                          (int) strlen(key));
+}
+
+TrieValue trie_lookup(Trie *trie, char *key)
+{
+	return trie_lookup_binary(trie, (unsigned char *) key,
+	                          (int) strlen(key));
+}
+
+TrieValue trie_lookup_binary(Trie *trie, unsigned char *key, int key_length)
+{
+	TrieNode *node;
+	unsigned int prefix_length;
+
+	if (trie->frozen != NULL) {
+		return trie_frozen_value(
+		    trie, trie_frozen_find(trie, key, (unsigned int) key_length,
+		                           1, &prefix_length));
+	}
+
+	node = trie_find_end_binary(trie, key, key_length);
+
+	if (node != NULL) {
+		return node->data;
+	} else {
+		return trie_null_value;
+	}
+}
+
+/* Look up a batch of keys.  The keys that have not finished are kept
+ * at the start of the active array, and each pass over them moves every
+ * one down a level. */
+static unsigned int trie_lookup_batch(Trie *trie, unsigned char **keys,
+                                      unsigned int *key_lengths,
+                                      TrieValue *values, unsigned int batch)
+{
+	TrieNode *nodes[TRIE_BATCH_SIZE];
+	unsigned int positions[TRIE_BATCH_SIZE];
+	unsigned int active[TRIE_BATCH_SIZE];
+	unsigned int num_active;
+	unsigned int found;
+	unsigned int i;
+	unsigned int j;
+	TrieNode **child;
+	TrieNode *node;
+	unsigned int position;
+
+	num_active = 0;
+	found = 0;
+
+	if (trie->frozen != NULL) {
+		for (i = 0; i < batch; ++i) {
+			values[i] = trie_frozen_value(
+			    trie, trie_frozen_find(trie, keys[i], key_lengths[i],
+			                           1, &position));
+
+			if (!trie_value_is_null(&values[i])) {
+				++found;
+			}
+		}
+
+		return found;
+	}
+
+	for (i = 0; i < batch; ++i) {
+		values[i] = trie_null_value;
+
+		if (trie->root_node != NULL) {
+			nodes[i] = trie->root_node;
+			positions[i] = 0;
+			active[num_active] = i;
+			++num_active;
+		}
+	}
+
+	while (num_active > 0) {
+		j = 0;
+
+		while (j < num_active) {
+			i = active[j];
+			node = nodes[i];
+			position = positions[i];
+			child = NULL;
+
+			if (node->label_length <= key_lengths[i] - position &&
+			    memcmp(TRIE_NODE_LABEL(node), keys[i] + position,
+			           node->label_length) == 0) {
+				position += node->label_length;
+
+				if (position == key_lengths[i]) {
+					values[i] = node->data;
+
+					if (!trie_value_is_null(&values[i])) {
+						++found;
+					}
+				} else {
+					child = trie_find_child(
+					    node, keys[i][position]);
+				}
+			}
+
+			/* Move on to the child, or replace this lookup
+			 * with the last active one if it has finished */
+			if (child != NULL) {
+				nodes[i] = *child;
+				positions[i] = position;
+				TRIE_PREFETCH(*child);
+				++j;
+			} else {
+				--num_active;
+				active[j] = active[num_active];
+			}
+		}
+	}
+
+	return found;
+}
+
+unsigned int trie_lookup_many_binary(Trie *trie, unsigned char **keys,
+                                     int *key_lengths, TrieValue *values,
+                                     unsigned int count)
+{
+	unsigned int lengths[TRIE_BATCH_SIZE];
+	unsigned int batch;
+	unsigned int done;
+	unsigned int found;
+	unsigned int i;
+
+	found = 0;
+
+	for (done = 0; done < count; done += batch) {
+		batch = count - done;
+
+		if (batch > TRIE_BATCH_SIZE) {
+			batch = TRIE_BATCH_SIZE;
+		}
+
+		for (i = 0; i < batch; ++i) {
+			lengths[i] = (unsigned int) key_lengths[done + i];
+		}
+
+		found += trie_lookup_batch(trie, keys + done, lengths,
+		                           values + done, batch);
+	}
+
+	return found;
+}
+
+unsigned int trie_lookup_many(Trie *trie, char **keys, TrieValue *values,
+                              unsigned int count)
+{
+	unsigned int lengths[TRIE_BATCH_SIZE];
+	unsigned int batch;
+	unsigned int done;
+	unsigned int found;
+	unsigned int i;
+
+	found = 0;
+
+	for (done = 0; done < count; done += batch) {
+		batch = count - done;
+
+		if (batch > TRIE_BATCH_SIZE) {
+			batch = TRIE_BATCH_SIZE;
+		}
+
+		for (i = 0; i < batch; ++i) {
+			lengths[i] = (unsigned int) strlen(keys[done + i]);
+		}
+
+		found += trie_lookup_batch(trie, (unsigned char **) keys + done,
+		                           lengths, values + done, batch);
+	}
+
+	return found;
+}
+
+unsigned int trie_num_entries(Trie *trie)
+{
+	return trie->num_entries;
+}
+
+TrieValue trie_lookup_longest_prefix_binary(Trie *trie, unsigned char *key,
+                                            int key_length,
+                                            int *prefix_length)
+{
+	TrieNode *node;
+	TrieNode **child;
+	TrieValue result;
+	unsigned int remaining;
+	unsigned int length;
+	unsigned int matched;
+
+	node = trie->root_node;
+	remaining = (unsigned int) key_length;
+	result = trie_null_value;
+	length = 0;
+	matched = 0;
+
+	if (trie->frozen != NULL) {
+		result = trie_frozen_value(
+		    trie, trie_frozen_find(trie, key, remaining, 0, &length));
+		node = NULL;
+	}
+
+	/* Follow the key down the trie, remembering the last value seen */
+	while (node != NULL) {
+		if (node->label_length > remaining ||
+		    memcmp(TRIE_NODE_LABEL(node), key + matched,
+		           node->label_length) != 0) {
+			break;
+		}
+
+		matched += node->label_length;
+		remaining -= node->label_length;
+
+		if (!trie_value_is_null(&node->data)) {
+			result = node->data;
+			length = matched;
+		}
+
+		if (remaining == 0) {
+			break;
+		}
+
+		child = trie_find_child(node, key[matched]);
+
+		if (child == NULL) {
+			break;
+		}
+
+		node = *child;
+	}
+
+	if (prefix_length != NULL) {
+		*prefix_length = (int) length;
+	}
+
+	return result;
+}
+
+TrieValue trie_lookup_longest_prefix(Trie *trie, char *key,
+                                     int *prefix_length)
+{
+	return trie_lookup_longest_prefix_binary(trie, (unsigned char *) key,
+	                                         (int) strlen(key),
+	                                         prefix_length);
+}
+
+/* Allocate the memory for an iterator.  Every node other than the root
+ * adds at least one byte to the key, so no key or stack can be longer
+ * than the longest key inserted. */
+static int trie_iter_init(Trie *trie, TrieIterator *iter,
+                          unsigned char *end, int end_length)
+{
+	size_t stack_size;
+	size_t size;
+
+	/* Frozen tries can only be used for lookups */
+	if (trie->frozen != NULL) {
+		iter->stack = NULL;
+		iter->has_more = 0;
+		return 0;
+	}
+
+	stack_size = (trie->max_key_length + 2) *
+	             sizeof(struct _TrieIteratorFrame);
+	size = stack_size + trie->max_key_length + 1;
+
+	if (end != NULL) {
+		size += (size_t) end_length;
+	}
+
+	iter->stack = (struct _TrieIteratorFrame *) malloc(size);
+
+	if (iter->stack == NULL) {
+		iter->has_more = 0;
+		return 0;
+	}
+
+	iter->depth = 0;
+	iter->key = (unsigned char *) iter->stack + stack_size;
+	iter->key_length = 0;
+	iter->key[0] = '\0';
+	iter->end = NULL;
+	iter->end_length = 0;
+	iter->advance = 0;
+	iter->has_more = 0;
+
+	if (end != NULL) {
+		iter->end = iter->key + trie->max_key_length + 1;
+		iter->end_length = (unsigned int) end_length;
+		memcpy(iter->end, end, iter->end_length);
+	}
+
+	return 1;
+}
+
+/* Add a node to the iterator's stack, and its label to the key */
+static void trie_iter_push(TrieIterator *iter, TrieNode *node,
+                           unsigned int next_child)
+{
+	struct _TrieIteratorFrame *frame;
+
+	frame = &iter->stack[iter->depth];
+	++iter->depth;
+
+	frame->node = node;
+	frame->next_child = next_child;
+	frame->key_length = iter->key_length;
+
+	memcpy(iter->key + iter->key_length, TRIE_NODE_LABEL(node),
+	       node->label_length);
+	iter->key_length += node->label_length;
+	iter->key[iter->key_length] = '\0';
+}
+
+/* The node on top of the stack has a value, and is the next to be
+ * returned, unless it is past the end of a range. */
+static void trie_iter_found(TrieIterator *iter)
+{
+	unsigned int length;
+	int diff;
+
+	iter->has_more = 1;
+
+	if (iter->end == NULL) {
+		return;
+	}
+
+	length = iter->key_length < iter->end_length ? iter->key_length
+	                                             : iter->end_length;
+	diff = memcmp(iter->key, iter->end, length);
+
+	if (diff > 0 || (diff == 0 && iter->key_length >= iter->end_length)) {
+		iter->has_more = 0;
+		iter->depth = 0;
+	}
+}
+
+/* Search for the next node with a value, after the node on top of the
+ * stack and those of its children that have already been visited.
+ * The key of a node comes before the keys of all of its children, and
+ * children are visited in order of their first byte, so the keys are
+ * found in lexicographic order. */
+static void trie_iter_advance(TrieIterator *iter)
+{
+	struct _TrieIteratorFrame *frame;
+	TrieNode *child;
+	unsigned int c;
+
+	while (iter->depth > 0) {
+		frame = &iter->stack[iter->depth - 1];
+		c = frame->next_child;
+		child = trie_next_child(frame->node, &c);
+
+		if (child == NULL) {
+			iter->key_length = frame->key_length;
+			--iter->depth;
+			continue;
+		}
+
+		frame->next_child = c + 1;
+		trie_iter_push(iter, child, 0);
+
+		if (!trie_value_is_null(&child->data)) {
+			trie_iter_found(iter);
+			return;
+		}
+	}
+
+	iter->has_more = 0;
+}
+
+/* Start from a node that has just been pushed onto the stack */
+static void trie_iter_start(TrieIterator *iter, TrieNode *node)
+{
+	if (!trie_value_is_null(&node->data)) {
+		trie_iter_found(iter);
+	} else {
+		trie_iter_advance(iter);
+	}
+}
+
+int trie_iterate_prefix_binary(Trie *trie, TrieIterator *iter,
+                               unsigned char *prefix, int prefix_length)
+{
+	TrieNode *node;
+	TrieNode **child;
+	unsigned int remaining;
+	unsigned int matched;
+	unsigned int length;
+
+	if (!trie_iter_init(trie, iter, NULL, 0)) {
+		return 0;
+	}
+
+	/* Find the node at the top of the subtree of keys beginning with
+	 * the prefix.  Only that node is put on the stack, so the
+	 * iteration ends with the last key below it. */
+	node = trie->root_node;
+	remaining = (unsigned int) prefix_length;
+	matched = 0;
+
+	while (node != NULL) {
+		length = trie_match_label(node, prefix + matched, remaining);
+
+		if (length < node->label_length && length < remaining) {
+			break;
+		}
+
+		if (remaining <= node->label_length) {
+			memcpy(iter->key, prefix, matched);
+			iter->key_length = matched;
+			trie_iter_push(iter, node, 0);
+			trie_iter_start(iter, node);
+			break;
+		}
+
+		matched += length;
+		remaining -= length;
+		child = trie_find_child(node, prefix[matched]);
+
+		if (child == NULL) {
+			break;
+		}
+
+		node = *child;
+	}
+
+	return 1;
+}
+
+int trie_iterate_prefix(Trie *trie, TrieIterator *iter, char *prefix)
+{
+	return trie_iterate_prefix_binary(trie, iter, (unsigned char *) prefix,
+	                                  (int) strlen(prefix));
+}
+
+int trie_iterate(Trie *trie, TrieIterator *iter)
+{
+	return trie_iterate_prefix_binary(trie, iter, (unsigned char *) "", 0);
+}
+
+int trie_iterate_range_binary(Trie *trie, TrieIterator *iter,
+                              unsigned char *start, int start_length,
+                              unsigned char *end, int end_length)
+{
+	TrieNode *node;
+	TrieNode **child;
+	unsigned char *label;
+	unsigned int remaining;
+	unsigned int matched;
+	unsigned int length;
+	unsigned int c;
+
+	if (!trie_iter_init(trie, iter, end, end_length)) {
+		return 0;
+	}
+
+	if (start == NULL) {
+		start = (unsigned char *) "";
+		start_length = 0;
+	}
+
+	/* Follow the start key down the trie, putting each node on the
+	 * path on the stack with its search for children starting after
+	 * the next byte of the key.  This leaves the stack as it would be
+	 * if iterating over the whole trie had just passed the start key.
+	 * Keys below a node whose label is less than the start key are
+	 * all before the start, and keys below one whose label is greater
+	 * are all after it. */
+	node = trie->root_node;
+	remaining = (unsigned int) start_length;
+	matched = 0;
+
+	while (node != NULL) {
+		label = TRIE_NODE_LABEL(node);
+		length = trie_match_label(node, start + matched, remaining);
+
+		if (length < node->label_length && length < remaining) {
+			if (label[length] > start[matched + length]) {
+				trie_iter_push(iter, node, 0);
+				trie_iter_start(iter, node);
+				return 1;
+			}
+
+			break;
+		}
+
+		if (remaining <= node->label_length) {
+			trie_iter_push(iter, node, 0);
+			trie_iter_start(iter, node);
+			return 1;
+		}
+
+		matched += length;
+		remaining -= length;
+		c = start[matched];
+		trie_iter_push(iter, node, c);
+		child = trie_find_child(node, (unsigned char) c);
+
+		if (child == NULL) {
+			break;
+		}
+
+		iter->stack[iter->depth - 1].next_child = c + 1;
+		node = *child;
+	}
+
+	trie_iter_advance(iter);
+
+	return 1;
+}
+
+int trie_iterate_range(Trie *trie, TrieIterator *iter, char *start,
+                       char *end)
+{
+	return trie_iterate_range_binary(
+	    trie, iter, (unsigned char *) start,
+	    start != NULL ? (int) strlen(start) : 0, (unsigned char *) end,
+	    end != NULL ? (int) strlen(end) : 0);
+}
+
+int trie_iter_has_more(TrieIterator *iterator)
+{
+	/* Moving on from the value last returned is delayed until now, so
+	 * that its key stays available until then */
+	if (iterator->advance) {
+		iterator->advance = 0;
+		trie_iter_advance(iterator);
+	}
+
+	return iterator->has_more;
+}
+
+TrieValue trie_iter_next(TrieIterator *iterator)
+{
+	if (!trie_iter_has_more(iterator)) {
+		return trie_null_value;
+	}
+
+	iterator->advance = 1;
+
+	return iterator->stack[iterator->depth - 1].node->data;
+}
+
+unsigned char *trie_iter_key(TrieIterator *iterator, int *key_length)
+{
+	if (key_length != NULL) {
+		*key_length = (int) iterator->key_length;
+	}
+
+	return iterator->key;
+}
+
+void trie_iter_free(TrieIterator *iterator)
+{
+	free(iterator->stack);
+	iterator->stack = NULL;
+	iterator->has_more = 0;
 }
@@ -26,20 +26,50 @@ CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  * A trie is a data structure which provides fast mappings from strings
  * to values.
  *
+ * The trie is stored as an adaptive radix tree: a run of key bytes
+ * where the trie does not branch is held in a single node, rather than
+ * in one node per byte, and each node only has room for as many children
+ * as it needs, switching between forms for up to 4, 16, 48 and 256
+ * children as they are added and removed.  The memory used therefore
+ * depends on the number of keys rather than on their total length.
+ *
  * To create a new trie, use @ref trie_new.  To destroy a trie,
- * use @ref trie_free.
+ * use @ref trie_free.  A trie using a different storage scheme can be
+ * created using @ref trie_new_with_flags.
  *
  * To insert a value into a trie, use @ref trie_insert. To remove a value
  * from a trie, use @ref trie_remove.
  *
- * To look up a value from its key, use @ref trie_lookup.
+ * To look up a value from its key, use @ref trie_lookup.  To look up
+ * many keys at once, use @ref trie_lookup_many.
  *
  * To find the number of entries in a trie, use @ref trie_num_entries.
+ *
+ * To find the value for the longest key which is a prefix of a given
+ * string, use @ref trie_lookup_longest_prefix.
+ *
+ * Keys are iterated over in lexicographic order of their bytes.  To
+ * iterate over all keys, use @ref trie_iterate; to iterate over those
+ * beginning with a prefix, use @ref trie_iterate_prefix; and to iterate
+ * over those in a range, use @ref trie_iterate_range.  Each of these
+ * initialises a @ref TrieIterator structure, with @ref trie_iter_next and
+ * @ref trie_iter_has_more used to read each value in turn, and
+ * @ref trie_iter_key to read its key.  The iterator must be freed with
+ * @ref trie_iter_free afterwards.
+ *
+ * A trie can be frozen into a buffer using @ref trie_freeze.  The buffer
+ * holds no pointers, so it can be written to a file and later mapped
+ * into memory, at any address and by any number of processes, and
+ * @ref trie_new_frozen then creates a trie that looks keys up directly
+ * in the buffer, without copying it.  A frozen trie cannot be changed
+ * or iterated over.
  */
 
 #ifndef ALGORITHM_TRIE_H
 #define ALGORITHM_TRIE_H
 
+#include <stddef.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -65,6 +95,43 @@ typedef void *TrieValue;
 
 #endif /* #ifndef TEST_ALTERNATE_VALUE_TYPES */
 
+/**
+ * Flags which may be passed to @ref trie_new_with_flags to control how a
+ * trie is stored.  Flags can be combined using bitwise OR.
+ */
+typedef enum {
+	/**
+	 * Allocate the nodes of the trie from large blocks owned by the
+	 * trie, rather than with a separate malloc() for each.  Adding a
+	 * node usually only needs a pointer to be advanced, and freeing
+	 * the trie only needs to free each block rather than visiting
+	 * each node.  The memory used by removed nodes is reused for new
+	 * nodes, but is not returned until the trie is freed.
+	 */
+	TRIE_POOLED = 1 << 0
+} TrieFlag;
+
+/**
+ * An object used to iterate over the keys in a trie.
+ *
+ * @see trie_iterate
+ */
+typedef struct _TrieIterator TrieIterator;
+
+/**
+ * Definition of a @ref TrieIterator.
+ */
+struct _TrieIterator {
+	struct _TrieIteratorFrame *stack;
+	unsigned int depth;
+	unsigned char *key;
+	unsigned int key_length;
+	unsigned char *end;
+	unsigned int end_length;
+	int advance;
+	int has_more;
+};
+
 /**
  * Create a new trie.
  *
@@ -74,6 +141,16 @@ typedef void *TrieValue;
  */
 Trie *trie_new(void);
 
+/**
+ * Create a new trie, with flags controlling how it is stored.
+ *
+ * @param flags              Bitwise OR of @ref TrieFlag values.
+ * @return                   Pointer to a new trie structure, or NULL if it
+ *                           was not possible to allocate memory for the
+ *                           new trie.
+ */
+Trie *trie_new_with_flags(unsigned int flags);
+
 /**
  * Destroy a trie.
  *
@@ -90,7 +167,8 @@ void trie_free(Trie *trie);
  * @param value              The value.
  * @return                   Non-zero if the value was inserted successfully,
  *                           or zero if it was not possible to allocate
- *                           memory for the new entry.
+ *                           memory for the new entry or the trie is
+ *                           frozen.
  */
 int trie_insert(Trie *trie, char *key, TrieValue value);
 
@@ -104,7 +182,8 @@ int trie_insert(Trie *trie, char *key, TrieValue value);
  * @param value              The value.
  * @return                   Non-zero if the value was inserted successfully,
  *                           or zero if it was not possible to allocate
- *                           memory for the new entry.
+ *                           memory for the new entry or the trie is
+ *                           frozen.
  */
 int trie_insert_binary(Trie *trie, unsigned char *key, int key_length,
                        TrieValue value);
@@ -134,6 +213,41 @@ TrieValue trie_lookup(Trie *trie, char *key);
  */
 TrieValue trie_lookup_binary(Trie *trie, unsigned char *key, int key_length);
 
+/**
+ * Look up a number of values in a trie, as though by calling
+ * @ref trie_lookup for each key in turn.  The keys are looked up a batch
+ * at a time, moving down the trie together, so that several lookups can
+ * wait on memory at once.
+ *
+ * @param trie               The trie.
+ * @param keys               Array of NUL-terminated keys to look up.
+ * @param values             Array in which to store the value for each
+ *                           key, or @ref TRIE_NULL for keys that are not
+ *                           in the trie.
+ * @param count              Number of entries in the arrays.
+ * @return                   The number of keys that were found.
+ */
+unsigned int trie_lookup_many(Trie *trie, char **keys, TrieValue *values,
+                              unsigned int count);
+
+/**
+ * Look up a number of values in a trie, as though by calling
+ * @ref trie_lookup_binary for each key in turn.  The keys are looked up
+ * a batch at a time, as with @ref trie_lookup_many.
+ *
+ * @param trie               The trie.
+ * @param keys               Array of keys to look up.
+ * @param key_lengths        Array of the lengths of the keys in bytes.
+ * @param values             Array in which to store the value for each
+ *                           key, or @ref TRIE_NULL for keys that are not
+ *                           in the trie.
+ * @param count              Number of entries in the arrays.
+ * @return                   The number of keys that were found.
+ */
+unsigned int trie_lookup_many_binary(Trie *trie, unsigned char **keys,
+                                     int *key_lengths, TrieValue *values,
+                                     unsigned int count);
+
 /**
  * Remove an entry from a trie.
  * The key is a NUL-terminated string; for binary strings, use
@@ -142,7 +256,8 @@ TrieValue trie_lookup_binary(Trie *trie, unsigned char *key, int key_length);
  * @param trie               The trie.
  * @param key                The key of the entry to remove.
  * @return                   Non-zero if the key was removed successfully,
- *                           or zero if it is not present in the trie.
+ *                           or zero if it is not present in the trie or
+ *                           the trie is frozen.
  */
 int trie_remove(Trie *trie, char *key);
 
@@ -155,7 +270,8 @@ int trie_remove(Trie *trie, char *key);
  * @param key                The key of the entry to remove.
  * @param key_length         The key length in bytes.
  * @return                   Non-zero if the key was removed successfully,
- *                           or zero if it is not present in the trie.
+ *                           or zero if it is not present in the trie or
+ *                           the trie is frozen.
  */
 int trie_remove_binary(Trie *trie, unsigned char *key, int key_length);
 
@@ -167,6 +283,220 @@ int trie_remove_binary(Trie *trie, unsigned char *key, int key_length);
  */
 unsigned int trie_num_entries(Trie *trie);
 
+/**
+ * Find the value for the longest key in a trie which is a prefix of a
+ * string.  The key is a NUL-terminated string; for binary strings, use
+ * @ref trie_lookup_longest_prefix_binary.
+ *
+ * @param trie               The trie.
+ * @param key                The string to match against.
+ * @param prefix_length      If not NULL, the length of the matching key
+ *                           is stored here, or zero if there is none.
+ * @return                   The value for the longest matching key, or
+ *                           @ref TRIE_NULL if no key in the trie is a
+ *                           prefix of the string.
+ */
+TrieValue trie_lookup_longest_prefix(Trie *trie, char *key,
+                                     int *prefix_length);
+
+/**
+ * Find the value for the longest key in a trie which is a prefix of a
+ * sequence of bytes.  For a NUL-terminated text string, use
+ * @ref trie_lookup_longest_prefix.
+ *
+ * @param trie               The trie.
+ * @param key                The bytes to match against.
+ * @param key_length         The length of the bytes.
+ * @param prefix_length      If not NULL, the length of the matching key
+ *                           is stored here, or zero if there is none.
+ * @return                   The value for the longest matching key, or
+ *                           @ref TRIE_NULL if no key in the trie is a
+ *                           prefix of the bytes.
+ */
+TrieValue trie_lookup_longest_prefix_binary(Trie *trie, unsigned char *key,
+                                            int key_length,
+                                            int *prefix_length);
+
+/**
+ * Initialise a @ref TrieIterator to iterate over all keys in a trie, in
+ * lexicographic order.  The trie must not be changed while the iterator
+ * is in use.
+ *
+ * @param trie               The trie.
+ * @param iter               Pointer to the iterator to initialise.
+ * @return                   Non-zero on success, or zero if it was not
+ *                           possible to allocate memory for the
+ *                           iterator or the trie is frozen.  The
+ *                           iterator then has no values to return, but
+ *                           may still be freed.
+ */
+int trie_iterate(Trie *trie, TrieIterator *iter);
+
+/**
+ * Initialise a @ref TrieIterator to iterate over the keys in a trie that
+ * begin with a prefix, in lexicographic order.  The prefix is a
+ * NUL-terminated string; for binary strings, use
+ * @ref trie_iterate_prefix_binary.
+ *
+ * @param trie               The trie.
+ * @param iter               Pointer to the iterator to initialise.
+ * @param prefix             The prefix.
+ * @return                   Non-zero on success, or zero if it was not
+ *                           possible to allocate memory for the
+ *                           iterator.
+ */
+int trie_iterate_prefix(Trie *trie, TrieIterator *iter, char *prefix);
+
+/**
+ * Initialise a @ref TrieIterator to iterate over the keys in a trie that
+ * begin with a sequence of bytes, in lexicographic order.  For a
+ * NUL-terminated text string, use @ref trie_iterate_prefix.
+ *
+ * @param trie               The trie.
+ * @param iter               Pointer to the iterator to initialise.
+ * @param prefix             The prefix.
+ * @param prefix_length      The length of the prefix in bytes.
+ * @return                   Non-zero on success, or zero if it was not
+ *                           possible to allocate memory for the
+ *                           iterator.
+ */
+int trie_iterate_prefix_binary(Trie *trie, TrieIterator *iter,
+                               unsigned char *prefix, int prefix_length);
+
+/**
+ * Initialise a @ref TrieIterator to iterate over the keys in a trie that
+ * are at least one string and less than another, in lexicographic
+ * order.  The bounds are NUL-terminated strings; for binary strings,
+ * use @ref trie_iterate_range_binary.
+ *
+ * @param trie               The trie.
+ * @param iter               Pointer to the iterator to initialise.
+ * @param start              The first key to include, or NULL to start
+ *                           from the first key in the trie.
+ * @param end                The key to stop before, or NULL to continue
+ *                           to the last key in the trie.
+ * @return                   Non-zero on success, or zero if it was not
+ *                           possible to allocate memory for the
+ *                           iterator.
+ */
+int trie_iterate_range(Trie *trie, TrieIterator *iter, char *start,
+                       char *end);
+
+/**
+ * Initialise a @ref TrieIterator to iterate over the keys in a trie that
+ * are at least one sequence of bytes and less than another, in
+ * lexicographic order.  For NUL-terminated text strings, use
+ * @ref trie_iterate_range.
+ *
+ * @param trie               The trie.
+ * @param iter               Pointer to the iterator to initialise.
+ * @param start              The first key to include, or NULL to start
+ *                           from the first key in the trie.
+ * @param start_length       The length of the start key in bytes.
+ * @param end                The key to stop before, or NULL to continue
+ *                           to the last key in the trie.
+ * @param end_length         The length of the end key in bytes.
+ * @return                   Non-zero on success, or zero if it was not
+ *                           possible to allocate memory for the
+ *                           iterator.
+ */
+int trie_iterate_range_binary(Trie *trie, TrieIterator *iter,
+                              unsigned char *start, int start_length,
+                              unsigned char *end, int end_length);
+
+/**
+ * Determine if there are more keys in a trie to iterate over.
+ *
+ * @param iterator           The trie iterator.
+ * @return                   Zero if there are no more keys to iterate
+ *                           over, non-zero if there are more values to
+ *                           be read.
+ */
+int trie_iter_has_more(TrieIterator *iterator);
+
+/**
+ * Using a trie iterator, retrieve the next value from the trie.
+ *
+ * @param iterator           The trie iterator.
+ * @return                   The next value from the trie, or
+ *                           @ref TRIE_NULL if no more values are
+ *                           available.
+ */
+TrieValue trie_iter_next(TrieIterator *iterator);
+
+/**
+ * Find the key of the value most recently returned by
+ * @ref trie_iter_next.  The key is followed by a NUL byte, so keys
+ * inserted as text strings can be used as strings.
+ *
+ * @param iterator           The trie iterator.
+ * @param key_length         If not NULL, the length of the key in bytes
+ *                           is stored here.
+ * @return                   Pointer to the key.  This is only valid until
+ *                           the next call to @ref trie_iter_has_more,
+ *                           @ref trie_iter_next or @ref trie_iter_free.
+ */
+unsigned char *trie_iter_key(TrieIterator *iterator, int *key_length);
+
+/**
+ * Free the memory used by a trie iterator.  This must be called for
+ * every iterator that has been initialised, whether or not it has been
+ * used to read every value.
+ *
+ * @param iterator           The trie iterator.
+ */
+void trie_iter_free(TrieIterator *iterator);
+
+/**
+ * Find the number of bytes needed to freeze a trie using
+ * @ref trie_freeze.
+ *
+ * @param trie               The trie.
+ * @return                   The number of bytes needed, or zero if the
+ *                           trie is too large to be frozen, as the
+ *                           frozen form cannot be more than 4 GB.
+ */
+size_t trie_frozen_size(Trie *trie);
+
+/**
+ * Freeze a trie into a buffer, from which @ref trie_new_frozen can look
+ * up its keys.  The buffer does not depend on the address it is stored
+ * at or on the byte order of the machine.
+ *
+ * Values cannot be stored in the buffer, as they may be pointers, so
+ * each is replaced by its position in the order of the keys, the order
+ * in which @ref trie_iterate returns them.  A frozen trie is given an
+ * array of values in that order, which might point into a second file
+ * holding the data for each key.
+ *
+ * @param trie               The trie.
+ * @param buffer             The buffer to write to, which must be at least
+ *                           @ref trie_frozen_size bytes long.
+ * @return                   The number of bytes written, or zero if the
+ *                           trie is too large to be frozen.
+ */
+size_t trie_freeze(Trie *trie, unsigned char *buffer);
+
+/**
+ * Create a trie from the output of @ref trie_freeze.  Keys are looked up
+ * in the buffer itself, which is not copied, and the trie cannot be
+ * changed.  Only the start of the buffer is checked here, but a damaged
+ * buffer can only cause lookups to fail, and will not be read past its
+ * end.
+ *
+ * @param buffer             The buffer to read from, which must not be
+ *                           changed or freed until the trie is freed.
+ * @param length             The length of the buffer, in bytes.
+ * @param values             Array with the value for each key, in key
+ *                           order, which must not be freed until the
+ *                           trie is freed.
+ * @return                   A new trie, or NULL if the buffer does not
+ *                           hold a frozen trie or if it was not possible
+ *                           to allocate memory for the new trie.
+ */
+Trie *trie_new_frozen(const unsigned char *buffer, size_t length,
+                      TrieValue *values);
+
 #ifdef __cplusplus
 }
 #endif
@@ -23,6 +23,7 @@ CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 #include <string.h>
 
 #include <assert.h>
+#include <pthread.h>
 
 #define ALLOC_TESTING_C
 
@@ -59,6 +60,10 @@ static size_t allocated_bytes = 0;
  * are allowed.  If this has a negative value, the limit is disabled. */
 signed int allocation_limit = -1;
 
+/* Some of the code under test allocates memory from several threads at
+ * once, so the counters above are protected by a lock. */
+static pthread_mutex_t alloc_test_lock = PTHREAD_MUTEX_INITIALIZER;
+
 /* Get the block header for an allocated pointer. */
 static BlockHeader *alloc_test_get_header(void *ptr)
 {
@@ -95,8 +100,11 @@ void *alloc_test_malloc(size_t bytes)
 	BlockHeader *header;
 	void *ptr;
 
+	pthread_mutex_lock(&alloc_test_lock);
+
 	/* Check if we have reached the allocation limit. */
 	if (allocation_limit == 0) {
+		pthread_mutex_unlock(&alloc_test_lock);
 		return NULL;
 	}
 
@@ -105,6 +113,7 @@ void *alloc_test_malloc(size_t bytes)
 	header = malloc(sizeof(BlockHeader) + bytes);
 
 	if (header == NULL) {
+		pthread_mutex_unlock(&alloc_test_lock);
 		return NULL;
 	}
 
@@ -124,6 +133,8 @@ void *alloc_test_malloc(size_t bytes)
 		--allocation_limit;
 	}
 
+	pthread_mutex_unlock(&alloc_test_lock);
+
 	/* Skip past the header and return the block itself */
 	return header + 1;
 }
@@ -142,7 +153,6 @@ void alloc_test_free(void *ptr)
 	/* Get the block header and do a sanity check */
 	header = alloc_test_get_header(ptr);
 	block_size = header->bytes;
-	assert(allocated_bytes >= block_size);
 
 	/* Trash the allocated block to foil any code that relies on memory
 	 * that has been freed. */
@@ -156,7 +166,10 @@ void alloc_test_free(void *ptr)
 	free(header);
 
 	/* Update counter */
+	pthread_mutex_lock(&alloc_test_lock);
+	assert(allocated_bytes >= block_size);
 	allocated_bytes -= block_size;
+	pthread_mutex_unlock(&alloc_test_lock);
 }
 
 void *alloc_test_realloc(void *ptr, size_t bytes)
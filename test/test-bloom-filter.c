@@ -218,7 +218,177 @@ void test_bloom_filter_mismatch(void)
 	assert(bloom_filter_union(filter1, filter2) == NULL);
 	bloom_filter_free(filter2);
 
+	/* Different layout */
+	filter2 = bloom_filter_new_with_flags(512, string_hash, 4,
+	                                      BLOOM_FILTER_BLOCKED);
 	bloom_filter_free(filter1);
+	filter1 = bloom_filter_new(512, string_hash, 4);
+	assert(bloom_filter_intersection(filter1, filter2) == NULL);
+	assert(bloom_filter_union(filter1, filter2) == NULL);
+	bloom_filter_free(filter2);
+
+	bloom_filter_free(filter1);
+}
+
+void test_bloom_filter_blocked(void)
+{
+	BloomFilter *filter1;
+	BloomFilter *filter2;
+	BloomFilter *result;
+	unsigned char state[64];
+	char buf[16];
+	unsigned int false_positives;
+	unsigned int i;
+
+	/* Every value inserted is found, and few that were not inserted
+	 * are, with 16 bits per value */
+	filter1 = bloom_filter_new_with_flags(16000, string_hash, 8,
+	                                      BLOOM_FILTER_BLOCKED);
+	assert(filter1 != NULL);
+
+	for (i = 0; i < 1000; ++i) {
+		sprintf(buf, "test %u", i);
+		bloom_filter_insert(filter1, buf);
+	}
+
+	false_positives = 0;
+
+	for (i = 0; i < 1000; ++i) {
+		sprintf(buf, "test %u", i);
+		assert(bloom_filter_query(filter1, buf) != 0);
+
+		sprintf(buf, "other %u", i);
+
+		if (bloom_filter_query(filter1, buf) != 0) {
+			++false_positives;
+		}
+	}
+
+	assert(false_positives < 20);
+	bloom_filter_free(filter1);
+
+	/* The table size is rounded up to a whole block */
+	filter1 = bloom_filter_new_with_flags(100, string_hash, 4,
+	                                      BLOOM_FILTER_BLOCKED);
+	assert(bloom_filter_query(filter1, "test 1") == 0);
+	bloom_filter_insert(filter1, "test 1");
+	bloom_filter_read(filter1, state);
+
+	filter2 = bloom_filter_new_with_flags(512, string_hash, 4,
+	                                      BLOOM_FILTER_BLOCKED);
+	bloom_filter_load(filter2, state);
+	assert(bloom_filter_query(filter2, "test 1") != 0);
+	bloom_filter_insert(filter2, "test 2");
+
+	/* Union and intersection */
+	result = bloom_filter_union(filter1, filter2);
+	assert(bloom_filter_query(result, "test 1") != 0);
+	assert(bloom_filter_query(result, "test 2") != 0);
+	bloom_filter_free(result);
+
+	result = bloom_filter_intersection(filter1, filter2);
+	assert(bloom_filter_query(result, "test 1") != 0);
+	bloom_filter_free(result);
+
+	bloom_filter_free(filter1);
+	bloom_filter_free(filter2);
+
+	/* Test out of memory scenario */
+	alloc_test_set_limit(1);
+	filter1 = bloom_filter_new_with_flags(128, string_hash, 4,
+	                                      BLOOM_FILTER_BLOCKED);
+	assert(filter1 == NULL);
+	alloc_test_set_limit(-1);
+}
+
+void test_bloom_filter_wide(void)
+{
+	BloomFilter *filter1;
+	BloomFilter *filter2;
+	BloomFilter *result;
+	unsigned char state[2000];
+	char buf[16];
+	unsigned int false_positives;
+	unsigned int flags;
+	unsigned int i;
+
+	/* Every value inserted is found, and close to the theoretical
+	 * number of other values are, for both layouts */
+	for (flags = 0; flags <= BLOOM_FILTER_BLOCKED; ++flags) {
+		filter1 = bloom_filter_new_wide(160000, string_wide_hash, 11,
+		                                flags);
+		assert(filter1 != NULL);
+
+		for (i = 0; i < 10000; ++i) {
+			sprintf(buf, "test %u", i);
+			bloom_filter_insert(filter1, buf);
+		}
+
+		false_positives = 0;
+
+		for (i = 0; i < 10000; ++i) {
+			sprintf(buf, "test %u", i);
+			assert(bloom_filter_query(filter1, buf) != 0);
+
+			sprintf(buf, "other %u", i);
+
+			if (bloom_filter_query(filter1, buf) != 0) {
+				++false_positives;
+			}
+		}
+
+		assert(false_positives < 30);
+		bloom_filter_free(filter1);
+	}
+
+	/* There is no limit on the number of functions, except for a
+	 * blocked filter */
+	filter1 = bloom_filter_new_wide(16000, string_wide_hash, 100, 0);
+	assert(filter1 != NULL);
+	bloom_filter_insert(filter1, "test 1");
+	assert(bloom_filter_query(filter1, "test 1") != 0);
+	assert(bloom_filter_query(filter1, "test 2") == 0);
+	bloom_filter_free(filter1);
+
+	assert(bloom_filter_new_wide(16000, string_wide_hash, 100,
+	                             BLOOM_FILTER_BLOCKED) == NULL);
+	assert(bloom_filter_new_wide(0, string_wide_hash, 4, 0) == NULL);
+
+	/* Read and load */
+	filter1 = bloom_filter_new_wide(16000, string_wide_hash, 4, 0);
+	bloom_filter_insert(filter1, "test 1");
+	bloom_filter_read(filter1, state);
+
+	filter2 = bloom_filter_new_wide(16000, string_wide_hash, 4, 0);
+	bloom_filter_load(filter2, state);
+	assert(bloom_filter_query(filter2, "test 1") != 0);
+	bloom_filter_insert(filter2, "test 2");
+
+	/* Union and intersection */
+	result = bloom_filter_union(filter1, filter2);
+	assert(bloom_filter_query(result, "test 1") != 0);
+	assert(bloom_filter_query(result, "test 2") != 0);
+	bloom_filter_free(result);
+
+	result = bloom_filter_intersection(filter1, filter2);
+	assert(bloom_filter_query(result, "test 1") != 0);
+	assert(bloom_filter_query(result, "test 2") == 0);
+	bloom_filter_free(result);
+
+	bloom_filter_free(filter2);
+
+	/* Filters using a wide and a narrow hash cannot be combined */
+	filter2 = bloom_filter_new(16000, string_hash, 4);
+	assert(bloom_filter_union(filter1, filter2) == NULL);
+	assert(bloom_filter_intersection(filter1, filter2) == NULL);
+	bloom_filter_free(filter2);
+	bloom_filter_free(filter1);
+
+	/* Test out of memory scenario */
+	alloc_test_set_limit(1);
+	filter1 = bloom_filter_new_wide(128, string_wide_hash, 4, 0);
+	assert(filter1 == NULL);
+	alloc_test_set_limit(-1);
 }
 
 /* clang-format off */
@@ -229,6 +399,8 @@ static UnitTestFunction tests[] = {
 	test_bloom_filter_intersection,
 	test_bloom_filter_union,
 	test_bloom_filter_mismatch,
+	test_bloom_filter_blocked,
+	test_bloom_filter_wide,
 	NULL
 };
 /* clang-format on */
@@ -0,0 +1,397 @@
+/*
+
+Copyright (c) 2026 Simon Howard
+
+Permission to use, copy, modify, and/or distribute this software
+for any purpose with or without fee is hereby granted, provided
+that the above copyright notice and this permission notice appear
+in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT,
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "alloc-testing.h"
+#include "framework.h"
+
+#include "compare-int.h"
+#include "compare-string.h"
+#include "concurrent-hash-table.h"
+#include "hash-int.h"
+#include "hash-string.h"
+
+#define NUM_TEST_VALUES 10000
+
+#define NUM_THREADS 4
+#define NUM_THREAD_VALUES 5000
+
+int allocated_keys = 0;
+int allocated_values = 0;
+
+/* Generates a table for use in tests containing 10,000 entries */
+ConcurrentHashTable *generate_hash_table(void)
+{
+	ConcurrentHashTable *hash_table;
+	char buf[10];
+	char *value;
+	int i;
+
+	hash_table = concurrent_hash_table_new(string_hash, string_equal, 0);
+
+	for (i = 0; i < NUM_TEST_VALUES; ++i) {
+		sprintf(buf, "%i", i);
+
+		value = strdup(buf);
+
+		concurrent_hash_table_insert(hash_table, value, value);
+	}
+
+	concurrent_hash_table_register_free_functions(hash_table, NULL, free);
+
+	return hash_table;
+}
+
+void test_concurrent_hash_table_new_free(void)
+{
+	ConcurrentHashTable *hash_table;
+	int limit;
+
+	hash_table = concurrent_hash_table_new(int_hash, int_equal, 0);
+	assert(hash_table != NULL);
+	concurrent_hash_table_free(hash_table);
+
+	/* Stripe counts are rounded up to a power of two */
+	hash_table = concurrent_hash_table_new(int_hash, int_equal, 5);
+	assert(hash_table != NULL);
+	assert(concurrent_hash_table_num_entries(hash_table) == 0);
+	concurrent_hash_table_free(hash_table);
+
+	/* Four stripes need six allocations.  Every one of them failing
+	 * must be cleaned up. */
+	for (limit = 0; limit < 6; ++limit) {
+		alloc_test_set_limit(limit);
+		hash_table = concurrent_hash_table_new(int_hash, int_equal, 4);
+		assert(hash_table == NULL);
+		assert(alloc_test_get_allocated() == 0);
+	}
+
+	alloc_test_set_limit(6);
+	hash_table = concurrent_hash_table_new(int_hash, int_equal, 4);
+	assert(hash_table != NULL);
+	alloc_test_set_limit(-1);
+	concurrent_hash_table_free(hash_table);
+}
+
+void test_concurrent_hash_table_insert_lookup(void)
+{
+	ConcurrentHashTable *hash_table;
+	char buf[10];
+	char *value;
+	int i;
+
+	hash_table = generate_hash_table();
+
+	assert(concurrent_hash_table_num_entries(hash_table) ==
+	       NUM_TEST_VALUES);
+
+	for (i = 0; i < NUM_TEST_VALUES; ++i) {
+		sprintf(buf, "%i", i);
+		value = concurrent_hash_table_lookup(hash_table, buf);
+
+		assert(strcmp(value, buf) == 0);
+	}
+
+	sprintf(buf, "%i", -1);
+	assert(concurrent_hash_table_lookup(hash_table, buf) == NULL);
+	sprintf(buf, "%i", NUM_TEST_VALUES);
+	assert(concurrent_hash_table_lookup(hash_table, buf) == NULL);
+
+	/* Insert overwrites existing entries with the same key */
+	sprintf(buf, "%i", 1234);
+	concurrent_hash_table_insert(hash_table, buf, strdup("hello world"));
+	value = concurrent_hash_table_lookup(hash_table, buf);
+	assert(strcmp(value, "hello world") == 0);
+	assert(concurrent_hash_table_num_entries(hash_table) ==
+	       NUM_TEST_VALUES);
+
+	concurrent_hash_table_free(hash_table);
+}
+
+void test_concurrent_hash_table_remove(void)
+{
+	ConcurrentHashTable *hash_table;
+	char buf[10];
+	int i;
+
+	hash_table = generate_hash_table();
+
+	sprintf(buf, "%i", 5000);
+	assert(concurrent_hash_table_remove(hash_table, buf) != 0);
+	assert(concurrent_hash_table_num_entries(hash_table) == 9999);
+	assert(concurrent_hash_table_lookup(hash_table, buf) == NULL);
+
+	/* Removing again, or removing a key never added, does nothing */
+	assert(concurrent_hash_table_remove(hash_table, buf) == 0);
+	sprintf(buf, "%i", -1);
+	assert(concurrent_hash_table_remove(hash_table, buf) == 0);
+	assert(concurrent_hash_table_num_entries(hash_table) == 9999);
+
+	/* Remove everything else */
+	for (i = 0; i < NUM_TEST_VALUES; ++i) {
+		sprintf(buf, "%i", i);
+		concurrent_hash_table_remove(hash_table, buf);
+	}
+
+	assert(concurrent_hash_table_num_entries(hash_table) == 0);
+
+	concurrent_hash_table_free(hash_table);
+}
+
+int *new_key(int value)
+{
+	int *result;
+
+	result = malloc(sizeof(int));
+	*result = value;
+
+	++allocated_keys;
+
+	return result;
+}
+
+void free_key(void *key)
+{
+	free(key);
+
+	--allocated_keys;
+}
+
+int *new_value(int value)
+{
+	int *result;
+
+	result = malloc(sizeof(int));
+	*result = value;
+
+	++allocated_values;
+
+	return result;
+}
+
+void free_value(void *value)
+{
+	free(value);
+
+	--allocated_values;
+}
+
+void test_concurrent_hash_table_free_functions(void)
+{
+	ConcurrentHashTable *hash_table;
+	int *key;
+	int *value;
+	int i;
+
+	hash_table = concurrent_hash_table_new(int_hash, int_equal, 0);
+
+	concurrent_hash_table_register_free_functions(hash_table, free_key,
+	                                              free_value);
+
+	for (i = 0; i < NUM_TEST_VALUES; ++i) {
+		key = new_key(i);
+		value = new_value(99);
+
+		concurrent_hash_table_insert(hash_table, key, value);
+	}
+
+	assert(allocated_keys == NUM_TEST_VALUES);
+	assert(allocated_values == NUM_TEST_VALUES);
+
+	/* Removing a key frees the key and value */
+	i = NUM_TEST_VALUES / 2;
+	concurrent_hash_table_remove(hash_table, &i);
+
+	assert(allocated_keys == NUM_TEST_VALUES - 1);
+	assert(allocated_values == NUM_TEST_VALUES - 1);
+
+	/* Replacing a key frees the old key and value */
+	key = new_key(NUM_TEST_VALUES / 3);
+	value = new_value(999);
+	concurrent_hash_table_insert(hash_table, key, value);
+
+	assert(allocated_keys == NUM_TEST_VALUES - 1);
+	assert(allocated_values == NUM_TEST_VALUES - 1);
+
+	concurrent_hash_table_free(hash_table);
+
+	assert(allocated_keys == 0);
+	assert(allocated_values == 0);
+}
+
+void test_concurrent_hash_table_out_of_memory(void)
+{
+	ConcurrentHashTable *hash_table;
+	int values[13];
+	unsigned int i;
+
+	/* With a single stripe, the table starts with 16 chains and is
+	 * enlarged when the 13th entry is added. */
+	hash_table = concurrent_hash_table_new(int_hash, int_equal, 1);
+
+	alloc_test_set_limit(0);
+	values[0] = 0;
+	assert(concurrent_hash_table_insert(hash_table, &values[0],
+	                                    &values[0]) == 0);
+	assert(concurrent_hash_table_num_entries(hash_table) == 0);
+
+	alloc_test_set_limit(-1);
+
+	for (i = 0; i < 12; ++i) {
+		values[i] = (int) i;
+		assert(concurrent_hash_table_insert(hash_table, &values[i],
+		                                    &values[i]) != 0);
+	}
+
+	alloc_test_set_limit(0);
+	values[12] = 12;
+	assert(concurrent_hash_table_insert(hash_table, &values[12],
+	                                    &values[12]) == 0);
+	assert(concurrent_hash_table_num_entries(hash_table) == 12);
+
+	/* The table is still usable afterwards */
+	alloc_test_set_limit(-1);
+	assert(concurrent_hash_table_insert(hash_table, &values[12],
+	                                    &values[12]) != 0);
+
+	for (i = 0; i < 13; ++i) {
+		assert(concurrent_hash_table_lookup(hash_table, &values[i]) ==
+		       &values[i]);
+	}
+
+	concurrent_hash_table_free(hash_table);
+}
+
+typedef struct {
+	ConcurrentHashTable *hash_table;
+	int *keys;
+	int *other_keys;
+} ThreadData;
+
+/* Each thread inserts its own set of keys, checks them, then removes
+ * half of them, while also reading the keys belonging to another
+ * thread which are being changed at the same time. */
+static void *thread_main(void *arg)
+{
+	ThreadData *data = arg;
+	HashTableValue value;
+	int i;
+
+	for (i = 0; i < NUM_THREAD_VALUES; ++i) {
+		assert(concurrent_hash_table_insert(
+			   data->hash_table, &data->keys[i], &data->keys[i]) != 0);
+
+		/* Keys owned by the other thread are either absent or map
+		 * to themselves */
+		value = concurrent_hash_table_lookup(data->hash_table,
+		                                     &data->other_keys[i]);
+		assert(value == NULL || value == &data->other_keys[i]);
+	}
+
+	for (i = 0; i < NUM_THREAD_VALUES; ++i) {
+		assert(concurrent_hash_table_lookup(data->hash_table,
+		                                    &data->keys[i]) ==
+		       &data->keys[i]);
+	}
+
+	for (i = 0; i < NUM_THREAD_VALUES; i += 2) {
+		assert(concurrent_hash_table_remove(data->hash_table,
+		                                    &data->keys[i]) != 0);
+	}
+
+	return NULL;
+}
+
+void test_concurrent_hash_table_threads(void)
+{
+	ConcurrentHashTable *hash_table;
+	pthread_t threads[NUM_THREADS];
+	ThreadData data[NUM_THREADS];
+	int *keys;
+	int i, j;
+
+	/* Use few stripes so that the threads contend for them */
+	hash_table = concurrent_hash_table_new(int_hash, int_equal, 2);
+	keys = malloc(sizeof(int) * NUM_THREADS * NUM_THREAD_VALUES);
+
+	for (i = 0; i < NUM_THREADS * NUM_THREAD_VALUES; ++i) {
+		keys[i] = i;
+	}
+
+	for (i = 0; i < NUM_THREADS; ++i) {
+		data[i].hash_table = hash_table;
+		data[i].keys = &keys[i * NUM_THREAD_VALUES];
+		data[i].other_keys =
+		    &keys[((i + 1) % NUM_THREADS) * NUM_THREAD_VALUES];
+	}
+
+	for (i = 0; i < NUM_THREADS; ++i) {
+		assert(pthread_create(&threads[i], NULL, thread_main,
+		                      &data[i]) == 0);
+	}
+
+	for (i = 0; i < NUM_THREADS; ++i) {
+		pthread_join(threads[i], NULL);
+	}
+
+	assert(concurrent_hash_table_num_entries(hash_table) ==
+	       NUM_THREADS * NUM_THREAD_VALUES / 2);
+
+	for (i = 0; i < NUM_THREADS; ++i) {
+		for (j = 0; j < NUM_THREAD_VALUES; ++j) {
+			if (j % 2 == 0) {
+				assert(concurrent_hash_table_lookup(
+					   hash_table, &data[i].keys[j]) ==
+				       NULL);
+			} else {
+				assert(concurrent_hash_table_lookup(
+					   hash_table, &data[i].keys[j]) ==
+				       &data[i].keys[j]);
+			}
+		}
+	}
+
+	concurrent_hash_table_free(hash_table);
+	free(keys);
+}
+
+/* clang-format off */
+static UnitTestFunction tests[] = {
+	test_concurrent_hash_table_new_free,
+	test_concurrent_hash_table_insert_lookup,
+	test_concurrent_hash_table_remove,
+	test_concurrent_hash_table_free_functions,
+	test_concurrent_hash_table_out_of_memory,
+	test_concurrent_hash_table_threads,
+	NULL
+};
+/* clang-format on */
+
+int main(int argc, char *argv[])
+{
+	run_tests(tests);
+
+	return 0;
+}
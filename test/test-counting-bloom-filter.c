@@ -0,0 +1,237 @@
+/*
+
+Copyright (c) 2026 Simon Howard
+
+Permission to use, copy, modify, and/or distribute this software
+for any purpose with or without fee is hereby granted, provided
+that the above copyright notice and this permission notice appear
+in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT,
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "alloc-testing.h"
+#include "framework.h"
+
+#include "counting-bloom-filter.h"
+#include "hash-string.h"
+
+void test_counting_bloom_filter_new_free(void)
+{
+	CountingBloomFilter *filter;
+
+	filter = counting_bloom_filter_new(128, string_hash, 4);
+	assert(filter != NULL);
+	counting_bloom_filter_free(filter);
+
+	/* An odd number of counters */
+	filter = counting_bloom_filter_new(127, string_hash, 4);
+	assert(filter != NULL);
+	counting_bloom_filter_free(filter);
+
+	/* A table must have at least one counter */
+	assert(counting_bloom_filter_new(0, string_hash, 4) == NULL);
+
+	/* Test out of memory scenario */
+	alloc_test_set_limit(0);
+	assert(counting_bloom_filter_new(128, string_hash, 4) == NULL);
+	alloc_test_set_limit(1);
+	assert(counting_bloom_filter_new(128, string_hash, 4) == NULL);
+	alloc_test_set_limit(-1);
+}
+
+void test_counting_bloom_filter_insert_remove(void)
+{
+	CountingBloomFilter *filter;
+	char buf[16];
+	unsigned int false_positives;
+	unsigned int i;
+
+	filter = counting_bloom_filter_new(16000, string_hash, 8);
+
+	assert(counting_bloom_filter_query(filter, "test 1") == 0);
+	assert(counting_bloom_filter_remove(filter, "test 1") == 0);
+
+	/* Insert some values, and remove the odd ones */
+	for (i = 0; i < 1000; ++i) {
+		sprintf(buf, "test %u", i);
+		counting_bloom_filter_insert(filter, buf);
+	}
+
+	for (i = 1; i < 1000; i += 2) {
+		sprintf(buf, "test %u", i);
+		assert(counting_bloom_filter_remove(filter, buf) != 0);
+	}
+
+	/* Values still present are always found, and few of those removed
+	 * are */
+	false_positives = 0;
+
+	for (i = 0; i < 1000; ++i) {
+		sprintf(buf, "test %u", i);
+
+		if (i % 2 == 0) {
+			assert(counting_bloom_filter_query(filter, buf) != 0);
+		} else if (counting_bloom_filter_query(filter, buf) != 0) {
+			++false_positives;
+		}
+	}
+
+	assert(false_positives < 10);
+
+	/* Removing everything empties the filter */
+	for (i = 0; i < 1000; i += 2) {
+		sprintf(buf, "test %u", i);
+		assert(counting_bloom_filter_remove(filter, buf) != 0);
+	}
+
+	for (i = 0; i < 1000; ++i) {
+		sprintf(buf, "test %u", i);
+		assert(counting_bloom_filter_query(filter, buf) == 0);
+	}
+
+	/* A value inserted twice must be removed twice */
+	counting_bloom_filter_insert(filter, "test 1");
+	counting_bloom_filter_insert(filter, "test 1");
+	assert(counting_bloom_filter_remove(filter, "test 1") != 0);
+	assert(counting_bloom_filter_query(filter, "test 1") != 0);
+	assert(counting_bloom_filter_remove(filter, "test 1") != 0);
+	assert(counting_bloom_filter_query(filter, "test 1") == 0);
+
+	counting_bloom_filter_free(filter);
+}
+
+void test_counting_bloom_filter_saturate(void)
+{
+	CountingBloomFilter *filter;
+	unsigned int i;
+
+	/* Counters stick at their maximum, so a value inserted too many
+	 * times is never removed */
+	filter = counting_bloom_filter_new(64, string_hash, 4);
+
+	for (i = 0; i < 20; ++i) {
+		counting_bloom_filter_insert(filter, "test 1");
+	}
+
+	for (i = 0; i < 20; ++i) {
+		assert(counting_bloom_filter_remove(filter, "test 1") != 0);
+	}
+
+	assert(counting_bloom_filter_query(filter, "test 1") != 0);
+
+	counting_bloom_filter_free(filter);
+}
+
+void test_counting_bloom_filter_distinct(void)
+{
+	static const unsigned int table_sizes[] = { 8, 64, 97, 100 };
+	CountingBloomFilter *filter;
+	char buf[16];
+	unsigned int i, j, n;
+
+	/* Every value must get num_functions different counters, whatever
+	 * the table size.  If any counter were used twice, inserting a
+	 * value eight times with eight functions would push it past the
+	 * maximum, where it sticks, and the value could not be removed. */
+	for (i = 0; i < sizeof(table_sizes) / sizeof(*table_sizes); ++i) {
+		for (j = 0; j < 500; ++j) {
+			filter = counting_bloom_filter_new(table_sizes[i],
+			                                   string_hash, 8);
+			sprintf(buf, "test %u", j);
+
+			for (n = 0; n < 8; ++n) {
+				counting_bloom_filter_insert(filter, buf);
+			}
+
+			for (n = 0; n < 8; ++n) {
+				assert(counting_bloom_filter_remove(filter, buf)
+				       != 0);
+			}
+
+			assert(counting_bloom_filter_query(filter, buf) == 0);
+
+			counting_bloom_filter_free(filter);
+		}
+	}
+}
+
+void test_counting_bloom_filter_union(void)
+{
+	CountingBloomFilter *filter1;
+	CountingBloomFilter *filter2;
+	CountingBloomFilter *result;
+
+	filter1 = counting_bloom_filter_new(128, string_hash, 4);
+	counting_bloom_filter_insert(filter1, "test 1");
+
+	filter2 = counting_bloom_filter_new(128, string_hash, 4);
+	counting_bloom_filter_insert(filter2, "test 1");
+	counting_bloom_filter_insert(filter2, "test 2");
+
+	/* Both should be present, and the counts are added together */
+	result = counting_bloom_filter_union(filter1, filter2);
+	assert(counting_bloom_filter_query(result, "test 1") != 0);
+	assert(counting_bloom_filter_query(result, "test 2") != 0);
+
+	assert(counting_bloom_filter_remove(result, "test 1") != 0);
+	assert(counting_bloom_filter_query(result, "test 1") != 0);
+	assert(counting_bloom_filter_remove(result, "test 1") != 0);
+	assert(counting_bloom_filter_remove(result, "test 2") != 0);
+	assert(counting_bloom_filter_query(result, "test 1") == 0);
+	assert(counting_bloom_filter_query(result, "test 2") == 0);
+
+	counting_bloom_filter_free(result);
+
+	/* Test out of memory scenario */
+	alloc_test_set_limit(0);
+	assert(counting_bloom_filter_union(filter1, filter2) == NULL);
+	alloc_test_set_limit(-1);
+
+	counting_bloom_filter_free(filter2);
+
+	/* Filters created with different parameters */
+	filter2 = counting_bloom_filter_new(64, string_hash, 4);
+	assert(counting_bloom_filter_union(filter1, filter2) == NULL);
+	counting_bloom_filter_free(filter2);
+
+	filter2 = counting_bloom_filter_new(128, string_nocase_hash, 4);
+	assert(counting_bloom_filter_union(filter1, filter2) == NULL);
+	counting_bloom_filter_free(filter2);
+
+	filter2 = counting_bloom_filter_new(128, string_hash, 8);
+	assert(counting_bloom_filter_union(filter1, filter2) == NULL);
+	counting_bloom_filter_free(filter2);
+
+	counting_bloom_filter_free(filter1);
+}
+
+/* clang-format off */
+static UnitTestFunction tests[] = {
+	test_counting_bloom_filter_new_free,
+	test_counting_bloom_filter_insert_remove,
+	test_counting_bloom_filter_saturate,
+	test_counting_bloom_filter_distinct,
+	test_counting_bloom_filter_union,
+	NULL
+};
+/* clang-format on */
+
+int main(int argc, char *argv[])
+{
+	run_tests(tests);
+
+	return 0;
+}
@@ -36,9 +36,13 @@ CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 #include <binary-heap.h>
 #include <binomial-heap.h>
 #include <bloom-filter.h>
+#include <concurrent-hash-table.h>
+#include <counting-bloom-filter.h>
 #include <hash-table.h>
+#include <int-set.h>
 #include <list.h>
 #include <queue.h>
+#include <roaring-bitmap.h>
 #include <set.h>
 #include <slist.h>
 #include <trie.h>
@@ -147,6 +151,24 @@ static void test_bloom_filter(void)
 	bloom_filter_free(filter);
 }
 
+#ifdef HAVE_PTHREADS
+static void test_concurrent_hash_table(void)
+{
+	ConcurrentHashTable *hash_table;
+
+	hash_table = concurrent_hash_table_new(string_hash, string_equal, 0);
+	concurrent_hash_table_free(hash_table);
+}
+#endif
+
+static void test_counting_bloom_filter(void)
+{
+	CountingBloomFilter *filter;
+
+	filter = counting_bloom_filter_new(16, string_hash, 10);
+	counting_bloom_filter_free(filter);
+}
+
 static void test_hash_table(void)
 {
 	HashTable *hash_table;
@@ -155,6 +177,15 @@ static void test_hash_table(void)
 	hash_table_free(hash_table);
 }
 
+static void test_int_set(void)
+{
+	IntSet *set;
+
+	set = int_set_new();
+	int_set_insert(set, 1);
+	int_set_free(set);
+}
+
 static void test_list(void)
 {
 	ListEntry *list = NULL;
@@ -175,6 +206,15 @@ static void test_queue(void)
 	queue_free(queue);
 }
 
+static void test_roaring_bitmap(void)
+{
+	RoaringBitmap *bitmap;
+
+	bitmap = roaring_bitmap_new();
+	roaring_bitmap_insert(bitmap, 1);
+	roaring_bitmap_free(bitmap);
+}
+
 static void test_set(void)
 {
 	Set *set;
@@ -215,9 +255,15 @@ static UnitTestFunction tests[] = {
 	test_binary_heap, 
 	test_binomial_heap,
 	test_bloom_filter,
+#ifdef HAVE_PTHREADS
+	test_concurrent_hash_table,
+#endif
+	test_counting_bloom_filter,
 	test_hash_table,
+	test_int_set,
 	test_list,
 	test_queue,
+	test_roaring_bitmap,
 	test_set,
 	test_slist,
 	test_trie,
@@ -19,6 +19,7 @@ CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
 #include <assert.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -116,12 +117,41 @@ void test_string_nocase_hash(void)
 	assert(string_nocase_hash(test1) == string_nocase_hash(test4));
 }
 
+void test_string_wide_hash(void)
+{
+	char test1[] = "this is a test";
+	char test2[] = "this is a tesu";
+	char test3[] = "this is a test ";
+	char test4[] = "this is a test";
+	char test5[] = "This is a test";
+
+	/* Contents affect the hash */
+	assert(string_wide_hash(test1) != string_wide_hash(test2));
+
+	/* Length affects the hash */
+	assert(string_wide_hash(test1) != string_wide_hash(test3));
+
+	/* Case sensitive */
+	assert(string_wide_hash(test1) != string_wide_hash(test5));
+
+	/* The same strings give the same hash */
+	assert(string_wide_hash(test1) == string_wide_hash(test4));
+
+	/* Every bit of an unsigned long is used */
+#if ULONG_MAX > 0xffffffffUL
+	assert(string_wide_hash("a") == 0xaf63dc4c8601ec8cUL);
+#else
+	assert(string_wide_hash("a") == 0xe40c292cUL);
+#endif
+}
+
 /* clang-format off */
 static UnitTestFunction tests[] = {
 	test_pointer_hash,
 	test_int_hash,
 	test_string_hash,
 	test_string_nocase_hash,
+	test_string_wide_hash,
 	NULL
 };
 /* clang-format on */
@@ -38,8 +38,9 @@ int value1 = 1, value2 = 2, value3 = 3, value4 = 4;
 int allocated_keys = 0;
 int allocated_values = 0;
 
-/* Generates a hash table for use in tests containing 10,000 entries */
-HashTable *generate_hash_table(void)
+/* Generates a hash table for use in tests containing 10,000 entries,
+ * created with the given flags */
+HashTable *generate_hash_table_with_flags(unsigned int flags)
 {
 	HashTable *hash_table;
 	char buf[10];
@@ -50,7 +51,7 @@ HashTable *generate_hash_table(void)
 	 * string versions of the integer values 0..9999 to ensure that there
 	 * will be collisions within the hash table (using integer values
 	 * with int_hash causes no collisions) */
-	hash_table = hash_table_new(string_hash, string_equal);
+	hash_table = hash_table_new_with_flags(string_hash, string_equal, flags);
 
 	/* Insert lots of values */
 	for (i = 0; i < NUM_TEST_VALUES; ++i) {
@@ -67,6 +68,12 @@ HashTable *generate_hash_table(void)
 	return hash_table;
 }
 
+/* Generates a hash table for use in tests containing 10,000 entries */
+HashTable *generate_hash_table(void)
+{
+	return generate_hash_table_with_flags(0);
+}
+
 /* Basic allocate and free */
 void test_hash_table_new_free(void)
 {
@@ -422,6 +429,1233 @@ void test_hash_iterator_key_pair()
 	hash_table_free(hash_table);
 }
 
+int hash_calls = 0;
+int equal_calls = 0;
+
+unsigned int counting_hash(void *value)
+{
+	++hash_calls;
+
+	return int_hash(value);
+}
+
+int counting_equal(void *value1, void *value2)
+{
+	++equal_calls;
+
+	return int_equal(value1, value2);
+}
+
+/* The hash of each key is saved in the table, so the hash function is
+ * called exactly once per operation even when the table is enlarged,
+ * and keys with different hashes are never compared. */
+void test_hash_table_saved_hashes(void)
+{
+	HashTable *hash_table;
+	int values[NUM_TEST_VALUES];
+	int missing;
+	unsigned int flags;
+	int i;
+
+	for (flags = 0; flags <= HASH_TABLE_OPEN_ADDRESSING; ++flags) {
+		hash_table = hash_table_new_with_flags(counting_hash,
+		                                       counting_equal, flags);
+		hash_calls = 0;
+		equal_calls = 0;
+
+		for (i = 0; i < NUM_TEST_VALUES; ++i) {
+			values[i] = i;
+			hash_table_insert(hash_table, &values[i], &values[i]);
+		}
+
+		assert(hash_calls == NUM_TEST_VALUES);
+
+		for (i = 0; i < NUM_TEST_VALUES; ++i) {
+			assert(hash_table_lookup(hash_table, &values[i]) ==
+			       &values[i]);
+		}
+
+		assert(hash_calls == NUM_TEST_VALUES * 2);
+
+		/* The chained table only compares keys with matching
+		 * hashes.  All keys have distinct hashes, so a successful
+		 * lookup compares exactly one key. */
+		if (flags != HASH_TABLE_OPEN_ADDRESSING) {
+			assert(equal_calls == NUM_TEST_VALUES);
+
+			missing = NUM_TEST_VALUES;
+			assert(hash_table_lookup(hash_table, &missing) == NULL);
+			assert(hash_table_remove(hash_table, &missing) == 0);
+			assert(equal_calls == NUM_TEST_VALUES);
+		}
+
+		hash_table_free(hash_table);
+	}
+}
+
+/* Test a chained table using power-of-two table sizes */
+void test_hash_table_power_of_two(void)
+{
+	HashTable *hash_table;
+	HashTableIterator iterator;
+	int values[NUM_TEST_VALUES];
+	char buf[10];
+	int count;
+	int i;
+
+	hash_table = generate_hash_table_with_flags(HASH_TABLE_POWER_OF_TWO);
+
+	assert(hash_table_num_entries(hash_table) == NUM_TEST_VALUES);
+
+	for (i = 0; i < NUM_TEST_VALUES; ++i) {
+		sprintf(buf, "%i", i);
+		assert(strcmp(hash_table_lookup(hash_table, buf), buf) == 0);
+	}
+
+	sprintf(buf, "%i", 5000);
+	assert(hash_table_remove(hash_table, buf) != 0);
+	assert(hash_table_lookup(hash_table, buf) == NULL);
+	assert(hash_table_num_entries(hash_table) == NUM_TEST_VALUES - 1);
+
+	hash_table_free(hash_table);
+
+	/* Sequential integers are a worst case for masking unless the
+	 * hash is mixed first. */
+	hash_table = hash_table_new_with_flags(int_hash, int_equal,
+	                                       HASH_TABLE_POWER_OF_TWO);
+
+	for (i = 0; i < NUM_TEST_VALUES; ++i) {
+		values[i] = i * 256;
+		assert(hash_table_insert(hash_table, &values[i], &values[i]) !=
+		       0);
+	}
+
+	count = 0;
+	hash_table_iterate(hash_table, &iterator);
+
+	while (hash_table_iter_has_more(&iterator)) {
+		hash_table_iter_next(&iterator);
+		++count;
+	}
+
+	assert(count == NUM_TEST_VALUES);
+
+	for (i = 0; i < NUM_TEST_VALUES; ++i) {
+		assert(hash_table_lookup(hash_table, &values[i]) == &values[i]);
+	}
+
+	hash_table_free(hash_table);
+}
+
+/* Test a table that is enlarged incrementally */
+void test_hash_table_incremental_resize(void)
+{
+	HashTable *hash_table;
+	HashTableIterator iterator;
+	int values[NUM_TEST_VALUES];
+	int count;
+	int i, j;
+
+	hash_table = generate_hash_table_with_flags(
+	    HASH_TABLE_INCREMENTAL_RESIZE | HASH_TABLE_POWER_OF_TWO);
+	assert(hash_table_num_entries(hash_table) == NUM_TEST_VALUES);
+	hash_table_free(hash_table);
+
+	hash_table = hash_table_new_with_flags(int_hash, int_equal,
+	                                       HASH_TABLE_INCREMENTAL_RESIZE);
+
+	/* After every insert, all keys must be found, whether or not they
+	 * have been moved into the new table yet. */
+	for (i = 0; i < 1000; ++i) {
+		values[i] = i;
+		assert(hash_table_insert(hash_table, &values[i], &values[i]) !=
+		       0);
+
+		for (j = 0; j <= i; ++j) {
+			assert(hash_table_lookup(hash_table, &values[j]) ==
+			       &values[j]);
+		}
+	}
+
+	/* Overwrite some entries in the middle of a resize */
+	for (i = 1000; i < 2000; ++i) {
+		values[i] = i;
+		hash_table_insert(hash_table, &values[i], &values[i]);
+		assert(hash_table_insert(hash_table, &values[i - 1000],
+		                         &values[i]) != 0);
+	}
+
+	assert(hash_table_num_entries(hash_table) == 2000);
+
+	for (i = 0; i < 1000; ++i) {
+		assert(hash_table_lookup(hash_table, &values[i]) ==
+		       &values[i + 1000]);
+	}
+
+	/* Remove entries while further resizes are in progress */
+	for (i = 2000; i < NUM_TEST_VALUES; ++i) {
+		values[i] = i;
+		hash_table_insert(hash_table, &values[i], &values[i]);
+
+		if (i % 3 == 0) {
+			assert(hash_table_remove(hash_table, &values[i]) != 0);
+			assert(hash_table_lookup(hash_table, &values[i]) ==
+			       NULL);
+		}
+	}
+
+	/* Every entry is visited exactly once */
+	count = 0;
+	hash_table_iterate(hash_table, &iterator);
+
+	while (hash_table_iter_has_more(&iterator)) {
+		hash_table_iter_next(&iterator);
+		++count;
+	}
+
+	assert(count == (int) hash_table_num_entries(hash_table));
+
+	hash_table_free(hash_table);
+
+	/* Cannot be combined with open addressing */
+	hash_table = hash_table_new_with_flags(
+	    int_hash, int_equal,
+	    HASH_TABLE_INCREMENTAL_RESIZE | HASH_TABLE_OPEN_ADDRESSING);
+	assert(hash_table == NULL);
+}
+
+/* Test the open addressing storage scheme */
+void test_hash_table_open_addressing(void)
+{
+	HashTable *hash_table;
+	HashTableIterator iterator;
+	HashTablePair pair;
+	char buf[10];
+	char *value;
+	int count;
+	int i;
+
+	hash_table = generate_hash_table_with_flags(HASH_TABLE_OPEN_ADDRESSING);
+
+	assert(hash_table_num_entries(hash_table) == NUM_TEST_VALUES);
+
+	for (i = 0; i < NUM_TEST_VALUES; ++i) {
+		sprintf(buf, "%i", i);
+		value = hash_table_lookup(hash_table, buf);
+
+		assert(strcmp(value, buf) == 0);
+	}
+
+	sprintf(buf, "%i", -1);
+	assert(hash_table_lookup(hash_table, buf) == NULL);
+	assert(hash_table_remove(hash_table, buf) == 0);
+
+	/* Insert overwrites existing entries with the same key */
+	sprintf(buf, "%i", 1234);
+	hash_table_insert(hash_table, buf, strdup("hello world"));
+	value = hash_table_lookup(hash_table, buf);
+	assert(strcmp(value, "hello world") == 0);
+	assert(hash_table_num_entries(hash_table) == NUM_TEST_VALUES);
+
+	/* Remove every even entry while iterating over the table */
+	count = 0;
+
+	hash_table_iterate(hash_table, &iterator);
+
+	while (hash_table_iter_has_more(&iterator)) {
+		pair = hash_table_iter_next(&iterator);
+
+		if (atoi(pair.key) % 2 == 0) {
+			assert(hash_table_remove(hash_table, pair.key) != 0);
+		}
+
+		++count;
+	}
+
+	assert(count == NUM_TEST_VALUES);
+	assert(hash_table_num_entries(hash_table) == NUM_TEST_VALUES / 2);
+
+	pair = hash_table_iter_next(&iterator);
+	assert(pair.value == HASH_TABLE_NULL);
+
+	for (i = 0; i < NUM_TEST_VALUES; ++i) {
+		sprintf(buf, "%i", i);
+
+		if (i % 2 == 0) {
+			assert(hash_table_lookup(hash_table, buf) == NULL);
+		} else {
+			assert(hash_table_lookup(hash_table, buf) != NULL);
+		}
+	}
+
+	/* Slots freed by the removals are reused by new entries */
+	for (i = 0; i < NUM_TEST_VALUES; i += 2) {
+		sprintf(buf, "%i", i);
+		value = strdup(buf);
+		assert(hash_table_insert(hash_table, value, value) != 0);
+	}
+
+	assert(hash_table_num_entries(hash_table) == NUM_TEST_VALUES);
+
+	for (i = 0; i < NUM_TEST_VALUES; ++i) {
+		sprintf(buf, "%i", i);
+		value = hash_table_lookup(hash_table, buf);
+
+		assert(value != NULL && strcmp(value, buf) == 0);
+	}
+
+	hash_table_free(hash_table);
+
+	/* Iterating over an empty table */
+	hash_table = hash_table_new_with_flags(int_hash, int_equal,
+	                                       HASH_TABLE_OPEN_ADDRESSING);
+
+	hash_table_iterate(hash_table, &iterator);
+	assert(hash_table_iter_has_more(&iterator) == 0);
+
+	hash_table_free(hash_table);
+}
+
+/* Test that churn through the same open addressing table, which leaves
+ * deleted slots behind, does not make it grow without bound */
+void test_hash_table_open_addressing_churn(void)
+{
+	HashTable *hash_table;
+	int values[100];
+	int i;
+
+	hash_table = hash_table_new_with_flags(int_hash, int_equal,
+	                                       HASH_TABLE_OPEN_ADDRESSING);
+
+	for (i = 0; i < 100; ++i) {
+		values[i] = i;
+	}
+
+	for (i = 0; i < 10000; ++i) {
+		assert(hash_table_insert(hash_table, &values[i % 100],
+		                         &values[i % 100]) != 0);
+
+		if (i >= 10) {
+			assert(hash_table_remove(hash_table,
+			                         &values[(i - 10) % 100]) != 0);
+		}
+	}
+
+	assert(hash_table_num_entries(hash_table) == 10);
+
+	for (i = 0; i < 100; ++i) {
+		if (i >= 90) {
+			assert(hash_table_lookup(hash_table, &values[i]) ==
+			       &values[i]);
+		} else {
+			assert(hash_table_lookup(hash_table, &values[i]) ==
+			       NULL);
+		}
+	}
+
+	hash_table_free(hash_table);
+}
+
+void test_hash_table_open_addressing_out_of_memory(void)
+{
+	HashTable *hash_table;
+	int values[15];
+	unsigned int i;
+
+	alloc_test_set_limit(1);
+	hash_table = hash_table_new_with_flags(int_hash, int_equal,
+	                                       HASH_TABLE_OPEN_ADDRESSING);
+	assert(hash_table == NULL);
+	assert(alloc_test_get_allocated() == 0);
+
+	alloc_test_set_limit(-1);
+	hash_table = hash_table_new_with_flags(int_hash, int_equal,
+	                                       HASH_TABLE_OPEN_ADDRESSING);
+
+	/* The initial table has 16 slots, of which 14 can be used before
+	 * the table must be enlarged. */
+	alloc_test_set_limit(0);
+
+	for (i = 0; i < 14; ++i) {
+		values[i] = (int) i;
+		assert(hash_table_insert(hash_table, &values[i], &values[i]) !=
+		       0);
+	}
+
+	values[14] = 14;
+	assert(hash_table_insert(hash_table, &values[14], &values[14]) == 0);
+	assert(hash_table_num_entries(hash_table) == 14);
+
+	for (i = 0; i < 14; ++i) {
+		assert(hash_table_lookup(hash_table, &values[i]) == &values[i]);
+	}
+
+	hash_table_free(hash_table);
+}
+
+static const unsigned int bulk_test_flags[] = {
+	0,
+	HASH_TABLE_POWER_OF_TWO,
+	HASH_TABLE_INCREMENTAL_RESIZE,
+	HASH_TABLE_POOLED,
+	HASH_TABLE_OPEN_ADDRESSING,
+};
+
+#define NUM_BULK_TEST_FLAGS \
+	(sizeof(bulk_test_flags) / sizeof(*bulk_test_flags))
+
+void test_hash_table_reserve(void)
+{
+	HashTable *hash_table;
+	int values[1000];
+	unsigned int flags;
+	unsigned int f;
+	unsigned int i;
+
+	for (f = 0; f < NUM_BULK_TEST_FLAGS; ++f) {
+		flags = bulk_test_flags[f];
+		hash_table = hash_table_new_with_flags(int_hash, int_equal,
+		                                       flags);
+
+		assert(hash_table_reserve(hash_table, 1000) != 0);
+
+		/* Reserving less space than is already available does
+		 * nothing */
+		alloc_test_set_limit(0);
+		assert(hash_table_reserve(hash_table, 10) != 0);
+
+		/* No more allocations are needed for the table itself, so
+		 * chained tables only need one per entry, and open
+		 * addressing tables none at all. */
+		if ((flags & HASH_TABLE_OPEN_ADDRESSING) == 0) {
+			alloc_test_set_limit(1000);
+		}
+
+		for (i = 0; i < 1000; ++i) {
+			values[i] = (int) i;
+			assert(hash_table_insert(hash_table, &values[i],
+			                         &values[i]) != 0);
+		}
+
+		alloc_test_set_limit(-1);
+
+		assert(hash_table_num_entries(hash_table) == 1000);
+
+		for (i = 0; i < 1000; ++i) {
+			assert(hash_table_lookup(hash_table, &values[i]) ==
+			       &values[i]);
+		}
+
+		hash_table_free(hash_table);
+
+		/* A failed reservation leaves the table usable */
+		hash_table = hash_table_new_with_flags(int_hash, int_equal,
+		                                       flags);
+		alloc_test_set_limit(0);
+		assert(hash_table_reserve(hash_table, 100000) == 0);
+		alloc_test_set_limit(-1);
+
+		for (i = 0; i < 1000; ++i) {
+			assert(hash_table_insert(hash_table, &values[i],
+			                         &values[i]) != 0);
+		}
+
+		assert(hash_table_num_entries(hash_table) == 1000);
+
+		hash_table_free(hash_table);
+	}
+}
+
+void test_hash_table_insert_lookup_many(void)
+{
+	HashTable *hash_table;
+	HashTableKey keys[2000];
+	HashTableValue results[2000];
+	int values[2000];
+	unsigned int f;
+	unsigned int i;
+
+	for (i = 0; i < 2000; ++i) {
+		values[i] = (int) i;
+	}
+
+	for (f = 0; f < NUM_BULK_TEST_FLAGS; ++f) {
+		hash_table = hash_table_new_with_flags(int_hash, int_equal,
+		                                       bulk_test_flags[f]);
+
+		/* The keys include every even number below 1000 twice.  The
+		 * second time, each replaces the first. */
+		for (i = 0; i < 1000; ++i) {
+			keys[i] = &values[i];
+			keys[1000 + i] = &values[(i * 2) % 1000];
+		}
+
+		assert(hash_table_insert_many(hash_table, keys,
+		                              (HashTableValue *) keys,
+		                              2000) == 2000);
+		assert(hash_table_num_entries(hash_table) == 1000);
+
+		/* Look up every key, along with as many that are missing */
+		for (i = 0; i < 2000; ++i) {
+			keys[i] = &values[i];
+		}
+
+		assert(hash_table_lookup_many(hash_table, keys, results,
+		                              2000) == 1000);
+
+		for (i = 0; i < 1000; ++i) {
+			assert(results[i] == &values[i]);
+			assert(results[1000 + i] == NULL);
+		}
+
+		/* An empty batch does nothing */
+		assert(hash_table_insert_many(hash_table, keys, results, 0) ==
+		       0);
+		assert(hash_table_lookup_many(hash_table, keys, results, 0) ==
+		       0);
+
+		hash_table_free(hash_table);
+	}
+}
+
+void test_hash_table_insert_many_out_of_memory(void)
+{
+	HashTable *hash_table;
+	HashTableKey keys[100];
+	int values[100];
+	unsigned int i;
+
+	for (i = 0; i < 100; ++i) {
+		values[i] = (int) i;
+		keys[i] = &values[i];
+	}
+
+	/* One allocation for the larger table, then ten entries */
+	hash_table = hash_table_new(int_hash, int_equal);
+	alloc_test_set_limit(11);
+	assert(hash_table_insert_many(hash_table, keys, keys, 100) == 10);
+	alloc_test_set_limit(-1);
+	assert(hash_table_num_entries(hash_table) == 10);
+	hash_table_free(hash_table);
+
+	/* The open addressing table cannot be enlarged at all, so only
+	 * the 14 entries that fit in the initial 16 slots are added */
+	hash_table = hash_table_new_with_flags(int_hash, int_equal,
+	                                       HASH_TABLE_OPEN_ADDRESSING);
+	alloc_test_set_limit(0);
+	assert(hash_table_insert_many(hash_table, keys, keys, 100) == 14);
+	alloc_test_set_limit(-1);
+	assert(hash_table_num_entries(hash_table) == 14);
+
+	for (i = 0; i < 14; ++i) {
+		assert(hash_table_lookup(hash_table, &values[i]) == &values[i]);
+	}
+
+	hash_table_free(hash_table);
+}
+
+void test_hash_table_pooled(void)
+{
+	HashTable *hash_table;
+	int values[10000];
+	int *key;
+	int *value;
+	unsigned int i;
+
+	hash_table = hash_table_new_with_flags(int_hash, int_equal,
+	                                       HASH_TABLE_POOLED);
+
+	/* Entries come from a handful of slabs rather than needing an
+	 * allocation each */
+	alloc_test_set_limit(100);
+
+	for (i = 0; i < 10000; ++i) {
+		values[i] = (int) i;
+		assert(hash_table_insert(hash_table, &values[i], &values[i]) !=
+		       0);
+	}
+
+	assert(hash_table_num_entries(hash_table) == 10000);
+
+	/* Removed entries are reused without allocating any more memory */
+	for (i = 0; i < 10000; i += 2) {
+		assert(hash_table_remove(hash_table, &values[i]) != 0);
+	}
+
+	assert(hash_table_num_entries(hash_table) == 5000);
+
+	alloc_test_set_limit(0);
+
+	for (i = 0; i < 10000; i += 2) {
+		assert(hash_table_insert(hash_table, &values[i], &values[i]) !=
+		       0);
+	}
+
+	alloc_test_set_limit(-1);
+
+	for (i = 0; i < 10000; ++i) {
+		assert(hash_table_lookup(hash_table, &values[i]) == &values[i]);
+	}
+
+	hash_table_free(hash_table);
+
+	/* The free functions are still called for every entry */
+	hash_table = hash_table_new_with_flags(
+	    int_hash, int_equal,
+	    HASH_TABLE_POOLED | HASH_TABLE_INCREMENTAL_RESIZE);
+	hash_table_register_free_functions(hash_table, free_key, free_value);
+	allocated_values = 0;
+
+	for (i = 0; i < 1000; ++i) {
+		key = new_key((int) i);
+		value = new_value(99);
+		hash_table_insert(hash_table, key, value);
+	}
+
+	i = 500;
+	hash_table_remove(hash_table, &i);
+	assert(allocated_keys == 999);
+	assert(allocated_values == 999);
+
+	hash_table_free(hash_table);
+	assert(allocated_keys == 0);
+	assert(allocated_values == 0);
+
+	/* Test out of memory scenario */
+	hash_table = hash_table_new_with_flags(int_hash, int_equal,
+	                                       HASH_TABLE_POOLED);
+	alloc_test_set_limit(0);
+	assert(hash_table_insert(hash_table, &values[0], &values[0]) == 0);
+	assert(hash_table_num_entries(hash_table) == 0);
+	alloc_test_set_limit(-1);
+	hash_table_free(hash_table);
+}
+
+void test_hash_table_load_factor(void)
+{
+	HashTable *hash_table;
+	int values[194];
+	unsigned int i;
+
+	hash_table = hash_table_new(int_hash, int_equal);
+
+	/* The minimum must be less than half of the maximum */
+	assert(hash_table_set_load_factor(hash_table, 0.0, 0.0) == 0);
+	assert(hash_table_set_load_factor(hash_table, 1.0, -0.1) == 0);
+	assert(hash_table_set_load_factor(hash_table, 1.0, 0.5) == 0);
+	assert(hash_table_set_load_factor(hash_table, 1.0, 0.0) != 0);
+
+	/* With a maximum load factor of one, the initial table of 193
+	 * chains holds 193 entries without being enlarged */
+	alloc_test_set_limit(193);
+
+	for (i = 0; i < 193; ++i) {
+		values[i] = (int) i;
+		assert(hash_table_insert(hash_table, &values[i], &values[i]) !=
+		       0);
+	}
+
+	alloc_test_set_limit(0);
+	values[193] = 193;
+	assert(hash_table_insert(hash_table, &values[193], &values[193]) ==
+	       0);
+	alloc_test_set_limit(-1);
+
+	assert(hash_table_insert(hash_table, &values[193], &values[193]) !=
+	       0);
+	assert(hash_table_num_entries(hash_table) == 194);
+
+	hash_table_free(hash_table);
+}
+
+static const unsigned int shrink_test_flags[] = {
+	0,
+	HASH_TABLE_POWER_OF_TWO,
+	HASH_TABLE_INCREMENTAL_RESIZE,
+	HASH_TABLE_POOLED,
+	HASH_TABLE_OPEN_ADDRESSING,
+};
+
+#define NUM_SHRINK_TEST_FLAGS \
+	(sizeof(shrink_test_flags) / sizeof(*shrink_test_flags))
+
+/* Fill a table far beyond its initial size, then remove all but the
+ * first few entries again */
+static void fill_and_drain(HashTable *hash_table, int *values,
+                           unsigned int keep)
+{
+	unsigned int i;
+
+	for (i = keep; i < NUM_TEST_VALUES; ++i) {
+		values[i] = (int) i;
+		assert(hash_table_insert(hash_table, &values[i], &values[i]) !=
+		       0);
+	}
+
+	for (i = keep; i < NUM_TEST_VALUES; ++i) {
+		assert(hash_table_remove(hash_table, &values[i]) != 0);
+	}
+
+	assert(hash_table_num_entries(hash_table) == keep);
+
+	for (i = 0; i < keep; ++i) {
+		assert(hash_table_lookup(hash_table, &values[i]) == &values[i]);
+	}
+}
+
+void test_hash_table_shrink(void)
+{
+	HashTable *hash_table;
+	HashTableIterator iterator;
+	int values[NUM_TEST_VALUES];
+	unsigned int flags;
+	size_t baseline;
+	unsigned int f;
+	unsigned int i;
+
+	for (f = 0; f < NUM_SHRINK_TEST_FLAGS; ++f) {
+		flags = shrink_test_flags[f];
+		hash_table = hash_table_new_with_flags(int_hash, int_equal,
+		                                       flags);
+
+		if ((flags & HASH_TABLE_OPEN_ADDRESSING) != 0) {
+			assert(hash_table_set_load_factor(hash_table, 0.875,
+			                                  0.1) != 0);
+		} else {
+			assert(hash_table_set_load_factor(hash_table, 0.5,
+			                                  0.1) != 0);
+		}
+
+		for (i = 0; i < 10; ++i) {
+			values[i] = (int) i;
+			hash_table_insert(hash_table, &values[i], &values[i]);
+		}
+
+		baseline = alloc_test_get_allocated();
+
+		fill_and_drain(hash_table, values, 10);
+
+		/* An incremental resize may still be in progress, with the
+		 * old table allocated.  Starting to iterate finishes it. */
+		hash_table_iterate(hash_table, &iterator);
+
+		/* Chained tables return to their initial size.  The open
+		 * addressing table stops shrinking at 64 slots, where ten
+		 * entries are still above the minimum load. */
+		if ((flags & HASH_TABLE_OPEN_ADDRESSING) != 0) {
+			assert(alloc_test_get_allocated() <= baseline * 4);
+		} else if ((flags & HASH_TABLE_POOLED) == 0) {
+			assert(alloc_test_get_allocated() == baseline);
+		}
+
+		hash_table_free(hash_table);
+	}
+}
+
+void test_hash_table_compact(void)
+{
+	HashTable *hash_table;
+	int values[NUM_TEST_VALUES];
+	unsigned int flags;
+	size_t baseline;
+	unsigned int f;
+	unsigned int i;
+
+	for (f = 0; f < NUM_SHRINK_TEST_FLAGS; ++f) {
+		flags = shrink_test_flags[f];
+		hash_table = hash_table_new_with_flags(int_hash, int_equal,
+		                                       flags);
+
+		for (i = 0; i < 10; ++i) {
+			values[i] = (int) i;
+			hash_table_insert(hash_table, &values[i], &values[i]);
+		}
+
+		baseline = alloc_test_get_allocated();
+
+		/* Without a minimum load factor, the table keeps its size
+		 * until it is compacted */
+		fill_and_drain(hash_table, values, 10);
+		assert(alloc_test_get_allocated() > baseline);
+
+		/* Compacting needs memory for the new table */
+		alloc_test_set_limit(0);
+		assert(hash_table_compact(hash_table) == 0);
+		alloc_test_set_limit(-1);
+
+		assert(hash_table_compact(hash_table) != 0);
+		assert(alloc_test_get_allocated() <= baseline);
+		assert(hash_table_num_entries(hash_table) == 10);
+
+		for (i = 0; i < 10; ++i) {
+			assert(hash_table_lookup(hash_table, &values[i]) ==
+			       &values[i]);
+		}
+
+		/* The table is still usable afterwards */
+		for (i = 10; i < NUM_TEST_VALUES; ++i) {
+			assert(hash_table_insert(hash_table, &values[i],
+			                         &values[i]) != 0);
+		}
+
+		for (i = 0; i < NUM_TEST_VALUES; ++i) {
+			assert(hash_table_lookup(hash_table, &values[i]) ==
+			       &values[i]);
+		}
+
+		hash_table_free(hash_table);
+	}
+}
+
+static const unsigned int update_test_flags[] = {
+	0,
+	HASH_TABLE_INCREMENTAL_RESIZE,
+	HASH_TABLE_POOLED,
+	HASH_TABLE_OPEN_ADDRESSING,
+};
+
+#define NUM_UPDATE_TEST_FLAGS \
+	(sizeof(update_test_flags) / sizeof(*update_test_flags))
+
+void test_hash_table_lookup_or_insert(void)
+{
+	HashTable *hash_table;
+	HashTableValue *slot;
+	int keys[NUM_TEST_VALUES];
+	int counts[NUM_TEST_VALUES];
+	int inserted;
+	unsigned int f;
+	unsigned int i;
+	unsigned int round;
+
+	for (f = 0; f < NUM_UPDATE_TEST_FLAGS; ++f) {
+		hash_table = hash_table_new_with_flags(int_hash, int_equal,
+		                                       update_test_flags[f]);
+
+		for (i = 0; i < NUM_TEST_VALUES; ++i) {
+			keys[i] = (int) i;
+			counts[i] = 0;
+		}
+
+		/* Count each key three times.  The first update of each
+		 * key inserts it, and the value is then changed in place
+		 * through the pointer returned. */
+		for (round = 0; round < 3; ++round) {
+			for (i = 0; i < NUM_TEST_VALUES; ++i) {
+				slot = hash_table_lookup_or_insert(
+				    hash_table, &keys[i], NULL, &inserted);
+				assert(slot != NULL);
+				assert(inserted == (round == 0));
+
+				if (round == 0) {
+					assert(*slot == NULL);
+					*slot = &counts[i];
+				}
+
+				++*((int *) *slot);
+			}
+		}
+
+		assert(hash_table_num_entries(hash_table) == NUM_TEST_VALUES);
+
+		for (i = 0; i < NUM_TEST_VALUES; ++i) {
+			assert(hash_table_lookup(hash_table, &keys[i]) ==
+			       &counts[i]);
+			assert(counts[i] == 3);
+		}
+
+		/* The inserted flag is optional */
+		slot = hash_table_lookup_or_insert(hash_table, &keys[0], NULL,
+		                                   NULL);
+		assert(slot != NULL && *slot == &counts[0]);
+
+		hash_table_free(hash_table);
+	}
+
+	/* Test out of memory scenario.  The inserted flag is cleared. */
+	hash_table = hash_table_new(int_hash, int_equal);
+	alloc_test_set_limit(0);
+	inserted = 1;
+	assert(hash_table_lookup_or_insert(hash_table, &keys[0], NULL,
+	                                   &inserted) == NULL);
+	assert(inserted == 0);
+	alloc_test_set_limit(-1);
+	assert(hash_table_num_entries(hash_table) == 0);
+	hash_table_free(hash_table);
+}
+
+void test_hash_table_lookup_pair(void)
+{
+	HashTable *hash_table;
+	HashTablePair pair;
+	char stored_key[] = "stored";
+	char query_key[] = "stored";
+	char missing_key[] = "missing";
+	unsigned int f;
+
+	for (f = 0; f < NUM_UPDATE_TEST_FLAGS; ++f) {
+		hash_table = hash_table_new_with_flags(
+		    string_hash, string_equal, update_test_flags[f]);
+
+		/* A key stored with a null value looks the same as a
+		 * missing key to hash_table_lookup, but not here */
+		hash_table_insert(hash_table, stored_key, NULL);
+
+		assert(hash_table_lookup(hash_table, query_key) == NULL);
+		assert(hash_table_contains(hash_table, query_key) != 0);
+		assert(hash_table_contains(hash_table, missing_key) == 0);
+
+		assert(hash_table_lookup_pair(hash_table, query_key, &pair) !=
+		       0);
+		assert(pair.key == stored_key);
+		assert(pair.value == NULL);
+
+		assert(hash_table_lookup_pair(hash_table, missing_key,
+		                              &pair) == 0);
+
+		hash_table_remove(hash_table, query_key);
+		assert(hash_table_contains(hash_table, query_key) == 0);
+
+		hash_table_free(hash_table);
+	}
+}
+
+/* Hash function which puts every key in the same chain */
+static unsigned int constant_hash(HashTableKey key)
+{
+	return 0;
+}
+
+void test_hash_table_statistics(void)
+{
+	HashTable *hash_table;
+	HashTableStatistics stats;
+	int keys[NUM_TEST_VALUES];
+	unsigned long searches;
+	unsigned int total;
+	unsigned int f;
+	unsigned int i;
+
+	for (i = 0; i < NUM_TEST_VALUES; ++i) {
+		keys[i] = (int) i;
+	}
+
+	for (f = 0; f < NUM_UPDATE_TEST_FLAGS; ++f) {
+		hash_table = hash_table_new_with_flags(int_hash, int_equal,
+		                                       update_test_flags[f]);
+
+		hash_table_get_statistics(hash_table, &stats);
+		assert(stats.entries == 0);
+		assert(stats.resizes == 0);
+		assert(stats.max_chain_length == 0);
+		assert(stats.memory_used > 0);
+
+		for (i = 0; i < NUM_TEST_VALUES; ++i) {
+			hash_table_insert(hash_table, &keys[i], &keys[i]);
+		}
+
+		hash_table_get_statistics(hash_table, &stats);
+		assert(stats.entries == NUM_TEST_VALUES);
+		assert(stats.table_size >= NUM_TEST_VALUES);
+		assert(stats.load_factor > 0.0 && stats.load_factor < 1.0);
+		assert(stats.resizes > 0);
+
+		/* Chained tables count every chain in the histogram, open
+		 * addressing tables count every entry */
+		total = 0;
+
+		for (i = 0; i < HASH_TABLE_HISTOGRAM_SIZE; ++i) {
+			total += stats.chain_lengths[i];
+		}
+
+		if ((update_test_flags[f] & HASH_TABLE_OPEN_ADDRESSING) != 0) {
+			assert(total == NUM_TEST_VALUES);
+		} else {
+			assert(total == stats.table_size);
+		}
+
+		/* Each lookup is one search, and examines at least one
+		 * entry when the key is present */
+		searches = stats.searches;
+
+		for (i = 0; i < NUM_TEST_VALUES; ++i) {
+			assert(hash_table_lookup(hash_table, &keys[i]) ==
+			       &keys[i]);
+		}
+
+		hash_table_get_statistics(hash_table, &stats);
+		assert(stats.searches == searches + NUM_TEST_VALUES);
+		assert(stats.probes >= stats.searches - searches);
+		assert(stats.max_probes >= 1);
+
+		hash_table_free(hash_table);
+	}
+
+	/* A hash function that puts everything in one chain shows up as
+	 * a single long chain */
+	hash_table = hash_table_new(constant_hash, int_equal);
+
+	for (i = 0; i < 100; ++i) {
+		hash_table_insert(hash_table, &keys[i], &keys[i]);
+	}
+
+	/* Inserting the last key had to check every other key first */
+	hash_table_get_statistics(hash_table, &stats);
+	assert(stats.max_chain_length == 100);
+	assert(stats.chain_lengths[HASH_TABLE_HISTOGRAM_SIZE - 1] == 1);
+	assert(stats.chain_lengths[0] == stats.table_size - 1);
+	assert(stats.max_probes == 99);
+
+	hash_table_free(hash_table);
+
+	/* In an open addressing table, the entries are pushed along the
+	 * probe sequence instead */
+	hash_table = hash_table_new_with_flags(constant_hash, int_equal,
+	                                       HASH_TABLE_OPEN_ADDRESSING);
+
+	for (i = 0; i < 100; ++i) {
+		hash_table_insert(hash_table, &keys[i], &keys[i]);
+	}
+
+	hash_table_get_statistics(hash_table, &stats);
+	assert(stats.max_chain_length >= 100 / 16 - 1);
+	assert(stats.chain_lengths[0] <= 16);
+
+	hash_table_free(hash_table);
+}
+
+static const unsigned int parallel_test_flags[] = {
+	0,
+	HASH_TABLE_POWER_OF_TWO,
+	HASH_TABLE_INCREMENTAL_RESIZE,
+	HASH_TABLE_POOLED,
+	HASH_TABLE_OPEN_ADDRESSING,
+};
+
+#define NUM_PARALLEL_TEST_FLAGS \
+	(sizeof(parallel_test_flags) / sizeof(*parallel_test_flags))
+
+#define NUM_PARALLEL_TEST_VALUES (NUM_TEST_VALUES * 2)
+
+void test_hash_table_parallel(void)
+{
+	HashTable *hash_table;
+	HashTableKey *keys;
+	HashTableValue *values;
+	int *numbers;
+	unsigned int found;
+	unsigned int result;
+	unsigned int f;
+	unsigned int i;
+
+	numbers = malloc(sizeof(int) * NUM_PARALLEL_TEST_VALUES * 2);
+	keys = malloc(sizeof(HashTableKey) * NUM_PARALLEL_TEST_VALUES * 2);
+	values = malloc(sizeof(HashTableValue) * NUM_PARALLEL_TEST_VALUES * 2);
+
+	/* Every key appears twice, and the second value inserted for
+	 * each key must win */
+	for (i = 0; i < NUM_PARALLEL_TEST_VALUES * 2; ++i) {
+		numbers[i] = (int) i;
+		keys[i] = &numbers[i % NUM_PARALLEL_TEST_VALUES];
+		values[i] = &numbers[i];
+	}
+
+	for (f = 0; f < NUM_PARALLEL_TEST_FLAGS; ++f) {
+
+		/* Enlarging the table one insert at a time */
+		hash_table = hash_table_new_with_flags(int_hash, int_equal,
+		                                       parallel_test_flags[f]);
+		hash_table_set_threads(hash_table, 4);
+
+		for (i = 0; i < NUM_PARALLEL_TEST_VALUES; ++i) {
+			assert(hash_table_insert(hash_table, keys[i],
+			                         values[i]) != 0);
+		}
+
+		assert(hash_table_num_entries(hash_table) ==
+		       NUM_PARALLEL_TEST_VALUES);
+
+		for (i = 0; i < NUM_PARALLEL_TEST_VALUES; ++i) {
+			assert(hash_table_lookup(hash_table, keys[i]) ==
+			       values[i]);
+		}
+
+		hash_table_free(hash_table);
+
+		/* Bulk insert */
+		hash_table = hash_table_new_with_flags(int_hash, int_equal,
+		                                       parallel_test_flags[f]);
+		hash_table_set_threads(hash_table, 4);
+
+		result = hash_table_insert_many(hash_table, keys, values,
+		                                NUM_PARALLEL_TEST_VALUES * 2);
+		assert(result == NUM_PARALLEL_TEST_VALUES * 2);
+		assert(hash_table_num_entries(hash_table) ==
+		       NUM_PARALLEL_TEST_VALUES);
+
+		for (i = 0; i < NUM_PARALLEL_TEST_VALUES; ++i) {
+			assert(hash_table_lookup(hash_table, keys[i]) ==
+			       values[i + NUM_PARALLEL_TEST_VALUES]);
+		}
+
+		/* Overwriting keys already in the table */
+		result = hash_table_insert_many(hash_table, keys, values,
+		                                NUM_PARALLEL_TEST_VALUES);
+		assert(result == NUM_PARALLEL_TEST_VALUES);
+		assert(hash_table_num_entries(hash_table) ==
+		       NUM_PARALLEL_TEST_VALUES);
+
+		for (i = 0; i < NUM_PARALLEL_TEST_VALUES; ++i) {
+			assert(hash_table_lookup(hash_table, keys[i]) ==
+			       values[i]);
+		}
+
+		hash_table_free(hash_table);
+	}
+
+	/* Test out of memory scenario.  The values that were inserted
+	 * are not necessarily the first ones, but are all present. */
+	hash_table = hash_table_new(int_hash, int_equal);
+	hash_table_set_threads(hash_table, 4);
+
+	alloc_test_set_limit(100);
+	result = hash_table_insert_many(hash_table, keys, values,
+	                                NUM_PARALLEL_TEST_VALUES);
+	alloc_test_set_limit(-1);
+
+	assert(result < NUM_PARALLEL_TEST_VALUES);
+	assert(hash_table_num_entries(hash_table) == result);
+
+	found = 0;
+
+	for (i = 0; i < NUM_PARALLEL_TEST_VALUES; ++i) {
+		if (hash_table_lookup(hash_table, keys[i]) == values[i]) {
+			++found;
+		}
+	}
+
+	assert(found == result);
+
+	hash_table_free(hash_table);
+
+	free(numbers);
+	free(keys);
+	free(values);
+}
+
+static const unsigned int scan_test_flags[] = {
+	0,
+	HASH_TABLE_POWER_OF_TWO,
+	HASH_TABLE_INCREMENTAL_RESIZE,
+	HASH_TABLE_POWER_OF_TWO | HASH_TABLE_INCREMENTAL_RESIZE,
+	HASH_TABLE_POOLED,
+	HASH_TABLE_OPEN_ADDRESSING,
+};
+
+#define NUM_SCAN_TEST_FLAGS \
+	(sizeof(scan_test_flags) / sizeof(*scan_test_flags))
+
+static void count_scanned(HashTablePair pair, void *user_data)
+{
+	unsigned int *counts;
+
+	counts = user_data;
+	++counts[*((int *) pair.key)];
+}
+
+void test_hash_table_scan(void)
+{
+	HashTable *hash_table;
+	HashTableCursor cursor;
+	int values[NUM_TEST_VALUES];
+	unsigned int counts[NUM_TEST_VALUES];
+	int *key;
+	unsigned int steps;
+	unsigned int f;
+	unsigned int i;
+
+	for (i = 0; i < NUM_TEST_VALUES; ++i) {
+		values[i] = (int) i;
+	}
+
+	for (f = 0; f < NUM_SCAN_TEST_FLAGS; ++f) {
+		hash_table = hash_table_new_with_flags(int_hash, int_equal,
+		                                       scan_test_flags[f]);
+
+		/* A complete scan of an unchanging table visits every
+		 * entry exactly once */
+		for (i = 0; i < 1000; ++i) {
+			hash_table_insert(hash_table, &values[i], &values[i]);
+		}
+
+		memset(counts, 0, sizeof(counts));
+		hash_table_scan_start(hash_table, &cursor);
+
+		while (hash_table_scan(hash_table, &cursor, 7, count_scanned,
+		                       counts) != 0)
+			;
+
+		for (i = 0; i < NUM_TEST_VALUES; ++i) {
+			assert(counts[i] == (i < 1000));
+		}
+
+		/* Change the table between steps: the table grows to many
+		 * times its size, then shrinks again.  The even entries are
+		 * there throughout, and must be visited. */
+		memset(counts, 0, sizeof(counts));
+		hash_table_scan_start(hash_table, &cursor);
+		steps = 0;
+
+		while (hash_table_scan(hash_table, &cursor, 3, count_scanned,
+		                       counts) != 0) {
+			if (steps < 500) {
+				key = &values[(steps * 2 + 1) % 1000];
+				hash_table_remove(hash_table, key);
+
+				for (i = 0; i < 18; ++i) {
+					key = &values[1000 + steps * 18 + i];
+					hash_table_insert(hash_table, key, key);
+				}
+			} else if (steps < 1000) {
+				for (i = 0; i < 18; ++i) {
+					key = &values[1000 + (steps - 500) * 18
+					              + i];
+					hash_table_remove(hash_table, key);
+				}
+			}
+
+			++steps;
+			assert(steps < NUM_TEST_VALUES * 10);
+		}
+
+		for (i = 0; i < 1000; i += 2) {
+			assert(counts[i] >= 1);
+		}
+
+		/* Scanning an empty table */
+		hash_table_free(hash_table);
+		hash_table = hash_table_new_with_flags(int_hash, int_equal,
+		                                       scan_test_flags[f]);
+
+		memset(counts, 0, sizeof(counts));
+		hash_table_scan_start(hash_table, &cursor);
+		steps = 0;
+
+		while (hash_table_scan(hash_table, &cursor, 1000, count_scanned,
+		                       counts) != 0) {
+			++steps;
+		}
+
+		assert(steps < 2);
+
+		for (i = 0; i < NUM_TEST_VALUES; ++i) {
+			assert(counts[i] == 0);
+		}
+
+		hash_table_free(hash_table);
+	}
+}
+
 /* clang-format off */
 static UnitTestFunction tests[] = {
 	test_hash_table_new_free,
@@ -432,6 +1666,24 @@ static UnitTestFunction tests[] = {
 	test_hash_table_free_functions,
 	test_hash_table_out_of_memory,
 	test_hash_iterator_key_pair,
+	test_hash_table_saved_hashes,
+	test_hash_table_power_of_two,
+	test_hash_table_incremental_resize,
+	test_hash_table_open_addressing,
+	test_hash_table_open_addressing_churn,
+	test_hash_table_open_addressing_out_of_memory,
+	test_hash_table_reserve,
+	test_hash_table_insert_lookup_many,
+	test_hash_table_insert_many_out_of_memory,
+	test_hash_table_pooled,
+	test_hash_table_load_factor,
+	test_hash_table_shrink,
+	test_hash_table_compact,
+	test_hash_table_lookup_or_insert,
+	test_hash_table_lookup_pair,
+	test_hash_table_statistics,
+	test_hash_table_parallel,
+	test_hash_table_scan,
 	NULL
 };
 /* clang-format on */
@@ -0,0 +1,417 @@
+/*
+
+Copyright (c) 2026 Simon Howard
+
+Permission to use, copy, modify, and/or distribute this software
+for any purpose with or without fee is hereby granted, provided
+that the above copyright notice and this permission notice appear
+in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT,
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "alloc-testing.h"
+#include "framework.h"
+
+#include "int-set.h"
+
+#define NUM_TEST_VALUES 10000
+
+/* Values used by the tests.  These are spread out, and include negative
+ * values and zero, which is handled specially. */
+static int test_value(unsigned int i)
+{
+	return ((int) i - NUM_TEST_VALUES / 2) * 7919;
+}
+
+IntSet *generate_int_set(void)
+{
+	IntSet *set;
+	unsigned int i;
+
+	set = int_set_new();
+
+	for (i = 0; i < NUM_TEST_VALUES; ++i) {
+		assert(int_set_insert(set, test_value(i)) != 0);
+		assert(int_set_num_entries(set) == i + 1);
+	}
+
+	return set;
+}
+
+void test_int_set_new_free(void)
+{
+	IntSet *set;
+
+	set = generate_int_set();
+	int_set_free(set);
+
+	/* Test out of memory scenario */
+	alloc_test_set_limit(0);
+	set = int_set_new();
+	assert(set == NULL);
+
+	alloc_test_set_limit(1);
+	set = int_set_new();
+	assert(set == NULL);
+	assert(alloc_test_get_allocated() == 0);
+}
+
+void test_int_set_insert_query(void)
+{
+	IntSet *set;
+	unsigned int i;
+
+	set = generate_int_set();
+
+	/* Inserting values a second time has no effect */
+	for (i = 0; i < NUM_TEST_VALUES; ++i) {
+		assert(int_set_insert(set, test_value(i)) == 0);
+	}
+
+	assert(int_set_num_entries(set) == NUM_TEST_VALUES);
+
+	for (i = 0; i < NUM_TEST_VALUES; ++i) {
+		assert(int_set_query(set, test_value(i)) != 0);
+		assert(int_set_query(set, test_value(i) + 1) == 0);
+	}
+
+	assert(int_set_query(set, 0) != 0);
+
+	int_set_free(set);
+
+	/* Zero is only found once it has been added */
+	set = int_set_new();
+
+	assert(int_set_query(set, 0) == 0);
+	assert(int_set_num_entries(set) == 0);
+	assert(int_set_insert(set, 0) != 0);
+	assert(int_set_insert(set, 0) == 0);
+	assert(int_set_query(set, 0) != 0);
+	assert(int_set_num_entries(set) == 1);
+
+	int_set_free(set);
+}
+
+void test_int_set_remove(void)
+{
+	IntSet *set;
+	unsigned int i;
+
+	set = generate_int_set();
+
+	/* Remove every third value, including zero */
+	for (i = 0; i < NUM_TEST_VALUES; i += 3) {
+		assert(int_set_remove(set, test_value(i)) != 0);
+		assert(int_set_remove(set, test_value(i)) == 0);
+	}
+
+	assert(int_set_num_entries(set) ==
+	       NUM_TEST_VALUES - (NUM_TEST_VALUES + 2) / 3);
+
+	/* Values that were moved to fill the gaps are still found */
+	for (i = 0; i < NUM_TEST_VALUES; ++i) {
+		assert((int_set_query(set, test_value(i)) != 0) == (i % 3 != 0));
+	}
+
+	/* Removing values that were never in the set has no effect */
+	assert(int_set_remove(set, 1) == 0);
+	assert(int_set_remove(set, -1) == 0);
+
+	int_set_free(set);
+}
+
+void test_int_set_iterating(void)
+{
+	IntSet *set;
+	IntSetIterator iterator;
+	char *seen;
+	unsigned int count;
+	int value;
+
+	set = generate_int_set();
+	seen = calloc(NUM_TEST_VALUES, 1);
+
+	/* Every value is returned exactly once */
+	count = 0;
+	int_set_iterate(set, &iterator);
+
+	while (int_set_iter_has_more(&iterator)) {
+		value = int_set_iter_next(&iterator);
+
+		assert(value % 7919 == 0);
+		assert(seen[value / 7919 + NUM_TEST_VALUES / 2] == 0);
+		seen[value / 7919 + NUM_TEST_VALUES / 2] = 1;
+
+		++count;
+	}
+
+	assert(count == NUM_TEST_VALUES);
+	assert(int_set_iter_next(&iterator) == 0);
+
+	free(seen);
+	int_set_free(set);
+
+	/* Test iterating over an empty set */
+	set = int_set_new();
+
+	int_set_iterate(set, &iterator);
+	assert(int_set_iter_has_more(&iterator) == 0);
+
+	int_set_free(set);
+}
+
+/* Removing the current value while iterating should not affect the
+ * iterator. */
+void test_int_set_iterating_remove(void)
+{
+	IntSet *set;
+	IntSetIterator iterator;
+	unsigned int count;
+	unsigned int removed;
+	int value;
+
+	set = generate_int_set();
+
+	count = 0;
+	removed = 0;
+	int_set_iterate(set, &iterator);
+
+	while (int_set_iter_has_more(&iterator)) {
+		value = int_set_iter_next(&iterator);
+
+		if ((value / 7919) % 2 == 0) {
+			assert(int_set_remove(set, value) != 0);
+			++removed;
+		}
+
+		++count;
+	}
+
+	assert(count == NUM_TEST_VALUES);
+	assert(removed == NUM_TEST_VALUES / 2);
+	assert(int_set_num_entries(set) == NUM_TEST_VALUES - removed);
+
+	int_set_free(set);
+}
+
+void test_int_set_to_array(void)
+{
+	IntSet *set;
+	int *array;
+	unsigned int i;
+	int sum;
+
+	set = int_set_new();
+
+	for (i = 0; i < 100; ++i) {
+		int_set_insert(set, (int) i);
+	}
+
+	array = int_set_to_array(set);
+
+	sum = 0;
+
+	for (i = 0; i < 100; ++i) {
+		sum += array[i];
+	}
+
+	assert(sum == 99 * 100 / 2);
+
+	free(array);
+
+	/* Test out of memory scenario */
+	alloc_test_set_limit(0);
+	assert(int_set_to_array(set) == NULL);
+
+	int_set_free(set);
+}
+
+void test_int_set_union(void)
+{
+	int numbers1[] = {1, 2, 3, 4, 5, 6, 7};
+	int numbers2[] = {5, 6, 7, 8, 9, 10, 11, 0};
+	int result[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+	IntSet *set1;
+	IntSet *set2;
+	IntSet *result_set;
+	size_t allocated;
+	unsigned int i;
+
+	set1 = int_set_new();
+
+	for (i = 0; i < sizeof(numbers1) / sizeof(int); ++i) {
+		int_set_insert(set1, numbers1[i]);
+	}
+
+	set2 = int_set_new();
+
+	for (i = 0; i < sizeof(numbers2) / sizeof(int); ++i) {
+		int_set_insert(set2, numbers2[i]);
+	}
+
+	result_set = int_set_union(set1, set2);
+
+	assert(int_set_num_entries(result_set) == 12);
+
+	for (i = 0; i < sizeof(result) / sizeof(int); ++i) {
+		assert(int_set_query(result_set, result[i]) != 0);
+	}
+
+	int_set_free(result_set);
+
+	/* Test out of memory scenario */
+	alloc_test_set_limit(0);
+	assert(int_set_union(set1, set2) == NULL);
+	alloc_test_set_limit(-1);
+
+	int_set_free(set1);
+	int_set_free(set2);
+
+	/* The result is sized for both sets before any values are added,
+	 * so a union that needs a larger table fails without leaking */
+	set1 = generate_int_set();
+	set2 = int_set_new();
+
+	alloc_test_set_limit(2);
+	allocated = alloc_test_get_allocated();
+	assert(int_set_union(set1, set2) == NULL);
+	assert(alloc_test_get_allocated() == allocated);
+	alloc_test_set_limit(-1);
+
+	result_set = int_set_union(set2, set1);
+	assert(int_set_num_entries(result_set) == NUM_TEST_VALUES);
+
+	for (i = 0; i < NUM_TEST_VALUES; ++i) {
+		assert(int_set_query(result_set, test_value(i)) != 0);
+	}
+
+	int_set_free(result_set);
+	int_set_free(set1);
+	int_set_free(set2);
+}
+
+void test_int_set_intersection(void)
+{
+	int numbers1[] = {1, 2, 3, 4, 5, 6, 7, 0};
+	int numbers2[] = {5, 6, 7, 8, 9, 10, 11};
+	int result[] = {5, 6, 7};
+	IntSet *set1;
+	IntSet *set2;
+	IntSet *result_set;
+	unsigned int i;
+
+	set1 = int_set_new();
+
+	for (i = 0; i < sizeof(numbers1) / sizeof(int); ++i) {
+		int_set_insert(set1, numbers1[i]);
+	}
+
+	set2 = int_set_new();
+
+	for (i = 0; i < sizeof(numbers2) / sizeof(int); ++i) {
+		int_set_insert(set2, numbers2[i]);
+	}
+
+	result_set = int_set_intersection(set1, set2);
+
+	assert(int_set_num_entries(result_set) == 3);
+
+	for (i = 0; i < sizeof(result) / sizeof(int); ++i) {
+		assert(int_set_query(result_set, result[i]) != 0);
+	}
+
+	assert(int_set_query(result_set, 0) == 0);
+
+	int_set_free(result_set);
+
+	/* Test out of memory scenario */
+	alloc_test_set_limit(0);
+	assert(int_set_intersection(set1, set2) == NULL);
+	alloc_test_set_limit(-1);
+
+	int_set_free(set2);
+
+	/* Intersect with a much larger set, in both orders */
+	set2 = generate_int_set();
+
+	result_set = int_set_intersection(set1, set2);
+	assert(int_set_num_entries(result_set) == 1);
+	assert(int_set_query(result_set, 0) != 0);
+	int_set_free(result_set);
+
+	result_set = int_set_intersection(set2, set1);
+	assert(int_set_num_entries(result_set) == 1);
+	int_set_free(result_set);
+
+	int_set_free(set1);
+	int_set_free(set2);
+}
+
+/* Test for out of memory when the table is enlarged */
+void test_int_set_out_of_memory(void)
+{
+	IntSet *set;
+	int i;
+
+	set = int_set_new();
+
+	/* The initial table has 16 slots and is enlarged when 3/4 full,
+	 * so the 13th non-zero value needs a larger table. */
+	for (i = 1; i <= 12; ++i) {
+		assert(int_set_insert(set, i) != 0);
+	}
+
+	alloc_test_set_limit(0);
+
+	assert(int_set_insert(set, 13) == 0);
+	assert(int_set_num_entries(set) == 12);
+
+	/* Zero and existing values do not need any memory */
+	assert(int_set_insert(set, 0) != 0);
+	assert(int_set_insert(set, 12) == 0);
+	assert(int_set_num_entries(set) == 13);
+
+	alloc_test_set_limit(-1);
+
+	assert(int_set_insert(set, 13) != 0);
+
+	for (i = 0; i <= 13; ++i) {
+		assert(int_set_query(set, i) != 0);
+	}
+
+	int_set_free(set);
+}
+
+static UnitTestFunction tests[] = {
+	test_int_set_new_free,
+	test_int_set_insert_query,
+	test_int_set_remove,
+	test_int_set_iterating,
+	test_int_set_iterating_remove,
+	test_int_set_to_array,
+	test_int_set_union,
+	test_int_set_intersection,
+	test_int_set_out_of_memory,
+	NULL
+};
+
+int main(int argc, char *argv[])
+{
+	run_tests(tests);
+
+	return 0;
+}
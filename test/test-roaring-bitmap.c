@@ -0,0 +1,595 @@
+/*
+
+Copyright (c) 2026 Simon Howard
+
+Permission to use, copy, modify, and/or distribute this software
+for any purpose with or without fee is hereby granted, provided
+that the above copyright notice and this permission notice appear
+in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT,
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+ */
+
+#include <assert.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "alloc-testing.h"
+#include "framework.h"
+
+#include "roaring-bitmap.h"
+
+/* Tests compare bitmaps against a plain array of flags covering the
+ * first few containers. */
+#define UNIVERSE (4 * 65536)
+
+static unsigned int random_state;
+
+/* Simple xorshift generator, so that results are repeatable */
+static unsigned int next_random(void)
+{
+	random_state ^= random_state << 13;
+	random_state ^= random_state >> 17;
+	random_state ^= random_state << 5;
+
+	return random_state;
+}
+
+/* Fill a bitmap and the matching flags.  Each container gets a
+ * different density, so that all forms of container are used. */
+static RoaringBitmap *generate_bitmap(char *flags, unsigned int seed)
+{
+	RoaringBitmap *bitmap;
+	unsigned int value;
+	unsigned int i;
+
+	random_state = seed;
+	bitmap = roaring_bitmap_new();
+	memset(flags, 0, UNIVERSE);
+
+	for (i = 0; i < UNIVERSE; ++i) {
+		switch (i >> 16) {
+		case 0:
+			/* Sparse: an array container */
+			value = (next_random() % 1000 == 0);
+			break;
+		case 1:
+			/* Dense: a bitmap container */
+			value = (next_random() % 2 == 0);
+			break;
+		case 2:
+			/* Long ranges: becomes a run container when
+			 * optimized */
+			value = ((i + seed) / 1000) % 3 == 0;
+			break;
+		default:
+			value = 0;
+			break;
+		}
+
+		if (value) {
+			assert(roaring_bitmap_insert(bitmap, i) != 0);
+			flags[i] = 1;
+		}
+	}
+
+	return bitmap;
+}
+
+/* Check that a bitmap holds exactly the values set in the flags */
+static void check_bitmap(RoaringBitmap *bitmap, const char *flags)
+{
+	RoaringBitmapIterator iterator;
+	unsigned int *array;
+	unsigned long count;
+	unsigned int i;
+
+	count = 0;
+
+	for (i = 0; i < UNIVERSE; ++i) {
+		assert((roaring_bitmap_query(bitmap, i) != 0) == flags[i]);
+		count += (unsigned long) flags[i];
+	}
+
+	assert(roaring_bitmap_num_entries(bitmap) == count);
+
+	array = roaring_bitmap_to_array(bitmap);
+	roaring_bitmap_iterate(bitmap, &iterator);
+
+	for (i = 0; i < count; ++i) {
+		assert(flags[array[i]]);
+		assert(i == 0 || array[i] > array[i - 1]);
+		assert(roaring_bitmap_iter_has_more(&iterator));
+		assert(roaring_bitmap_iter_next(&iterator) == array[i]);
+	}
+
+	assert(!roaring_bitmap_iter_has_more(&iterator));
+
+	free(array);
+}
+
+void test_roaring_bitmap_new_free(void)
+{
+	RoaringBitmap *bitmap;
+
+	bitmap = roaring_bitmap_new();
+	assert(bitmap != NULL);
+	assert(roaring_bitmap_num_entries(bitmap) == 0);
+	roaring_bitmap_free(bitmap);
+
+	/* Test out of memory scenario */
+	alloc_test_set_limit(0);
+	bitmap = roaring_bitmap_new();
+	assert(bitmap == NULL);
+}
+
+void test_roaring_bitmap_insert_remove(void)
+{
+	RoaringBitmap *bitmap;
+	unsigned int i;
+
+	bitmap = roaring_bitmap_new();
+
+	/* Values at the extremes */
+	assert(roaring_bitmap_insert(bitmap, 0) != 0);
+	assert(roaring_bitmap_insert(bitmap, 0xffffffffU) != 0);
+	assert(roaring_bitmap_insert(bitmap, 0) == 0);
+	assert(roaring_bitmap_query(bitmap, 0) != 0);
+	assert(roaring_bitmap_query(bitmap, 0xffffffffU) != 0);
+	assert(roaring_bitmap_query(bitmap, 1) == 0);
+	assert(roaring_bitmap_num_entries(bitmap) == 2);
+
+	/* Fill a container past the size of an array, then empty it again,
+	 * so that it switches to a bitmap and back */
+	for (i = 1; i < 10000; ++i) {
+		assert(roaring_bitmap_insert(bitmap, i * 3) != 0);
+		assert(roaring_bitmap_num_entries(bitmap) == i + 2);
+	}
+
+	for (i = 0; i < 30000; ++i) {
+		assert((roaring_bitmap_query(bitmap, i) != 0) == (i % 3 == 0));
+	}
+
+	for (i = 1; i < 10000; ++i) {
+		assert(roaring_bitmap_remove(bitmap, i * 3) != 0);
+		assert(roaring_bitmap_remove(bitmap, i * 3) == 0);
+		assert(roaring_bitmap_query(bitmap, i * 3) == 0);
+	}
+
+	assert(roaring_bitmap_num_entries(bitmap) == 2);
+
+	/* Removing the last value of a container */
+	assert(roaring_bitmap_remove(bitmap, 0) != 0);
+	assert(roaring_bitmap_remove(bitmap, 0xffffffffU) != 0);
+	assert(roaring_bitmap_remove(bitmap, 0xffffffffU) == 0);
+	assert(roaring_bitmap_num_entries(bitmap) == 0);
+
+	roaring_bitmap_free(bitmap);
+}
+
+void test_roaring_bitmap_optimize(void)
+{
+	unsigned int changes[] = {200, 299, 250, 250, 50, 150, 100, 399, 150};
+	RoaringBitmap *bitmap;
+	char *flags;
+	size_t size_before;
+	unsigned int i;
+
+	flags = malloc(UNIVERSE);
+	bitmap = generate_bitmap(flags, 1);
+
+	size_before = roaring_bitmap_serialized_size(bitmap);
+	assert(roaring_bitmap_optimize(bitmap) != 0);
+	assert(roaring_bitmap_serialized_size(bitmap) < size_before);
+	check_bitmap(bitmap, flags);
+
+	roaring_bitmap_free(bitmap);
+
+	/* Two runs, which are stored as four values */
+	bitmap = roaring_bitmap_new();
+	memset(flags, 0, UNIVERSE);
+
+	for (i = 100; i < 400; ++i) {
+		if (i < 200 || i >= 300) {
+			roaring_bitmap_insert(bitmap, i);
+			flags[i] = 1;
+		}
+	}
+
+	assert(roaring_bitmap_optimize(bitmap) != 0);
+	assert(roaring_bitmap_serialized_size(bitmap) == 8 + 7 + 2 * 4);
+
+	/* Runs are extended, joined and split as values change */
+	for (i = 0; i < sizeof(changes) / sizeof(*changes); ++i) {
+		if (flags[changes[i]]) {
+			assert(roaring_bitmap_remove(bitmap, changes[i]) != 0);
+			flags[changes[i]] = 0;
+		} else {
+			assert(roaring_bitmap_insert(bitmap, changes[i]) != 0);
+			flags[changes[i]] = 1;
+		}
+
+		check_bitmap(bitmap, flags);
+	}
+
+	/* Filling the gap joins the two long runs together, leaving only
+	 * the run holding 50 beside it */
+	for (i = 200; i < 300; ++i) {
+		roaring_bitmap_insert(bitmap, i);
+		flags[i] = 1;
+	}
+
+	check_bitmap(bitmap, flags);
+	assert(roaring_bitmap_serialized_size(bitmap) == 8 + 7 + 2 * 4);
+
+	roaring_bitmap_free(bitmap);
+	free(flags);
+}
+
+void test_roaring_bitmap_iterating_remove(void)
+{
+	RoaringBitmap *bitmap;
+	RoaringBitmapIterator iterator;
+	char *flags;
+	unsigned int value;
+	unsigned long count;
+	unsigned long total;
+
+	flags = malloc(UNIVERSE);
+	bitmap = generate_bitmap(flags, 2);
+	roaring_bitmap_optimize(bitmap);
+	total = roaring_bitmap_num_entries(bitmap);
+
+	/* Remove every other value returned by the iterator */
+	count = 0;
+	roaring_bitmap_iterate(bitmap, &iterator);
+
+	while (roaring_bitmap_iter_has_more(&iterator)) {
+		value = roaring_bitmap_iter_next(&iterator);
+
+		if (count % 2 == 0) {
+			assert(roaring_bitmap_remove(bitmap, value) != 0);
+			flags[value] = 0;
+		}
+
+		++count;
+	}
+
+	assert(count == total);
+	assert(roaring_bitmap_iter_next(&iterator) == 0);
+
+	check_bitmap(bitmap, flags);
+
+	roaring_bitmap_free(bitmap);
+	free(flags);
+}
+
+void test_roaring_bitmap_algebra(void)
+{
+	RoaringBitmap *bitmap1, *bitmap2, *result;
+	char *flags1, *flags2, *expected;
+	unsigned int pass;
+	unsigned int i;
+
+	flags1 = malloc(UNIVERSE);
+	flags2 = malloc(UNIVERSE);
+	expected = malloc(UNIVERSE);
+
+	/* Try each combination of plain and optimized bitmaps, so that
+	 * every pair of container forms is combined */
+	for (pass = 0; pass < 4; ++pass) {
+		bitmap1 = generate_bitmap(flags1, 3);
+		bitmap2 = generate_bitmap(flags2, 500);
+
+		if (pass & 1) {
+			roaring_bitmap_optimize(bitmap1);
+		}
+		if (pass & 2) {
+			roaring_bitmap_optimize(bitmap2);
+		}
+
+		result = roaring_bitmap_union(bitmap1, bitmap2);
+		for (i = 0; i < UNIVERSE; ++i) {
+			expected[i] = (char) (flags1[i] || flags2[i]);
+		}
+		check_bitmap(result, expected);
+		roaring_bitmap_free(result);
+
+		result = roaring_bitmap_intersection(bitmap1, bitmap2);
+		for (i = 0; i < UNIVERSE; ++i) {
+			expected[i] = (char) (flags1[i] && flags2[i]);
+		}
+		check_bitmap(result, expected);
+		roaring_bitmap_free(result);
+
+		result = roaring_bitmap_difference(bitmap1, bitmap2);
+		for (i = 0; i < UNIVERSE; ++i) {
+			expected[i] = (char) (flags1[i] && !flags2[i]);
+		}
+		check_bitmap(result, expected);
+		roaring_bitmap_free(result);
+
+		/* A bitmap with itself */
+		result = roaring_bitmap_difference(bitmap1, bitmap1);
+		assert(roaring_bitmap_num_entries(result) == 0);
+		roaring_bitmap_free(result);
+
+		roaring_bitmap_free(bitmap1);
+		roaring_bitmap_free(bitmap2);
+	}
+
+	free(flags1);
+	free(flags2);
+	free(expected);
+}
+
+void test_roaring_bitmap_algebra_out_of_memory(void)
+{
+	RoaringBitmap *bitmap1, *bitmap2, *result;
+	char *flags;
+	size_t allocated;
+	int limit;
+
+	flags = malloc(UNIVERSE);
+	bitmap1 = generate_bitmap(flags, 4);
+	bitmap2 = generate_bitmap(flags, 5);
+	roaring_bitmap_optimize(bitmap2);
+
+	/* Fail each allocation in turn, checking that nothing leaks */
+	for (limit = 0;; ++limit) {
+		allocated = alloc_test_get_allocated();
+		alloc_test_set_limit(limit);
+		result = roaring_bitmap_union(bitmap1, bitmap2);
+		alloc_test_set_limit(-1);
+
+		if (result != NULL) {
+			break;
+		}
+
+		assert(alloc_test_get_allocated() == allocated);
+	}
+
+	assert(limit > 0);
+	roaring_bitmap_free(result);
+
+	roaring_bitmap_free(bitmap1);
+	roaring_bitmap_free(bitmap2);
+	free(flags);
+}
+
+void test_roaring_bitmap_serialize(void)
+{
+	RoaringBitmap *bitmap, *loaded;
+	unsigned char *buffer;
+	char *flags;
+	size_t size;
+	size_t i;
+
+	flags = malloc(UNIVERSE);
+	bitmap = generate_bitmap(flags, 6);
+	roaring_bitmap_optimize(bitmap);
+
+	/* Add another sparse container */
+	roaring_bitmap_insert(bitmap, 3 * 65536 + 5);
+	flags[3 * 65536 + 5] = 1;
+
+	size = roaring_bitmap_serialized_size(bitmap);
+	buffer = malloc(size);
+	assert(roaring_bitmap_serialize(bitmap, buffer) == size);
+
+	loaded = roaring_bitmap_deserialize(buffer, size);
+	assert(loaded != NULL);
+	check_bitmap(loaded, flags);
+	roaring_bitmap_free(loaded);
+
+	/* Truncated data is rejected */
+	for (i = 0; i < size; i += 97) {
+		assert(roaring_bitmap_deserialize(buffer, i) == NULL);
+	}
+
+	assert(roaring_bitmap_deserialize(buffer, size - 1) == NULL);
+
+	/* Bad cookie */
+	buffer[0] ^= 1;
+	assert(roaring_bitmap_deserialize(buffer, size) == NULL);
+	buffer[0] ^= 1;
+
+	/* Containers out of order: swap the key of the first container */
+	buffer[8] = 0xff;
+	buffer[9] = 0xff;
+	assert(roaring_bitmap_deserialize(buffer, size) == NULL);
+
+	roaring_bitmap_free(bitmap);
+
+	/* An empty bitmap */
+	bitmap = roaring_bitmap_new();
+	assert(roaring_bitmap_serialize(bitmap, buffer) ==
+	       roaring_bitmap_serialized_size(bitmap));
+	loaded = roaring_bitmap_deserialize(buffer, 8);
+	assert(loaded != NULL);
+	assert(roaring_bitmap_num_entries(loaded) == 0);
+	roaring_bitmap_free(loaded);
+	roaring_bitmap_free(bitmap);
+
+	free(buffer);
+	free(flags);
+}
+
+void test_roaring_bitmap_container_size(void)
+{
+	RoaringBitmap *bitmap;
+	unsigned char *buffer;
+	unsigned int i;
+
+	/* Runs which have been optimized, then broken up by inserting
+	 * values between them.  Once the runs would take more space than
+	 * a bitmap, the container switches to a bitmap. */
+	bitmap = roaring_bitmap_new();
+
+	for (i = 0; i < 1000; ++i) {
+		roaring_bitmap_insert(bitmap, i * 4);
+		roaring_bitmap_insert(bitmap, i * 4 + 1);
+		roaring_bitmap_insert(bitmap, i * 4 + 2);
+	}
+
+	assert(roaring_bitmap_optimize(bitmap) != 0);
+	assert(roaring_bitmap_serialized_size(bitmap) == 8 + 7 + 1000 * 4);
+
+	for (i = 1000; i < 3000; ++i) {
+		assert(roaring_bitmap_insert(bitmap, i * 4) != 0);
+	}
+
+	assert(roaring_bitmap_serialized_size(bitmap) == 8 + 7 + 8192);
+	assert(roaring_bitmap_num_entries(bitmap) == 5000);
+
+	for (i = 0; i < 12000; ++i) {
+		assert((roaring_bitmap_query(bitmap, i) != 0) ==
+		       (i % 4 == 0 || (i < 4000 && i % 4 != 3)));
+	}
+
+	roaring_bitmap_free(bitmap);
+
+	/* A bitmap which could not switch back to an array when it
+	 * became small enough does so on a later removal */
+	bitmap = roaring_bitmap_new();
+
+	for (i = 0; i < 4098; ++i) {
+		roaring_bitmap_insert(bitmap, i * 2);
+	}
+
+	assert(roaring_bitmap_remove(bitmap, 0) != 0);
+	alloc_test_set_limit(0);
+	assert(roaring_bitmap_remove(bitmap, 2) != 0);
+	alloc_test_set_limit(-1);
+	assert(roaring_bitmap_serialized_size(bitmap) == 8 + 7 + 8192);
+
+	assert(roaring_bitmap_remove(bitmap, 4) != 0);
+	assert(roaring_bitmap_serialized_size(bitmap) == 8 + 7 + 2 * 4095);
+
+	roaring_bitmap_free(bitmap);
+
+	/* A bitmap container holding few values is loaded as an array */
+	buffer = calloc(1, 8 + 7 + 8192);
+	memcpy(buffer, "RBM1", 4);
+	buffer[4] = 1;
+	buffer[8 + 2] = 1;
+	buffer[8 + 7] = 0x0e;
+
+	bitmap = roaring_bitmap_deserialize(buffer, 8 + 7 + 8192);
+	assert(bitmap != NULL);
+	assert(roaring_bitmap_num_entries(bitmap) == 3);
+	assert(roaring_bitmap_query(bitmap, 0) == 0);
+	assert(roaring_bitmap_query(bitmap, 1) != 0);
+	assert(roaring_bitmap_query(bitmap, 3) != 0);
+	assert(roaring_bitmap_serialized_size(bitmap) == 8 + 7 + 2 * 3);
+
+	roaring_bitmap_free(bitmap);
+	free(buffer);
+}
+
+void test_roaring_bitmap_full(void)
+{
+	RoaringBitmap *bitmap;
+	unsigned char *buffer;
+	unsigned char *p;
+	size_t size;
+	unsigned int key;
+
+	/* Every possible unsigned int, as one run in each of the 65536
+	 * containers.  This is far quicker to load than to insert. */
+	size = 8 + 65536 * (7 + 4);
+	buffer = calloc(1, size);
+	memcpy(buffer, "RBM1", 4);
+	buffer[6] = 1;
+
+	for (key = 0, p = buffer + 8; key < 65536; ++key, p += 7 + 4) {
+		p[0] = (unsigned char) (key & 0xff);
+		p[1] = (unsigned char) (key >> 8);
+		p[2] = 2;
+		p[3] = 1;
+		p[9] = 0xff;
+		p[10] = 0xff;
+	}
+
+	bitmap = roaring_bitmap_deserialize(buffer, size);
+	assert(bitmap != NULL);
+	assert(roaring_bitmap_query(bitmap, 0) != 0);
+	assert(roaring_bitmap_query(bitmap, 0xffffffffU) != 0);
+
+	/* The count does not fit in a 32-bit unsigned long, and saturates
+	 * rather than wrapping around to zero */
+	if (ULONG_MAX > 0xffffffffUL) {
+		assert(roaring_bitmap_num_entries(bitmap) - 1 == 0xffffffffUL);
+	} else {
+		assert(roaring_bitmap_num_entries(bitmap) == ULONG_MAX);
+	}
+
+	/* Removing a value brings the count back within range */
+	assert(roaring_bitmap_remove(bitmap, 12345) != 0);
+	assert(roaring_bitmap_num_entries(bitmap) == 0xffffffffUL);
+
+	roaring_bitmap_free(bitmap);
+	free(buffer);
+}
+
+void test_roaring_bitmap_out_of_memory(void)
+{
+	RoaringBitmap *bitmap;
+	unsigned int i;
+
+	bitmap = roaring_bitmap_new();
+
+	/* A new container needs memory */
+	alloc_test_set_limit(0);
+	assert(roaring_bitmap_insert(bitmap, 1) == 0);
+	assert(roaring_bitmap_num_entries(bitmap) == 0);
+	alloc_test_set_limit(-1);
+
+	/* Fill an array container, then fail to convert it to a bitmap */
+	for (i = 0; i < 4096; ++i) {
+		assert(roaring_bitmap_insert(bitmap, i * 2) != 0);
+	}
+
+	alloc_test_set_limit(0);
+	assert(roaring_bitmap_insert(bitmap, 1) == 0);
+	assert(roaring_bitmap_num_entries(bitmap) == 4096);
+	assert(roaring_bitmap_query(bitmap, 1) == 0);
+	assert(roaring_bitmap_to_array(bitmap) == NULL);
+	alloc_test_set_limit(-1);
+
+	assert(roaring_bitmap_insert(bitmap, 1) != 0);
+	assert(roaring_bitmap_num_entries(bitmap) == 4097);
+
+	roaring_bitmap_free(bitmap);
+}
+
+static UnitTestFunction tests[] = {
+	test_roaring_bitmap_new_free,
+	test_roaring_bitmap_insert_remove,
+	test_roaring_bitmap_optimize,
+	test_roaring_bitmap_iterating_remove,
+	test_roaring_bitmap_algebra,
+	test_roaring_bitmap_algebra_out_of_memory,
+	test_roaring_bitmap_serialize,
+	test_roaring_bitmap_container_size,
+	test_roaring_bitmap_full,
+	test_roaring_bitmap_out_of_memory,
+	NULL
+};
+
+int main(int argc, char *argv[])
+{
+	run_tests(tests);
+
+	return 0;
+}
@@ -230,18 +230,20 @@ void test_set_union(void)
 	alloc_test_set_limit(0);
 	assert(set_union(set1, set2) == NULL);
 
-	/* Can allocate set, can't copy all set1 values */
-	alloc_test_set_limit(2 + 2);
+	/* Can allocate set, can't allocate the block for its entries */
+	alloc_test_set_limit(2);
 	allocated = alloc_test_get_allocated();
 	assert(set_union(set1, set2) == NULL);
 	assert(alloc_test_get_allocated() == allocated);
 
-	/* Can allocate set, can copy set1 values,
-	 * can't copy all set2 values */
-	alloc_test_set_limit(2 + 7 + 2);
-	allocated = alloc_test_get_allocated();
-	assert(set_union(set1, set2) == NULL);
-	assert(alloc_test_get_allocated() == allocated);
+	/* The set, its table and a single block for all of the entries
+	 * are the only memory needed */
+	alloc_test_set_limit(3);
+	result_set = set_union(set1, set2);
+	assert(result_set != NULL);
+	assert(set_num_entries(result_set) == 11);
+	alloc_test_set_limit(-1);
+	set_free(result_set);
 
 	set_free(set1);
 	set_free(set2);
@@ -285,12 +287,22 @@ void test_set_intersection(void)
 	alloc_test_set_limit(0);
 	assert(set_intersection(set1, set2) == NULL);
 
-	/* Can allocate set, can't copy all values */
-	alloc_test_set_limit(2 + 2);
+	/* Can allocate set, can't allocate the block for its entries */
+	alloc_test_set_limit(2);
 	allocated = alloc_test_get_allocated();
 	assert(set_intersection(set1, set2) == NULL);
 	assert(alloc_test_get_allocated() == allocated);
 
+	set_free(result_set);
+
+	/* The set, its table and a single block for all of the entries
+	 * are the only memory needed */
+	alloc_test_set_limit(3);
+	result_set = set_intersection(set1, set2);
+	assert(result_set != NULL);
+	assert(set_num_entries(result_set) == 3);
+	alloc_test_set_limit(-1);
+
 	set_free(set1);
 	set_free(set2);
 	set_free(result_set);
@@ -501,6 +513,569 @@ void test_set_out_of_memory(void)
 }
 
 /* clang-format off */
+/* Test a set using power-of-two table sizes with a weak hash function */
+void test_set_power_of_two(void)
+{
+	Set *set;
+	Set *other;
+	Set *result;
+	int values[10000];
+	unsigned int i;
+
+	set = set_new_with_flags(pointer_hash, pointer_equal, SET_POWER_OF_TWO);
+	other = set_new_with_flags(pointer_hash, pointer_equal,
+	                           SET_POWER_OF_TWO);
+
+	/* Addresses of consecutive array elements only differ in their
+	 * low bits by multiples of sizeof(int), which would leave most
+	 * chains empty if they were not mixed. */
+	for (i = 0; i < 10000; ++i) {
+		assert(set_insert(set, &values[i]) != 0);
+		assert(set_num_entries(set) == i + 1);
+
+		if (i % 2 == 0) {
+			set_insert(other, &values[i]);
+		}
+	}
+
+	assert(set_insert(set, &values[0]) == 0);
+
+	for (i = 0; i < 10000; ++i) {
+		assert(set_query(set, &values[i]) != 0);
+	}
+
+	result = set_intersection(set, other);
+	assert(set_num_entries(result) == 5000);
+	set_free(result);
+
+	for (i = 0; i < 10000; i += 2) {
+		assert(set_remove(set, &values[i]) != 0);
+		assert(set_query(set, &values[i]) == 0);
+	}
+
+	assert(set_num_entries(set) == 5000);
+
+	result = set_union(set, other);
+	assert(set_num_entries(result) == 10000);
+	set_free(result);
+
+	set_free(set);
+	set_free(other);
+}
+
+void test_set_pooled(void)
+{
+	Set *set;
+	int values[10000];
+	int *value;
+	unsigned int i;
+
+	set = set_new_with_flags(int_hash, int_equal, SET_POOLED);
+
+	/* Entries come from a handful of slabs rather than needing an
+	 * allocation each */
+	alloc_test_set_limit(100);
+
+	for (i = 0; i < 10000; ++i) {
+		values[i] = (int) i;
+		assert(set_insert(set, &values[i]) != 0);
+	}
+
+	assert(set_num_entries(set) == 10000);
+
+	/* Removed entries are reused without allocating any more memory */
+	for (i = 0; i < 10000; i += 2) {
+		assert(set_remove(set, &values[i]) != 0);
+	}
+
+	assert(set_num_entries(set) == 5000);
+
+	alloc_test_set_limit(0);
+
+	for (i = 0; i < 10000; i += 2) {
+		assert(set_insert(set, &values[i]) != 0);
+	}
+
+	alloc_test_set_limit(-1);
+
+	for (i = 0; i < 10000; ++i) {
+		assert(set_query(set, &values[i]) != 0);
+	}
+
+	set_free(set);
+
+	/* The free function is still called for every value */
+	set = set_new_with_flags(int_hash, int_equal, SET_POOLED);
+	set_register_free_function(set, free_value);
+	allocated_values = 0;
+
+	for (i = 0; i < 1000; ++i) {
+		value = new_value((int) i);
+		set_insert(set, value);
+	}
+
+	i = 500;
+	set_remove(set, &i);
+	assert(allocated_values == 999);
+
+	set_free(set);
+	assert(allocated_values == 0);
+
+	/* Test out of memory scenario */
+	set = set_new_with_flags(int_hash, int_equal, SET_POOLED);
+	alloc_test_set_limit(0);
+	assert(set_insert(set, &values[0]) == 0);
+	assert(set_num_entries(set) == 0);
+	alloc_test_set_limit(-1);
+	set_free(set);
+}
+
+void test_set_robin_hood(void)
+{
+	Set *set;
+	Set *other;
+	Set *result;
+	SetIterator iterator;
+	SetStatistics stats;
+	SetValue *array;
+	int *values;
+	int *value;
+	unsigned char *visited;
+	unsigned int num_values;
+	unsigned int count;
+	unsigned int i;
+
+	/* Fill the set right up to its maximum load, so that probe
+	 * sequences are long and some wrap around the end of the table */
+	num_values = 16384 - 16384 / 8;
+	values = malloc(sizeof(int) * num_values);
+	visited = malloc(num_values);
+
+	set = set_new_with_flags(int_hash, int_equal, SET_ROBIN_HOOD);
+	other = set_new_with_flags(int_hash, int_equal, SET_ROBIN_HOOD);
+
+	for (i = 0; i < num_values; ++i) {
+		values[i] = (int) i;
+		assert(set_insert(set, &values[i]) != 0);
+		assert(set_num_entries(set) == i + 1);
+
+		if (i % 2 == 0) {
+			set_insert(other, &values[i]);
+		}
+	}
+
+	assert(set_insert(set, &values[0]) == 0);
+
+	set_get_statistics(set, &stats);
+	assert(stats.table_size == 16384);
+	assert(stats.chain_lengths[0] > 0);
+	assert(stats.max_chain_length < 64);
+
+	count = 0;
+
+	for (i = 0; i < SET_HISTOGRAM_SIZE; ++i) {
+		count += stats.chain_lengths[i];
+	}
+
+	assert(count == num_values);
+
+	for (i = 0; i < num_values; ++i) {
+		assert(set_query(set, &values[i]) != 0);
+	}
+
+	result = set_intersection(set, other);
+	assert(set_num_entries(result) == num_values / 2);
+	set_free(result);
+
+	array = set_to_array(set);
+	assert(array != NULL);
+	free(array);
+
+	/* Removing the value just returned by the iterator does not cause
+	 * any other value to be missed or returned twice */
+	memset(visited, 0, num_values);
+	set_iterate(set, &iterator);
+
+	while (set_iter_has_more(&iterator)) {
+		value = set_iter_next(&iterator);
+		++visited[*value];
+
+		if (*value % 2 == 0) {
+			assert(set_remove(set, value) != 0);
+		}
+	}
+
+	for (i = 0; i < num_values; ++i) {
+		assert(visited[i] == 1);
+		assert(set_query(set, &values[i]) == (i % 2 != 0));
+	}
+
+	assert(set_num_entries(set) == num_values / 2);
+
+	result = set_union(set, other);
+	assert(set_num_entries(result) == num_values);
+	set_free(result);
+
+	/* Remove everything while iterating */
+	set_iterate(set, &iterator);
+	count = 0;
+
+	while (set_iter_has_more(&iterator)) {
+		value = set_iter_next(&iterator);
+		assert(set_remove(set, value) != 0);
+		++count;
+	}
+
+	assert(count == num_values / 2);
+	assert(set_num_entries(set) == 0);
+
+	set_iterate(set, &iterator);
+	assert(set_iter_has_more(&iterator) == 0);
+
+	set_free(set);
+	set_free(other);
+
+	/* The free function is called for removed values and those left
+	 * when the set is freed */
+	set = set_new_with_flags(int_hash, int_equal, SET_ROBIN_HOOD);
+	set_register_free_function(set, free_value);
+	allocated_values = 0;
+
+	for (i = 0; i < 1000; ++i) {
+		value = new_value((int) i);
+		set_insert(set, value);
+	}
+
+	i = 500;
+	set_remove(set, &i);
+	assert(allocated_values == 999);
+
+	set_free(set);
+	assert(allocated_values == 0);
+
+	/* Test out of memory scenario */
+	set = set_new_with_flags(int_hash, int_equal, SET_ROBIN_HOOD);
+	alloc_test_set_limit(0);
+
+	for (i = 0; i < num_values; ++i) {
+		if (!set_insert(set, &values[i])) {
+			break;
+		}
+	}
+
+	alloc_test_set_limit(-1);
+	assert(i < num_values);
+	assert(set_num_entries(set) == i);
+	set_free(set);
+
+	free(values);
+	free(visited);
+}
+
+static const unsigned int algebra_test_flags[] = {
+	0,
+	SET_POWER_OF_TWO,
+	SET_POOLED,
+	SET_ROBIN_HOOD,
+};
+
+#define NUM_ALGEBRA_TEST_FLAGS \
+	(sizeof(algebra_test_flags) / sizeof(*algebra_test_flags))
+
+/* Create a set containing every multiple of step below 10000 */
+static Set *generate_multiples(int *values, int step, unsigned int flags)
+{
+	Set *set;
+	int i;
+
+	set = set_new_with_flags(int_hash, int_equal, flags);
+
+	for (i = 0; i < 10000; i += step) {
+		set_insert(set, &values[i]);
+	}
+
+	return set;
+}
+
+void test_set_algebra(void)
+{
+	Set *evens;
+	Set *threes;
+	Set *sixes;
+	Set *result;
+	SetStatistics stats;
+	int values[10000];
+	unsigned int f, g;
+	int i;
+
+	for (i = 0; i < 10000; ++i) {
+		values[i] = i;
+	}
+
+	/* Every combination of kinds of set, so that both the fast paths
+	 * for sets of the same kind and the general case are covered */
+	for (f = 0; f < NUM_ALGEBRA_TEST_FLAGS; ++f) {
+		for (g = 0; g < NUM_ALGEBRA_TEST_FLAGS; ++g) {
+			evens = generate_multiples(values, 2,
+			                           algebra_test_flags[f]);
+			threes = generate_multiples(values, 3,
+			                            algebra_test_flags[g]);
+			sixes = generate_multiples(values, 6,
+			                           algebra_test_flags[g]);
+
+			/* The result of a union is sized up front */
+			result = set_union(evens, threes);
+			assert(set_num_entries(result) == 5000 + 3334 - 1667);
+			set_get_statistics(result, &stats);
+			assert(stats.resizes <= 1);
+
+			for (i = 0; i < 10000; ++i) {
+				assert(set_query(result, &values[i]) ==
+				       (i % 2 == 0 || i % 3 == 0));
+			}
+
+			set_free(result);
+
+			result = set_intersection(evens, threes);
+			assert(set_num_entries(result) == 1667);
+			assert(set_is_subset(result, sixes) != 0);
+			assert(set_is_subset(sixes, result) != 0);
+			set_free(result);
+
+			result = set_difference(evens, threes);
+			assert(set_num_entries(result) == 5000 - 1667);
+
+			for (i = 0; i < 10000; ++i) {
+				assert(set_query(result, &values[i]) ==
+				       (i % 2 == 0 && i % 3 != 0));
+			}
+
+			set_free(result);
+
+			assert(set_is_subset(sixes, evens) != 0);
+			assert(set_is_subset(sixes, threes) != 0);
+			assert(set_is_subset(evens, sixes) == 0);
+			assert(set_is_subset(threes, evens) == 0);
+
+			/* In place versions */
+			assert(set_union_into(sixes, evens) != 0);
+			assert(set_num_entries(sixes) == 5000);
+			assert(set_is_subset(evens, sixes) != 0);
+
+			set_intersect_inplace(evens, threes);
+			assert(set_num_entries(evens) == 1667);
+
+			for (i = 0; i < 10000; ++i) {
+				assert(set_query(evens, &values[i]) ==
+				       (i % 6 == 0));
+			}
+
+			set_free(evens);
+			set_free(threes);
+			set_free(sixes);
+		}
+	}
+
+	/* Empty sets */
+	evens = generate_multiples(values, 2, 0);
+	result = set_new(int_hash, int_equal);
+	assert(set_is_subset(result, evens) != 0);
+	assert(set_is_subset(evens, result) == 0);
+	set_intersect_inplace(evens, result);
+	assert(set_num_entries(evens) == 0);
+	set_free(evens);
+	set_free(result);
+
+	/* Values removed in place are freed */
+	evens = set_new(int_hash, int_equal);
+	set_register_free_function(evens, free_value);
+	threes = generate_multiples(values, 3, 0);
+	allocated_values = 0;
+
+	for (i = 0; i < 100; i += 2) {
+		set_insert(evens, new_value(i));
+	}
+
+	set_intersect_inplace(evens, threes);
+	assert(set_num_entries(evens) == 17);
+	assert(allocated_values == 17);
+
+	set_free(evens);
+	set_free(threes);
+	assert(allocated_values == 0);
+
+	/* A union of pooled sets needs only four allocations: the set,
+	 * its initial table, the table it is enlarged to and one slab for
+	 * the entries */
+	evens = generate_multiples(values, 2, SET_POOLED);
+	threes = generate_multiples(values, 3, SET_POOLED);
+
+	alloc_test_set_limit(4);
+	result = set_union(evens, threes);
+	alloc_test_set_limit(-1);
+	assert(result != NULL);
+	assert(set_num_entries(result) == 5000 + 3334 - 1667);
+	set_free(result);
+
+	/* Test out of memory scenario */
+	alloc_test_set_limit(0);
+	assert(set_difference(evens, threes) == NULL);
+	alloc_test_set_limit(-1);
+
+	set_free(evens);
+	set_free(threes);
+}
+
+/* Hash function which puts every value in the same chain */
+static unsigned int constant_hash(SetValue value)
+{
+	return 0;
+}
+
+void test_set_statistics(void)
+{
+	Set *set;
+	SetStatistics stats;
+	int values[1000];
+	unsigned long searches;
+	unsigned int total;
+	unsigned int i;
+
+	set = set_new_with_flags(int_hash, int_equal, SET_POOLED);
+
+	set_get_statistics(set, &stats);
+	assert(stats.entries == 0);
+	assert(stats.resizes == 0);
+	assert(stats.chain_lengths[0] == stats.table_size);
+
+	for (i = 0; i < 1000; ++i) {
+		values[i] = (int) i;
+		set_insert(set, &values[i]);
+	}
+
+	set_get_statistics(set, &stats);
+	assert(stats.entries == 1000);
+	assert(stats.load_factor > 0.0 && stats.load_factor < 1.0);
+	assert(stats.resizes > 0);
+	assert(stats.memory_used > 1000 * sizeof(SetValue));
+
+	total = 0;
+
+	for (i = 0; i < SET_HISTOGRAM_SIZE; ++i) {
+		total += stats.chain_lengths[i];
+	}
+
+	assert(total == stats.table_size);
+
+	/* Each query is one search */
+	searches = stats.searches;
+
+	for (i = 0; i < 1000; ++i) {
+		assert(set_query(set, &values[i]) != 0);
+	}
+
+	set_get_statistics(set, &stats);
+	assert(stats.searches == searches + 1000);
+	assert(stats.probes >= 1000);
+	assert(stats.max_probes >= 1);
+
+	set_free(set);
+
+	/* A hash function that puts everything in one chain shows up as
+	 * a single long chain */
+	set = set_new(constant_hash, int_equal);
+
+	for (i = 0; i < 50; ++i) {
+		set_insert(set, &values[i]);
+	}
+
+	set_get_statistics(set, &stats);
+	assert(stats.max_chain_length == 50);
+	assert(stats.chain_lengths[SET_HISTOGRAM_SIZE - 1] == 1);
+	assert(stats.max_probes == 49);
+
+	set_free(set);
+}
+
+static void count_scanned(SetValue value, void *user_data)
+{
+	unsigned int *counts;
+
+	counts = user_data;
+	++counts[*((int *) value)];
+}
+
+void test_set_scan(void)
+{
+	Set *set;
+	SetCursor cursor;
+	int values[10000];
+	unsigned int counts[10000];
+	unsigned int flags;
+	unsigned int steps;
+	unsigned int f;
+	unsigned int i;
+
+	for (i = 0; i < 10000; ++i) {
+		values[i] = (int) i;
+	}
+
+	for (f = 0; f < NUM_ALGEBRA_TEST_FLAGS; ++f) {
+		flags = algebra_test_flags[f];
+		set = set_new_with_flags(int_hash, int_equal, flags);
+
+		for (i = 0; i < 1000; ++i) {
+			set_insert(set, &values[i]);
+		}
+
+		/* Remove and insert values between steps, enlarging the
+		 * set several times.  The even values are there throughout,
+		 * and must be visited. */
+		memset(counts, 0, sizeof(counts));
+		set_scan_start(set, &cursor);
+		steps = 0;
+
+		while (set_scan(set, &cursor, 3, count_scanned, counts) != 0) {
+			if (steps < 500) {
+				set_remove(set, &values[steps * 2 % 1000 + 1]);
+
+				for (i = 1000 + steps * 18;
+				     i < 1000 + (steps + 1) * 18; ++i) {
+					set_insert(set, &values[i]);
+				}
+			}
+
+			++steps;
+			assert(steps < 100000);
+		}
+
+		/* Power-of-two sets only grow, so no value is visited
+		 * twice */
+		for (i = 0; i < 1000; i += 2) {
+			if ((flags & (SET_POWER_OF_TWO | SET_ROBIN_HOOD)) != 0) {
+				assert(counts[i] == 1);
+			} else {
+				assert(counts[i] >= 1);
+			}
+		}
+
+		/* A complete scan of an unchanging set visits every value
+		 * exactly once */
+		memset(counts, 0, sizeof(counts));
+		set_scan_start(set, &cursor);
+
+		while (set_scan(set, &cursor, 10, count_scanned, counts) != 0)
+			;
+
+		for (i = 0; i < 10000; ++i) {
+			assert(counts[i] ==
+			       (unsigned int) set_query(set, &values[i]));
+		}
+
+		set_free(set);
+	}
+}
+
 static UnitTestFunction tests[] = {
 	test_set_new_free,
 	test_set_insert,
@@ -513,6 +1088,12 @@ static UnitTestFunction tests[] = {
 	test_set_to_array,
 	test_set_free_function,
 	test_set_out_of_memory,
+	test_set_power_of_two,
+	test_set_pooled,
+	test_set_statistics,
+	test_set_robin_hood,
+	test_set_algebra,
+	test_set_scan,
 	NULL
 };
 /* clang-format on */
@@ -118,11 +118,20 @@ void test_trie_insert(void)
 	assert(trie_insert(trie, "a", "test value") == 0);
 	assert(trie_num_entries(trie) == entries);
 
-	/* Test rollback */
-	alloc_test_set_limit(5);
-	assert(trie_insert(trie, "hello world", "test value") == 0);
+	/* Test rollback.  Adding a key which shares part of the label of
+	 * an existing node splits the node, which needs several
+	 * allocations. */
+	alloc_test_set_limit(-1);
+	assert(trie_insert(trie, "hello world", "test value") != 0);
+	++entries;
+
+	allocated = alloc_test_get_allocated();
+	alloc_test_set_limit(1);
+	assert(trie_insert(trie, "hello there", "test value") == 0);
 	assert(alloc_test_get_allocated() == allocated);
 	assert(trie_num_entries(trie) == entries);
+	assert(trie_lookup(trie, "hello world") != NULL);
+	assert(trie_lookup(trie, "hello") == NULL);
 
 	trie_free(trie);
 }
@@ -308,7 +317,7 @@ void test_trie_insert_out_of_memory(void)
 
 	trie = generate_binary_trie();
 
-	alloc_test_set_limit(3);
+	alloc_test_set_limit(1);
 
 	assert(trie_insert_binary(trie, bin_key4, sizeof(bin_key4),
 	                          "test value") == 0);
@@ -346,6 +355,615 @@ void test_trie_remove_binary(void)
 	trie_free(trie);
 }
 
+/* Keys sharing prefixes are stored by splitting and merging the labels
+ * of nodes.  Test that this keeps every key reachable, and that removing
+ * all of the keys frees all of the memory used by them. */
+void test_trie_compressed_labels(void)
+{
+	char *keys[] = {
+		"romane", "romanus", "romulus", "rubens", "ruber", "rubicon",
+		"rubicundus", "rom", "r", "", "rubicundusmaximus",
+	};
+	unsigned int num_keys = sizeof(keys) / sizeof(*keys);
+	Trie *trie;
+	size_t allocated;
+	unsigned int i;
+	unsigned int j;
+
+	trie = trie_new();
+	allocated = alloc_test_get_allocated();
+
+	for (i = 0; i < num_keys; ++i) {
+		assert(trie_insert(trie, keys[i], keys[i]) != 0);
+		assert(trie_num_entries(trie) == i + 1);
+
+		for (j = 0; j < num_keys; ++j) {
+			assert(trie_lookup(trie, keys[j]) ==
+			       (j <= i ? keys[j] : NULL));
+		}
+	}
+
+	/* Prefixes of keys that were not inserted themselves */
+	assert(trie_lookup(trie, "roman") == NULL);
+	assert(trie_lookup(trie, "rub") == NULL);
+	assert(trie_lookup(trie, "rubicundusmax") == NULL);
+	assert(trie_lookup(trie, "rubicundusmaximusx") == NULL);
+	assert(trie_remove(trie, "roman") == 0);
+	assert(trie_remove(trie, "rubi") == 0);
+
+	/* Remove in a different order to insertion */
+	for (i = 0; i < num_keys; ++i) {
+		assert(trie_remove(trie, keys[(i * 7) % num_keys]) != 0);
+		assert(trie_remove(trie, keys[(i * 7) % num_keys]) == 0);
+		assert(trie_num_entries(trie) == num_keys - i - 1);
+
+		for (j = i + 1; j < num_keys; ++j) {
+			assert(trie_lookup(trie, keys[(j * 7) % num_keys]) ==
+			       keys[(j * 7) % num_keys]);
+		}
+	}
+
+	assert(alloc_test_get_allocated() == allocated);
+
+	trie_free(trie);
+}
+
+/* Nodes change form as children are added and removed.  Give one node
+ * every possible number of children, in both directions. */
+void test_trie_node_sizes(void)
+{
+	unsigned char keys[256][2];
+	Trie *trie;
+	size_t allocated;
+	unsigned int i;
+	unsigned int j;
+
+	/* Keys below a key with a value, whose second bytes are not in
+	 * sorted order */
+	for (i = 0; i < 256; ++i) {
+		keys[i][0] = 'x';
+		keys[i][1] = (unsigned char) ((i * 37) % 256);
+	}
+
+	trie = trie_new();
+	allocated = alloc_test_get_allocated();
+
+	assert(trie_insert_binary(trie, keys[0], 1, "parent") != 0);
+
+	for (i = 0; i < 256; ++i) {
+
+		/* Running out of memory when the node is full and must be
+		 * moved to a larger form */
+		if (i == 0 || i == 4 || i == 16 || i == 48) {
+			alloc_test_set_limit(1);
+			assert(trie_insert_binary(trie, keys[i], 2, keys[i]) ==
+			       0);
+			alloc_test_set_limit(-1);
+			assert(trie_num_entries(trie) == i + 1);
+		}
+
+		assert(trie_insert_binary(trie, keys[i], 2, keys[i]) != 0);
+		assert(trie_num_entries(trie) == i + 2);
+
+		for (j = 0; j < 256; ++j) {
+			assert(trie_lookup_binary(trie, keys[j], 2) ==
+			       (j <= i ? keys[j] : NULL));
+		}
+	}
+
+	/* Remove them again, in the same order */
+	for (i = 0; i < 256; ++i) {
+		assert(trie_remove_binary(trie, keys[i], 2) != 0);
+		assert(trie_num_entries(trie) == 256 - i);
+
+		for (j = 0; j < 256; ++j) {
+			assert(trie_lookup_binary(trie, keys[j], 2) ==
+			       (j > i ? keys[j] : NULL));
+		}
+	}
+
+	assert(trie_lookup_binary(trie, keys[0], 1) != NULL);
+	assert(trie_remove_binary(trie, keys[0], 1) != 0);
+	assert(alloc_test_get_allocated() == allocated);
+
+	trie_free(trie);
+}
+
+static int compare_strings(const void *a, const void *b)
+{
+	return strcmp(*((char **) a), *((char **) b));
+}
+
+/* Check that an iterator returns exactly the keys in test_strings which
+ * are at least start and less than end, in sorted order */
+static void check_iterator(TrieIterator *iterator, char **sorted,
+                           char *start, char *end, char *prefix)
+{
+	unsigned int i;
+	char *key;
+	int key_length;
+	int *value;
+
+	for (i = 0; i < NUM_TEST_VALUES; ++i) {
+		if ((start != NULL && strcmp(sorted[i], start) < 0) ||
+		    (end != NULL && strcmp(sorted[i], end) >= 0) ||
+		    strncmp(sorted[i], prefix, strlen(prefix)) != 0) {
+			continue;
+		}
+
+		assert(trie_iter_has_more(iterator));
+		value = (int *) trie_iter_next(iterator);
+		key = (char *) trie_iter_key(iterator, &key_length);
+
+		assert(!strcmp(key, sorted[i]));
+		assert(key_length == (int) strlen(sorted[i]));
+		assert(*value == atoi(sorted[i]));
+	}
+
+	assert(!trie_iter_has_more(iterator));
+	assert(trie_iter_next(iterator) == TRIE_NULL);
+
+	trie_iter_free(iterator);
+}
+
+void test_trie_iterate(void)
+{
+	Trie *trie;
+	TrieIterator iterator;
+	char *sorted[NUM_TEST_VALUES];
+	unsigned int i;
+
+	trie = generate_trie();
+
+	for (i = 0; i < NUM_TEST_VALUES; ++i) {
+		sorted[i] = test_strings[i];
+	}
+
+	qsort(sorted, NUM_TEST_VALUES, sizeof(char *), compare_strings);
+
+	/* All keys */
+	assert(trie_iterate(trie, &iterator) != 0);
+	check_iterator(&iterator, sorted, NULL, NULL, "");
+
+	/* Prefixes that are keys, that lie inside a node's label, and
+	 * that are not present */
+	assert(trie_iterate_prefix(trie, &iterator, "12") != 0);
+	check_iterator(&iterator, sorted, NULL, NULL, "12");
+	assert(trie_iterate_prefix(trie, &iterator, "9999") != 0);
+	check_iterator(&iterator, sorted, NULL, NULL, "9999");
+	assert(trie_iterate_prefix(trie, &iterator, "99999") != 0);
+	check_iterator(&iterator, sorted, NULL, NULL, "99999");
+	assert(trie_iterate_prefix(trie, &iterator, "a") != 0);
+	check_iterator(&iterator, sorted, NULL, NULL, "a");
+
+	/* Ranges */
+	assert(trie_iterate_range(trie, &iterator, "123", "2") != 0);
+	check_iterator(&iterator, sorted, "123", "2", "");
+	assert(trie_iterate_range(trie, &iterator, "1234", "12345") != 0);
+	check_iterator(&iterator, sorted, "1234", "12345", "");
+	assert(trie_iterate_range(trie, &iterator, "55555", NULL) != 0);
+	check_iterator(&iterator, sorted, "55555", NULL, "");
+	assert(trie_iterate_range(trie, &iterator, NULL, "0") != 0);
+	check_iterator(&iterator, sorted, NULL, "0", "");
+	assert(trie_iterate_range(trie, &iterator, "/", "10") != 0);
+	check_iterator(&iterator, sorted, "/", "10", "");
+	assert(trie_iterate_range(trie, &iterator, "9999a", NULL) != 0);
+	check_iterator(&iterator, sorted, "9999a", NULL, "");
+	assert(trie_iterate_range(trie, &iterator, "5", "4") != 0);
+	check_iterator(&iterator, sorted, "5", "4", "");
+
+	trie_free(trie);
+
+	/* Iterating over an empty trie */
+	trie = trie_new();
+
+	assert(trie_iterate(trie, &iterator) != 0);
+	assert(!trie_iter_has_more(&iterator));
+	trie_iter_free(&iterator);
+
+	/* Test out of memory scenario */
+	assert(trie_insert(trie, "a", "a") != 0);
+	alloc_test_set_limit(0);
+	assert(trie_iterate(trie, &iterator) == 0);
+	assert(!trie_iter_has_more(&iterator));
+	trie_iter_free(&iterator);
+	alloc_test_set_limit(-1);
+
+	trie_free(trie);
+}
+
+void test_trie_iterate_binary(void)
+{
+	Trie *trie;
+	TrieIterator iterator;
+	unsigned char *key;
+	int key_length;
+
+	trie = generate_binary_trie();
+	assert(trie_insert_binary(trie, bin_key3, sizeof(bin_key3), "abc") !=
+	       0);
+	assert(trie_insert_binary(trie, bin_key4, sizeof(bin_key4), "z") != 0);
+	assert(trie_insert_binary(trie, bin_key4, 0, "empty") != 0);
+
+	/* Bytes are compared as unsigned values, and a key comes before
+	 * any longer key that it is a prefix of */
+	assert(trie_iterate(trie, &iterator) != 0);
+
+	assert(!strcmp(trie_iter_next(&iterator), "empty"));
+	trie_iter_key(&iterator, &key_length);
+	assert(key_length == 0);
+
+	assert(!strcmp(trie_iter_next(&iterator), "abc"));
+	assert(!strcmp(trie_iter_next(&iterator), "hello world"));
+	key = trie_iter_key(&iterator, &key_length);
+	assert(key_length == sizeof(bin_key));
+	assert(!memcmp(key, bin_key, sizeof(bin_key)));
+
+	assert(!strcmp(trie_iter_next(&iterator), "goodbye world"));
+	assert(!strcmp(trie_iter_next(&iterator), "z"));
+	assert(!trie_iter_has_more(&iterator));
+	trie_iter_free(&iterator);
+
+	/* A range ending at a key's prefix excludes it */
+	assert(trie_iterate_range_binary(trie, &iterator, bin_key3,
+	                                 sizeof(bin_key3), bin_key,
+	                                 sizeof(bin_key)) != 0);
+	assert(!strcmp(trie_iter_next(&iterator), "abc"));
+	assert(!trie_iter_has_more(&iterator));
+	trie_iter_free(&iterator);
+
+	assert(trie_iterate_prefix_binary(trie, &iterator, bin_key,
+	                                  sizeof(bin_key)) != 0);
+	assert(!strcmp(trie_iter_next(&iterator), "hello world"));
+	assert(!strcmp(trie_iter_next(&iterator), "goodbye world"));
+	assert(!trie_iter_has_more(&iterator));
+	trie_iter_free(&iterator);
+
+	trie_free(trie);
+}
+
+void test_trie_longest_prefix(void)
+{
+	Trie *trie;
+	int length;
+	int *value;
+
+	trie = generate_trie();
+
+	value = trie_lookup_longest_prefix(trie, "12345678", &length);
+	assert(*value == 1234);
+	assert(length == 4);
+
+	value = trie_lookup_longest_prefix(trie, "7", &length);
+	assert(*value == 7);
+	assert(length == 1);
+
+	assert(trie_lookup_longest_prefix(trie, "abc", &length) == NULL);
+	assert(length == 0);
+	assert(trie_lookup_longest_prefix(trie, "", NULL) == NULL);
+
+	/* The empty key is a prefix of everything */
+	assert(trie_insert(trie, "", "empty") != 0);
+	assert(!strcmp(trie_lookup_longest_prefix(trie, "abc", &length),
+	               "empty"));
+	assert(length == 0);
+
+	trie_free(trie);
+
+	/* Matches that end part of the way through a node's label */
+	trie = generate_binary_trie();
+
+	assert(trie_lookup_longest_prefix_binary(trie, bin_key3,
+	                                         sizeof(bin_key3),
+	                                         &length) == NULL);
+	assert(!strcmp(trie_lookup_longest_prefix_binary(
+	                   trie, bin_key2, sizeof(bin_key2), &length),
+	               "goodbye world"));
+	assert(length == sizeof(bin_key2));
+	assert(!strcmp(trie_lookup_longest_prefix_binary(
+	                   trie, bin_key2, sizeof(bin_key2) - 1, &length),
+	               "hello world"));
+	assert(length == sizeof(bin_key));
+
+	trie_free(trie);
+}
+
+void test_trie_pooled(void)
+{
+	Trie *trie;
+	TrieIterator iterator;
+	char buf[10];
+	char *long_key;
+	unsigned char keys[256][2];
+	size_t allocated;
+	unsigned int i;
+	int *value;
+
+	trie = trie_new_with_flags(TRIE_POOLED);
+
+	for (i = 0; i < NUM_TEST_VALUES; ++i) {
+		test_array[i] = (int) i;
+		sprintf(test_strings[i], "%u", i);
+		assert(trie_insert(trie, test_strings[i], &test_array[i]) != 0);
+	}
+
+	assert(trie_num_entries(trie) == NUM_TEST_VALUES);
+
+	/* A node with 256 children, and a long label, are too large for
+	 * the free lists */
+	for (i = 0; i < 256; ++i) {
+		keys[i][0] = 'x';
+		keys[i][1] = (unsigned char) i;
+		assert(trie_insert_binary(trie, keys[i], 2, keys[i]) != 0);
+	}
+
+	long_key = malloc(LONG_STRING_LEN);
+	memset(long_key, 'A', LONG_STRING_LEN);
+	long_key[LONG_STRING_LEN - 1] = '\0';
+	assert(trie_insert(trie, long_key, long_key) != 0);
+
+	for (i = 0; i < NUM_TEST_VALUES; ++i) {
+		sprintf(buf, "%u", i);
+		value = (int *) trie_lookup(trie, buf);
+		assert(*value == (int) i);
+	}
+
+	assert(trie_lookup(trie, long_key) == long_key);
+
+	/* Removed nodes are reused, so removing every key and adding them
+	 * all again needs no more memory */
+	allocated = alloc_test_get_allocated();
+
+	for (i = 0; i < NUM_TEST_VALUES; ++i) {
+		assert(trie_remove(trie, test_strings[i]) != 0);
+	}
+
+	for (i = 0; i < NUM_TEST_VALUES; ++i) {
+		assert(trie_insert(trie, test_strings[i], &test_array[i]) != 0);
+	}
+
+	assert(alloc_test_get_allocated() == allocated);
+
+	/* The large nodes are freed as soon as they are removed */
+	for (i = 0; i < 256; ++i) {
+		assert(trie_remove_binary(trie, keys[i], 2) != 0);
+	}
+
+	assert(trie_remove(trie, long_key) != 0);
+	assert(alloc_test_get_allocated() < allocated);
+	assert(trie_num_entries(trie) == NUM_TEST_VALUES);
+
+	assert(trie_iterate_prefix(trie, &iterator, "999") != 0);
+	assert(*((int *) trie_iter_next(&iterator)) == 999);
+
+	for (i = 9990; i < 10000; ++i) {
+		assert(*((int *) trie_iter_next(&iterator)) == (int) i);
+	}
+
+	assert(!trie_iter_has_more(&iterator));
+	trie_iter_free(&iterator);
+
+	/* Freeing the trie frees every block, with or without values */
+	assert(trie_insert(trie, long_key, long_key) != 0);
+	trie_free(trie);
+	free(long_key);
+
+	/* Test out of memory scenario */
+	trie = trie_new_with_flags(TRIE_POOLED);
+	alloc_test_set_limit(0);
+	assert(trie_insert(trie, "a", "a") == 0);
+	assert(trie_num_entries(trie) == 0);
+	alloc_test_set_limit(-1);
+	assert(trie_insert(trie, "a", "a") != 0);
+	trie_free(trie);
+}
+
+void test_trie_lookup_many(void)
+{
+	Trie *trie;
+	char *keys[NUM_TEST_VALUES + 3];
+	TrieValue values[NUM_TEST_VALUES + 3];
+	unsigned char *bin_keys[4];
+	int bin_lengths[4];
+	unsigned int i;
+
+	trie = generate_trie();
+
+	/* Keys that are missing part of the way through a label, that are
+	 * too long, and that are not there at all, mixed in with keys that
+	 * are present */
+	keys[0] = "000";
+	keys[1] = "99999";
+	keys[2] = "";
+
+	for (i = 0; i < NUM_TEST_VALUES; ++i) {
+		keys[i + 3] = test_strings[NUM_TEST_VALUES - 1 - i];
+	}
+
+	assert(trie_lookup_many(trie, keys, values, NUM_TEST_VALUES + 3) ==
+	       NUM_TEST_VALUES);
+
+	for (i = 0; i < NUM_TEST_VALUES + 3; ++i) {
+		assert(values[i] == trie_lookup(trie, keys[i]));
+	}
+
+	/* Counts which are not a whole number of batches */
+	for (i = 0; i < 40; ++i) {
+		assert(trie_lookup_many(trie, keys + 3, values, i) == i);
+	}
+
+	trie_free(trie);
+
+	/* Binary keys, and an empty trie */
+	trie = generate_binary_trie();
+
+	bin_keys[0] = bin_key;
+	bin_lengths[0] = sizeof(bin_key);
+	bin_keys[1] = bin_key2;
+	bin_lengths[1] = sizeof(bin_key2);
+	bin_keys[2] = bin_key3;
+	bin_lengths[2] = sizeof(bin_key3);
+	bin_keys[3] = bin_key4;
+	bin_lengths[3] = sizeof(bin_key4);
+
+	assert(trie_lookup_many_binary(trie, bin_keys, bin_lengths, values,
+	                               4) == 2);
+	assert(!strcmp(values[0], "hello world"));
+	assert(!strcmp(values[1], "goodbye world"));
+	assert(values[2] == NULL);
+	assert(values[3] == NULL);
+
+	trie_free(trie);
+
+	trie = trie_new();
+	assert(trie_lookup_many_binary(trie, bin_keys, bin_lengths, values,
+	                               4) == 0);
+	assert(values[0] == NULL);
+	trie_free(trie);
+}
+
+void test_trie_freeze(void)
+{
+	Trie *trie;
+	Trie *frozen;
+	TrieIterator iterator;
+	TrieValue *values;
+	TrieValue many[NUM_TEST_VALUES];
+	char *keys[NUM_TEST_VALUES];
+	unsigned char *buffer;
+	unsigned char *copy;
+	unsigned char key[2];
+	size_t size;
+	int prefix_length;
+	unsigned int i;
+
+	/* A node with too many children for the sparse form */
+	trie = generate_trie();
+	key[0] = 'x';
+
+	for (i = 0; i < 256; ++i) {
+		key[1] = (unsigned char) i;
+		assert(trie_insert_binary(trie, key, 2, &test_array[i]) != 0);
+	}
+
+	/* The values are given in key order */
+	values = malloc(sizeof(TrieValue) * trie_num_entries(trie));
+	assert(trie_iterate(trie, &iterator) != 0);
+
+	for (i = 0; trie_iter_has_more(&iterator); ++i) {
+		values[i] = trie_iter_next(&iterator);
+	}
+
+	trie_iter_free(&iterator);
+	assert(i == trie_num_entries(trie));
+
+	size = trie_frozen_size(trie);
+	buffer = malloc(size);
+	assert(trie_freeze(trie, buffer) == size);
+	trie_free(trie);
+
+	frozen = trie_new_frozen(buffer, size, values);
+	assert(frozen != NULL);
+	assert(trie_num_entries(frozen) == NUM_TEST_VALUES + 256);
+
+	for (i = 0; i < NUM_TEST_VALUES; ++i) {
+		assert(trie_lookup(frozen, test_strings[i]) == &test_array[i]);
+		keys[i] = test_strings[i];
+	}
+
+	for (i = 0; i < 256; ++i) {
+		key[1] = (unsigned char) i;
+		assert(trie_lookup_binary(frozen, key, 2) == &test_array[i]);
+	}
+
+	assert(trie_lookup(frozen, "") == NULL);
+	assert(trie_lookup(frozen, "000") == NULL);
+	assert(trie_lookup(frozen, "99999") == NULL);
+	assert(trie_lookup(frozen, "x") == NULL);
+	assert(trie_lookup(frozen, "y") == NULL);
+
+	assert(trie_lookup_many(frozen, keys, many, NUM_TEST_VALUES) ==
+	       NUM_TEST_VALUES);
+
+	for (i = 0; i < NUM_TEST_VALUES; ++i) {
+		assert(many[i] == &test_array[i]);
+	}
+
+	assert(trie_lookup_longest_prefix(frozen, "12345", &prefix_length) ==
+	       &test_array[1234]);
+	assert(prefix_length == 4);
+	assert(trie_lookup_longest_prefix(frozen, "x", &prefix_length) ==
+	       NULL);
+	assert(prefix_length == 0);
+
+	/* A frozen trie cannot be changed or iterated over */
+	assert(trie_insert(frozen, "a", "a") == 0);
+	assert(trie_remove(frozen, "1") == 0);
+	assert(trie_lookup(frozen, "1") == &test_array[1]);
+	assert(trie_iterate(frozen, &iterator) == 0);
+	assert(!trie_iter_has_more(&iterator));
+	trie_iter_free(&iterator);
+
+	/* Freezing a frozen trie copies its buffer */
+	assert(trie_frozen_size(frozen) == size);
+	copy = malloc(size);
+	assert(trie_freeze(frozen, copy) == size);
+	assert(memcmp(copy, buffer, size) == 0);
+	trie_free(frozen);
+
+	/* Buffers that do not hold a frozen trie */
+	assert(trie_new_frozen(copy, 15, values) == NULL);
+	assert(trie_new_frozen(copy, size - 1, values) == NULL);
+	copy[0] ^= 1;
+	assert(trie_new_frozen(copy, size, values) == NULL);
+	copy[0] ^= 1;
+
+	/* A buffer with its end cut off is never read past the end */
+	memcpy(copy, buffer, size / 2);
+	copy = realloc(copy, size / 2);
+	copy[12] = (unsigned char) ((size / 2) & 0xff);
+	copy[13] = (unsigned char) (((size / 2) >> 8) & 0xff);
+	copy[14] = (unsigned char) (((size / 2) >> 16) & 0xff);
+	frozen = trie_new_frozen(copy, size / 2, values);
+	assert(frozen != NULL);
+
+	for (i = 0; i < NUM_TEST_VALUES; ++i) {
+		assert(trie_lookup(frozen, test_strings[i]) == &test_array[i]
+		    || trie_lookup(frozen, test_strings[i]) == NULL);
+	}
+
+	trie_free(frozen);
+	free(copy);
+	free(buffer);
+	free(values);
+
+	/* An empty trie */
+	trie = trie_new();
+	size = trie_frozen_size(trie);
+	buffer = malloc(size);
+	assert(trie_freeze(trie, buffer) == size);
+	trie_free(trie);
+
+	frozen = trie_new_frozen(buffer, size, NULL);
+	assert(frozen != NULL);
+	assert(trie_num_entries(frozen) == 0);
+	assert(trie_lookup(frozen, "") == NULL);
+	assert(trie_lookup(frozen, "a") == NULL);
+	trie_free(frozen);
+	free(buffer);
+
+	/* Test out of memory scenario */
+	trie = generate_trie();
+	size = trie_frozen_size(trie);
+	buffer = malloc(size);
+	assert(trie_freeze(trie, buffer) == size);
+	alloc_test_set_limit(0);
+	assert(trie_new_frozen(buffer, size, NULL) == NULL);
+	alloc_test_set_limit(-1);
+	trie_free(trie);
+	free(buffer);
+}
+
 /* clang-format off */
 static UnitTestFunction tests[] = {
 	test_trie_new_free,
@@ -359,6 +977,14 @@ static UnitTestFunction tests[] = {
 	test_trie_insert_binary,
 	test_trie_insert_out_of_memory,
 	test_trie_remove_binary,
+	test_trie_compressed_labels,
+	test_trie_node_sizes,
+	test_trie_iterate,
+	test_trie_iterate_binary,
+	test_trie_longest_prefix,
+	test_trie_pooled,
+	test_trie_lookup_many,
+	test_trie_freeze,
 	NULL
 };
 /* clang-format on */